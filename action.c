@@ -96,7 +96,12 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
 #include <json.h>
+#ifdef HAVE_SYS_PRCTL_H
+#  include <sys/prctl.h>
+#endif
 
 #include "rsyslog.h"
 #include "dirty.h"
@@ -115,6 +120,8 @@
 #include "ruleset.h"
 #include "parserif.h"
 #include "statsobj.h"
+#include "msgtrace.h"
+#include "executor.h"
 
 /* AIXPORT : cs renamed to legacy_cs as clashes with libpthreads variable in complete file*/
 #ifdef _AIX
@@ -211,7 +218,8 @@ static struct cnfparamdescr cnfparamdescr[] = {
 	{ "action.resumeintervalmax", eCmdHdlrPositiveInt, 0 },
 	{ "action.resumeinterval", eCmdHdlrInt, 0 },
 	{ "action.externalstate.file", eCmdHdlrString, 0 },
-	{ "action.copymsg", eCmdHdlrBinary, 0 }
+	{ "action.copymsg", eCmdHdlrBinary, 0 },
+	{ "action.pipelinedepth", eCmdHdlrNonNegInt, 0 }
 };
 static struct cnfparamblk pblk =
 	{ CNFPARAMBLK_VERSION,
@@ -413,6 +421,7 @@ rsRetVal actionConstruct(action_t **ppThis)
 	pThis->bReportSuspension = -1; /* indicate "not yet set" */
 	pThis->bReportSuspensionCont = -1; /* indicate "not yet set" */
 	pThis->bCopyMsg = 0;
+	pThis->iPipelineDepth = 0;
 	pThis->tLastOccur = datetime.GetTime(NULL);	/* done once per action on startup only */
 	pThis->iActionNbr = iActionNbr;
 	pthread_mutex_init(&pThis->mutErrFile, NULL);
@@ -473,13 +482,13 @@ actionConstructFinalize(action_t *__restrict__ const pThis, struct nvlst *lst)
 	CHKiRet(statsobj.SetName(pThis->statsobj, pThis->pszName));
 	CHKiRet(statsobj.SetOrigin(pThis->statsobj, (uchar*)"core.action"));
 
-	STATSCOUNTER_INIT(pThis->ctrProcessed, pThis->mutCtrProcessed);
+	STATSCOUNTER_STRIPED_INIT(pThis->ctrProcessed);
 	CHKiRet(statsobj.AddCounter(pThis->statsobj, UCHAR_CONSTANT("processed"),
-		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &pThis->ctrProcessed));
+		ctrType_StripedCtr, CTR_FLAG_RESETTABLE, &pThis->ctrProcessed));
 
-	STATSCOUNTER_INIT(pThis->ctrFail, pThis->mutCtrFail);
+	STATSCOUNTER_STRIPED_INIT(pThis->ctrFail);
 	CHKiRet(statsobj.AddCounter(pThis->statsobj, UCHAR_CONSTANT("failed"),
-		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &pThis->ctrFail));
+		ctrType_StripedCtr, CTR_FLAG_RESETTABLE, &pThis->ctrFail));
 
 	STATSCOUNTER_INIT(pThis->ctrSuspend, pThis->mutCtrSuspend);
 	CHKiRet(statsobj.AddCounter(pThis->statsobj, UCHAR_CONSTANT("suspended"),
@@ -584,6 +593,24 @@ actionConstructFinalize(action_t *__restrict__ const pThis, struct nvlst *lst)
 			"that they will have no effect - "
 			"see https://www.rsyslog.com/mm-no-queue/", (char*)modGetName(pThis->pMod));
 	}
+
+	if(pThis->iPipelineDepth > 0
+	   && (!pThis->isTransactional || pThis->pQueue->qType == QUEUETYPE_DIRECT)) {
+		parser_warnmsg("action '%s': action.pipelinedepth requires a transactional "
+			"output module and a non-direct action queue - commit pipelining "
+			"disabled", pThis->pszName);
+		pThis->iPipelineDepth = 0;
+	}
+	if(pThis->iPipelineDepth > 0
+	   && (pThis->pQueue->qType == QUEUETYPE_DISK || pThis->pQueue->pszFilePrefix != NULL)) {
+		/* batches in the pipeline are no longer in the queue, so they
+		 * would not be persisted.
+		 */
+		parser_warnmsg("action '%s': action.pipelinedepth is not supported for "
+			"disk and disk-assisted queues - commit pipelining disabled",
+			pThis->pszName);
+		pThis->iPipelineDepth = 0;
+	}
 	
 	/* and now reset the queue params (see comment in its function header!) */
 	actionResetQueueParams();
@@ -884,7 +911,9 @@ actionDoRetry(action_t * const pThis, wti_t * const pWti)
 			} else {
 				++iRetries;
 				iSleepPeriod = pThis->iResumeInterval;
+				executorBlockBegin();
 				srSleep(iSleepPeriod, 0);
+				executorBlockEnd();
 				if(*pWti->pbShutdownImmediate) {
 					ABORT_FINALIZE(RS_RET_FORCE_TERM);
 				}
@@ -945,7 +974,9 @@ actionDoRetry_extFile(action_t *const pThis, wti_t *const pWti)
 			} else {
 				++iRetries;
 				iSleepPeriod = pThis->iResumeInterval;
+				executorBlockBegin();
 				srSleep(iSleepPeriod, 0);
+				executorBlockEnd();
 				if(*pWti->pbShutdownImmediate) {
 					ABORT_FINALIZE(RS_RET_FORCE_TERM);
 				}
@@ -1188,6 +1219,21 @@ releaseDoActionParams(action_t *__restrict__ const pAction, wti_t *__restrict__
 PRAGMA_DIAGNOSTIC_POP
 
 
+/* free a transactional iparam "cache" - we need to go through to max! */
+void
+actionFreeIParams(action_t *const pAction, actWrkrIParams_t *const iparams, const int maxIParams)
+{
+	int j, k;
+
+	for(j = 0 ; j < maxIParams ; ++j) {
+		for(k = 0 ; k < pAction->iNumTpls ; ++k) {
+			free(actParam(iparams, pAction->iNumTpls, j, k).param);
+		}
+	}
+	free(iparams);
+}
+
+
 /* This is used in resume processing. We only finally know that a resume
  * worked when we have been able to actually process a messages. As such,
  * we need to do some cleanup and status tracking in that case.
@@ -1362,11 +1408,13 @@ static rsRetVal ATTR_NONNULL()
 actionTryCommit(action_t *__restrict__ const pThis, wti_t *__restrict__ const pWti,
 	actWrkrIParams_t *__restrict__ const iparams, const int nparams)
 {
+	uint64_t tStart = 0;
 	DEFiRet;
 
 	DBGPRINTF("actionTryCommit[%s] enter\n", pThis->pszName);
 	CHKiRet(actionPrepare(pThis, pWti));
 
+	tStart = STATSHIST_NOW();
 	CHKiRet(doTransaction(pThis, pWti, iparams, nparams));
 
 	if(getActionState(pWti, pThis) == ACT_STATE_ITX) {
@@ -1402,6 +1450,7 @@ actionTryCommit(action_t *__restrict__ const pThis, wti_t *__restrict__ const pW
 	iRet = getReturnCode(pThis, pWti);
 
 finalize_it:
+	STATSHIST_RECORD_SINCE(pThis->histCommit, tStart);
 	RETiRet;
 }
 
@@ -1667,6 +1716,339 @@ finalize_it:
 	RETiRet;
 }
 
+/* Commit pipelining (action.pipelinedepth).
+ * Usually, the action queue worker renders the templates of a batch and
+ * then commits it, so for network-bound outputs it sits idle while waiting
+ * for the remote side. With pipelining, the worker only renders the batch
+ * and hands the result over to a commit thread. So the next batch is
+ * rendered while the previous one is still being committed. Each worker
+ * has its own pipeline per action, so its batches are committed in order.
+ * At most iPipelineDepth batches may be in flight; if so, the worker waits.
+ *
+ * The commit thread uses a private wti and thus has its own output module
+ * worker instance and action state. Failing commits are handled (retry,
+ * suspension, error file) by actionCommit() on the commit thread. Note that
+ * a batch is deleted from the queue once it is rendered, so up to depth
+ * batches can be lost on a crash. Thus pipelining is not permitted for
+ * disk and disk-assisted queues. If the action is suspended, the worker
+ * does not render, but keeps the batch in the queue, as usual.
+ *
+ * Cancellation: the commit thread can only be cancelled while it calls
+ * the output. This happens if the pipeline is torn down because its worker
+ * is cancelled or if the commit does not finish within the action
+ * completion timeout after an immediate shutdown was requested.
+ */
+
+/* a rendered batch on its way to the commit thread */
+typedef struct actPipelineSlot_s {
+	actWrkrIParams_t *iparams;
+	int nParams;		/* number of rendered messages */
+	int maxIParams;		/* allocated size of iparams */
+} actPipelineSlot_t;
+
+struct actPipeline_s {
+	action_t *pAction;
+	wti_t *pWti;		/* private wti of the commit thread */
+	pthread_t thrdID;
+	pthread_mutex_t mut;
+	pthread_cond_t condBatch;	/* a batch was submitted or we shall stop */
+	pthread_cond_t condSlot;	/* a batch was committed, so its slot is free */
+	int depth;		/* size of slots, copy of pAction->iPipelineDepth */
+	actPipelineSlot_t *slots;	/* ring buffer; free slots keep their buffers for reuse */
+	int head;		/* oldest batch in flight */
+	int nBatches;		/* batches in flight (waiting or being committed) */
+	sbool bStop;		/* commit remaining batches, then terminate */
+	sbool bAbort;		/* terminate without committing remaining batches */
+	sbool bDone;		/* commit thread has terminated its loop */
+	sbool bSuspended;	/* action of commit thread was suspended on last commit */
+};
+
+
+/* cancellation cleanup handler for the commit thread: the slot's buffer
+ * was only lent to the wti, the slot still owns it.
+ */
+static void
+actionPipelineCancelCleanup(void *arg)
+{
+	actWrkrInfo_t *const wrkrInfo = (actWrkrInfo_t*) arg;
+	wrkrInfo->p.tx.iparams = NULL;
+	wrkrInfo->p.tx.maxIParams = 0;
+	wrkrInfo->p.tx.currIParam = 0;
+}
+
+
+static void *
+actionPipelineCommitter(void *const arg)
+{
+	actPipeline_t *const pl = (actPipeline_t*) arg;
+	action_t *const pAction = pl->pAction;
+	actWrkrInfo_t *const wrkrInfo = &(pl->pWti->actWrkrInfo[pAction->iActionNbr]);
+	actPipelineSlot_t *slot;
+	sigset_t sigSet;
+	int iCancelStateSave;
+#	if defined(HAVE_PRCTL) && defined(PR_SET_NAME)
+	char thrdName[16];
+#	endif
+
+	/* block all signals except SIGTTIN and SIGSEGV, just like queue workers */
+	sigfillset(&sigSet);
+	sigdelset(&sigSet, SIGTTIN);
+	sigdelset(&sigSet, SIGSEGV);
+	pthread_sigmask(SIG_BLOCK, &sigSet, NULL);
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+#	if defined(HAVE_PRCTL) && defined(PR_SET_NAME)
+	snprintf(thrdName, sizeof(thrdName), "rs:commit/%d", pAction->iActionNbr);
+	if(prctl(PR_SET_NAME, thrdName, 0, 0, 0) != 0) {
+		DBGPRINTF("prctl failed, not setting thread name for '%s'\n", thrdName);
+	}
+#	endif
+	dbgSetThrdName(wtiGetDbgHdr(pl->pWti));
+
+	wrkrInfo->pAction = pAction;
+	pthread_mutex_lock(&pl->mut);
+	while(1) {
+		while(pl->nBatches == 0 && !pl->bStop)
+			pthread_cond_wait(&pl->condBatch, &pl->mut);
+		if(pl->nBatches == 0 || pl->bAbort)
+			break; /* stop requested and everything committed - or abort */
+		slot = &pl->slots[pl->head];
+		pthread_mutex_unlock(&pl->mut);
+
+		/* lend the slot's buffer to our wti, actionCommit() works on it */
+		wrkrInfo->p.tx.iparams = slot->iparams;
+		wrkrInfo->p.tx.maxIParams = slot->maxIParams;
+		wrkrInfo->p.tx.currIParam = slot->nParams;
+		/* at this spot, we may be cancelled */
+		pthread_cleanup_push(actionPipelineCancelCleanup, wrkrInfo);
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &iCancelStateSave);
+		actionCommit(pAction, pl->pWti);
+		pthread_setcancelstate(iCancelStateSave, NULL);
+		pthread_cleanup_pop(1);
+
+		pthread_mutex_lock(&pl->mut);
+		pl->bSuspended = (getActionState(pl->pWti, pAction) == ACT_STATE_SUSP);
+		pl->head = (pl->head + 1) % pl->depth;
+		--pl->nBatches;
+		pthread_cond_signal(&pl->condSlot);
+	}
+	pl->bDone = 1;
+	pthread_cond_signal(&pl->condSlot);
+	pthread_mutex_unlock(&pl->mut);
+
+	DBGPRINTF("action '%s': commit pipeline thread terminating\n", pAction->pszName);
+	return NULL;
+}
+
+
+/* create the commit pipeline of pWti for pAction, including its thread */
+static rsRetVal ATTR_NONNULL()
+actionPipelineConstruct(action_t *const pAction, wti_t *const pWti)
+{
+	actPipeline_t *pl;
+	uchar dbgHdr[128];
+	int r;
+	DEFiRet;
+
+	CHKmalloc(pl = calloc(1, sizeof(actPipeline_t)));
+	pthread_mutex_init(&pl->mut, NULL);
+	pthread_cond_init(&pl->condBatch, NULL);
+	pthread_cond_init(&pl->condSlot, NULL);
+	pl->pAction = pAction;
+	pl->depth = pAction->iPipelineDepth;
+	CHKmalloc(pl->slots = calloc(pl->depth, sizeof(actPipelineSlot_t)));
+
+	snprintf((char*) dbgHdr, sizeof(dbgHdr), "%s/commit", wtiGetDbgHdr(pWti));
+	CHKiRet(wtiConstruct(&pl->pWti));
+	CHKiRet(wtiSetDbgHdr(pl->pWti, dbgHdr, ustrlen(dbgHdr)));
+	CHKiRet(wtiConstructFinalize(pl->pWti));
+	pl->pWti->pbShutdownImmediate = pWti->pbShutdownImmediate;
+
+	if((r = pthread_create(&pl->thrdID, &default_thread_attr, actionPipelineCommitter, pl)) != 0) {
+		if(!pAction->bPipelineErrReported) {
+			LogError(r, RS_RET_ERR, "action '%s': cannot create commit pipeline "
+				"thread, committing without pipelining", pAction->pszName);
+			pAction->bPipelineErrReported = 1;
+		}
+		ABORT_FINALIZE(RS_RET_ERR);
+	}
+	pWti->actWrkrInfo[pAction->iActionNbr].pPipeline = pl;
+	DBGPRINTF("action '%s': commit pipeline with depth %d created for %s\n",
+		pAction->pszName, pl->depth, wtiGetDbgHdr(pWti));
+
+finalize_it:
+	if(iRet != RS_RET_OK && pl != NULL) {
+		if(pl->pWti != NULL)
+			wtiDestruct(&pl->pWti);
+		pthread_mutex_destroy(&pl->mut);
+		pthread_cond_destroy(&pl->condBatch);
+		pthread_cond_destroy(&pl->condSlot);
+		free(pl->slots);
+		free(pl);
+	}
+	RETiRet;
+}
+
+
+/* commit all batches still in flight, then destroy the pipeline. Called
+ * when the owning worker frees its action instances. If an immediate
+ * shutdown is requested and the commit thread does not finish within the
+ * action completion timeout, or if bAbort is set (the worker is being
+ * cancelled), the commit thread is cancelled and remaining batches are
+ * discarded. If the queue is run by the shared executor, nobody applies
+ * the queue shutdown timeout while we wait, so we do that ourselves.
+ */
+void
+actionPipelineDestruct(actPipeline_t *const pl, int bAbort)
+{
+	action_t *const pAction = pl->pAction;
+	actWrkrInfo_t *const wrkrInfo = &(pl->pWti->actWrkrInfo[pAction->iActionNbr]);
+	qqueue_t *const pQueue = pAction->pQueue;
+	struct timespec t;
+	long msWaited = 0;
+	long msImmediate = 0;
+	int i;
+
+	pthread_mutex_lock(&pl->mut);
+	pl->bStop = 1;
+	pthread_cond_signal(&pl->condBatch);
+	while(!pl->bDone && !bAbort) {
+		timeoutComp(&t, 100);
+		pthread_cond_timedwait(&pl->condSlot, &pl->mut, &t);
+		if(*pl->pWti->pbShutdownImmediate) {
+			msImmediate += 100;
+			if(msImmediate > pQueue->toActShutdown)
+				bAbort = 1;
+		} else if(pQueue->bEnqOnly) {
+			msWaited += 100;
+			if(msWaited > pQueue->toQShutdown)
+				*pl->pWti->pbShutdownImmediate = 1;
+		}
+	}
+	if(!pl->bDone) {
+		LogMsg(0, RS_RET_ERR, LOG_WARNING, "action '%s': commit pipeline did not "
+			"terminate, cancelling it - in-flight messages may be lost",
+			pAction->pszName);
+		pl->bAbort = 1;
+		pthread_cond_signal(&pl->condBatch);
+		pthread_cancel(pl->thrdID);
+	}
+	pthread_mutex_unlock(&pl->mut);
+	pthread_join(pl->thrdID, NULL);
+
+	if(pl->bDone) {
+		wtiFreeActWrkrInfo(pl->pWti, pAction->iActionNbr);
+	} else if(wrkrInfo->actWrkrData != NULL) {
+		/* just like for cancelled queue workers, the instance is not freed
+		 * as it may be in an inconsistent state.
+		 */
+		actionRemoveWorker(pAction, wrkrInfo->actWrkrData);
+	}
+	for(i = 0 ; i < pl->depth ; ++i)
+		actionFreeIParams(pl->pAction, pl->slots[i].iparams, pl->slots[i].maxIParams);
+	wtiDestruct(&pl->pWti);
+	pthread_mutex_destroy(&pl->mut);
+	pthread_cond_destroy(&pl->condBatch);
+	pthread_cond_destroy(&pl->condSlot);
+	free(pl->slots);
+	free(pl);
+}
+
+
+/* wait until the pipeline is drained if its action is suspended */
+static sbool
+actionPipelineDrainIfSuspended(actPipeline_t *const pl)
+{
+	sbool bSuspended;
+
+	pthread_mutex_lock(&pl->mut);
+	pthread_cleanup_push(mutexCancelCleanup, &pl->mut);
+	if(pl->bSuspended) {
+		while(pl->nBatches > 0)
+			pthread_cond_wait(&pl->condSlot, &pl->mut);
+	}
+	bSuspended = pl->bSuspended;
+	pthread_cleanup_pop(1);
+	return bSuspended;
+}
+
+
+/* If the action was suspended on the last commit of pWti's pipeline, wait
+ * until the pipeline is drained and then try to resume the action, just like
+ * processMsgMain() does via actionPrepare(). While the pipeline is empty, the
+ * commit thread does not touch its wti, so we can use it.
+ * Returns RS_RET_SUSPENDED if the action is still suspended, in which case
+ * the batch must be kept in the queue.
+ */
+static rsRetVal ATTR_NONNULL()
+actionPipelineChkResume(action_t *const pAction, wti_t *const pWti)
+{
+	actPipeline_t *const pl = pWti->actWrkrInfo[pAction->iActionNbr].pPipeline;
+	DEFiRet;
+
+	if(pl == NULL || !actionPipelineDrainIfSuspended(pl))
+		FINALIZE;
+
+	actionPrepare(pAction, pl->pWti);
+	iRet = getReturnCode(pAction, pl->pWti);
+	if(iRet == RS_RET_SUSPENDED)
+		FINALIZE;
+	pthread_mutex_lock(&pl->mut);
+	pl->bSuspended = 0;
+	pthread_mutex_unlock(&pl->mut);
+	iRet = RS_RET_OK;
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* hand the batch rendered by pWti over to its commit pipeline. If no
+ * pipeline can be created, we commit it ourselves.
+ */
+static rsRetVal ATTR_NONNULL()
+actionPipelineSubmit(action_t *const pAction, wti_t *const pWti)
+{
+	actWrkrInfo_t *const wrkrInfo = &(pWti->actWrkrInfo[pAction->iActionNbr]);
+	actPipeline_t *pl;
+	actPipelineSlot_t *slot;
+	actPipelineSlot_t freeSlot;
+	DEFiRet;
+
+	if(wrkrInfo->p.tx.currIParam == 0)
+		FINALIZE;
+	if(wrkrInfo->pPipeline == NULL && actionPipelineConstruct(pAction, pWti) != RS_RET_OK) {
+		iRet = actionCommit(pAction, pWti);
+		FINALIZE;
+	}
+	pl = wrkrInfo->pPipeline;
+
+	/* we may be cancelled while waiting, wtiWorkerCancelCleanup() then
+	 * tears down the pipeline.
+	 */
+	pthread_mutex_lock(&pl->mut);
+	pthread_cleanup_push(mutexCancelCleanup, &pl->mut);
+	while(pl->nBatches == pl->depth)
+		pthread_cond_wait(&pl->condSlot, &pl->mut);
+	slot = &pl->slots[(pl->head + pl->nBatches) % pl->depth];
+	freeSlot = *slot;
+	slot->iparams = wrkrInfo->p.tx.iparams;
+	slot->maxIParams = wrkrInfo->p.tx.maxIParams;
+	slot->nParams = wrkrInfo->p.tx.currIParam;
+	++pl->nBatches;
+	pthread_cond_signal(&pl->condBatch);
+	pthread_cleanup_pop(1);
+
+	/* render the next batch into the buffer of an already committed one */
+	wrkrInfo->p.tx.iparams = freeSlot.iparams;
+	wrkrInfo->p.tx.maxIParams = freeSlot.maxIParams;
+	wrkrInfo->p.tx.currIParam = 0;
+
+finalize_it:
+	RETiRet;
+}
+
+
 /* This entry point is called by the ACTION queue (not main queue!)
  */
 static rsRetVal ATTR_NONNULL()
@@ -1677,18 +2059,31 @@ processBatchMain(void *__restrict__ const pVoid,
 	action_t *__restrict__ const pAction = (action_t*__restrict__ const) pVoid;
 	int i;
 	struct syslogTime ttNow;
+	int tracedElems[MSGTRACE_MAX_PER_BATCH];	/* traced elements that did not fail */
+	int nTraced = 0;
 	DEFiRet;
 
 	wtiResetExecState(pWti, pBatch);
 	/* indicate we have not yet read the date */
 	ttNow.year = 0;
 
+	if(pAction->iPipelineDepth > 0) {
+		/* we only render, the output is called by the commit thread */
+		pWti->actWrkrInfo[pAction->iActionNbr].pAction = pAction;
+		if(actionPipelineChkResume(pAction, pWti) == RS_RET_SUSPENDED) {
+			DBGPRINTF("action '%s' suspended, keeping batch in queue\n", pAction->pszName);
+			FINALIZE;
+		}
+	}
+
 	for(i = 0 ; i < batchNumMsgs(pBatch) && !*pWti->pbShutdownImmediate ; ++i) {
 		if(batchIsValidElem(pBatch, i)) {
 			/* we do not check error state below, because aborting would be
 			 * more harmful than continuing.
 			 */
-			rsRetVal localRet = processMsgMain(pAction, pWti, pBatch->pElem[i].pMsg, &ttNow);
+			rsRetVal localRet = (pAction->iPipelineDepth > 0)
+				? prepareDoActionParams(pAction, pWti, pBatch->pElem[i].pMsg, &ttNow)
+				: processMsgMain(pAction, pWti, pBatch->pElem[i].pMsg, &ttNow);
 			DBGPRINTF("processBatchMain: i %d, processMsgMain iRet %d\n", i, localRet);
 			if(   localRet == RS_RET_OK
 			   || localRet == RS_RET_DEFER_COMMIT
@@ -1696,11 +2091,27 @@ processBatchMain(void *__restrict__ const pVoid,
 			   || localRet == RS_RET_PREVIOUS_COMMITTED ) {
 				batchSetElemState(pBatch, i, BATCH_STATE_COMM);
 				DBGPRINTF("processBatchMain: i %d, COMM state set\n", i);
+				if(pBatch->pElem[i].pMsg->pTrace != NULL && localRet != RS_RET_ACTION_FAILED
+				   && nTraced < MSGTRACE_MAX_PER_BATCH)
+					tracedElems[nTraced++] = i;
 			}
 		}
 	}
 
-	iRet = actionCommit(pAction, pWti);
+	if(pAction->iPipelineDepth > 0) {
+		iRet = actionPipelineSubmit(pAction, pWti);
+	} else {
+		iRet = actionCommit(pAction, pWti);
+	}
+
+	/* note: with pipelining, this records the hand-off to the commit thread */
+	if(iRet == RS_RET_OK) {
+		for(i = 0 ; i < nTraced ; ++i) {
+			msgtraceCommit(pBatch->pElem[tracedElems[i]].pMsg, pAction->pszName);
+		}
+	}
+
+finalize_it:
 	RETiRet;
 }
 
@@ -1818,10 +2229,17 @@ doSubmitToActionQ(action_t * const pAction, wti_t * const pWti, smsg_t *pMsg)
 		FINALIZE;
 	}
 
-	STATSCOUNTER_INC(pAction->ctrProcessed, pAction->mutCtrProcessed);
+	STATSCOUNTER_STRIPED_INC(pAction->ctrProcessed);
+	MSGTRACE_STAMP(pMsg, MSGTRACE_SUBMIT);
 	if(pAction->pQueue->qType == QUEUETYPE_DIRECT) {
 		ttNow.year = 0;
 		iRet = processMsgMain(pAction, pWti, pMsg, &ttNow);
+		/* for transactional actions, the actual commit happens at the end
+		 * of the batch, so this is slightly early for them.
+		 */
+		if(pMsg->pTrace != NULL && (iRet == RS_RET_OK || iRet == RS_RET_DEFER_COMMIT
+		   || iRet == RS_RET_PREVIOUS_COMMITTED))
+			msgtraceCommit(pMsg, pAction->pszName);
 	} else {/* in this case, we do single submits to the queue.
 		 * TODO: optimize this, we may do at least a multi-submit!
 		 */
@@ -1832,7 +2250,7 @@ doSubmitToActionQ(action_t * const pAction, wti_t * const pWti, smsg_t *pMsg)
 		(iRet == RS_RET_SUSPENDED || iRet == RS_RET_ACTION_FAILED);
 
 	if (iRet == RS_RET_ACTION_FAILED)	/* Increment failed counter */
-		STATSCOUNTER_INC(pAction->ctrFail, pAction->mutCtrFail);
+		STATSCOUNTER_STRIPED_INC(pAction->ctrFail);
 
 	DBGPRINTF("action '%s': set suspended state to %d\n",
 		pAction->pszName, pWti->execState.bPrevWasSuspended);
@@ -1955,6 +2373,14 @@ DEFFUNC_llExecFunc(doActivateActions)
 {
 	rsRetVal localRet;
 	action_t * const pThis = (action_t*) pData;
+	/* latency stats are a global setting, so they are only known now */
+	if(GatherLatencyStats) {
+		STATSHIST_INIT(pThis->histCommit);
+		localRet = statsobj.AddCounter(pThis->statsobj, UCHAR_CONSTANT("commit.latency.us"),
+			ctrType_Histogram, CTR_FLAG_RESETTABLE, &pThis->histCommit);
+		if(localRet != RS_RET_OK)
+			LogError(0, localRet, "error adding commit latency counter, ignored");
+	}
 	localRet = qqueueStart(pThis->pQueue);
 	if(localRet != RS_RET_OK) {
 		LogError(0, localRet, "error starting up action queue");
@@ -2069,6 +2495,8 @@ actionApplyCnfParam(action_t * const pAction, struct cnfparamvals * const pvals)
 			pAction->bReportSuspensionCont = (int) pvals[i].val.d.n;
 		} else if(!strcmp(pblk.descr[i].name, "action.copymsg")) {
 			pAction->bCopyMsg = (int) pvals[i].val.d.n;
+		} else if(!strcmp(pblk.descr[i].name, "action.pipelinedepth")) {
+			pAction->iPipelineDepth = (int) pvals[i].val.d.n;
 		} else if(!strcmp(pblk.descr[i].name, "action.resumeinterval")) {
 			pAction->iResumeInterval = pvals[i].val.d.n;
 		} else if(!strcmp(pblk.descr[i].name, "action.resumeintervalMax")) {
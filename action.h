@@ -50,6 +50,8 @@ struct action_s {
 	sbool	bDisabled;
 	sbool	isTransactional;
 	sbool	bCopyMsg;
+	sbool	bPipelineErrReported; /* pipeline construction failure already logged? */
+	int	iPipelineDepth;	/* max rendered batches in flight per worker, 0 = no commit pipelining */
 	int	iSecsExecOnceInterval; /* if non-zero, minimum seconds to wait until action is executed again */
 	time_t	ttResumeRtry;	/* when is it time to retry the resume? */
 	int	iResumeInterval;/* resume interval for this action */
@@ -87,11 +89,12 @@ struct action_s {
 	int nWrkr;
 	/* for statistics subsystem */
 	statsobj_t *statsobj;
-	STATSCOUNTER_DEF(ctrProcessed, mutCtrProcessed)
-	STATSCOUNTER_DEF(ctrFail, mutCtrFail)
+	STATSCOUNTER_STRIPED_DEF(ctrProcessed) /* updated by all workers */
+	STATSCOUNTER_STRIPED_DEF(ctrFail)
 	STATSCOUNTER_DEF(ctrSuspend, mutCtrSuspend)
 	STATSCOUNTER_DEF(ctrSuspendDuration, mutCtrSuspendDuration)
 	STATSCOUNTER_DEF(ctrResume, mutCtrResume)
+	STATSHIST_DEF(histCommit)	/* duration of transaction commits */
 };
 
 
@@ -113,6 +116,8 @@ rsRetVal actionProcessCnf(struct cnfobj *o);
 void actionCommitAllDirect(wti_t *pWti);
 void actionRemoveWorker(action_t *const pAction, void *const actWrkrData);
 void releaseDoActionParams(action_t * const pAction, wti_t * const pWti, int action_destruct);
+void actionFreeIParams(action_t *const pAction, actWrkrIParams_t *const iparams, const int maxIParams);
+void actionPipelineDestruct(actPipeline_t *const pPipeline, int bAbort);
 
 /* external data */
 extern int iActionNbr;
@@ -237,6 +237,9 @@ cnfobjType2str(const enum cnfobjType ot)
 	case CNFOBJ_DYN_STATS:
 		return "dyn_stats";
 		break;
+	case CNFOBJ_RATELIMITER:
+		return "ratelimiter";
+		break;
 	default:return "error: invalid cnfobjType";
 	}
 }
@@ -2405,6 +2408,28 @@ doFunct_DynInc(struct cnffunc *__restrict__ const func,
 	varFreeMembers(&srcVal);
 }
 
+static void ATTR_NONNULL()
+doFunct_Ratelimit(struct cnffunc *__restrict__ const func,
+	struct svar *__restrict__ const ret,
+	void *__restrict__ const usrptr,
+	wti_t *__restrict__ const pWti)
+{
+	struct svar srcVal;
+	int bMustFree;
+	char *str;
+
+	ret->datatype = 'N';
+	if(func->funcdata == NULL) {
+		ret->d.n = 1; /* no ratelimiter - let the message pass */
+		return;
+	}
+	cnfexprEval(func->expr[1], &srcVal, usrptr, pWti);
+	str = (char*) var2CString(&srcVal, &bMustFree);
+	ret->d.n = keyedratelimitCheck(func->funcdata, (uchar*)str);
+	if(bMustFree) free(str);
+	varFreeMembers(&srcVal);
+}
+
 static void ATTR_NONNULL()
 doFunct_FormatTime(struct cnffunc *__restrict__ const func,
 	struct svar *__restrict__ const ret,
@@ -3399,6 +3424,30 @@ finalize_it:
 	RETiRet;
 }
 
+static rsRetVal
+initFunc_ratelimit(struct cnffunc *func)
+{
+	uchar *cstr = NULL;
+	DEFiRet;
+
+	func->destructable_funcdata = 0;
+	func->funcdata = NULL;
+	if(func->expr[0]->nodetype != 'S') {
+		parser_errmsg("ratelimiter name (param 1) of ratelimit() must be a constant string");
+		FINALIZE;
+	}
+
+	cstr = (uchar*)es_str2cstr(((struct cnfstringval*) func->expr[0])->estr, NULL);
+	if((func->funcdata = keyedratelimitFind(cstr)) == NULL) {
+		parser_errmsg("ratelimiter '%s' not found", cstr);
+		FINALIZE;
+	}
+
+finalize_it:
+	free(cstr);
+	RETiRet;
+}
+
 static rsRetVal
 initFunc_re_match(struct cnffunc *func)
 {
@@ -3566,6 +3615,7 @@ static struct scriptFunct functions[] = {
 	{"prifilt", 1, 1, doFunct_Prifilt, initFunc_prifilt, NULL},
 	{"lookup", 2, 2, doFunct_Lookup, resolveLookupTable, NULL},
 	{"dyn_inc", 2, 2, doFunct_DynInc, initFunc_dyn_stats, NULL},
+	{"ratelimit", 2, 2, doFunct_Ratelimit, initFunc_ratelimit, NULL},
 	{"replace", 3, 3, doFunct_Replace, NULL, NULL},
 	{"wrap", 2, 3, doFunct_Wrap, NULL, NULL},
 	{"random", 1, 1, doFunct_RandomGen, NULL, NULL},
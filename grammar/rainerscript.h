@@ -46,6 +46,7 @@ enum cnfobjType {
 	CNFOBJ_PARSER,
 	CNFOBJ_TIMEZONE,
 	CNFOBJ_DYN_STATS,
+	CNFOBJ_RATELIMITER,
 	CNFOBJ_INVALID = 0
 };
 
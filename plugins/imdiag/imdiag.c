@@ -59,6 +59,7 @@
 #include "lookup.h"
 #include "net.h" /* for permittedPeers, may be removed when this is removed */
 #include "statsobj.h"
+#include "msgtrace.h"
 
 
 MODULE_TYPE_INPUT
@@ -475,6 +476,57 @@ finalize_it:
 	RETiRet;
 }
 
+/* send the most recent message traces (see msgtrace.c), one per line.
+ * Times are given in microseconds relative to parsing. The optional
+ * parameter is the max number of traces to dump.
+ */
+#define MSGTRACE_MAX_DUMP 16
+static rsRetVal
+dumpMsgTrace(uchar *pszCmd, tcps_sess_t *pSess)
+{
+	static const char *const stageNames[MSGTRACE_NUM_STAGES] = { "parse", "ruleset", "submit", "commit" };
+	msgtraceRec_t recs[MSGTRACE_MAX_DUMP];
+	uchar wordBuf[1024];
+	char buf[2048];
+	size_t len = 0;
+	ssize_t lenSend;
+	int nMax;
+	int nRecs;
+	int i, j;
+	DEFiRet;
+
+	getFirstWord(&pszCmd, wordBuf, sizeof(wordBuf), TO_LOWERCASE);
+	nMax = atoi((char*) wordBuf);
+	if(nMax <= 0 || nMax > MSGTRACE_MAX_DUMP)
+		nMax = (wordBuf[0] == '\0') ? 10 : MSGTRACE_MAX_DUMP;
+
+	nRecs = msgtraceGetRecent(recs, nMax);
+	if(nRecs == 0) {
+		CHKiRet(sendResponse(pSess, "no message traces recorded\n"));
+		FINALIZE;
+	}
+
+	buf[0] = '\0';
+	for(i = 0 ; i < nRecs && len < sizeof(buf) ; ++i) {
+		len += snprintf(buf + len, sizeof(buf) - len, "msgtrace id=%llu action=%s",
+			(unsigned long long) recs[i].id, (const char*) recs[i].action);
+		for(j = MSGTRACE_RULESET ; j < MSGTRACE_NUM_STAGES && len < sizeof(buf) ; ++j) {
+			if(recs[i].ts[j] == 0 || recs[i].ts[j] < recs[i].ts[MSGTRACE_PARSE])
+				len += snprintf(buf + len, sizeof(buf) - len, " %s=-", stageNames[j]);
+			else
+				len += snprintf(buf + len, sizeof(buf) - len, " %s=+%lluus", stageNames[j],
+					(unsigned long long) (recs[i].ts[j] - recs[i].ts[MSGTRACE_PARSE]) / 1000);
+		}
+		if(len < sizeof(buf))
+			len += snprintf(buf + len, sizeof(buf) - len, "\n");
+	}
+	lenSend = (len < sizeof(buf)) ? (ssize_t) len : (ssize_t) sizeof(buf) - 1;
+	CHKiRet(netstrm.Send(pSess->pStrm, (uchar*) buf, &lenSend));
+
+finalize_it:
+	RETiRet;
+}
+
 /* Function to handle received messages. This is our core function!
  * rgerhards, 2009-05-24
  */
@@ -517,6 +569,8 @@ OnMsgReceived(tcps_sess_t *const pSess, uchar *const pRcv, const int iLenMsg)
 		CHKiRet(awaitStatsReport(pszMsg, pSess));
 	} else if(!ustrcmp(cmdBuf, UCHAR_CONSTANT("enabledebug"))) {
 		CHKiRet(enableDebug(pSess));
+	} else if(!ustrcmp(cmdBuf, UCHAR_CONSTANT("dumpmsgtrace"))) {
+		CHKiRet(dumpMsgTrace(pszMsg, pSess));
 	} else {
 		dbgprintf("imdiag unkown command '%s'\n", cmdBuf);
 		CHKiRet(sendResponse(pSess, "unkown command '%s'\n", cmdBuf));
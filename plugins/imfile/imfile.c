@@ -64,6 +64,7 @@
 #include "ratelimit.h"
 #include "srUtils.h"
 #include "parserif.h"
+#include "hashtable.h"
 
 #include <regex.h>
 
@@ -97,7 +98,8 @@ static int bLegacyCnfModGlobalsPermitted;/* are legacy module-global config para
 
 #define NUM_MULTISUB 1024 /* default max number of submits */
 #define DFLT_PollInterval 10
-#define INIT_WDMAP_TAB_SIZE 1 /* default wdMap table size - is extended as needed, use 2^x value */
+#define RDPOOL_MAX_LINES 4096 /* max lines a pool reader processes from a file in one go */
+#define INIT_WDMAP_TAB_SIZE 256 /* initial wdMap hash table size - is extended as needed */
 #define ADD_METADATA_UNSPECIFIED -1
 
 /* If set to 1, fileTableDisplay will be compiled and used for debugging */
@@ -191,6 +193,9 @@ struct act_obj_s {
 	ratelimit_t *ratelimiter;
 	multi_submit_t multiSub;
 	int is_symlink;
+	sbool bReadPending;	/* file is queued for reading in the current batch */
+	sbool bReadMore;	/* reader stopped before EOF, file needs to be read again */
+	sbool bHadData;		/* last read had data, reported to bHadFileData by the input thread */
 };
 struct fs_edge_s {
 	fs_node_t *parent;	/* node pointing to this edge */
@@ -213,6 +218,9 @@ struct fs_node_s {
 static rsRetVal persistStrmState(act_obj_t *);
 static rsRetVal resetConfigVariables(uchar __attribute__((unused)) *pp, void __attribute__((unused)) *pVal);
 static rsRetVal ATTR_NONNULL(1) pollFile(act_obj_t *act);
+static void ATTR_NONNULL(1) rdPoolAdd(act_obj_t *const act);
+static void ATTR_NONNULL(1) rdPoolRemove(act_obj_t *const act);
+static void rdPoolRun(void);
 static int ATTR_NONNULL() getBasename(uchar *const __restrict__ basen, uchar *const __restrict__ path);
 static void ATTR_NONNULL() act_obj_unlink(act_obj_t *act);
 static uchar * ATTR_NONNULL(1, 2) getStateFileName(const act_obj_t *, uchar *, const size_t);
@@ -238,11 +246,14 @@ struct modConfData_s {
 	sbool sortFiles;
 	sbool normalizePath;	/* normalize file system pathes (all start with root dir) */
 	sbool haveReadTimeouts;	/* use special processing if read timeouts exist */
+	int nReaderThreads;	/* nbr of reader pool threads, 0 = read in input thread */
+	int eventCoalescingWindow; /* ms to wait for further inotify events before reading files */
 	sbool bHadFileData;	/* actually a global variable:
 				   1 - last call to pollFile() had data
 				   0 - last call to pollFile() had NO data
 				   Must be manually reset to 0 if desired. Helper for
-				   polling mode.
+				   polling mode. Only written by the input thread,
+				   see noteHadData().
 				 */
 };
 static modConfData_t *loadModConf = NULL;/* modConf ptr to use for the current load process */
@@ -252,23 +263,41 @@ static modConfData_t *currModConf = NULL;/* modConf ptr to CURRENT mod conf (run
 
 #ifdef HAVE_INOTIFY_INIT
 /* We need to map watch descriptors to our actual objects. Unfortunately, the
- * inotify API does not provide us with any cookie, so a simple O(1) algorithm
- * cannot be done (what a shame...). We assume that maintaining the array is much
- * less often done than looking it up, so we keep the array sorted by watch descriptor
- * and do a binary search on the wd we get back. This is at least O(log n), which
- * is not too bad for the anticipated use case.
+ * inotify API does not provide us with any cookie, so we keep a hash table
+ * keyed by watch descriptor. With tens of thousands of watched files (and
+ * frequent adds and removes, e.g. container logs), a sorted array became
+ * too costly to maintain.
  */
-struct wd_map_s {
-	int wd;		/* ascending sort key */
-	act_obj_t *act; /* point to related active object */
-};
-typedef struct wd_map_s wd_map_t;
-static wd_map_t *wdmap = NULL;
-static int nWdmap;
-static int allocMaxWdmap;
+static struct hashtable *wdmap = NULL;
 static int ino_fd;	/* fd for inotify calls */
 #endif /* #if HAVE_INOTIFY_INIT -------------------------------------------------- */
 
+/* reader pool: files that need to be read are collected in a batch, so that
+ * each file is read only once per batch, even if we got many events for it.
+ * The batch is then read either by the input thread itself or, if reader
+ * threads are configured, by the pool. The input thread waits until the
+ * whole batch has been read, so active objects cannot go away while a reader
+ * works on them and each file is read by at most one thread at a time, which
+ * preserves per-file order. Pool readers process at most RDPOOL_MAX_LINES
+ * lines per file and batch, so that a single busy file cannot starve the
+ * others; files not yet read to EOF stay in the batch for the next run.
+ */
+static struct {
+	pthread_mutex_t mut;
+	pthread_cond_t wakeup;	/* readers wait here for work */
+	pthread_cond_t done;	/* input thread waits here for batch completion */
+	pthread_t *thrds;
+	int nThrds;		/* nbr of reader threads actually running */
+	sbool bInit;		/* sync objects initialized? */
+	sbool bShutdown;
+	act_obj_t **pending;	/* files to read in current batch */
+	int nPending;
+	int maxPending;		/* size of pending array */
+	int nJobs;		/* nbr of jobs published to the readers */
+	int iNext;		/* next job to hand out */
+	int nDone;		/* nbr of jobs completed */
+} rdPool;
+
 #if defined(OS_SOLARIS) && defined (HAVE_PORT_SOURCE_FILE)
 struct fileinfo {
 	struct file_obj fobj;
@@ -290,7 +319,9 @@ static struct cnfparamdescr modpdescr[] = {
 	{ "sortfiles", eCmdHdlrBinary, 0 },
 	{ "statefile.directory", eCmdHdlrString, 0 },
 	{ "normalizepath", eCmdHdlrBinary, 0 },
-	{ "mode", eCmdHdlrGetWord, 0 }
+	{ "mode", eCmdHdlrGetWord, 0 },
+	{ "readerthreads", eCmdHdlrNonNegInt, 0 },
+	{ "eventcoalescingwindow", eCmdHdlrNonNegInt, 0 }
 };
 static struct cnfparamblk modpblk =
 	{ CNFPARAMBLK_VERSION,
@@ -464,59 +495,51 @@ gen_full_name(const char *const dirname, const char *const name)
 static void
 dbg_wdmapPrint(const char *msg)
 {
-	int i;
-	DBGPRINTF("%s\n", msg);
-	for(i = 0 ; i < nWdmap ; ++i)
-		DBGPRINTF("wdmap[%d]: wd: %d, act %p, name: %s\n",
-			i, wdmap[i].wd, wdmap[i].act, wdmap[i].act->name);
+	DBGPRINTF("%s: wdmap has %u entries\n", msg, hashtable_count(wdmap));
 }
 #endif
 
+static unsigned int
+wdmap_hash(void *k)
+{
+	return (unsigned int) *((int*) k);
+}
+
+static int
+wdmap_keyEq(void *k1, void *k2)
+{
+	return *((int*) k1) == *((int*) k2);
+}
+
 static rsRetVal
 wdmapInit(void)
 {
 	DEFiRet;
-	free(wdmap);
-	CHKmalloc(wdmap = malloc(sizeof(wd_map_t) * INIT_WDMAP_TAB_SIZE));
-	allocMaxWdmap = INIT_WDMAP_TAB_SIZE;
-	nWdmap = 0;
+	if(wdmap != NULL)
+		hashtable_destroy(wdmap, 0);
+	CHKmalloc(wdmap = create_hashtable(INIT_WDMAP_TAB_SIZE, wdmap_hash, wdmap_keyEq, NULL));
 finalize_it:
 	RETiRet;
 }
 
 
-/* note: we search backwards, as inotify tends to return increasing wd's */
 static rsRetVal
 wdmapAdd(int wd, act_obj_t *const act)
 {
-	wd_map_t *newmap;
-	int newmapsize;
-	int i;
+	int *pKey = NULL;
 	DEFiRet;
 
-	for(i = nWdmap-1 ; i >= 0 && wdmap[i].wd > wd ; --i)
-		; 	/* just scan */
-	if(i >= 0 && wdmap[i].wd == wd) {
+	if(hashtable_search(wdmap, &wd) != NULL) {
 		LogError(0, RS_RET_INTERNAL_ERROR, "imfile: wd %d already in wdmap!", wd);
 		ABORT_FINALIZE(RS_RET_FILE_ALREADY_IN_TABLE);
 	}
-	++i;
-	/* i now points to the entry that is to be moved upwards (or end of map) */
-	if(nWdmap == allocMaxWdmap) {
-		newmapsize = 2 * allocMaxWdmap;
-		CHKmalloc(newmap = realloc(wdmap, sizeof(wd_map_t) * newmapsize));
-		// TODO: handle the error more intelligently? At all possible? -- 2013-10-15
-		wdmap = newmap;
-		allocMaxWdmap = newmapsize;
+	CHKmalloc(pKey = malloc(sizeof(int)));
+	*pKey = wd;
+	if(!hashtable_insert(wdmap, pKey, act)) {
+		free(pKey);
+		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
 	}
-	if(i < nWdmap) {
-		/* we need to shift to make room for new entry */
-		memmove(wdmap + i + 1, wdmap + i, sizeof(wd_map_t) * (nWdmap - i));
-	}
-	wdmap[i].wd = wd;
-	wdmap[i].act = act;
-	++nWdmap;
-	DBGPRINTF("add wdmap[%d]: wd %d, act obj %p, path %s\n", i, wd, act, act->name);
+	DBGPRINTF("add wdmap: wd %d, act obj %p, path %s\n", wd, act, act->name);
 
 finalize_it:
 	RETiRet;
@@ -545,48 +568,26 @@ in_setupWatch(act_obj_t *const act, const int is_file)
 done:	return wd;
 }
 
-/* compare function for bsearch() */
-static int
-wdmap_cmp(const void *k, const void *a)
-{
-	int key = *((int*) k);
-	wd_map_t *etry = (wd_map_t*) a;
-	if(key < etry->wd)
-		return -1;
-	else if(key > etry->wd)
-		return 1;
-	else
-		return 0;
-}
-/* looks up a wdmap entry and returns it's index if found
- * or -1 if not found.
+/* looks up the active object for a watch descriptor,
+ * returns NULL if not found.
  */
-static wd_map_t *
+static act_obj_t *
 wdmapLookup(int wd)
 {
-	return bsearch(&wd, wdmap, nWdmap, sizeof(wd_map_t), wdmap_cmp);
+	return (act_obj_t*) hashtable_search(wdmap, &wd);
 }
 
 
 static rsRetVal
-wdmapDel(const int wd)
+wdmapDel(int wd)
 {
-	int i;
 	DEFiRet;
 
-	for(i = 0 ; i < nWdmap && wdmap[i].wd < wd ; ++i)
-		; 	/* just scan */
-	if(i == nWdmap ||  wdmap[i].wd != wd) {
+	if(hashtable_remove(wdmap, &wd) == NULL) {
 		DBGPRINTF("wd %d shall be deleted but not in wdmap!\n", wd);
 		FINALIZE;
 	}
-
-	if(i < nWdmap-1) {
-		/* we need to shift to delete it (see comment at wdmap definition) */
-		memmove(wdmap + i, wdmap + i + 1, sizeof(wd_map_t) * (nWdmap - i - 1));
-	}
-	--nWdmap;
-	DBGPRINTF("wd %d deleted, was idx %d\n", wd, i);
+	DBGPRINTF("wd %d deleted\n", wd);
 
 finalize_it:
 	RETiRet;
@@ -825,7 +826,10 @@ poll_active_files(fs_edge_t *const edge)
 	for(act = edge->active ; act != NULL ; act = act->next) {
 		fen_setupWatch(act);
 		DBGPRINTF("poll_active_files: polling '%s'\n", act->name);
-		pollFile(act);
+		if(runModConf->nReaderThreads > 0 && !act->is_symlink)
+			rdPoolAdd(act); /* read by pool at end of tree walk */
+		else
+			pollFile(act);
 	}
 }
 
@@ -989,6 +993,9 @@ act_obj_destroy(act_obj_t *const act, const int is_deleted)
 			unlink((char*)statefn);
 		}
 	}
+	if(act->bReadPending) {
+		rdPoolRemove(act);
+	}
 	if(act->ratelimiter != NULL) {
 		ratelimitDestruct(act->ratelimiter);
 	}
@@ -1292,13 +1299,14 @@ getStateFileName(const act_obj_t *const act,
 }
 
 
-/* enqueue the read file line as a message. The provided string is
- * not freed - this must be done by the caller.
+/* enqueue the read file line as a message. The line need not be NUL-terminated
+ * and is not freed - this must be done by the caller (if required).
  */
 #define MAX_OFFSET_REPRESENTATION_NUM_BYTES 20
 static rsRetVal ATTR_NONNULL(1,2)
 enqLine(act_obj_t *const act,
-	cstr_t *const __restrict__ cstrLine,
+	const uchar *const __restrict__ line,
+	const size_t msgLen,
 	const int64 strtOffs)
 {
 	DEFiRet;
@@ -1307,7 +1315,6 @@ enqLine(act_obj_t *const act,
 	uchar file_offset[MAX_OFFSET_REPRESENTATION_NUM_BYTES+1];
 	const uchar *metadata_names[2] = {(uchar *)"filename",(uchar *)"fileoffset"} ;
 	const uchar *metadata_values[2] ;
-	const size_t msgLen = cstrLen(cstrLine);
 
 	if(msgLen == 0) {
 		/* we do not process empty lines */
@@ -1322,12 +1329,13 @@ enqLine(act_obj_t *const act,
 		size_t ceeMsgSize = msgLen + CONST_LEN_CEE_COOKIE + 1;
 		char *ceeMsg;
 		CHKmalloc(ceeMsg = malloc(ceeMsgSize));
-		strcpy(ceeMsg, CONST_CEE_COOKIE);
-		strcat(ceeMsg, (char*)rsCStrGetSzStrNoNULL(cstrLine));
+		memcpy(ceeMsg, CONST_CEE_COOKIE, CONST_LEN_CEE_COOKIE);
+		memcpy(ceeMsg + CONST_LEN_CEE_COOKIE, line, msgLen);
+		ceeMsg[ceeMsgSize - 1] = '\0';
 		MsgSetRawMsg(pMsg, ceeMsg, ceeMsgSize);
 		free(ceeMsg);
 	} else {
-		MsgSetRawMsg(pMsg, (char*)rsCStrGetSzStrNoNULL(cstrLine), msgLen);
+		MsgSetRawMsg(pMsg, (const char*)line, msgLen);
 	}
 	MsgSetMSGoffs(pMsg, 0);	/* we do not have a header... */
 	MsgSetHOSTNAME(pMsg, glbl.GetLocalHostName(), ustrlen(glbl.GetLocalHostName()));
@@ -1534,9 +1542,11 @@ static void pollFileCancelCleanup(void *pArg)
 
 /* pollFile needs to be split due to the unfortunate pthread_cancel_push() macros. */
 static rsRetVal ATTR_NONNULL()
-pollFileReal(act_obj_t *act, cstr_t **pCStr)
+pollFileReal(act_obj_t *act, cstr_t **pCStr, const int maxLines)
 {
 	int64 strtOffs;
+	const uchar *pLine = NULL;
+	size_t lenLine = 0;
 	DEFiRet;
 	int64_t startOffs = 0;
 	int nProcessed = 0;
@@ -1547,6 +1557,9 @@ pollFileReal(act_obj_t *act, cstr_t **pCStr)
 	DBGPRINTF("pollFileReal enter, edge->instarr %p\n", act->edge->instarr);
 
 	instanceConf_t *const inst = act->edge->instarr[0];// TODO: same file, multiple instances?
+	int maxLinesAtOnce = inst->maxLinesAtOnce;
+	if(maxLines > 0 && (maxLinesAtOnce == 0 || maxLines < maxLinesAtOnce))
+		maxLinesAtOnce = maxLines;
 
 	if(act->pStrm == NULL) {
 		CHKiRet(openFile(act)); /* open file */
@@ -1558,9 +1571,15 @@ pollFileReal(act_obj_t *act, cstr_t **pCStr)
 	startOffs = act->pStrm->iCurrOffs;
 	/* loop below will be exited when strmReadLine() returns EOF */
 	while(glbl.GetGlobalInputTermState() == 0) {
-		if(inst->maxLinesAtOnce != 0 && nProcessed >= inst->maxLinesAtOnce)
+		if(maxLinesAtOnce != 0 && nProcessed >= maxLinesAtOnce)
 			break;
-		if((start_preg == NULL) && (end_preg == NULL)) {
+		if((start_preg == NULL) && (end_preg == NULL) && inst->readMode == 0) {
+			/* most common case: hand the line from the read buffer directly
+			 * to enqLine(), without going through an intermediate cstr.
+			 */
+			CHKiRet(strm.ReadLineDirect(act->pStrm, pCStr, &pLine, &lenLine,
+				inst->trimLineOverBytes, &strtOffs));
+		} else if((start_preg == NULL) && (end_preg == NULL)) {
 			CHKiRet(strm.ReadLine(act->pStrm, pCStr, inst->readMode, inst->escapeLF, inst->escapeLFString,
 				inst->trimLineOverBytes, &strtOffs));
 		} else {
@@ -1575,9 +1594,15 @@ pollFileReal(act_obj_t *act, cstr_t **pCStr)
 			persistStrmState(act);
 			startOffs = act->pStrm->iCurrOffs; /* disable check */
 		}
-		runModConf->bHadFileData = 1; /* this is just a flag, so set it and forget it */
-		CHKiRet(enqLine(act, *pCStr, strtOffs)); /* process line */
-		rsCStrDestruct(pCStr); /* discard string (must be done by us!) */
+		act->bHadData = 1; /* may run on a reader thread, see noteHadData() */
+		if(*pCStr != NULL) {
+			pLine = rsCStrGetSzStrNoNULL(*pCStr);
+			lenLine = cstrLen(*pCStr);
+		}
+		CHKiRet(enqLine(act, pLine, lenLine, strtOffs)); /* process line */
+		if(*pCStr != NULL) {
+			rsCStrDestruct(pCStr); /* discard string (must be done by us!) */
+		}
 		if(inst->iPersistStateInterval > 0 && ++act->nRecords >= inst->iPersistStateInterval) {
 			persistStrmState(act);
 			act->nRecords = 0;
@@ -1594,9 +1619,13 @@ finalize_it:
 	RETiRet;
 }
 
-/* poll a file, need to check file rollover etc. open file if not open */
+/* poll a file, need to check file rollover etc. open file if not open.
+ * If maxLines is non-zero, at most that many lines are processed (in
+ * addition to maxLinesAtOnce); RS_RET_OK is then returned if we stopped
+ * before reaching EOF.
+ */
 static rsRetVal ATTR_NONNULL(1)
-pollFile(act_obj_t *const act)
+pollFileLimited(act_obj_t *const act, const int maxLines)
 {
 	cstr_t *pCStr = NULL;
 	DEFiRet;
@@ -1607,12 +1636,229 @@ pollFile(act_obj_t *const act)
 	 * otherwise do not work if I include the _cleanup_pop() inside an if... -- rgerhards, 2008-08-14
 	 */
 	pthread_cleanup_push(pollFileCancelCleanup, &pCStr);
-	iRet = pollFileReal(act, &pCStr);
+	iRet = pollFileReal(act, &pCStr, maxLines);
 	pthread_cleanup_pop(0);
 finalize_it: RETiRet;
 }
 
 
+/* carry the "had data" flag of a file over to the module. Must be called by
+ * the input thread, after the file has been read.
+ */
+static void ATTR_NONNULL(1)
+noteHadData(act_obj_t *const act)
+{
+	if(act->bHadData) {
+		runModConf->bHadFileData = 1; /* this is just a flag, so set it and forget it */
+		act->bHadData = 0;
+	}
+}
+
+
+/* poll a file on the input thread */
+static rsRetVal ATTR_NONNULL(1)
+pollFile(act_obj_t *const act)
+{
+	DEFiRet;
+	iRet = pollFileLimited(act, 0);
+	noteHadData(act);
+	RETiRet;
+}
+
+
+/* add a file to the current read batch. Files already in it are not
+ * added again, so multiple events for the same file result in a single read.
+ */
+static void ATTR_NONNULL(1)
+rdPoolAdd(act_obj_t *const act)
+{
+	act_obj_t **newPending;
+	int newMax;
+
+	if(act->bReadPending)
+		return;
+	if(rdPool.nPending == rdPool.maxPending) {
+		newMax = (rdPool.maxPending == 0) ? 64 : 2 * rdPool.maxPending;
+		newPending = realloc(rdPool.pending, sizeof(act_obj_t*) * newMax);
+		if(newPending == NULL) {
+			/* we cannot batch it, so read it right away */
+			pollFile(act);
+			return;
+		}
+		rdPool.pending = newPending;
+		rdPool.maxPending = newMax;
+	}
+	act->bReadPending = 1;
+	rdPool.pending[rdPool.nPending++] = act;
+}
+
+
+/* pick up the next job and process it. Must be called with the pool
+ * mutex locked, returns with it locked.
+ */
+static void
+rdPoolDoJob(void)
+{
+	act_obj_t *const act = rdPool.pending[rdPool.iNext++];
+	pthread_mutex_unlock(&rdPool.mut);
+	act->bReadMore = (pollFileLimited(act, RDPOOL_MAX_LINES) == RS_RET_OK);
+	pthread_mutex_lock(&rdPool.mut);
+	if(++rdPool.nDone == rdPool.nJobs)
+		pthread_cond_signal(&rdPool.done);
+}
+
+
+/* the reader thread */
+static void *
+rdPoolThrd(void __attribute__((unused)) *arg)
+{
+	dbgSetThrdName((uchar*) "imfile reader");
+	pthread_mutex_lock(&rdPool.mut);
+	while(1) {
+		while(!rdPool.bShutdown && rdPool.iNext >= rdPool.nJobs)
+			pthread_cond_wait(&rdPool.wakeup, &rdPool.mut);
+		if(rdPool.bShutdown)
+			break;
+		rdPoolDoJob();
+	}
+	pthread_mutex_unlock(&rdPool.mut);
+	return NULL;
+}
+
+
+/* remove a file from the current batch. This is needed when an active
+ * object is destroyed while it is still queued for reading.
+ */
+static void ATTR_NONNULL(1)
+rdPoolRemove(act_obj_t *const act)
+{
+	int i;
+
+	for(i = 0 ; i < rdPool.nPending ; ++i) {
+		if(rdPool.pending[i] == act) {
+			memmove(rdPool.pending + i, rdPool.pending + i + 1,
+				sizeof(act_obj_t*) * (rdPool.nPending - i - 1));
+			--rdPool.nPending;
+			break;
+		}
+	}
+	act->bReadPending = 0;
+}
+
+
+/* read all files of the current batch. Returns only after all of them
+ * have been read. The input thread helps the readers while it waits.
+ * Files that still have data (see RDPOOL_MAX_LINES) remain in the batch.
+ * The input thread must not be cancelled while the readers work, as the
+ * pool mutex would stay locked and the file objects would be freed under
+ * the readers' feet. This is fine, as readers stop at termination.
+ */
+static void
+rdPoolRun(void)
+{
+	act_obj_t *act;
+	int iCancelStateSave;
+	int i;
+	int n;
+
+	if(rdPool.nPending == 0)
+		return;
+	DBGPRINTF("imfile: reading batch of %d files\n", rdPool.nPending);
+
+	if(rdPool.nThrds == 0) {
+		for(i = 0 ; i < rdPool.nPending ; ++i) {
+			pollFile(rdPool.pending[i]);
+			rdPool.pending[i]->bReadMore = 0;
+		}
+	} else if(rdPool.nPending == 1) {
+		act = rdPool.pending[0];
+		act->bReadMore = (pollFileLimited(act, RDPOOL_MAX_LINES) == RS_RET_OK);
+	} else {
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &iCancelStateSave);
+		pthread_mutex_lock(&rdPool.mut);
+		rdPool.iNext = 0;
+		rdPool.nDone = 0;
+		rdPool.nJobs = rdPool.nPending;
+		pthread_cond_broadcast(&rdPool.wakeup);
+		while(rdPool.iNext < rdPool.nJobs)
+			rdPoolDoJob();
+		while(rdPool.nDone < rdPool.nJobs)
+			pthread_cond_wait(&rdPool.done, &rdPool.mut);
+		rdPool.nJobs = 0;
+		rdPool.iNext = 0;
+		pthread_mutex_unlock(&rdPool.mut);
+		pthread_setcancelstate(iCancelStateSave, NULL);
+	}
+
+	n = 0;
+	for(i = 0 ; i < rdPool.nPending ; ++i) {
+		act = rdPool.pending[i];
+		noteHadData(act);
+		if(act->bReadMore && glbl.GetGlobalInputTermState() == 0)
+			rdPool.pending[n++] = act;
+		else
+			act->bReadPending = 0;
+	}
+	rdPool.nPending = n;
+}
+
+
+/* start reader threads, if configured. If not all of them can be
+ * started, we run with the ones we got (maybe none at all).
+ */
+static void
+rdPoolStart(void)
+{
+	int r;
+
+	memset(&rdPool, 0, sizeof(rdPool));
+	if(runModConf->nReaderThreads == 0)
+		return;
+	if((rdPool.thrds = calloc(runModConf->nReaderThreads, sizeof(pthread_t))) == NULL)
+		return;
+	pthread_mutex_init(&rdPool.mut, NULL);
+	pthread_cond_init(&rdPool.wakeup, NULL);
+	pthread_cond_init(&rdPool.done, NULL);
+	rdPool.bInit = 1;
+	while(rdPool.nThrds < runModConf->nReaderThreads) {
+		r = pthread_create(&rdPool.thrds[rdPool.nThrds], NULL, rdPoolThrd, NULL);
+		if(r != 0) {
+			LogError(r, RS_RET_ERR, "imfile: cannot create reader thread %d of %d",
+				rdPool.nThrds + 1, runModConf->nReaderThreads);
+			break;
+		}
+		++rdPool.nThrds;
+	}
+	DBGPRINTF("imfile: %d reader threads started\n", rdPool.nThrds);
+}
+
+
+/* read what is still pending and stop the reader threads */
+static void
+rdPoolStop(void)
+{
+	int i;
+
+	rdPoolRun();
+	if(rdPool.bInit) {
+		pthread_mutex_lock(&rdPool.mut);
+		rdPool.bShutdown = 1;
+		pthread_cond_broadcast(&rdPool.wakeup);
+		pthread_mutex_unlock(&rdPool.mut);
+		for(i = 0 ; i < rdPool.nThrds ; ++i)
+			pthread_join(rdPool.thrds[i], NULL);
+		pthread_mutex_destroy(&rdPool.mut);
+		pthread_cond_destroy(&rdPool.wakeup);
+		pthread_cond_destroy(&rdPool.done);
+	}
+	for(i = 0 ; i < rdPool.nPending ; ++i)
+		rdPool.pending[i]->bReadPending = 0;
+	free(rdPool.thrds);
+	free(rdPool.pending);
+	memset(&rdPool, 0, sizeof(rdPool));
+}
+
+
 /* create input instance, set default parameters, and
  * add it to the list of instances.
  */
@@ -1948,6 +2194,8 @@ CODESTARTbeginCnfLoad
 	loadModConf->haveReadTimeouts = 0; /* default: no timeout */
 	loadModConf->normalizePath = 1;
 	loadModConf->sortFiles = GLOB_NOSORT;
+	loadModConf->nReaderThreads = 0;
+	loadModConf->eventCoalescingWindow = 0;
 	loadModConf->stateFileDirectory = NULL;
 	loadModConf->conf_tree = calloc(sizeof(fs_node_t), 1);
 	loadModConf->conf_tree->edges = NULL;
@@ -2006,6 +2254,10 @@ CODESTARTsetModCnf
 			loadModConf->stateFileDirectory = (uchar*)es_str2cstr(pvals[i].val.d.estr, NULL);
 		} else if(!strcmp(modpblk.descr[i].name, "normalizepath")) {
 			loadModConf->normalizePath = (sbool) pvals[i].val.d.n;
+		} else if(!strcmp(modpblk.descr[i].name, "readerthreads")) {
+			loadModConf->nReaderThreads = (int) pvals[i].val.d.n;
+		} else if(!strcmp(modpblk.descr[i].name, "eventcoalescingwindow")) {
+			loadModConf->eventCoalescingWindow = (int) pvals[i].val.d.n;
 		} else if(!strcmp(modpblk.descr[i].name, "mode")) {
 			if(!es_strconstcmp(pvals[i].val.d.estr, "polling"))
 				loadModConf->opMode = OPMODE_POLLING;
@@ -2179,12 +2431,15 @@ static rsRetVal
 doPolling(void)
 {
 	DEFiRet;
+	rdPoolStart();
 	do_initial_poll_run();
+	rdPoolRun();
 	while(glbl.GetGlobalInputTermState() == 0) {
 		DBGPRINTF("doPolling: new poll run\n");
 		do {
 			runModConf->bHadFileData = 0;
 			fs_node_walk(runModConf->conf_tree, poll_tree);
+			rdPoolRun();
 			DBGPRINTF("doPolling: end poll walk, hadData %d\n", runModConf->bHadFileData);
 		} while(runModConf->bHadFileData); /* warning: do...while()! */
 
@@ -2198,6 +2453,7 @@ doPolling(void)
 			srSleep(runModConf->iPollInterval, 10);
 	}
 
+	rdPoolStop();
 	RETiRet;
 }
 
@@ -2254,11 +2510,11 @@ in_dbg_showEv(const struct inotify_event *ev)
 
 
 static void ATTR_NONNULL(1, 2)
-in_handleFileEvent(struct inotify_event *ev, const wd_map_t *const etry)
+in_handleFileEvent(struct inotify_event *ev, act_obj_t *const act)
 {
 	if(ev->mask & IN_MODIFY) {
-		DBGPRINTF("fs_node_notify_file_update: act->name '%s'\n", etry->act->name);
-		pollFile(etry->act);
+		DBGPRINTF("fs_node_notify_file_update: act->name '%s'\n", act->name);
+		rdPoolAdd(act); /* read at end of event batch */
 	} else {
 		DBGPRINTF("got non-expected inotify event:\n");
 		in_dbg_showEv(ev);
@@ -2299,26 +2555,29 @@ in_processEvent(struct inotify_event *ev)
 	}
 
 	DBGPRINTF("in_processEvent process Event %x for %s\n", ev->mask, ev->name);
-	const wd_map_t *const etry =  wdmapLookup(ev->wd);
-	if(etry == NULL) {
+	act_obj_t *const act = wdmapLookup(ev->wd);
+	if(act == NULL) {
 		LogMsg(0, RS_RET_INTERNAL_ERROR, LOG_WARNING, "imfile: internal error? "
 			"inotify provided watch descriptor %d which we could not find "
 			"in our tables - ignored", ev->wd);
 		goto done;
 	}
 	DBGPRINTF("in_processEvent process Event %x is_file %d, act->name '%s'\n",
-		ev->mask, etry->act->edge->is_file, etry->act->name);
+		ev->mask, act->edge->is_file, act->name);
 
-	if((ev->mask & IN_MOVED_FROM)) {
-		flag_in_move(etry->act->edge->node->edges, ev->name);
+	if(act->edge->is_file && !(act->is_symlink) && !(ev->mask & (IN_MOVED_FROM | IN_MOVED_TO))) {
+		in_handleFileEvent(ev, act); // esentially poll_file()!
+		goto done;
 	}
-	if(ev->mask & (IN_MOVED_FROM | IN_MOVED_TO))  {
-		fs_node_walk(etry->act->edge->node, poll_tree);
-	} else if(etry->act->edge->is_file && !(etry->act->is_symlink)) {
-		in_handleFileEvent(ev, etry); // esentially poll_file()!
-	} else {
-		fs_node_walk(etry->act->edge->node, poll_tree);
+
+	/* the tree walk may destroy active objects, so files that are
+	 * still pending must be read before.
+	 */
+	rdPoolRun();
+	if((ev->mask & IN_MOVED_FROM)) {
+		flag_in_move(act->edge->node->edges, ev->name);
 	}
+	fs_node_walk(act->edge->node, poll_tree);
 done:	return;
 }
 
@@ -2327,13 +2586,54 @@ done:	return;
 PRAGMA_DIAGNOSTIC_PUSH
 PRAGMA_IGNORE_Wcast_align
 /* Problem with the warnings: they seem to stem back from the way the API is structured */
+/* process all events inside an inotify read buffer */
+static void
+in_processEvents(char *const iobuf, const int rd)
+{
+	struct inotify_event *ev;
+	int currev = 0;
+
+	while(currev < rd) {
+		ev = (struct inotify_event*) (iobuf+currev);
+		in_dbg_showEv(ev);
+		in_processEvent(ev);
+		currev += sizeof(struct inotify_event) + ev->len;
+	}
+}
+
+
+/* if configured, wait up to the coalescing window for further events, so
+ * that files written to in quick succession are read only once.
+ */
+static void
+in_coalesceEvents(char *const iobuf, const size_t lenIobuf)
+{
+	struct timespec tEnd;
+	struct pollfd pollfd;
+	long toWait;
+	int rd;
+
+	if(runModConf->eventCoalescingWindow == 0)
+		return;
+	timeoutComp(&tEnd, runModConf->eventCoalescingWindow);
+	pollfd.fd = ino_fd;
+	pollfd.events = POLLIN;
+	while(glbl.GetGlobalInputTermState() == 0 && (toWait = timeoutVal(&tEnd)) > 0) {
+		if(poll(&pollfd, 1, toWait) != 1)
+			break;
+		rd = read(ino_fd, iobuf, lenIobuf);
+		if(rd <= 0)
+			break;
+		in_processEvents(iobuf, rd);
+	}
+}
+
+
 static rsRetVal
 do_inotify(void)
 {
-	char iobuf[8192];
-	struct inotify_event *ev;
+	char iobuf[65536] __attribute__((aligned(__alignof__(struct inotify_event))));
 	int rd;
-	int currev;
 	DEFiRet;
 
 	CHKiRet(wdmapInit());
@@ -2345,10 +2645,22 @@ do_inotify(void)
 	}
 	DBGPRINTF("inotify fd %d\n", ino_fd);
 
+	rdPoolStart();
 	do_initial_poll_run();
 
 	while(glbl.GetGlobalInputTermState() == 0) {
-		if(runModConf->haveReadTimeouts) {
+		if(rdPool.nPending > 0) {
+			/* some files still have unread data, so we must not block
+			 * waiting for new events - only pick up those already there.
+			 */
+			struct pollfd pollfd;
+			pollfd.fd = ino_fd;
+			pollfd.events = POLLIN;
+			if(poll(&pollfd, 1, 0) != 1) {
+				rdPoolRun();
+				continue;
+			}
+		} else if(runModConf->haveReadTimeouts) {
 			int r;
 			struct pollfd pollfd;
 			pollfd.fd = ino_fd;
@@ -2384,16 +2696,13 @@ do_inotify(void)
 			LogError(errno, RS_RET_IO_ERROR, "imfile: error during inotify - ignored");
 			continue;
 		}
-		currev = 0;
-		while(currev < rd) {
-			ev = (struct inotify_event*) (iobuf+currev);
-			in_dbg_showEv(ev);
-			in_processEvent(ev);
-			currev += sizeof(struct inotify_event) + ev->len;
-		}
+		in_processEvents(iobuf, rd);
+		in_coalesceEvents(iobuf, sizeof(iobuf));
+		rdPoolRun();
 	}
 
 finalize_it:
+	rdPoolStop();
 	close(ino_fd);
 	RETiRet;
 }
@@ -2696,6 +3005,8 @@ finalize_it:
  */
 BEGINafterRun
 CODESTARTafterRun
+	/* the input thread may have been cancelled before it could stop the pool */
+	rdPoolStop();
 	if(pInputName != NULL)
 		prop.Destruct(&pInputName);
 ENDafterRun
@@ -2721,7 +3032,10 @@ CODESTARTmodExit
 	objRelease(ruleset, CORE_COMPONENT);
 
 	#ifdef HAVE_INOTIFY_INIT
-	free(wdmap);
+	if(wdmap != NULL) {
+		hashtable_destroy(wdmap, 0);
+		wdmap = NULL;
+	}
 	#endif
 ENDmodExit
 
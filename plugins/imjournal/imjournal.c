@@ -30,10 +30,12 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <time.h>
 #include <sys/poll.h>
 #include <sys/socket.h>
 #include <errno.h>
+#include <pthread.h>
 #include <systemd/sd-journal.h>
 
 #include "dirty.h"
@@ -84,6 +86,8 @@ static struct configSettings_s {
 	int bWorkAroundJournalBug; /* deprecated, left for backwards compatibility only */
 	int bFsync;
 	int bRemote;
+	int iBatchSize;
+	int iPersistStatePeriod;
 } cs;
 
 static rsRetVal facilityHdlr(uchar **pp, void *pVal);
@@ -102,7 +106,9 @@ static struct cnfparamdescr modpdescr[] = {
 	{ "usepid", eCmdHdlrString, 0 },
 	{ "workaroundjournalbug", eCmdHdlrBinary, 0 },
 	{ "fsync", eCmdHdlrBinary, 0 },
-	{ "remote", eCmdHdlrBinary, 0 }
+	{ "remote", eCmdHdlrBinary, 0 },
+	{ "batchsize", eCmdHdlrPositiveInt, 0 },
+	{ "persiststateperiod", eCmdHdlrNonNegInt, 0 }
 };
 static struct cnfparamblk modpblk =
 	{ CNFPARAMBLK_VERSION,
@@ -111,6 +117,8 @@ static struct cnfparamblk modpblk =
 	};
 
 #define DFLT_persiststateinterval 10
+#define DFLT_batchsize 1
+#define MAX_batchsize 1024 /* multi_submit_t can only hold a short number of elements */
 #define DFLT_SEVERITY pri2sev(LOG_NOTICE)
 #define DFLT_FACILITY pri2fac(LOG_USER)
 
@@ -142,6 +150,18 @@ struct journalContext_s { /* structure encapsulating all the journald_API-relate
 };
 static struct journalContext_s journalContext = {NULL, 0, 1, NULL};
 
+/* The cursor is updated by the input thread, but may be persisted by the
+ * state persistence thread (see persiststateperiod). This mutex guards it.
+ */
+static pthread_mutex_t mutCursor = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+	pthread_t tid;
+	pthread_cond_t wakeup;
+	sbool bRunning;
+	sbool bStop;
+	sbool bCursorChanged; /* cursor changed since last persist? */
+} persister;
+
 #define J_PROCESS_PERIOD 1024  /* Call sd_journal_process() every 1,024 records */
 
 static rsRetVal persistJournalState(void);
@@ -175,24 +195,6 @@ static void closeJournal(void) {
 	journalContext.j = NULL; /* setting to NULL here as journald API will not do that for us... */
 }
 
-static int journalGetData(const char *field, const void **data, size_t *length)
-{
-	int ret;
-
-	ret = sd_journal_get_data(journalContext.j, field, data, length);
-	if (ret == -EADDRNOTAVAIL) {
-		LogError(-ret, RS_RET_ERR, "imjournal: Tried to get data without a 'next' call.\n");
-		if ((ret = sd_journal_next(journalContext.j)) < 0) {
-			LogError(-ret, RS_RET_ERR, "imjournal: sd_journal_next() failed\n");
-		} else {
-			ret = sd_journal_get_data(journalContext.j, field, data, length);
-		}
-	}
-
-	return ret;
-}
-
-
 /* ugly workaround to handle facility numbers; values
  * derived from names need to be eight times smaller,
  * i.e.: 0..23
@@ -251,10 +253,66 @@ finalize_it:
 }
 
 
-/* Read JSON part of single journald message and return it as JSON object
+/* well-known fields of a journal entry, which we need for the message
+ * properties. They are obtained during the single pass over the entry
+ * data which also builds the JSON object.
+ */
+struct jrnlFields_s {
+	char *message;
+	char *sys_iden;
+	char *sys_pid;
+	char *pid; /* _PID, for usepid="both" fallback */
+	int severity;
+	int facility;
+};
+
+#define FIELD_IS(name, get, prefixlen) \
+	((size_t) (prefixlen) == sizeof(name) - 1 && !memcmp((get), (name), sizeof(name) - 1))
+
+static void
+parseSeverity(struct jrnlFields_s *const fields, const char *const val, const size_t len)
+{
+	if (len == 1) {
+		fields->severity = val[0] - '0';
+		if (fields->severity < 0 || 7 < fields->severity) {
+			LogError(0, RS_RET_ERR, "imjournal: the value of the 'PRIORITY' field is "
+				"out of bounds: %d, resetting", fields->severity);
+			fields->severity = cs.iDfltSeverity;
+		}
+	} else {
+		LogError(0, RS_RET_ERR, "The value of the 'PRIORITY' field has an "
+			"unexpected length: %zu\n", len + 9);
+	}
+}
+
+static void
+parseFacility(struct jrnlFields_s *const fields, const char *const val, const size_t len)
+{
+	// Note: the journal frequently contains invalid facilities!
+	if (len == 1 || len == 2) {
+		fields->facility = val[0] - '0';
+		if (len == 2) {
+			fields->facility *= 10;
+			fields->facility += val[1] - '0';
+		}
+		if (fields->facility < 0 || 23 < fields->facility) {
+			DBGPRINTF("The value of the 'FACILITY' field is "
+				"out of bounds: %d, resetting\n", fields->facility);
+			fields->facility = cs.iDfltFacility;
+		}
+	} else {
+		DBGPRINTF("The value of the 'FACILITY' field has an "
+			"unexpected length: %zu value: '%.*s'\n", len + 16, (int) len, val);
+	}
+}
+
+/* Read all fields of a single journald message. Well-known fields are
+ * stored in *fields, all fields are returned in a JSON object. Doing this
+ * in a single pass saves one lookup (sd_journal_get_data() is a linear
+ * search over the entry) per well-known field.
  */
 static rsRetVal
-readJSONfromJournalMsg(struct fjson_object **json)
+readJournalFields(struct fjson_object **json, struct jrnlFields_s *const fields)
 {
 	DEFiRet;
 	const void *get;
@@ -262,12 +320,18 @@ readJSONfromJournalMsg(struct fjson_object **json)
 	struct fjson_object *jval;
 	size_t l;
 	long prefixlen = 0;
+	const size_t lenPidFieldName = strlen(pidFieldName);
+	char namebuf[128];
+	sbool bHaveSeverity = 0;
+	sbool bHaveFacility = 0;
 
 	CHKmalloc(*json = fjson_object_new_object());
 
 	SD_JOURNAL_FOREACH_DATA(journalContext.j, get, l) {
-		char *data;
+		char *data = NULL;
 		char *name;
+		const char *val;
+		size_t lenVal;
 
 		/* locate equal sign, this is always present */
 		equal_sign = memchr(get, '=', l);
@@ -281,21 +345,58 @@ readJSONfromJournalMsg(struct fjson_object **json)
 
 		/* get length of journal data prefix */
 		prefixlen = ((char *)equal_sign - (char *)get);
+		val = (const char *)equal_sign + 1;
+		lenVal = l - prefixlen - 1;
 
-		CHKmalloc(name = strndup(get, prefixlen));
-
-		prefixlen++; /* remove '=' */
+		/* the journal may contain the same field multiple times. As
+		 * sd_journal_get_data() did, we use the first occurrence.
+		 */
+		if (fields->message == NULL && FIELD_IS("MESSAGE", get, prefixlen)) {
+			CHKiRet(sanitizeValue(val, lenVal, &fields->message));
+		} else if (!bHaveSeverity && FIELD_IS("PRIORITY", get, prefixlen)) {
+			parseSeverity(fields, val, lenVal);
+			bHaveSeverity = 1;
+		} else if (!bHaveFacility && FIELD_IS("SYSLOG_FACILITY", get, prefixlen)) {
+			parseFacility(fields, val, lenVal);
+			bHaveFacility = 1;
+		} else if (fields->sys_iden == NULL && FIELD_IS("SYSLOG_IDENTIFIER", get, prefixlen)) {
+			CHKiRet(sanitizeValue(val, lenVal, &fields->sys_iden));
+		}
+		if (fields->sys_pid == NULL && (size_t) prefixlen == lenPidFieldName
+		    && !memcmp(get, pidFieldName, lenPidFieldName)) {
+			CHKiRet(sanitizeValue(val, lenVal, &fields->sys_pid));
+		} else if (bPidFallBack && fields->pid == NULL && FIELD_IS("_PID", get, prefixlen)) {
+			CHKiRet(sanitizeValue(val, lenVal, &fields->pid));
+		}
 
-		CHKiRet_Hdlr(sanitizeValue(((const char *)get) + prefixlen, l - prefixlen, &data)) {
-			free (name);
-			FINALIZE;
+		/* field names are limited to 64 chars by journald, so the
+		 * buffer is usually sufficient.
+		 */
+		if ((size_t) prefixlen < sizeof(namebuf)) {
+			memcpy(namebuf, get, prefixlen);
+			namebuf[prefixlen] = '\0';
+			name = namebuf;
+		} else {
+			CHKmalloc(name = strndup(get, prefixlen));
 		}
 
-		/* and save them to json object */
-		jval = fjson_object_new_string((char *)data);
+		/* and save them to json object; values only need to be copied
+		 * if they contain NUL characters.
+		 */
+		if (memchr(val, '\0', lenVal) == NULL) {
+			jval = fjson_object_new_string_len(val, lenVal);
+		} else {
+			CHKiRet_Hdlr(sanitizeValue(val, lenVal, &data)) {
+				if (name != namebuf)
+					free(name);
+				FINALIZE;
+			}
+			jval = fjson_object_new_string(data);
+		}
 		fjson_object_object_add(*json, name, jval);
-		free (data);
-		free (name);
+		free(data);
+		if (name != namebuf)
+			free(name);
 	}
 finalize_it:
 	RETiRet;
@@ -316,8 +417,11 @@ updateJournalCursor(void)
 		ABORT_FINALIZE(RS_RET_ERR);
 	}
 	/* save journal cursor (at this point we can be sure it is valid) */
+	pthread_mutex_lock(&mutCursor);
 	free(journalContext.cursor);
 	journalContext.cursor = c;
+	persister.bCursorChanged = 1;
+	pthread_mutex_unlock(&mutCursor);
 finalize_it:
 	RETiRet;
 }
@@ -325,11 +429,12 @@ finalize_it:
 
 /* enqueue the the journal message into the message queue.
  * The provided msg string is not freed - thus must be done
- * by the caller.
+ * by the caller. If pMultiSub is given, the message is added
+ * to that batch, which must be flushed by the caller.
  */
 static rsRetVal
 enqMsg(uchar *msg, uchar *pszTag, int iFacility, int iSeverity, struct timeval *tp, struct fjson_object *json,
-int sharedJsonProperties)
+int sharedJsonProperties, multi_submit_t *const pMultiSub)
 {
 	struct syslogTime st;
 	smsg_t *pMsg;
@@ -363,7 +468,7 @@ int sharedJsonProperties)
 		msgAddJSON(pMsg, (uchar*)"!", json, 0, sharedJsonProperties);
 	}
 
-	CHKiRet(ratelimitAddMsg(ratelimiter, NULL, pMsg));
+	CHKiRet(ratelimitAddMsg(ratelimiter, pMultiSub, pMsg));
 	STATSCOUNTER_INC(statsCounter.ctrSubmitted, statsCounter.mutCtrSubmitted);
 
 finalize_it:
@@ -378,9 +483,11 @@ finalize_it:
 
 
 /* Read journal log while data are available, each read() reads one journald record.
+ * Note: the journal cursor is NOT updated, this must be done by the caller once
+ * the message has been submitted (see commitBatch()).
  */
 static rsRetVal
-readjournal(void)
+readjournal(multi_submit_t *const pMultiSub)
 {
 	DEFiRet;
 
@@ -391,126 +498,110 @@ readjournal(void)
 	int r;
 
 	/* Information from messages */
-	char *message = NULL;
-	char *sys_iden;
+	struct jrnlFields_s fields = { NULL, NULL, NULL, NULL, cs.iDfltSeverity, cs.iDfltFacility };
 	char *sys_iden_help = NULL;
 
-	const void *get;
-	const void *pidget;
-	size_t length;
-	size_t pidlength;
-
-	int severity = cs.iDfltSeverity;
-	int facility = cs.iDfltFacility;
-
-	/* Get message text */
-	if (journalGetData("MESSAGE", &get, &length) < 0) {
-		CHKmalloc(message = strdup(""));
-	} else {
-		CHKiRet(sanitizeValue(((const char *)get) + 8, length - 8, &message));
-	}
+	CHKiRet(readJournalFields(&json, &fields));
 	STATSCOUNTER_INC(statsCounter.ctrRead, statsCounter.mutCtrRead);
 
-	/* Get message severity ("priority" in journald's terminology) */
-	if (journalGetData("PRIORITY", &get, &length) >= 0) {
-		if (length == 10) {
-			severity = ((char *)get)[9] - '0';
-			if (severity < 0 || 7 < severity) {
-				LogError(0, RS_RET_ERR, "imjournal: the value of the 'PRIORITY' field is "
-					"out of bounds: %d, resetting", severity);
-				severity = cs.iDfltSeverity;
-			}
-		} else {
-			LogError(0, RS_RET_ERR, "The value of the 'PRIORITY' field has an "
-				"unexpected length: %zu\n", length);
-		}
-	}
-
-	/* Get syslog facility */
-	if (journalGetData("SYSLOG_FACILITY", &get, &length) >= 0) {
-		// Note: the journal frequently contains invalid facilities!
-		if (length == 17 || length == 18) {
-			facility = ((char *)get)[16] - '0';
-			if (length == 18) {
-				facility *= 10;
-				facility += ((char *)get)[17] - '0';
-			}
-			if (facility < 0 || 23 < facility) {
-				DBGPRINTF("The value of the 'FACILITY' field is "
-					"out of bounds: %d, resetting\n", facility);
-				facility = cs.iDfltFacility;
-			}
-		} else {
-			DBGPRINTF("The value of the 'FACILITY' field has an "
-				"unexpected length: %zu value: '%s'\n", length, (const char*)get);
-		}
+	/* Get message text */
+	if (fields.message == NULL) {
+		CHKmalloc(fields.message = strdup(""));
 	}
 
-	/* Get message identifier, client pid and add ':' */
-	if (journalGetData("SYSLOG_IDENTIFIER", &get, &length) >= 0) {
-		CHKiRet(sanitizeValue(((const char *)get) + 18, length - 18, &sys_iden));
-	} else {
-		CHKmalloc(sys_iden = strdup("journal"));
+	/* build tag from message identifier, client pid and add ':' */
+	if (fields.sys_iden == NULL) {
+		CHKmalloc(fields.sys_iden = strdup("journal"));
 	}
-
-	/* trying to get PID, default is "SYSLOG_PID" property */
-	if (journalGetData(pidFieldName, &pidget, &pidlength) >= 0) {
-		char *sys_pid;
-		int val_ofs;
-
-		val_ofs = strlen(pidFieldName) + 1; /* name + '=' */
-		CHKiRet_Hdlr(sanitizeValue(((const char *)pidget) + val_ofs, pidlength - val_ofs, &sys_pid)) {
-			free (sys_iden);
-			FINALIZE;
-		}
-		r = asprintf(&sys_iden_help, "%s[%s]:", sys_iden, sys_pid);
-		free (sys_pid);
+	if (fields.sys_pid != NULL) {
+		r = asprintf(&sys_iden_help, "%s[%s]:", fields.sys_iden, fields.sys_pid);
+	} else if (fields.pid != NULL) {
+		/* this is fallback, "SYSLOG_PID" doesn't exist so we use the "_PID" property */
+		r = asprintf(&sys_iden_help, "%s[%s]:", fields.sys_iden, fields.pid);
 	} else {
-		/* this is fallback, "SYSLOG_PID" doesn't exist so trying to get "_PID" property */
-		if (bPidFallBack && journalGetData("_PID", &pidget, &pidlength) >= 0) {
-			char *sys_pid;
-			int val_ofs;
-
-			val_ofs = strlen("_PID") + 1; /* name + '=' */
-			CHKiRet_Hdlr(sanitizeValue(((const char *)pidget) + val_ofs, pidlength - val_ofs, &sys_pid)) {
-				free (sys_iden);
-				FINALIZE;
-			}
-			r = asprintf(&sys_iden_help, "%s[%s]:", sys_iden, sys_pid);
-			free (sys_pid);
-		} else {
-			/* there is no PID property available */
-			r = asprintf(&sys_iden_help, "%s:", sys_iden);
-		}
+		/* there is no PID property available */
+		r = asprintf(&sys_iden_help, "%s:", fields.sys_iden);
 	}
 
-	free (sys_iden);
-
 	if (-1 == r) {
 		STATSCOUNTER_INC(statsCounter.ctrFailed, statsCounter.mutCtrFailed);
+		sys_iden_help = NULL;
 		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
 	}
 
-	CHKiRet(readJSONfromJournalMsg(&json));
-
 	/* calculate timestamp */
 	if (sd_journal_get_realtime_usec(journalContext.j, &timestamp) >= 0) {
 		tv.tv_sec = timestamp / 1000000;
 		tv.tv_usec = timestamp % 1000000;
 	}
 
-	iRet = updateJournalCursor();
-
 	/* submit message */
-	enqMsg((uchar *)message, (uchar *) sys_iden_help, facility, severity, &tv, json, 0);
+	enqMsg((uchar *)fields.message, (uchar *) sys_iden_help, fields.facility, fields.severity, &tv, json, 0,
+		pMultiSub);
+	json = NULL; /* now owned by the message */
 
 finalize_it:
+	if (json != NULL)
+		fjson_object_put(json);
 	free(sys_iden_help);
-	free(message);
+	free(fields.message);
+	free(fields.sys_iden);
+	free(fields.sys_pid);
+	free(fields.pid);
 	RETiRet;
 }
 
 
+/* Submit the messages of the current batch and remember the journal
+ * position. The cursor is obtained once per batch only, as
+ * sd_journal_get_cursor() is not cheap.
+ */
+static rsRetVal
+commitBatch(multi_submit_t *const pMultiSub, int *const pnInBatch)
+{
+	DEFiRet;
+
+	if (*pnInBatch == 0)
+		FINALIZE;
+	if (pMultiSub != NULL) {
+		multiSubmitFlush(pMultiSub);
+	}
+	*pnInBatch = 0;
+	iRet = updateJournalCursor();
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* Called if readjournal() failed for the current journal entry. Submits
+ * the messages read so far, but makes sure the cursor is not moved to
+ * the failed entry. Otherwise that entry would be skipped when we reopen
+ * the journal at the saved position. If we cannot step back, we do not
+ * update the cursor at all and accept that the batch is read again.
+ */
+static void
+abortBatch(multi_submit_t *const pMultiSub, int *const pnInBatch)
+{
+	int r;
+
+	if (*pnInBatch == 0)
+		return;
+	if ((r = sd_journal_previous(journalContext.j)) > 0) {
+		commitBatch(pMultiSub, pnInBatch);
+		return;
+	}
+	if (r < 0) {
+		LogError(-r, RS_RET_ERR, "imjournal: sd_journal_previous() failed, "
+			"journal position not updated");
+	}
+	if (pMultiSub != NULL) {
+		multiSubmitFlush(pMultiSub);
+	}
+	*pnInBatch = 0;
+}
+
+
 /* This function saves journal cursor into state file.
  * It must be checked that stateFile is configured prior to calling this.
  */
@@ -521,12 +612,21 @@ persistJournalState(void)
 	FILE *sf = NULL; /* state file */
 	char tmp_sf[MAXFNAME];
 	size_t n;
+	char *cursor = NULL;
+
+	/* work on a copy, the cursor may be updated while we write */
+	pthread_mutex_lock(&mutCursor);
+	if (journalContext.cursor != NULL) {
+		cursor = strdup(journalContext.cursor);
+	}
+	persister.bCursorChanged = 0;
+	pthread_mutex_unlock(&mutCursor);
 
 	DBGPRINTF("Persisting journal position, cursor: %s, at head? %d\n",
-			  journalContext.cursor, journalContext.atHead);
+			  cursor, journalContext.atHead);
 
 	/* first check that we have valid cursor */
-	if (!journalContext.cursor) {
+	if (!cursor) {
 		ABORT_FINALIZE(RS_RET_OK);
 	}
 
@@ -545,7 +645,7 @@ persistJournalState(void)
 		ABORT_FINALIZE(RS_RET_FOPEN_FAILURE);
 	}
 
-	if(fputs(journalContext.cursor, sf) == EOF) {
+	if(fputs(cursor, sf) == EOF) {
 		LogError(errno, RS_RET_IO_ERROR, "imjournal: failed to save cursor to: '%s'", tmp_sf);
 		ABORT_FINALIZE(RS_RET_IO_ERROR);
 	}
@@ -580,10 +680,68 @@ finalize_it:
 			iRet = RS_RET_IO_ERROR;
 		}
 	}
+	free(cursor);
 	RETiRet;
 }
 
 
+/* thread persisting the journal position every persiststateperiod
+ * seconds, so that the input thread does not need to do file I/O.
+ */
+static void *
+persisterThrd(void __attribute__((unused)) *arg)
+{
+	struct timespec t;
+
+	dbgSetThrdName((uchar*) "imjournal persist");
+	pthread_mutex_lock(&mutCursor);
+	while (!persister.bStop) {
+		timeoutComp(&t, (long) cs.iPersistStatePeriod * 1000);
+		pthread_cond_timedwait(&persister.wakeup, &mutCursor, &t);
+		if (persister.bStop || !persister.bCursorChanged)
+			continue;
+		pthread_mutex_unlock(&mutCursor);
+		persistJournalState();
+		pthread_mutex_lock(&mutCursor);
+	}
+	pthread_mutex_unlock(&mutCursor);
+	return NULL;
+}
+
+
+static void
+startPersister(void)
+{
+	int r;
+
+	persister.bStop = 0;
+	persister.bCursorChanged = 0;
+	pthread_cond_init(&persister.wakeup, NULL);
+	if ((r = pthread_create(&persister.tid, NULL, persisterThrd, NULL)) != 0) {
+		LogError(r, RS_RET_ERR, "imjournal: cannot create state persistence thread, "
+			"state is persisted by input thread");
+		pthread_cond_destroy(&persister.wakeup);
+		return;
+	}
+	persister.bRunning = 1;
+}
+
+
+static void
+stopPersister(void)
+{
+	if (!persister.bRunning)
+		return;
+	pthread_mutex_lock(&mutCursor);
+	persister.bStop = 1;
+	pthread_cond_signal(&persister.wakeup);
+	pthread_mutex_unlock(&mutCursor);
+	pthread_join(persister.tid, NULL);
+	pthread_cond_destroy(&persister.wakeup);
+	persister.bRunning = 0;
+}
+
+
 static rsRetVal skipOldMessages(void);
 
 static rsRetVal
@@ -770,6 +928,11 @@ tryRecover(void) {
 
 BEGINrunInput
 	uint64_t count = 0;
+	uint64_t countLastPersist = 0;
+	int nInBatch = 0;
+	smsg_t **ppMsgs = NULL;
+	multi_submit_t multiSub;
+	multi_submit_t *pMultiSub = NULL;
 CODESTARTrunInput
 	CHKiRet(ratelimitNew(&ratelimiter, "imjournal", NULL));
 	dbgprintf("imjournal: ratelimiting burst %u, interval %u\n", cs.ratelimitBurst,
@@ -808,6 +971,17 @@ CODESTARTrunInput
 		}
 	}
 
+	if (cs.iBatchSize > 1) {
+		CHKmalloc(ppMsgs = malloc(cs.iBatchSize * sizeof(smsg_t *)));
+		multiSub.ppMsgs = ppMsgs;
+		multiSub.maxElem = cs.iBatchSize;
+		multiSub.nElem = 0;
+		pMultiSub = &multiSub;
+	}
+
+	if (cs.stateFile && cs.iPersistStatePeriod > 0) {
+		startPersister();
+	}
 
 	/* this is an endless loop - it is terminated when the thread is
 	 * signalled to do so. This, however, is handled by the framework.
@@ -818,11 +992,14 @@ CODESTARTrunInput
 		r = sd_journal_next(journalContext.j);
 		if (r < 0) {
 			LogError(-r, RS_RET_ERR, "imjournal: sd_journal_next() failed");
+			commitBatch(pMultiSub, &nInBatch);
 			tryRecover();
 			continue;
 		}
 
 		if (r == 0) {
+			/* submit what we have before we (potentially) wait */
+			commitBatch(pMultiSub, &nInBatch);
 			if (journalContext.atHead) {
 				LogMsg(0, RS_RET_OK, LOG_WARNING, "imjournal: "
 						"Journal indicates no msgs when positioned at head.\n");
@@ -835,30 +1012,48 @@ CODESTARTrunInput
 		}
 
 		/*
-		 * update journal disk usage before reading the new message.
+		 * update journal disk usage before reading a new batch. This
+		 * needs to stat all journal files, so we do not do it per message.
 		 */
-		const int e = sd_journal_get_usage(journalContext.j, (uint64_t *)&statsCounter.diskUsageBytes);
-		if (e < 0) {
-			LogError(-e, RS_RET_ERR, "imjournal: sd_get_usage() failed");
+		if (nInBatch == 0) {
+			const int e = sd_journal_get_usage(journalContext.j, (uint64_t *)&statsCounter.diskUsageBytes);
+			if (e < 0) {
+				LogError(-e, RS_RET_ERR, "imjournal: sd_get_usage() failed");
+			}
 		}
 
-		if (readjournal() != RS_RET_OK) {
+		if (readjournal(pMultiSub) != RS_RET_OK) {
+			abortBatch(pMultiSub, &nInBatch);
 			tryRecover();
 			continue;
 		}
 
 		count++;
+		nInBatch++;
 		journalContext.atHead = 0;
 
-		if (cs.stateFile) { /* can't persist without a state file */
+		if (nInBatch >= cs.iBatchSize) {
+			commitBatch(pMultiSub, &nInBatch);
+		}
+
+		/* can't persist without a state file; if the persister thread
+		 * runs, it handles this for us.
+		 */
+		if (cs.stateFile && !persister.bRunning && nInBatch == 0) {
 			/* TODO: This could use some finer metric. */
-			if ((count % cs.iPersistStateInterval) == 0) {
+			if (count - countLastPersist >= (uint64_t) cs.iPersistStateInterval) {
 				persistJournalState();
+				countLastPersist = count;
 			}
 		}
 	}
 
 finalize_it:
+	if (pMultiSub != NULL) {
+		commitBatch(pMultiSub, &nInBatch);
+	}
+	stopPersister();
+	free(ppMsgs);
 ENDrunInput
 
 
@@ -878,6 +1073,8 @@ CODESTARTbeginCnfLoad
 	cs.bWorkAroundJournalBug = 1;
 	cs.bFsync = 0;
 	cs.bRemote = 0;
+	cs.iBatchSize = DFLT_batchsize;
+	cs.iPersistStatePeriod = 0;
 ENDbeginCnfLoad
 
 
@@ -899,6 +1096,11 @@ ENDendCnfLoad
 
 BEGINcheckCnf
 CODESTARTcheckCnf
+	if (cs.iBatchSize > MAX_batchsize) {
+		LogError(0, RS_RET_PARAM_ERROR, "imjournal: batchsize %d is too large, "
+			"reducing it to %d", cs.iBatchSize, MAX_batchsize);
+		cs.iBatchSize = MAX_batchsize;
+	}
 ENDcheckCnf
 
 
@@ -1035,6 +1237,16 @@ CODESTARTsetModCnf
 			cs.bFsync = (int) pvals[i].val.d.n;
 		} else if (!strcmp(modpblk.descr[i].name, "remote")) {
 			cs.bRemote = (int) pvals[i].val.d.n;
+		} else if (!strcmp(modpblk.descr[i].name, "batchsize")) {
+			cs.iBatchSize = (int) pvals[i].val.d.n;
+		} else if (!strcmp(modpblk.descr[i].name, "persiststateperiod")) {
+			cs.iPersistStatePeriod = (int) pvals[i].val.d.n;
+			/* the period is handled in milliseconds, which must fit an int */
+			if (cs.iPersistStatePeriod > INT_MAX / 1000) {
+				LogError(0, RS_RET_PARAM_ERROR, "imjournal: persiststateperiod %d is "
+					"too large, using %d", cs.iPersistStatePeriod, INT_MAX / 1000);
+				cs.iPersistStatePeriod = INT_MAX / 1000;
+			}
 		} else {
 			dbgprintf("imjournal: program error, non-handled "
 				"param '%s' in beginCnfLoad\n", modpblk.descr[i].name);
@@ -34,6 +34,9 @@
 #include <errno.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
+#include <netdb.h>
+#include <poll.h>
 #ifdef OS_LINUX
 #include <sys/types.h>
 #include <dirent.h>
@@ -61,6 +64,9 @@ MODULE_CNFNAME("impstats")
 #define DEFAULT_STATS_PERIOD (5 * 60)
 #define DEFAULT_FACILITY 5 /* syslog */
 #define DEFAULT_SEVERITY 6 /* info */
+#define DEFAULT_HTTP_ADDR "127.0.0.1"
+#define HTTP_REQ_TIMEOUT 2	/* seconds a client may take to send its whole request */
+#define HTTP_MAX_REQ 4096	/* max size of request header we read */
 
 /* Module static data */
 DEF_IMOD_STATIC_DATA
@@ -91,6 +97,8 @@ struct modConfData_s {
 	char *logfile;
 	sbool configSetViaV2Method;
 	uchar *pszBindRuleset;		/* name of ruleset to bind to */
+	int httpPort;			/* port for the metrics endpoint, 0 = disabled */
+	uchar *pszHttpAddr;		/* address the metrics endpoint listens on */
 };
 static modConfData_t *loadModConf = NULL;/* modConf ptr to use for the current load process */
 static modConfData_t *runModConf = NULL;/* modConf ptr to use for the current load process */
@@ -109,7 +117,9 @@ static struct cnfparamdescr modpdescr[] = {
 	{ "resetcounters", eCmdHdlrBinary, 0 },
 	{ "log.file", eCmdHdlrGetWord, 0 },
 	{ "format", eCmdHdlrGetWord, 0 },
-	{ "ruleset", eCmdHdlrString, 0 }
+	{ "ruleset", eCmdHdlrString, 0 },
+	{ "http.port", eCmdHdlrPositiveInt, 0 },
+	{ "http.address", eCmdHdlrGetWord, 0 }
 };
 static struct cnfparamblk modpblk =
 	{ CNFPARAMBLK_VERSION,
@@ -134,6 +144,13 @@ static intctr_t st_ru_nivcsw;
 static statsobj_t *statsobj_resources;
 
 static pthread_mutex_t hup_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t mutResources = PTHREAD_MUTEX_INITIALIZER;
+
+/* metrics http endpoint */
+static int httpSock = -1;
+static pthread_t httpThrdID;
+static int bHttpThrdRunning = 0;
+static volatile int bHttpThrdStop = 0;
 
 BEGINmodExit
 CODESTARTmodExit
@@ -300,14 +317,15 @@ doStatsLine(void __attribute__((unused)) *usrptr, const char *const str)
 }
 
 
-/* the function to generate the actual statistics messages
- * rgerhards, 2010-09-09
+/* refresh the resource usage counters. Called both from the interval
+ * reporting and the http endpoint, thus guarded by a mutex.
  */
 static void
-generateStatsMsgs(void)
+updateResourceStats(void)
 {
 	struct rusage ru;
 	int r;
+	pthread_mutex_lock(&mutResources);
 	r = getrusage(RUSAGE_SELF, &ru);
 	if(r != 0) {
 		dbgprintf("impstats: getrusage() failed with error %d, zeroing out\n", errno);
@@ -325,10 +343,247 @@ generateStatsMsgs(void)
 	st_ru_oublock = ru.ru_oublock;
 	st_ru_nvcsw = ru.ru_nvcsw;
 	st_ru_nivcsw = ru.ru_nivcsw;
+	pthread_mutex_unlock(&mutResources);
+}
+
+
+/* the function to generate the actual statistics messages
+ * rgerhards, 2010-09-09
+ */
+static void
+generateStatsMsgs(void)
+{
+	updateResourceStats();
 	statsobj.GetAllStatsLines(doStatsLine, NULL, runModConf->statsFmt, runModConf->bResetCtrs);
 }
 
 
+/* ------------------------- metrics http endpoint -------------------------
+ * A deliberately minimal HTTP/1.0-style server: one thread, one request per
+ * connection, GET only. It is meant to be scraped by Prometheus and friends
+ * and listens on localhost unless configured otherwise.
+ */
+
+/* callback for statsobj: the OpenMetrics format is handed over as a
+ * single document, which we keep for sending.
+ */
+static rsRetVal
+doStatsDoc(void *usrptr, const char *const str)
+{
+	char **const ppDoc = (char**) usrptr;
+	DEFiRet;
+	free(*ppDoc);
+	CHKmalloc(*ppDoc = strdup(str));
+finalize_it:
+	RETiRet;
+}
+
+
+static void
+httpSendAll(const int sock, const char *buf, size_t len)
+{
+	ssize_t nwritten;
+	while(len > 0) {
+		nwritten = send(sock, buf, len, MSG_NOSIGNAL);
+		if(nwritten < 0) {
+			if(errno == EINTR)
+				continue;
+			DBGPRINTF("impstats: error %d sending http response\n", errno);
+			return;
+		}
+		buf += nwritten;
+		len -= nwritten;
+	}
+}
+
+
+static void
+httpSendResponse(const int sock, const char *const status, const char *const contentType,
+	const char *const body)
+{
+	char hdr[512];
+	const size_t lenBody = strlen(body);
+	const int lenHdr = snprintf(hdr, sizeof(hdr),
+		"HTTP/1.1 %s\r\n"
+		"Content-Type: %s\r\n"
+		"Content-Length: %zu\r\n"
+		"Connection: close\r\n"
+		"\r\n", status, contentType, lenBody);
+	httpSendAll(sock, hdr, lenHdr);
+	httpSendAll(sock, body, lenBody);
+}
+
+
+/* read the request header and serve it. Anything we do not understand
+ * is rejected, we are not a general-purpose web server. The whole request
+ * must arrive within HTTP_REQ_TIMEOUT, otherwise the connection is dropped,
+ * so that a slow client cannot occupy our only thread.
+ */
+static void
+httpHandleConn(const int sock)
+{
+	char req[HTTP_MAX_REQ];
+	size_t lenReq = 0;
+	ssize_t nread;
+	char *path;
+	char *end;
+	char *doc = NULL;
+	struct timeval tv;
+	struct timespec tDeadline;
+	struct pollfd pfd;
+	long msLeft;
+	int r;
+
+	tv.tv_sec = HTTP_REQ_TIMEOUT;
+	tv.tv_usec = 0;
+	setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	timeoutComp(&tDeadline, HTTP_REQ_TIMEOUT * 1000);
+	while(lenReq < sizeof(req) - 1) {
+		if((msLeft = timeoutVal(&tDeadline)) == 0) {
+			DBGPRINTF("impstats: http request not complete in time, dropping connection\n");
+			goto done;
+		}
+		pfd.fd = sock;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		r = poll(&pfd, 1, (int) msLeft);
+		if(r < 0 && errno == EINTR)
+			continue;
+		if(r < 0)
+			goto done;
+		if(r == 0)
+			continue; /* deadline is checked above */
+		nread = recv(sock, req + lenReq, sizeof(req) - 1 - lenReq, 0);
+		if(nread < 0 && errno == EINTR)
+			continue;
+		if(nread <= 0)
+			break;
+		lenReq += nread;
+		req[lenReq] = '\0';
+		if(strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL)
+			break;
+	}
+	req[lenReq] = '\0';
+
+	if(strncmp(req, "GET ", 4)) {
+		httpSendResponse(sock, "405 Method Not Allowed", "text/plain", "method not allowed\n");
+		goto done;
+	}
+	path = req + 4;
+	end = path + strcspn(path, " ?\r\n");
+	*end = '\0';
+	DBGPRINTF("impstats: http request for '%s'\n", path);
+	if(strcmp(path, "/metrics") && strcmp(path, "/")) {
+		httpSendResponse(sock, "404 Not Found", "text/plain", "not found\n");
+		goto done;
+	}
+
+	updateResourceStats();
+	/* counters are not reset here, the flag only selects how they are exported */
+	if(statsobj.GetAllStatsLines(doStatsDoc, &doc, statsFmt_Prometheus, runModConf->bResetCtrs) != RS_RET_OK
+	   || doc == NULL) {
+		httpSendResponse(sock, "500 Internal Server Error", "text/plain", "error obtaining stats\n");
+		goto done;
+	}
+	httpSendResponse(sock, "200 OK",
+		"application/openmetrics-text; version=1.0.0; charset=utf-8", doc);
+
+done:
+	free(doc);
+}
+
+
+static void *
+httpThrd(void __attribute__((unused)) *arg)
+{
+	struct pollfd pfd;
+	int sock;
+
+	while(!bHttpThrdStop) {
+		pfd.fd = httpSock;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if(poll(&pfd, 1, 500) <= 0) /* timeout so that we notice termination */
+			continue;
+		sock = accept(httpSock, NULL, NULL);
+		if(sock < 0)
+			continue;
+		httpHandleConn(sock);
+		close(sock);
+	}
+	return NULL;
+}
+
+
+static rsRetVal
+httpStart(void)
+{
+	struct addrinfo hints;
+	struct addrinfo *res = NULL;
+	char port[8];
+	const int on = 1;
+	int r;
+	DEFiRet;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE | AI_NUMERICHOST | AI_NUMERICSERV;
+	snprintf(port, sizeof(port), "%d", runModConf->httpPort);
+	r = getaddrinfo((char*)runModConf->pszHttpAddr, port, &hints, &res);
+	if(r != 0) {
+		LogError(0, RS_RET_INVALID_PARAMS, "impstats: invalid http.address '%s': %s",
+			runModConf->pszHttpAddr, gai_strerror(r));
+		ABORT_FINALIZE(RS_RET_INVALID_PARAMS);
+	}
+
+	httpSock = socket(res->ai_family, res->ai_socktype | SOCK_CLOEXEC, res->ai_protocol);
+	if(httpSock < 0) {
+		LogError(errno, RS_RET_ERR, "impstats: cannot create http socket");
+		ABORT_FINALIZE(RS_RET_ERR);
+	}
+	setsockopt(httpSock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if(bind(httpSock, res->ai_addr, res->ai_addrlen) != 0 || listen(httpSock, 16) != 0) {
+		LogError(errno, RS_RET_ERR, "impstats: cannot listen on %s:%d for http requests",
+			runModConf->pszHttpAddr, runModConf->httpPort);
+		ABORT_FINALIZE(RS_RET_ERR);
+	}
+
+	bHttpThrdStop = 0;
+	if((r = pthread_create(&httpThrdID, NULL, httpThrd, NULL)) != 0) {
+		LogError(r, RS_RET_ERR, "impstats: cannot start http thread");
+		ABORT_FINALIZE(RS_RET_ERR);
+	}
+	bHttpThrdRunning = 1;
+	DBGPRINTF("impstats: serving metrics on %s:%d\n", runModConf->pszHttpAddr, runModConf->httpPort);
+
+finalize_it:
+	if(res != NULL)
+		freeaddrinfo(res);
+	if(iRet != RS_RET_OK && httpSock != -1) {
+		close(httpSock);
+		httpSock = -1;
+	}
+	RETiRet;
+}
+
+
+static void
+httpStop(void)
+{
+	if(bHttpThrdRunning) {
+		bHttpThrdStop = 1;
+		pthread_join(httpThrdID, NULL);
+		bHttpThrdRunning = 0;
+	}
+	if(httpSock != -1) {
+		close(httpSock);
+		httpSock = -1;
+	}
+}
+
+
 BEGINbeginCnfLoad
 CODESTARTbeginCnfLoad
 	loadModConf = pModConf;
@@ -345,6 +600,8 @@ CODESTARTbeginCnfLoad
 	loadModConf->bLogToSyslog = 1;
 	loadModConf->bBracketing = 0;
 	loadModConf->bResetCtrs = 0;
+	loadModConf->httpPort = 0;
+	loadModConf->pszHttpAddr = NULL;
 	bLegacyCnfModGlobalsPermitted = 1;
 	/* init legacy config vars */
 	initConfigSettings();
@@ -402,6 +659,15 @@ CODESTARTsetModCnf
 			free(mode);
 		} else if(!strcmp(modpblk.descr[i].name, "ruleset")) {
 			loadModConf->pszBindRuleset = (uchar*)es_str2cstr(pvals[i].val.d.estr, NULL);
+		} else if(!strcmp(modpblk.descr[i].name, "http.port")) {
+			if(pvals[i].val.d.n > 65535) {
+				parser_errmsg("impstats: http.port %lld is invalid", pvals[i].val.d.n);
+				ABORT_FINALIZE(RS_RET_PARAM_ERROR);
+			}
+			loadModConf->httpPort = (int) pvals[i].val.d.n;
+		} else if(!strcmp(modpblk.descr[i].name, "http.address")) {
+			free(loadModConf->pszHttpAddr);
+			loadModConf->pszHttpAddr = (uchar*)es_str2cstr(pvals[i].val.d.estr, NULL);
 		} else {
 			dbgprintf("impstats: program error, non-handled "
 			  "param '%s' in beginCnfLoad\n", modpblk.descr[i].name);
@@ -496,6 +762,10 @@ CODESTARTcheckCnf
 		pModConf->iStatsInterval = DEFAULT_STATS_PERIOD;
 	}
 	checkRuleset(pModConf);
+	if(pModConf->httpPort != 0 && pModConf->pszHttpAddr == NULL) {
+		CHKmalloc(pModConf->pszHttpAddr = ustrdup(DEFAULT_HTTP_ADDR));
+	}
+finalize_it:
 ENDcheckCnf
 
 
@@ -552,6 +822,7 @@ CODESTARTfreeCnf
 		close(runModConf->logfd);
 	free(runModConf->logfile);
 	free(runModConf->pszBindRuleset);
+	free(runModConf->pszHttpAddr);
 ENDfreeCnf
 
 
@@ -563,6 +834,10 @@ CODESTARTrunInput
 	 * final set of stats counters on termination request. Depending
 	 * on configuration, they may not make it to the final destination...
 	 */
+	if(runModConf->httpPort != 0) {
+		/* errors are already reported, interval stats continue to work */
+		httpStart();
+	}
 	while(glbl.GetGlobalInputTermState() == 0) {
 		srSleep(runModConf->iStatsInterval, 0); /* seconds, micro seconds */
 		DBGPRINTF("impstats: woke up, generating messages\n");
@@ -582,6 +857,7 @@ ENDwillRun
 
 BEGINafterRun
 CODESTARTafterRun
+	httpStop();
 ENDafterRun
 
 
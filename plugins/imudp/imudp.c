@@ -57,6 +57,7 @@
 #include "statsobj.h"
 #include "ratelimit.h"
 #include "unicode-helper.h"
+#include "dnscache.h"
 
 MODULE_TYPE_INPUT
 MODULE_TYPE_NOKEEP
@@ -83,8 +84,8 @@ static struct lstn_s {
 	statsobj_t *stats;	/* listener stats */
 	ratelimit_t *ratelimiter;
 	uchar *dfltTZ;
-	STATSCOUNTER_DEF(ctrSubmit, mutCtrSubmit)
-	STATSCOUNTER_DEF(ctrDisallowed, mutCtrDisallowed)
+	STATSCOUNTER_STRIPED_DEF(ctrSubmit) /* updated by all workers */
+	STATSCOUNTER_STRIPED_DEF(ctrDisallowed)
 } *lcnfRoot = NULL, *lcnfLast = NULL;
 
 
@@ -140,7 +141,8 @@ static struct wrkrInfo_s {
 	struct mmsghdr *recvmsg_mmh;
 	struct iovec *recvmsg_iov;
 #	endif
-} wrkrInfo[MAX_WRKR_THREADS];
+} __attribute__((aligned(STATSCTR_CACHE_LINE))) /* no false sharing of worker stats */
+	wrkrInfo[MAX_WRKR_THREADS];
 
 struct modConfData_s {
 	rsconf_t *pConf;		/* our overall config object */
@@ -335,12 +337,12 @@ addListner(instanceConf_t *inst)
 			CHKiRet(statsobj.Construct(&(newlcnfinfo->stats)));
 			CHKiRet(statsobj.SetName(newlcnfinfo->stats, dispname));
 			CHKiRet(statsobj.SetOrigin(newlcnfinfo->stats, (uchar*)"imudp"));
-			STATSCOUNTER_INIT(newlcnfinfo->ctrSubmit, newlcnfinfo->mutCtrSubmit);
+			STATSCOUNTER_STRIPED_INIT(newlcnfinfo->ctrSubmit);
 			CHKiRet(statsobj.AddCounter(newlcnfinfo->stats, UCHAR_CONSTANT("submitted"),
-				ctrType_IntCtr, CTR_FLAG_RESETTABLE, &(newlcnfinfo->ctrSubmit)));
-			STATSCOUNTER_INIT(newlcnfinfo->ctrDisallowed, newlcnfinfo->mutCtrDisallowed);
+				ctrType_StripedCtr, CTR_FLAG_RESETTABLE, &(newlcnfinfo->ctrSubmit)));
+			STATSCOUNTER_STRIPED_INIT(newlcnfinfo->ctrDisallowed);
 			CHKiRet(statsobj.AddCounter(newlcnfinfo->stats, UCHAR_CONSTANT("disallowed"),
-				ctrType_IntCtr, CTR_FLAG_RESETTABLE, &(newlcnfinfo->ctrDisallowed)));
+				ctrType_StripedCtr, CTR_FLAG_RESETTABLE, &(newlcnfinfo->ctrDisallowed)));
 			CHKiRet(statsobj.ConstructFinalize(newlcnfinfo->stats));
 			/* link to list. Order must be preserved to take care for
 			 * conflicting matches.
@@ -425,7 +427,7 @@ processPacket(struct lstn_s *lstn, struct sockaddr_storage *frominetPrev, int *p
 	
 			if(*pbIsPermitted == 0) {
 				DBGPRINTF("msg is not from an allowed sender\n");
-				STATSCOUNTER_INC(lstn->ctrDisallowed, lstn->mutCtrDisallowed);
+				STATSCOUNTER_STRIPED_INC(lstn->ctrDisallowed);
 				if(glbl.GetOption_DisallowWarning) {
 					LogError(0, NO_ERRCODE,
 						"imudp: UDP message from disallowed sender discarded");
@@ -457,7 +459,7 @@ processPacket(struct lstn_s *lstn, struct sockaddr_storage *frominetPrev, int *p
 		}
 		CHKiRet(msgSetFromSockinfo(pMsg, frominet));
 		CHKiRet(ratelimitAddMsg(lstn->ratelimiter, multiSub, pMsg));
-		STATSCOUNTER_INC(lstn->ctrSubmit, lstn->mutCtrSubmit);
+		STATSCOUNTER_STRIPED_INC(lstn->ctrSubmit);
 	}
 
 finalize_it:
@@ -492,6 +494,7 @@ int *pbIsPermitted)
 	smsg_t *pMsgs[CONF_NUM_MULTISUB];
 	multi_submit_t multiSub;
 	int nelem;
+	int nPrefetch;
 	int i;
 
 	multiSub.ppMsgs = pMsgs;
@@ -539,12 +542,27 @@ int *pbIsPermitted)
 		}
 
 		pWrkr->ctrMsgsRcvd += nelem;
+		nPrefetch = 0;
 		for(i = 0 ; i < nelem ; ++i) {
 			processPacket(lstn, frominetPrev, pbIsPermitted,
 				pWrkr->recvmsg_mmh[i].msg_hdr.msg_iov->iov_base,
 				pWrkr->recvmsg_mmh[i].msg_len, &stTime, ttGenTime, &(pWrkr->frominet[i]),
 				pWrkr->recvmsg_mmh[i].msg_hdr.msg_namelen, &multiSub);
+			/* the message has its own copy of the address, so we can compact
+			 * the addresses of allowed senders in place.
+			 */
+			if(*pbIsPermitted != 0 && pWrkr->recvmsg_mmh[i].msg_len > 0) {
+				if(nPrefetch != i)
+					memcpy(&(pWrkr->frominet[nPrefetch]), &(pWrkr->frominet[i]),
+						sizeof(struct sockaddr_storage));
+				++nPrefetch;
+			}
 		}
+		/* start resolving the senders' names now, so that the lookups done
+		 * when the messages are processed are (mostly) served by the cache
+		 */
+		if(nPrefetch > 0)
+			dnscachePrefetch(pWrkr->frominet, nPrefetch);
 	}
 
 finalize_it:
@@ -0,0 +1,141 @@
+/* Helpers shared by the frame-based stream compression drivers, see
+ * comprw.h. This file is compiled into each driver module; the drivers
+ * only add the library calls.
+ *
+ * Copyright 2026 Adiscon GmbH.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <assert.h>
+
+#include "rsyslog.h"
+#include "stream.h"
+#include "comprw.h"
+
+
+/* free a compression state, including the library context */
+static void
+comprwFreeCtx(comprwCtx_t *const pCtx)
+{
+	pCtx->pDrvr->FreeCctx(pCtx->cctx);
+	free(pCtx->outBuf);
+	free(pCtx);
+}
+
+
+/* set up the compression state on first write */
+static rsRetVal
+comprwInit(strm_t *const pThis, const comprwDrvr_t *const pDrvr)
+{
+	comprwCtx_t *pCtx = NULL;
+	DEFiRet;
+
+	CHKmalloc(pCtx = calloc(1, sizeof(comprwCtx_t)));
+	pCtx->pDrvr = pDrvr;
+	CHKiRet(pDrvr->Init(pThis, pCtx));
+	CHKmalloc(pCtx->outBuf = malloc(pCtx->lenOutBuf));
+	pThis->compressionCtx = pCtx;
+
+finalize_it:
+	if(iRet != RS_RET_OK && pCtx != NULL) {
+		comprwFreeCtx(pCtx);
+	}
+	RETiRet;
+}
+
+
+/* write lenOut bytes of compressed output from the output buffer */
+rsRetVal
+comprwWriteOut(strm_t *const pThis, comprwCtx_t *const pCtx, const size_t lenOut,
+	comprwPhysWrite_t strmPhysWrite)
+{
+	DEFiRet;
+	if(lenOut > 0) {
+		CHKiRet(strmPhysWrite(pThis, pCtx->outBuf, lenOut));
+	}
+finalize_it:
+	RETiRet;
+}
+
+
+/* finish the current frame. The next write starts a new one. */
+rsRetVal
+comprwFinish(strm_t *const pThis, comprwPhysWrite_t strmPhysWrite)
+{
+	comprwCtx_t *const pCtx = (comprwCtx_t*) pThis->compressionCtx;
+	DEFiRet;
+
+	if(pCtx == NULL || !pCtx->bInFrame)
+		FINALIZE;
+	pCtx->bInFrame = 0;
+	CHKiRet(pCtx->pDrvr->End(pThis, pCtx, strmPhysWrite));
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* compress a buffer and write the result. As with zlib, "very robust zip"
+ * mode closes the frame after each write, so that a crash loses at most the
+ * last (unfinished) frame. Concatenated zstd or lz4 frames are a valid file.
+ */
+rsRetVal
+comprwWrite(strm_t *const pThis, const comprwDrvr_t *const pDrvr, uchar *const pBuf,
+	const size_t lenBuf, const int bFlush, comprwPhysWrite_t strmPhysWrite)
+{
+	comprwCtx_t *pCtx;
+	DEFiRet;
+	assert(pThis != NULL);
+	assert(pBuf != NULL);
+
+	if(pThis->compressionCtx == NULL) {
+		CHKiRet(comprwInit(pThis, pDrvr));
+	}
+	pCtx = (comprwCtx_t*) pThis->compressionCtx;
+
+	if(!pCtx->bInFrame) {
+		if(pDrvr->Begin != NULL) {
+			CHKiRet(pDrvr->Begin(pThis, pCtx, strmPhysWrite));
+		}
+		pCtx->bInFrame = 1;
+	}
+	CHKiRet(pDrvr->Compress(pThis, pCtx, pBuf, lenBuf, bFlush, strmPhysWrite));
+
+finalize_it:
+	if(pThis->compressionCtx != NULL && pThis->bVeryReliableZip) {
+		comprwFinish(pThis, strmPhysWrite);
+	}
+	RETiRet;
+}
+
+
+/* free the compression state of a stream. Any unfinished frame is lost,
+ * so comprwFinish() must be called before if the data is needed.
+ */
+rsRetVal
+comprwDestruct(strm_t *const pThis)
+{
+	comprwCtx_t *const pCtx = (comprwCtx_t*) pThis->compressionCtx;
+
+	if(pCtx != NULL) {
+		comprwFreeCtx(pCtx);
+		pThis->compressionCtx = NULL;
+	}
+	return RS_RET_OK;
+}
@@ -0,0 +1,64 @@
+/* Helpers shared by the frame-based stream compression drivers (lmzstdw,
+ * lmlz4w). They implement the per-stream state, the output buffer and the
+ * frame handling ("very robust zip" mode, finishing and freeing), so that
+ * a driver only needs to provide the library-specific operations.
+ *
+ * Copyright 2026 Adiscon GmbH.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INCLUDED_COMPRW_H
+#define INCLUDED_COMPRW_H
+
+#include "stream.h"
+
+typedef rsRetVal (*comprwPhysWrite_t)(strm_t *pThis, uchar *pBuf, size_t lenBuf);
+
+typedef struct comprwCtx_s comprwCtx_t;
+
+/* the library-specific part of a driver */
+typedef struct comprwDrvr_s {
+	/* create pCtx->cctx and set pCtx->lenOutBuf */
+	rsRetVal (*Init)(strm_t *pThis, comprwCtx_t *pCtx);
+	/* start a new frame, NULL if the library does this implicitly */
+	rsRetVal (*Begin)(strm_t *pThis, comprwCtx_t *pCtx, comprwPhysWrite_t strmPhysWrite);
+	/* compress data into the current frame, flushing the library if bFlush is set */
+	rsRetVal (*Compress)(strm_t *pThis, comprwCtx_t *pCtx, uchar *pBuf, size_t lenBuf,
+		int bFlush, comprwPhysWrite_t strmPhysWrite);
+	/* finish the current frame */
+	rsRetVal (*End)(strm_t *pThis, comprwCtx_t *pCtx, comprwPhysWrite_t strmPhysWrite);
+	/* free pCtx->cctx, which may be NULL */
+	void (*FreeCctx)(void *cctx);
+} comprwDrvr_t;
+
+/* per-stream compression state, kept in pThis->compressionCtx */
+struct comprwCtx_s {
+	const comprwDrvr_t *pDrvr;
+	void *cctx;		/* the library's compression context */
+	uchar *outBuf;
+	size_t lenOutBuf;
+	sbool bInFrame;	/* has the current frame been started? */
+};
+
+/* prototypes */
+rsRetVal comprwWrite(strm_t *pThis, const comprwDrvr_t *pDrvr, uchar *pBuf, size_t lenBuf,
+	const int bFlush, comprwPhysWrite_t strmPhysWrite);
+rsRetVal comprwFinish(strm_t *pThis, comprwPhysWrite_t strmPhysWrite);
+rsRetVal comprwDestruct(strm_t *pThis);
+rsRetVal comprwWriteOut(strm_t *pThis, comprwCtx_t *pCtx, size_t lenOut, comprwPhysWrite_t strmPhysWrite);
+
+#endif /* #ifndef INCLUDED_COMPRW_H */
@@ -34,6 +34,8 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
 
 #include "syslogd-types.h"
 #include "glbl.h"
@@ -43,29 +45,61 @@
 #include "net.h"
 #include "hashtable.h"
 #include "prop.h"
+#include "srUtils.h"
+#include "atomic.h"
 #include "dnscache.h"
 
 /* module data structures */
 struct dnscache_entry_s {
 	struct sockaddr_storage addr;
-	prop_t *fqdn;
+	prop_t *fqdn;		/* NULL while the initial resolution is in progress */
 	prop_t *fqdnLowerCase;
 	prop_t *localName; /* only local name, without domain part (if configured so) */
-	prop_t *ip;
-	time_t validUntil;
+	prop_t *ip;		/* always set */
+	time_t validUntil;	/* 0 - never expires */
 	struct dnscache_entry_s *next;
+	struct dnscache_entry_s *nextJob; /* for the async resolver queue */
 	unsigned nUsed;
+	unsigned shard;		/* index of the shard we belong to */
+	sbool bResolving;	/* resolution (or refresh) in progress? */
+	sbool bNegative;	/* name could not be resolved */
 };
 typedef struct dnscache_entry_s dnscache_entry_t;
-struct dnscache_s {
-	pthread_rwlock_t rwlock;
+
+/* The cache is split into shards, each with its own lock. DNS queries are
+ * never done while a lock is held. Threads which need an entry currently
+ * being resolved wait on the shard's condition variable.
+ */
+#define DNSCACHE_NUM_SHARDS 16 /* must be a power of 2 */
+#define DNSCACHE_PREFETCH_DUPWINDOW 4 /* prefetch: nbr of preceeding addrs checked for dups */
+struct dnscache_shard_s {
+	pthread_mutex_t mut;
+	pthread_cond_t resolved;
 	struct hashtable *ht;
-	unsigned nEntries;
+};
+typedef struct dnscache_shard_s dnscache_shard_t;
+struct dnscache_s {
+	dnscache_shard_t shards[DNSCACHE_NUM_SHARDS];
 };
 typedef struct dnscache_s dnscache_t;
 
+/* pool of threads doing asynchronous resolution */
+static struct {
+	pthread_mutex_t mut;
+	pthread_cond_t wakeup;
+	pthread_t *thrds;
+	int nThrds;
+	sbool bStarted;
+	sbool bShutdown;
+	dnscache_entry_t *jobRoot;
+	dnscache_entry_t *jobLast;
+} resolverPool;
+
 unsigned dnscacheDefaultTTL = 24 * 60 * 60; /* 24 hrs default TTL */
 int dnscacheEnableTTL = 0; /* expire entries or not (0) ? */
+unsigned dnscacheNegativeTTL = 0; /* TTL for failed lookups, 0 - same as regular entries */
+int dnscacheAsyncWorkers = 0; /* resolver threads, 0 - resolve synchronously */
+int dnscacheAsyncTimeout = 0; /* ms to wait for async resolution before using the IP */
 
 
 /* static data */
@@ -74,6 +108,8 @@ DEFobjCurrIf(glbl)
 DEFobjCurrIf(prop)
 static dnscache_t dnsCache;
 static prop_t *staticErrValue;
+static int bNameNeeded = 0;	/* a message property has needed a resolved name, see dnscacheNameNeeded() */
+DEF_ATOMIC_HELPER_MUT(mutNameNeeded)
 
 
 /* Our hash function.
@@ -127,11 +163,9 @@ key_equals_fn(void *key1, void *key2)
 	return RetVal;
 }
 
-/* destruct a cache entry.
- * Precondition: entry must already be unlinked from list
- */
+/* free the name properties of a cache entry (but not the IP) */
 static void ATTR_NONNULL()
-entryDestruct(dnscache_entry_t *const etry)
+entryFreeNames(dnscache_entry_t *const etry)
 {
 	if(etry->fqdn != NULL)
 		prop.Destruct(&etry->fqdn);
@@ -139,23 +173,41 @@ entryDestruct(dnscache_entry_t *const etry)
 		prop.Destruct(&etry->fqdnLowerCase);
 	if(etry->localName != NULL)
 		prop.Destruct(&etry->localName);
+}
+
+/* destruct a cache entry.
+ * Precondition: entry must already be unlinked from list
+ */
+static void ATTR_NONNULL()
+entryDestruct(dnscache_entry_t *const etry)
+{
+	entryFreeNames(etry);
 	if(etry->ip != NULL)
 		prop.Destruct(&etry->ip);
 	free(etry);
 }
 
+static void resolverPoolStop(void);
+
 /* init function (must be called once) */
 rsRetVal
 dnscacheInit(void)
 {
+	int i;
 	DEFiRet;
-	if((dnsCache.ht = create_hashtable(100, hash_from_key_fn, key_equals_fn,
-				(void(*)(void*))entryDestruct)) == NULL) {
-		DBGPRINTF("dnscache: error creating hash table!\n");
-		ABORT_FINALIZE(RS_RET_ERR); // TODO: make this degrade, but run!
+	for(i = 0 ; i < DNSCACHE_NUM_SHARDS ; ++i) {
+		if((dnsCache.shards[i].ht = create_hashtable(100, hash_from_key_fn, key_equals_fn,
+					(void(*)(void*))entryDestruct)) == NULL) {
+			DBGPRINTF("dnscache: error creating hash table!\n");
+			ABORT_FINALIZE(RS_RET_ERR); // TODO: make this degrade, but run!
+		}
+		pthread_mutex_init(&dnsCache.shards[i].mut, NULL);
+		pthread_cond_init(&dnsCache.shards[i].resolved, NULL);
 	}
-	dnsCache.nEntries = 0;
-	pthread_rwlock_init(&dnsCache.rwlock, NULL);
+	memset(&resolverPool, 0, sizeof(resolverPool));
+	INIT_ATOMIC_HELPER_MUT(mutNameNeeded);
+	pthread_mutex_init(&resolverPool.mut, NULL);
+	pthread_cond_init(&resolverPool.wakeup, NULL);
 	CHKiRet(objGetObjInterface(&obj)); /* this provides the root pointer for all other queries */
 	CHKiRet(objUse(glbl, CORE_COMPONENT));
 	CHKiRet(objUse(prop, CORE_COMPONENT));
@@ -171,10 +223,18 @@ finalize_it:
 rsRetVal
 dnscacheDeinit(void)
 {
+	int i;
 	DEFiRet;
+	resolverPoolStop();
+	DESTROY_ATOMIC_HELPER_MUT(mutNameNeeded);
+	pthread_mutex_destroy(&resolverPool.mut);
+	pthread_cond_destroy(&resolverPool.wakeup);
 	prop.Destruct(&staticErrValue);
-	hashtable_destroy(dnsCache.ht, 1); /* 1 => free all values automatically */
-	pthread_rwlock_destroy(&dnsCache.rwlock);
+	for(i = 0 ; i < DNSCACHE_NUM_SHARDS ; ++i) {
+		hashtable_destroy(dnsCache.shards[i].ht, 1); /* 1 => free all values automatically */
+		pthread_mutex_destroy(&dnsCache.shards[i].mut);
+		pthread_cond_destroy(&dnsCache.shards[i].resolved);
+	}
 	objRelease(glbl, CORE_COMPONENT);
 	objRelease(prop, CORE_COMPONENT);
 	RETiRet;
@@ -334,6 +394,7 @@ finalize_it:
 
 	prop.CreateStringProp(&etry->ip, (uchar*)szIP, strlen(szIP));
 
+	etry->bNegative = (error && !glbl.GetDisableDNS());
 	if(error || glbl.GetDisableDNS()) {
 		dbgprintf("Host name for your address (%s) unknown\n", szIP);
 		prop.AddRef(etry->ip);
@@ -348,92 +409,425 @@ finalize_it:
 }
 
 
+/* obtain the numerical representation of an address as property. This
+ * does not involve any DNS query.
+ */
 static rsRetVal ATTR_NONNULL()
-addEntry(struct sockaddr_storage *const addr, dnscache_entry_t **const pEtry)
+getIPProp(struct sockaddr_storage *const addr, prop_t **const ip)
+{
+	char szIP[80]; /* large enough for IPv6 */
+	DEFiRet;
+
+	if(mygetnameinfo((struct sockaddr *)addr, SALEN((struct sockaddr *)addr),
+			    szIP, sizeof(szIP), NULL, 0, NI_NUMERICHOST) != 0) {
+		strcpy(szIP, "?error.obtaining.ip?");
+	}
+	CHKiRet(prop.CreateStringProp(ip, (uchar*)szIP, strlen(szIP)));
+finalize_it:
+	RETiRet;
+}
+
+
+static dnscache_shard_t * ATTR_NONNULL()
+getShard(struct sockaddr_storage *const addr, unsigned *const pIdx)
+{
+	const unsigned h = hash_from_key_fn(addr);
+	*pIdx = (h ^ (h >> 16)) & (DNSCACHE_NUM_SHARDS - 1);
+	return &dnsCache.shards[*pIdx];
+}
+
+
+static int ATTR_NONNULL()
+entryIsExpired(const dnscache_entry_t *const etry)
+{
+	return etry->validUntil != 0 && etry->validUntil <= time(NULL);
+}
+
+
+/* resolve the address of an entry and install the result in it. Must
+ * be called WITHOUT the shard lock being held, as it does the (potentially
+ * slow) DNS query. The entry must have bResolving set, which guarantees
+ * that nobody else modifies it concurrently.
+ */
+static void ATTR_NONNULL()
+resolveEntry(dnscache_entry_t *const etry)
+{
+	dnscache_entry_t res;
+	dnscache_shard_t *const shard = &dnsCache.shards[etry->shard];
+
+	memset(&res, 0, sizeof(res));
+	resolveAddr(&etry->addr, &res);
+	if(res.ip != NULL)
+		prop.Destruct(&res.ip); /* the entry already has it */
+	if(res.fqdn == NULL) {
+		/* out of memory - waiters must not block forever, so use the IP */
+		entryFreeNames(&res);
+		prop.AddRef(etry->ip);
+		res.fqdn = etry->ip;
+		prop.AddRef(etry->ip);
+		res.fqdnLowerCase = etry->ip;
+		prop.AddRef(etry->ip);
+		res.localName = etry->ip;
+	}
+
+	pthread_mutex_lock(&shard->mut);
+	entryFreeNames(etry);
+	etry->fqdn = res.fqdn;
+	etry->fqdnLowerCase = res.fqdnLowerCase;
+	etry->localName = res.localName;
+	etry->bNegative = res.bNegative;
+	if(etry->bNegative && dnscacheNegativeTTL > 0) {
+		etry->validUntil = time(NULL) + dnscacheNegativeTTL;
+	} else if(dnscacheEnableTTL) {
+		etry->validUntil = time(NULL) + dnscacheDefaultTTL;
+	} else {
+		etry->validUntil = 0;
+	}
+	etry->bResolving = 0;
+	pthread_cond_broadcast(&shard->resolved);
+	pthread_mutex_unlock(&shard->mut);
+}
+
+
+/* async resolver pool */
+static void *
+resolverThrd(void __attribute__((unused)) *arg)
+{
+	dnscache_entry_t *etry;
+
+	dbgSetThrdName((uchar*) "dns resolver");
+	pthread_mutex_lock(&resolverPool.mut);
+	while(1) {
+		while(!resolverPool.bShutdown && resolverPool.jobRoot == NULL)
+			pthread_cond_wait(&resolverPool.wakeup, &resolverPool.mut);
+		if(resolverPool.bShutdown)
+			break;
+		etry = resolverPool.jobRoot;
+		resolverPool.jobRoot = etry->nextJob;
+		if(resolverPool.jobRoot == NULL)
+			resolverPool.jobLast = NULL;
+		etry->nextJob = NULL;
+		pthread_mutex_unlock(&resolverPool.mut);
+		resolveEntry(etry);
+		pthread_mutex_lock(&resolverPool.mut);
+	}
+	pthread_mutex_unlock(&resolverPool.mut);
+	return NULL;
+}
+
+/* start the pool; must be called with the pool mutex locked */
+static void
+resolverPoolStart(void)
 {
 	int r;
+
+	resolverPool.bStarted = 1;
+	if((resolverPool.thrds = calloc(dnscacheAsyncWorkers, sizeof(pthread_t))) == NULL)
+		return;
+	while(resolverPool.nThrds < dnscacheAsyncWorkers) {
+		r = pthread_create(&resolverPool.thrds[resolverPool.nThrds], NULL, resolverThrd, NULL);
+		if(r != 0) {
+			LogError(r, RS_RET_ERR, "dnscache: cannot create resolver thread %d of %d",
+				resolverPool.nThrds + 1, dnscacheAsyncWorkers);
+			break;
+		}
+		++resolverPool.nThrds;
+	}
+	DBGPRINTF("dnscache: %d resolver threads started\n", resolverPool.nThrds);
+}
+
+static void
+resolverPoolStop(void)
+{
+	int i;
+
+	pthread_mutex_lock(&resolverPool.mut);
+	resolverPool.bShutdown = 1;
+	pthread_cond_broadcast(&resolverPool.wakeup);
+	pthread_mutex_unlock(&resolverPool.mut);
+	for(i = 0 ; i < resolverPool.nThrds ; ++i)
+		pthread_join(resolverPool.thrds[i], NULL);
+	free(resolverPool.thrds);
+	resolverPool.thrds = NULL;
+	resolverPool.nThrds = 0;
+}
+
+/* queue an entry for async resolution. Returns 0 if the pool is not
+ * available, in which case the caller must resolve itself.
+ */
+static int ATTR_NONNULL()
+resolverPoolAdd(dnscache_entry_t *const etry)
+{
+	int ret = 0;
+
+	pthread_mutex_lock(&resolverPool.mut);
+	if(!resolverPool.bStarted && !resolverPool.bShutdown)
+		resolverPoolStart();
+	if(resolverPool.nThrds > 0 && !resolverPool.bShutdown) {
+		etry->nextJob = NULL;
+		if(resolverPool.jobLast == NULL)
+			resolverPool.jobRoot = etry;
+		else
+			resolverPool.jobLast->nextJob = etry;
+		resolverPool.jobLast = etry;
+		pthread_cond_signal(&resolverPool.wakeup);
+		ret = 1;
+	}
+	pthread_mutex_unlock(&resolverPool.mut);
+	return ret;
+}
+
+
+/* create a new, not yet resolved entry and add it to the cache. Must be
+ * called with the shard lock held.
+ */
+static rsRetVal ATTR_NONNULL()
+addEntry(struct sockaddr_storage *const addr, const unsigned idxShard, prop_t *const ip,
+	dnscache_entry_t **const pEtry)
+{
 	dnscache_entry_t *etry = NULL;
 	DEFiRet;
 
 	/* entry still does not exist, so add it */
 	struct sockaddr_storage *const keybuf =  malloc(sizeof(struct sockaddr_storage));
 	CHKmalloc(keybuf);
-	CHKmalloc(etry = malloc(sizeof(dnscache_entry_t)));
-	resolveAddr(addr, etry);
-	assert(etry != NULL);
+	CHKmalloc(etry = calloc(1, sizeof(dnscache_entry_t)));
 	memcpy(&etry->addr, addr, SALEN((struct sockaddr*) addr));
-	etry->nUsed = 0;
-	if(dnscacheEnableTTL) {
-		etry->validUntil = time(NULL) + dnscacheDefaultTTL;
-	}
+	etry->shard = idxShard;
+	etry->bResolving = 1;
+	prop.AddRef(ip);
+	etry->ip = ip;
 
 	memcpy(keybuf, addr, sizeof(struct sockaddr_storage));
 
-	r = hashtable_insert(dnsCache.ht, keybuf, etry);
-	if(r == 0) {
+	if(hashtable_insert(dnsCache.shards[idxShard].ht, keybuf, etry) == 0) {
 		DBGPRINTF("dnscache: inserting element failed\n");
+		entryDestruct(etry);
+		etry = NULL;
+		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
 	}
 	*pEtry = etry;
 
 finalize_it:
 	if(iRet != RS_RET_OK) {
 		free(keybuf);
+		free(etry);
 	}
 	RETiRet;
 }
 
 
+static void
+setProps(prop_t *const name, prop_t *const nameLowerCase, prop_t *const local, prop_t *const ipProp,
+	prop_t **const fqdn, prop_t **const fqdnLowerCase,
+	prop_t **const localName, prop_t **const ip)
+{
+	prop.AddRef(ipProp);
+	*ip = ipProp;
+	if(fqdn != NULL) {
+		prop.AddRef(name);
+		*fqdn = name;
+	}
+	if(fqdnLowerCase != NULL) {
+		prop.AddRef(nameLowerCase);
+		*fqdnLowerCase = nameLowerCase;
+	}
+	if(localName != NULL) {
+		prop.AddRef(local);
+		*localName = local;
+	}
+}
+
+
 static rsRetVal ATTR_NONNULL(1, 5)
 findEntry(struct sockaddr_storage *const addr,
 	prop_t **const fqdn, prop_t **const fqdnLowerCase,
 	prop_t **const localName, prop_t **const ip)
 {
+	unsigned idxShard;
+	dnscache_shard_t *const shard = getShard(addr, &idxShard);
+	dnscache_entry_t *etry;
+	prop_t *ipNew = NULL;
+	struct timespec tAsyncTimeout;
+	int bMustResolve = 0;
+	int bTimedOut = 0;
+	const int bAsync = (dnscacheAsyncWorkers > 0);
+	int iCancelStateSave;
 	DEFiRet;
 
-	pthread_rwlock_rdlock(&dnsCache.rwlock);
-	dnscache_entry_t * etry = hashtable_search(dnsCache.ht, addr);
+	/* we may need to wait for other threads, which must not leave the lock held */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &iCancelStateSave);
+	pthread_mutex_lock(&shard->mut);
+	etry = hashtable_search(shard->ht, addr);
 	DBGPRINTF("findEntry: 1st lookup found %p\n", etry);
+	if(etry != NULL && etry->fqdn != NULL && !entryIsExpired(etry)) {
+		/* fast path: cache hit */
+		setProps(etry->fqdn, etry->fqdnLowerCase, etry->localName, etry->ip,
+			fqdn, fqdnLowerCase, localName, ip);
+		FINALIZE;
+	}
 
-	if(etry == NULL || (dnscacheEnableTTL && (etry->validUntil <= time(NULL)))) {
-		pthread_rwlock_unlock(&dnsCache.rwlock);
-		pthread_rwlock_wrlock(&dnsCache.rwlock);
-		etry = hashtable_search(dnsCache.ht, addr); /* re-query, might have changed */
+	if(etry == NULL) {
+		/* we need the IP in any case - obtain it without holding the lock */
+		pthread_mutex_unlock(&shard->mut);
+		iRet = getIPProp(addr, &ipNew);
+		pthread_mutex_lock(&shard->mut);
+		if(iRet != RS_RET_OK)
+			FINALIZE;
+		etry = hashtable_search(shard->ht, addr); /* re-query, might have changed */
 		DBGPRINTF("findEntry: 2nd lookup found %p\n", etry);
-		if(etry == NULL || (dnscacheEnableTTL && (etry->validUntil <= time(NULL)))) {
-			if(etry != NULL) {
-				DBGPRINTF("hashtable: entry timed out, discarding it; "
-					"valid until %lld, now %lld\n",
-					(long long) etry->validUntil, (long long) time(NULL));
-				dnscache_entry_t *const deleted = hashtable_remove(dnsCache.ht, addr);
-				if(deleted != etry) {
-					LogError(0, RS_RET_INTERNAL_ERROR, "dnscache %d: removed different "
-						"hashtable entry than expected - please report issue; "
-						"rsyslog version is %s", __LINE__, VERSION);
-				}
-				entryDestruct(etry);
+		if(etry == NULL) {
+			CHKiRet(addEntry(addr, idxShard, ipNew, &etry));
+			if(!bAsync || !resolverPoolAdd(etry))
+				bMustResolve = 1;
+		}
+	}
+
+	if(!bMustResolve && etry->fqdn != NULL && entryIsExpired(etry) && !etry->bResolving) {
+		DBGPRINTF("dnscache: entry timed out, refreshing it; valid until %lld, now %lld\n",
+			(long long) etry->validUntil, (long long) time(NULL));
+		etry->bResolving = 1;
+		if(!bAsync || !resolverPoolAdd(etry))
+			bMustResolve = 1;
+	}
+
+	if(bMustResolve) {
+		pthread_mutex_unlock(&shard->mut);
+		resolveEntry(etry);
+		pthread_mutex_lock(&shard->mut);
+	} else if(etry->fqdn == NULL) {
+		/* initial resolution in progress by someone else */
+		if(bAsync)
+			timeoutComp(&tAsyncTimeout, dnscacheAsyncTimeout);
+		while(etry->fqdn == NULL && !bTimedOut) {
+			if(bAsync) {
+				bTimedOut = (pthread_cond_timedwait(&shard->resolved, &shard->mut,
+					&tAsyncTimeout) == ETIMEDOUT);
+			} else {
+				pthread_cond_wait(&shard->resolved, &shard->mut);
 			}
-			/* now entry doesn't exist in any case, so let's (re)create it */
-			CHKiRet(addEntry(addr, &etry));
 		}
 	}
+	/* note: if the entry is expired and being refreshed asynchronously, we
+	 * use the old values until the refresh is done.
+	 */
 
-	prop.AddRef(etry->ip);
-	*ip = etry->ip;
-	if(fqdn != NULL) {
-		prop.AddRef(etry->fqdn);
-		*fqdn = etry->fqdn;
+	if(etry->fqdn == NULL) {
+		/* async resolution not yet done, use the IP for now */
+		DBGPRINTF("dnscache: resolution pending, using IP as host name\n");
+		setProps(etry->ip, etry->ip, etry->ip, etry->ip, fqdn, fqdnLowerCase, localName, ip);
+	} else {
+		setProps(etry->fqdn, etry->fqdnLowerCase, etry->localName, etry->ip,
+			fqdn, fqdnLowerCase, localName, ip);
 	}
-	if(fqdnLowerCase != NULL) {
-		prop.AddRef(etry->fqdnLowerCase);
-		*fqdnLowerCase = etry->fqdnLowerCase;
+
+finalize_it:
+	pthread_mutex_unlock(&shard->mut);
+	pthread_setcancelstate(iCancelStateSave, NULL);
+	if(ipNew != NULL)
+		prop.Destruct(&ipNew);
+	RETiRet;
+}
+
+
+/* queue a single address for prefetching, if it is neither cached nor
+ * already being resolved. Returns 1 if a resolution was started.
+ */
+static int ATTR_NONNULL()
+prefetchAddr(struct sockaddr_storage *const addr)
+{
+	unsigned idxShard;
+	dnscache_shard_t *const shard = getShard(addr, &idxShard);
+	dnscache_entry_t *etry;
+	prop_t *ipNew = NULL;
+	int bStarted = 0;
+
+	pthread_mutex_lock(&shard->mut);
+	etry = hashtable_search(shard->ht, addr);
+	if(etry == NULL) {
+		pthread_mutex_unlock(&shard->mut);
+		if(getIPProp(addr, &ipNew) != RS_RET_OK)
+			return 0;
+		pthread_mutex_lock(&shard->mut);
+		etry = hashtable_search(shard->ht, addr);
+		if(etry == NULL) {
+			if(addEntry(addr, idxShard, ipNew, &etry) != RS_RET_OK) {
+				etry = NULL;
+			} else if(resolverPoolAdd(etry)) {
+				bStarted = 1;
+			} else {
+				/* no pool: drop the entry again, the regular lookup
+				 * will take care of it */
+				hashtable_remove(shard->ht, addr);
+				entryDestruct(etry);
+			}
+			etry = NULL;
+		}
 	}
-	if(localName != NULL) {
-		prop.AddRef(etry->localName);
-		*localName = etry->localName;
+	if(etry != NULL && !etry->bResolving && entryIsExpired(etry)) {
+		etry->bResolving = 1;
+		if(resolverPoolAdd(etry))
+			bStarted = 1;
+		else
+			etry->bResolving = 0;
 	}
+	pthread_mutex_unlock(&shard->mut);
+	if(ipNew != NULL)
+		prop.Destruct(&ipNew);
+	return bStarted;
+}
+
+
+/* record that a message property (fromhost, or a name-based ACL check)
+ * needed a resolved name. Until this happens, prefetching is a no-op, so
+ * configurations that never use the name do not cause any DNS queries.
+ */
+void
+dnscacheNameNeeded(void)
+{
+	if(ATOMIC_FETCH_32BIT(&bNameNeeded, &mutNameNeeded) == 0)
+		ATOMIC_STORE_1_TO_INT(&bNameNeeded, &mutNameNeeded);
+}
+
+
+/* Prefetch the names for a batch of addresses, e.g. everything returned by
+ * a single recvmmsg() call. Duplicates are skipped and all addresses not
+ * yet in the cache are handed to the async resolver pool at once, so that
+ * they are resolved concurrently. We do NOT wait for the results: the
+ * regular dnscacheLookup() later picks up the resolved entries or waits for
+ * the one in flight. Without an async resolver pool, this is a no-op, as we
+ * must not do (potentially unneeded) DNS queries on the caller's thread.
+ * The same is true as long as no message ever needed a name.
+ */
+rsRetVal ATTR_NONNULL()
+dnscachePrefetch(struct sockaddr_storage *const addrs, const int nAddrs)
+{
+	int i, j;
+	int bDup;
+	int nStarted = 0;
+	int iCancelStateSave;
+	DEFiRet;
+
+	if(dnscacheAsyncWorkers == 0 || glbl.GetDisableDNS()
+	   || ATOMIC_FETCH_32BIT(&bNameNeeded, &mutNameNeeded) == 0)
+		FINALIZE;
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &iCancelStateSave);
+	for(i = 0 ; i < nAddrs ; ++i) {
+		/* senders tend to come in bursts; cheaply skip dups of the
+		 * recent past. Everything else is caught by the cache itself.
+		 */
+		bDup = 0;
+		for(j = i - 1 ; j >= 0 && j >= i - DNSCACHE_PREFETCH_DUPWINDOW && !bDup ; --j)
+			bDup = key_equals_fn(&addrs[i], &addrs[j]);
+		if(bDup)
+			continue;
+		nStarted += prefetchAddr(&addrs[i]);
+	}
+	pthread_setcancelstate(iCancelStateSave, NULL);
+	DBGPRINTF("dnscache: prefetch of %d addresses started %d resolutions\n", nAddrs, nStarted);
 
 finalize_it:
-	pthread_rwlock_unlock(&dnsCache.rwlock);
 	RETiRet;
 }
 
@@ -442,6 +836,10 @@ finalize_it:
  * and IP address. If the entry is not yet inside the cache, it is added.
  * If the entry can not be resolved, an error is reported back. If fqdn
  * or fqdnLowerCase are NULL, they are not set.
+ * If asynchronous resolution is configured, a not yet cached entry is
+ * resolved by the resolver pool. We wait at most dnscacheAsyncTimeout ms
+ * for it and return the IP as host name if resolution did not complete in
+ * time.
  */
 rsRetVal ATTR_NONNULL(1, 5)
 dnscacheLookup(struct sockaddr_storage *const addr,
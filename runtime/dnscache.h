@@ -27,7 +27,12 @@ rsRetVal dnscacheDeinit(void);
 rsRetVal ATTR_NONNULL(1, 5) dnscacheLookup(struct sockaddr_storage *const addr,
 	prop_t **const fqdn, prop_t **const fqdnLowerCase,
 	prop_t **const localName, prop_t **const ip);
+rsRetVal ATTR_NONNULL() dnscachePrefetch(struct sockaddr_storage *const addrs, const int nAddrs);
+void dnscacheNameNeeded(void);
 
 extern unsigned dnscacheDefaultTTL;
 extern int dnscacheEnableTTL;
+extern unsigned dnscacheNegativeTTL;
+extern int dnscacheAsyncWorkers;
+extern int dnscacheAsyncTimeout;
 #endif /* #ifndef INCLUDED_DNSCACHE_H */
@@ -79,7 +79,9 @@ static void /* assumes exclusive access to bucket */
 dynstats_destroyCountersIn(dynstats_bucket_t *b, htable *table, dynstats_ctr_t *ctrs) {
 	dynstats_ctr_t *ctr;
 	int ctrs_purged = 0;
-	hashtable_destroy(table, 0);
+	if (table != NULL) {
+		hashtable_destroy(table, 0);
+	}
 	while (ctrs != NULL) {
 		ctr = ctrs;
 		ctrs = ctrs->next;
@@ -92,23 +94,37 @@ dynstats_destroyCountersIn(dynstats_bucket_t *b, htable *table, dynstats_ctr_t *
 
 static void /* assumes exclusive access to bucket */
 dynstats_destroyCounters(dynstats_bucket_t *b) {
+	int i;
 	statsobj.UnlinkAllCounters(b->stats);
-	dynstats_destroyCountersIn(b, b->table, b->ctrs);
+	for (i = 0 ; i < DYNSTATS_NUM_STRIPES ; ++i) {
+		dynstats_destroyCountersIn(b, b->stripes[i].table, b->stripes[i].ctrs);
+	}
+}
+
+static struct dynstats_stripe_s *
+dynstats_getStripe(dynstats_bucket_t *b, const uchar *metric) {
+	return &b->stripes[hash_from_string((void*) metric) & (DYNSTATS_NUM_STRIPES - 1)];
 }
 
 static void
 dynstats_destroyBucket(dynstats_bucket_t* b) {
 	dynstats_buckets_t *bkts;
+	int i;
 
 	bkts = &loadConf->dynstats_buckets;
 
 	pthread_rwlock_wrlock(&b->lock);
 	dynstats_destroyCounters(b);
-	dynstats_destroyCountersIn(b, b->survivor_table, b->survivor_ctrs);
+	for (i = 0 ; i < DYNSTATS_NUM_STRIPES ; ++i) {
+		dynstats_destroyCountersIn(b, b->stripes[i].survivor_table, b->stripes[i].survivor_ctrs);
+	}
 	statsobj.Destruct(&b->stats);
 	free(b->name);
 	pthread_rwlock_unlock(&b->lock);
 	pthread_rwlock_destroy(&b->lock);
+	for (i = 0 ; i < DYNSTATS_NUM_STRIPES ; ++i) {
+		pthread_rwlock_destroy(&b->stripes[i].lock);
+	}
 	pthread_mutex_destroy(&b->mutMetricCount);
 	statsobj.DestructCounter(bkts->global_stats, b->pOpsOverflowCtr);
 	statsobj.DestructCounter(bkts->global_stats, b->pNewMetricAddCtr);
@@ -210,45 +226,49 @@ finalize_it:
 static void
 no_op_free(void __attribute__((unused)) *ignore)  {}
 
-static rsRetVal  /* assumes exclusive access to bucket */
+static rsRetVal  /* assumes exclusive access to bucket (all stripes locked) */
 dynstats_rebuildSurvivorTable(dynstats_bucket_t *b) {
-	htable *survivor_table = NULL;
-	htable *new_table = NULL;
+	htable *survivor_tables[DYNSTATS_NUM_STRIPES];
+	htable *new_tables[DYNSTATS_NUM_STRIPES];
+	struct dynstats_stripe_s *stripe;
 	size_t htab_sz;
+	int i;
 	DEFiRet;
 	
-	htab_sz = (size_t) (DYNSTATS_HASHTABLE_SIZE_OVERPROVISIONING * b->maxCardinality + 1);
-	if (b->table == NULL) {
-		CHKmalloc(survivor_table = create_hashtable(htab_sz, hash_from_string, key_equals_string,
+	memset(survivor_tables, 0, sizeof(survivor_tables));
+	memset(new_tables, 0, sizeof(new_tables));
+	htab_sz = (size_t) (DYNSTATS_HASHTABLE_SIZE_OVERPROVISIONING * b->maxCardinality
+		/ DYNSTATS_NUM_STRIPES + 1);
+	/* we first allocate everything, so that a failure leaves the bucket untouched */
+	for (i = 0 ; i < DYNSTATS_NUM_STRIPES ; ++i) {
+		if (b->stripes[i].table == NULL) {
+			CHKmalloc(survivor_tables[i] = create_hashtable(htab_sz, hash_from_string,
+				key_equals_string, no_op_free));
+		}
+		CHKmalloc(new_tables[i] = create_hashtable(htab_sz, hash_from_string, key_equals_string,
 			no_op_free));
 	}
-	CHKmalloc(new_table = create_hashtable(htab_sz, hash_from_string, key_equals_string, no_op_free));
 	statsobj.UnlinkAllCounters(b->stats);
-	if (b->survivor_table != NULL) {
-		dynstats_destroyCountersIn(b, b->survivor_table, b->survivor_ctrs);
+	for (i = 0 ; i < DYNSTATS_NUM_STRIPES ; ++i) {
+		stripe = &b->stripes[i];
+		if (stripe->survivor_table != NULL) {
+			dynstats_destroyCountersIn(b, stripe->survivor_table, stripe->survivor_ctrs);
+		}
+		stripe->survivor_table = (stripe->table == NULL) ? survivor_tables[i] : stripe->table;
+		stripe->survivor_ctrs = stripe->ctrs;
+		stripe->table = new_tables[i];
+		stripe->ctrs = NULL;
 	}
-	b->survivor_table = (b->table == NULL) ? survivor_table : b->table;
-	b->survivor_ctrs = b->ctrs;
-	b->table = new_table;
-	b->ctrs = NULL;
 finalize_it:
 	if (iRet != RS_RET_OK) {
 		LogError(errno, RS_RET_INTERNAL_ERROR, "error trying to evict "
 			"TTL-expired metrics of dyn-stats bucket named: %s", b->name);
-		if (new_table == NULL) {
-			LogError(errno, RS_RET_INTERNAL_ERROR, "error trying to "
-				"initialize hash-table for dyn-stats bucket named: %s", b->name);
-		} else {
-			assert(0); /* "can" not happen -- triggers Coverity CID 184307:
-			hashtable_destroy(new_table, 0);
-			We keep this as guard should code above change in the future */
-		}
-		if (b->table == NULL) {
-			if (survivor_table == NULL) {
-				LogError(errno, RS_RET_INTERNAL_ERROR, "error trying to initialize "
-				"ttl-survivor hash-table for dyn-stats bucket named: %s", b->name);
-			} else {
-				hashtable_destroy(survivor_table, 0);
+		for (i = 0 ; i < DYNSTATS_NUM_STRIPES ; ++i) {
+			if (new_tables[i] != NULL) {
+				hashtable_destroy(new_tables[i], 0);
+			}
+			if (survivor_tables[i] != NULL) {
+				hashtable_destroy(survivor_tables[i], 0);
 			}
 		}
 	}
@@ -257,12 +277,19 @@ finalize_it:
 
 static rsRetVal
 dynstats_resetBucket(dynstats_bucket_t *b) {
+	int i;
 	DEFiRet;
 	pthread_rwlock_wrlock(&b->lock);
+	for (i = 0 ; i < DYNSTATS_NUM_STRIPES ; ++i) {
+		pthread_rwlock_wrlock(&b->stripes[i].lock);
+	}
 	CHKiRet(dynstats_rebuildSurvivorTable(b));
 	STATSCOUNTER_INC(b->ctrPurgeTriggered, b->mutCtrPurgeTriggered);
 	timeoutComp(&b->metricCleanupTimeout, b->unusedMetricLife);
 finalize_it:
+	for (i = DYNSTATS_NUM_STRIPES - 1 ; i >= 0 ; --i) {
+		pthread_rwlock_unlock(&b->stripes[i].lock);
+	}
 	pthread_rwlock_unlock(&b->lock);
 	RETiRet;
 }
@@ -310,6 +337,7 @@ dynstats_newBucket(const uchar* name, uint8_t resettable, uint32_t maxCardinalit
 	dynstats_buckets_t *bkts;
 	uint8_t lock_initialized, metric_count_mutex_initialized;
 	pthread_rwlockattr_t bucket_lock_attr;
+	int i;
 	DEFiRet;
 
 	lock_initialized = metric_count_mutex_initialized = 0;
@@ -330,6 +358,9 @@ dynstats_newBucket(const uchar* name, uint8_t resettable, uint32_t maxCardinalit
 #endif
 
 		pthread_rwlock_init(&b->lock, &bucket_lock_attr);
+		for (i = 0 ; i < DYNSTATS_NUM_STRIPES ; ++i) {
+			pthread_rwlock_init(&b->stripes[i].lock, &bucket_lock_attr);
+		}
 		lock_initialized = 1;
 		pthread_mutex_init(&b->mutMetricCount, NULL);
 		metric_count_mutex_initialized = 1;
@@ -507,6 +538,7 @@ static rsRetVal
 dynstats_addNewCtr(dynstats_bucket_t *b, const uchar* metric, uint8_t doInitialIncrement) {
 	dynstats_ctr_t *ctr;
 	dynstats_ctr_t *found_ctr, *survivor_ctr, *effective_ctr;
+	struct dynstats_stripe_s *const stripe = dynstats_getStripe(b, metric);
 	int created;
 	uchar *copy_of_key = NULL;
 	DEFiRet;
@@ -520,8 +552,8 @@ dynstats_addNewCtr(dynstats_bucket_t *b, const uchar* metric, uint8_t doInitialI
 	
 	CHKiRet(dynstats_createCtr(b, metric, &ctr));
 
-	pthread_rwlock_wrlock(&b->lock);
-	found_ctr = (dynstats_ctr_t*) hashtable_search(b->table, ctr->metric);
+	pthread_rwlock_wrlock(&stripe->lock);
+	found_ctr = (dynstats_ctr_t*) hashtable_search(stripe->table, ctr->metric);
 	if (found_ctr != NULL) {
 		if (doInitialIncrement) {
 			STATSCOUNTER_INC(found_ctr->ctr, found_ctr->mutCtr);
@@ -529,7 +561,7 @@ dynstats_addNewCtr(dynstats_bucket_t *b, const uchar* metric, uint8_t doInitialI
 	} else {
 		copy_of_key = ustrdup(ctr->metric);
 		if (copy_of_key != NULL) {
-			survivor_ctr = (dynstats_ctr_t*) hashtable_search(b->survivor_table, ctr->metric);
+			survivor_ctr = (dynstats_ctr_t*) hashtable_search(stripe->survivor_table, ctr->metric);
 			if (survivor_ctr == NULL) {
 				effective_ctr = ctr;
 			} else {
@@ -540,27 +572,27 @@ dynstats_addNewCtr(dynstats_bucket_t *b, const uchar* metric, uint8_t doInitialI
 				if (survivor_ctr->next != NULL) {
 					survivor_ctr->next->prev = survivor_ctr->prev;
 				}
-				if (survivor_ctr == b->survivor_ctrs) {
-					b->survivor_ctrs = survivor_ctr->next;
+				if (survivor_ctr == stripe->survivor_ctrs) {
+					stripe->survivor_ctrs = survivor_ctr->next;
 				}
 			}
-			if ((created = hashtable_insert(b->table, copy_of_key, effective_ctr))) {
+			if ((created = hashtable_insert(stripe->table, copy_of_key, effective_ctr))) {
 				statsobj.AddPreCreatedCtr(b->stats, effective_ctr->pCtr);
 			}
 		}
 		if (created) {
-			if (b->ctrs != NULL) {
-				b->ctrs->prev = effective_ctr;
+			if (stripe->ctrs != NULL) {
+				stripe->ctrs->prev = effective_ctr;
 			}
 			effective_ctr->prev = NULL;
-			effective_ctr->next = b->ctrs;
-			b->ctrs = effective_ctr;
+			effective_ctr->next = stripe->ctrs;
+			stripe->ctrs = effective_ctr;
 			if (doInitialIncrement) {
 				STATSCOUNTER_INC(effective_ctr->ctr, effective_ctr->mutCtr);
 			}
 		}
 	}
-	pthread_rwlock_unlock(&b->lock);
+	pthread_rwlock_unlock(&stripe->lock);
 
 	if (found_ctr != NULL) {
 		//ignore
@@ -587,6 +619,7 @@ finalize_it:
 rsRetVal
 dynstats_inc(dynstats_bucket_t *b, uchar* metric) {
 	dynstats_ctr_t *ctr;
+	struct dynstats_stripe_s *stripe;
 	DEFiRet;
 
 	if (! GatherStats) {
@@ -598,12 +631,13 @@ dynstats_inc(dynstats_bucket_t *b, uchar* metric) {
 		FINALIZE;
 	}
 
-	if (pthread_rwlock_tryrdlock(&b->lock) == 0) {
-		ctr = (dynstats_ctr_t *) hashtable_search(b->table, metric);
+	stripe = dynstats_getStripe(b, metric);
+	if (pthread_rwlock_tryrdlock(&stripe->lock) == 0) {
+		ctr = (dynstats_ctr_t *) hashtable_search(stripe->table, metric);
 		if (ctr != NULL) {
 			STATSCOUNTER_INC(ctr->ctr, ctr->mutCtr);
 		}
-		pthread_rwlock_unlock(&b->lock);
+		pthread_rwlock_unlock(&stripe->lock);
 	} else {
 		ABORT_FINALIZE(RS_RET_NOENTRY);
 	}
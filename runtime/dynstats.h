@@ -31,10 +31,26 @@ struct dynstats_ctr_s {
 	struct dynstats_ctr_s *prev;
 };
 
-struct dynstats_bucket_s {
+/* the metrics of a bucket are spread over several stripes, each with its
+ * own lock and tables, so that workers updating different metrics do not
+ * all contend for a single lock.
+ */
+#define DYNSTATS_NUM_STRIPES 16 /* must be a power of 2 */
+struct dynstats_stripe_s {
+	pthread_rwlock_t lock;
 	htable *table;
+	struct dynstats_ctr_s *ctrs;
+	/*survivor objects are used to keep counter values around for upto unused-ttl duration,
+	  so in case it is accessed within (ttl - 2 * ttl) time-period we can re-store the
+	  accumulator value from this */
+	struct dynstats_ctr_s *survivor_ctrs;
+	htable *survivor_table;
+};
+
+struct dynstats_bucket_s {
+	struct dynstats_stripe_s stripes[DYNSTATS_NUM_STRIPES];
 	uchar *name;
-	pthread_rwlock_t lock;
+	pthread_rwlock_t lock; /* guards reset, which needs all stripes */
 	statsobj_t *stats;
 	STATSCOUNTER_DEF(ctrOpsOverflow, mutCtrOpsOverflow);
 	ctr_t *pOpsOverflowCtr;
@@ -49,12 +65,6 @@ struct dynstats_bucket_s {
 	STATSCOUNTER_DEF(ctrPurgeTriggered, mutCtrPurgeTriggered);
 	ctr_t *pPurgeTriggeredCtr;
 	struct dynstats_bucket_s *next; /* linked list ptr */
-	struct dynstats_ctr_s *ctrs;
-	/*survivor objects are used to keep counter values around for upto unused-ttl duration,
-	  so in case it is accessed within (ttl - 2 * ttl) time-period we can re-store the
-	  accumulator value from this */
-	struct dynstats_ctr_s *survivor_ctrs;
-	htable *survivor_table;
 	
 	uint32_t maxCardinality;
 	uint32_t metricCount;
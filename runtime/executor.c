@@ -0,0 +1,567 @@
+/* executor.c
+ * A shared, work-stealing executor for queue workers. Queues that are
+ * configured with queue.executor="shared" do not start their own worker
+ * thread pool. Instead, whenever such a queue has work, it submits a task
+ * (the queue itself) to the executor. A task processes a single batch and
+ * is then resubmitted by the queue as long as work is left. At most
+ * queue.workerthreads tasks of the same queue exist at any time, and all
+ * tasks are run by one small set of threads (global parameter
+ * executor.workerthreads), which are started on demand.
+ *
+ * Every executor thread has its own task deque. Tasks submitted by an
+ * executor thread itself (e.g. a ruleset queue feeding an action queue)
+ * are placed on its own deque, new work at the bottom (it is run next,
+ * while the messages are still cache-hot) and continuations at the top.
+ * Threads that run out of work steal from the top of the other threads'
+ * deques. Tasks submitted by other threads (inputs, regular queue workers)
+ * are spread round-robin over the started threads. Only threads that find
+ * no work at all sleep on the global condition variable.
+ *
+ * Executor threads are never cancelled. Queue shutdown thus waits for the
+ * tasks of the queue to complete (see qqueueShutdownWorkers()).
+ *
+ * Code that may block for an extended period of time (action retries,
+ * enqueueing into a full queue) calls executorBlockBegin()/End(). While
+ * an executor thread is blocked, it does not count against
+ * executor.workerthreads and an extra thread is started if tasks are
+ * pending and no other thread can run them. Otherwise, e.g. a single
+ * executor thread that blocks on a full action queue would wait for the
+ * consumer task of that queue, which sits on its own deque. The queues of
+ * actions that retry indefinitely are not run on the executor at all (see
+ * qqueueStart()), as they could occupy a thread for good.
+ *
+ * Note that output worker instances are kept per thread. As a task may run
+ * on any executor thread, an action queue with one worker thread may thus
+ * create up to one output worker instance (e.g. omfwd connection) per
+ * executor thread.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#ifdef HAVE_SYS_PRCTL_H
+#  include <sys/prctl.h>
+#endif
+
+#include "rsyslog.h"
+#include "queue.h"
+#include "wti.h"
+#include "action.h"
+#include "statsobj.h"
+#include "atomic.h"
+#include "errmsg.h"
+#include "srUtils.h"
+#include "unicode-helper.h"
+#include "executor.h"
+
+/* definitions for objects we access */
+DEFobjStaticHelpers
+DEFobjCurrIf(statsobj)
+
+#define EXEC_INITIAL_TASKS 64 /* initial deque size, must be a power of 2 */
+#define EXEC_MAX_EXTRA_WRKRS 32 /* max threads started to stand in for blocked ones */
+
+int executorNumWrkrs = 0;
+
+/* an executor thread and its task deque */
+typedef struct execWrkr_s {
+	pthread_t thrdID;
+	wti_t *pWti;		/* our worker thread instance, holds the action worker instances */
+	int idx;		/* index in wrkrs[] */
+	pthread_mutex_t mut;	/* protects the deque */
+	qqueue_t **tasks;	/* ring buffer of maxTasks entries */
+	unsigned maxTasks;	/* always a power of 2 */
+	unsigned top;		/* oldest task, stolen first */
+	unsigned bottom;	/* one past the newest task */
+	sbool bBlocked;		/* between executorBlockBegin() and End(), protected by mutExec */
+} execWrkr_t;
+
+static execWrkr_t *wrkrs = NULL;	/* nMaxWrkrs entries, set up by executorEnable() */
+static int nMaxWrkrs = 0;	/* executorNumWrkrs plus stand-ins for blocked threads */
+static pthread_mutex_t mutExec = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t condExec = PTHREAD_COND_INITIALIZER; /* idle threads wait here */
+/* the following are protected by mutExec */
+static int nStarted = 0;	/* threads started so far */
+static int nIdle = 0;		/* threads waiting on condExec */
+static int nBlocked = 0;	/* threads inside executorBlockBegin()/End() */
+static unsigned nextWrkr = 0;	/* round-robin target for outside submissions */
+static sbool bShutdown = 0;
+/* tasks in all deques; may briefly be too high, but never too low */
+static int nPending = 0;
+DEF_ATOMIC_HELPER_MUT(mutExecPending)
+static pthread_key_t keyWrkr;	/* execWrkr_t of the current thread, NULL if none */
+
+static statsobj_t *stats = NULL;
+static intctr_t ctrTasks;
+DEF_ATOMIC_HELPER_MUT64(mutExecTasks)
+static intctr_t ctrSteals;
+DEF_ATOMIC_HELPER_MUT64(mutExecSteals)
+static intctr_t ctrStandIns;
+DEF_ATOMIC_HELPER_MUT64(mutExecStandIns)
+
+
+/* the deque primitives; must be called with w->mut locked */
+static rsRetVal
+dequeGrow(execWrkr_t *const w)
+{
+	qqueue_t **newTasks;
+	const unsigned newMax = (w->maxTasks == 0) ? EXEC_INITIAL_TASKS : 2 * w->maxTasks;
+	unsigned i;
+	DEFiRet;
+
+	CHKmalloc(newTasks = malloc(newMax * sizeof(qqueue_t*)));
+	for(i = 0 ; i < w->bottom - w->top ; ++i)
+		newTasks[i] = w->tasks[(w->top + i) & (w->maxTasks - 1)];
+	free(w->tasks);
+	w->tasks = newTasks;
+	w->bottom -= w->top;
+	w->top = 0;
+	w->maxTasks = newMax;
+
+finalize_it:
+	RETiRet;
+}
+
+static rsRetVal
+dequePush(execWrkr_t *const w, qqueue_t *const pQueue, const execSubmitMode_t mode)
+{
+	DEFiRet;
+
+	if(w->bottom - w->top == w->maxTasks)
+		CHKiRet(dequeGrow(w));
+	if(mode == EXEC_SUBMIT_CONTINUE) {
+		w->tasks[--w->top & (w->maxTasks - 1)] = pQueue;
+	} else {
+		w->tasks[w->bottom++ & (w->maxTasks - 1)] = pQueue;
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+static qqueue_t *
+dequePopBottom(execWrkr_t *const w)
+{
+	qqueue_t *pQueue = NULL;
+
+	pthread_mutex_lock(&w->mut);
+	if(w->bottom != w->top)
+		pQueue = w->tasks[--w->bottom & (w->maxTasks - 1)];
+	pthread_mutex_unlock(&w->mut);
+	return pQueue;
+}
+
+static qqueue_t *
+dequeStealTop(execWrkr_t *const w)
+{
+	qqueue_t *pQueue = NULL;
+
+	pthread_mutex_lock(&w->mut);
+	if(w->bottom != w->top)
+		pQueue = w->tasks[w->top++ & (w->maxTasks - 1)];
+	pthread_mutex_unlock(&w->mut);
+	return pQueue;
+}
+
+
+/* find the next task for thread me: our own newest task, or else the
+ * oldest task of some other thread.
+ */
+static qqueue_t *
+getTask(execWrkr_t *const me)
+{
+	qqueue_t *pQueue;
+	const int n = nStarted; /* may be stale, which only delays a steal */
+	int i;
+
+	if((pQueue = dequePopBottom(me)) != NULL)
+		return pQueue;
+	for(i = 1 ; i < n ; ++i) {
+		if((pQueue = dequeStealTop(&wrkrs[(me->idx + i) % n])) != NULL) {
+			STATSCOUNTER_INC(ctrSteals, mutExecSteals);
+			return pQueue;
+		}
+	}
+	return NULL;
+}
+
+
+static void *
+executorWrkr(void *arg)
+{
+	execWrkr_t *const me = (execWrkr_t*) arg;
+	qqueue_t *pQueue;
+	sigset_t sigSet;
+	int iCancelStateSave;
+	int bTerminate = 0;
+#	if defined(HAVE_PRCTL) && defined(PR_SET_NAME)
+	char thrdName[32];
+#	endif
+
+	/* block all signals except SIGTTIN and SIGSEGV, just like wtp workers */
+	sigfillset(&sigSet);
+	sigdelset(&sigSet, SIGTTIN);
+	sigdelset(&sigSet, SIGSEGV);
+	pthread_sigmask(SIG_BLOCK, &sigSet, NULL);
+
+#	if defined(HAVE_PRCTL) && defined(PR_SET_NAME)
+	snprintf(thrdName, sizeof(thrdName), "rs:executor/%d", me->idx);
+	if(prctl(PR_SET_NAME, thrdName, 0, 0, 0) != 0) {
+		DBGPRINTF("prctl failed, not setting thread name for '%s'\n", thrdName);
+	}
+	dbgOutputTID(thrdName);
+#	endif
+	dbgSetThrdName(wtiGetDbgHdr(me->pWti));
+
+	pthread_setspecific(keyWrkr, me);
+	/* consumers enable cancellation where it is safe, so we must disable it */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &iCancelStateSave);
+
+	while(!bTerminate) {
+		if((pQueue = getTask(me)) != NULL) {
+			ATOMIC_DEC(&nPending, &mutExecPending);
+			STATSCOUNTER_INC(ctrTasks, mutExecTasks);
+			qqueueExecTask(pQueue, me->pWti);
+			continue;
+		}
+
+		/* out of work: the task counter is re-checked under mutExec, and
+		 * submitters signal under mutExec, so no wakeup can be lost.
+		 */
+		pthread_mutex_lock(&mutExec);
+		++nIdle;
+		while(ATOMIC_FETCH_32BIT(&nPending, &mutExecPending) == 0 && !bShutdown)
+			pthread_cond_wait(&condExec, &mutExec);
+		--nIdle;
+		bTerminate = bShutdown && ATOMIC_FETCH_32BIT(&nPending, &mutExecPending) == 0;
+		pthread_mutex_unlock(&mutExec);
+	}
+
+	pthread_setcancelstate(iCancelStateSave, NULL);
+	DBGPRINTF("executor: thread %d terminating\n", me->idx);
+	return NULL;
+}
+
+
+/* can (and should) we start another thread? Must be called with mutExec
+ * locked. Blocked threads do not count, as they do not run tasks.
+ */
+static inline int
+needMoreWrkrs(void)
+{
+	return nStarted - nBlocked < executorNumWrkrs && nStarted < nMaxWrkrs;
+}
+
+
+/* start another executor thread. Must be called with mutExec locked.
+ * Errors are reported by the caller, after mutExec has been released.
+ */
+static rsRetVal
+startWrkr(int *const pErr)
+{
+	execWrkr_t *const w = &wrkrs[nStarted];
+	uchar dbgHdr[32];
+	rsRetVal localRet;
+	DEFiRet;
+
+	if(w->pWti == NULL) {
+		snprintf((char*) dbgHdr, sizeof(dbgHdr), "executor/%d", nStarted);
+		CHKiRet(wtiConstruct(&w->pWti));
+		localRet = wtiSetDbgHdr(w->pWti, dbgHdr, ustrlen(dbgHdr));
+		if(localRet == RS_RET_OK)
+			localRet = wtiConstructFinalize(w->pWti);
+		if(localRet != RS_RET_OK) {
+			wtiDestruct(&w->pWti);
+			ABORT_FINALIZE(localRet);
+		}
+	}
+
+	if((*pErr = pthread_create(&w->thrdID, &default_thread_attr, executorWrkr, w)) != 0)
+		ABORT_FINALIZE(RS_RET_ERR);
+	++nStarted;
+	DBGPRINTF("executor: started thread %d of %d\n", nStarted, executorNumWrkrs);
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* submit a task for queue pQueue. The queue keeps track of how many of
+ * its tasks exist (see qqueueAdviseMaxWorkers()), we only run them.
+ * Tasks from outside the executor must only be placed on the deques of
+ * started threads, as no one else would look there. So if no thread is
+ * idle, we start the new one first and hand it the task.
+ */
+void
+executorSubmit(qqueue_t *const pQueue, const execSubmitMode_t mode)
+{
+	execWrkr_t *w;
+	rsRetVal localRet = RS_RET_OK;
+	rsRetVal startRet = RS_RET_OK;
+	int bTriedStart = 0;
+	int err = 0;
+	int i;
+
+	while(1) {
+		pthread_mutex_lock(&mutExec);
+		if((w = pthread_getspecific(keyWrkr)) == NULL) {
+			if(!bTriedStart && nIdle == 0 && needMoreWrkrs()) {
+				bTriedStart = 1;
+				startRet = startWrkr(&err);
+			}
+			if(startRet == RS_RET_OK && bTriedStart) {
+				w = &wrkrs[nStarted - 1];
+			} else if(nStarted == 0) {
+				/* no thread could be started; the next one will steal it */
+				w = &wrkrs[0];
+			} else {
+				/* prefer threads that are not blocked */
+				for(i = 0 ; i < nStarted ; ++i) {
+					w = &wrkrs[nextWrkr++ % nStarted];
+					if(!w->bBlocked)
+						break;
+				}
+			}
+		}
+		pthread_mutex_lock(&w->mut);
+		localRet = dequePush(w, pQueue, mode);
+		pthread_mutex_unlock(&w->mut);
+		if(localRet == RS_RET_OK)
+			break;
+		pthread_mutex_unlock(&mutExec);
+		/* we must not drop the task, the queue would wait for it forever */
+		LogError(0, localRet, "executor: cannot queue task, retrying");
+		srSleep(0, 100000);
+	}
+	ATOMIC_INC(&nPending, &mutExecPending);
+
+	if(nIdle > 0) {
+		pthread_cond_signal(&condExec);
+	} else if(!bTriedStart && needMoreWrkrs()) {
+		startRet = startWrkr(&err);
+	}
+	pthread_mutex_unlock(&mutExec);
+
+	if(startRet != RS_RET_OK) {
+		LogError(err, startRet, "executor: cannot start worker thread, "
+			"running with %d threads", nStarted);
+	}
+}
+
+
+/* the calling thread is about to block for a potentially long time. If it
+ * is an executor thread, make sure the tasks pending on its deque can be
+ * run by others, if needed by starting an additional thread. This may be
+ * called with a queue mutex locked, so we must not emit messages here.
+ */
+void
+executorBlockBegin(void)
+{
+	execWrkr_t *const me = pthread_getspecific(keyWrkr);
+	rsRetVal localRet = RS_RET_OK;
+	int err = 0;
+
+	if(me == NULL)
+		return;
+	pthread_mutex_lock(&mutExec);
+	me->bBlocked = 1;
+	++nBlocked;
+	if(ATOMIC_FETCH_32BIT(&nPending, &mutExecPending) > 0) {
+		if(nIdle > 0) {
+			pthread_cond_signal(&condExec);
+		} else if(needMoreWrkrs()) {
+			STATSCOUNTER_INC(ctrStandIns, mutExecStandIns);
+			localRet = startWrkr(&err);
+		}
+	}
+	pthread_mutex_unlock(&mutExec);
+	if(localRet != RS_RET_OK)
+		DBGPRINTF("executor: cannot start stand-in thread, error %d/%d\n", localRet, err);
+}
+
+
+void
+executorBlockEnd(void)
+{
+	execWrkr_t *const me = pthread_getspecific(keyWrkr);
+
+	if(me == NULL)
+		return;
+	pthread_mutex_lock(&mutExec);
+	me->bBlocked = 0;
+	--nBlocked;
+	pthread_mutex_unlock(&mutExec);
+}
+
+
+/* free the worker instances the executor threads hold for pAction. The
+ * caller must make sure the action is no longer being executed, which is
+ * the case once its (shared executor) queue has been shut down. Threads
+ * started later cannot hold an instance. We must not hold mutExec while
+ * freeing, as the output module may emit (internal) messages.
+ */
+void
+executorReleaseAction(action_t *const pAction)
+{
+	int i, n;
+
+	pthread_mutex_lock(&mutExec);
+	n = nStarted;
+	pthread_mutex_unlock(&mutExec);
+	for(i = 0 ; i < n ; ++i) {
+		wtiFreeActWrkrInfo(wrkrs[i].pWti, pAction->iActionNbr);
+	}
+}
+
+
+/* free the worker instances of all actions without a queue of their own.
+ * Such actions are executed by ruleset (and the main) queue workers, so
+ * this must only be called when all of these have been shut down. Action
+ * queues may still be active, so we must not touch their worker instances.
+ * Note that pAction is set once, when the first instance is created, so
+ * if it is non-NULL, it is stable.
+ */
+void
+executorReleaseDirectActions(void)
+{
+	actWrkrInfo_t *wrkrInfo;
+	int i, j, n;
+
+	pthread_mutex_lock(&mutExec);
+	n = nStarted;
+	pthread_mutex_unlock(&mutExec);
+	for(i = 0 ; i < n ; ++i) {
+		for(j = 0 ; j < iActionNbr ; ++j) {
+			wrkrInfo = &wrkrs[i].pWti->actWrkrInfo[j];
+			if(   wrkrInfo->pAction != NULL
+			   && (   wrkrInfo->pAction->pQueue == NULL
+			       || wrkrInfo->pAction->pQueue->qType == QUEUETYPE_DIRECT)) {
+				wtiFreeActWrkrInfo(wrkrs[i].pWti, j);
+			}
+		}
+	}
+}
+
+
+/* called once the configuration is loaded and the executor is enabled */
+rsRetVal
+executorEnable(void)
+{
+	int i;
+	DEFiRet;
+
+	if(wrkrs != NULL)
+		FINALIZE; /* already enabled */
+
+	nMaxWrkrs = executorNumWrkrs + EXEC_MAX_EXTRA_WRKRS;
+	CHKmalloc(wrkrs = calloc(nMaxWrkrs, sizeof(execWrkr_t)));
+	for(i = 0 ; i < nMaxWrkrs ; ++i) {
+		wrkrs[i].idx = i;
+		pthread_mutex_init(&wrkrs[i].mut, NULL);
+	}
+
+	ctrTasks = ctrSteals = ctrStandIns = 0;
+	INIT_ATOMIC_HELPER_MUT64(mutExecTasks);
+	INIT_ATOMIC_HELPER_MUT64(mutExecSteals);
+	INIT_ATOMIC_HELPER_MUT64(mutExecStandIns);
+	CHKiRet(statsobj.Construct(&stats));
+	CHKiRet(statsobj.SetName(stats, UCHAR_CONSTANT("executor")));
+	CHKiRet(statsobj.SetOrigin(stats, UCHAR_CONSTANT("core.executor")));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("tasks"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrTasks));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("steals"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrSteals));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("standins"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrStandIns));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("threads"),
+		ctrType_Int, CTR_FLAG_NONE, &nStarted));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("blocked"),
+		ctrType_Int, CTR_FLAG_NONE, &nBlocked));
+	CHKiRet(statsobj.ConstructFinalize(stats));
+	DBGPRINTF("executor: enabled with up to %d threads\n", executorNumWrkrs);
+
+finalize_it:
+	if(iRet != RS_RET_OK) {
+		LogError(0, iRet, "executor: error enabling shared executor, queues "
+			"will use their own worker threads");
+		if(stats != NULL)
+			statsobj.Destruct(&stats);
+		if(wrkrs != NULL) {
+			for(i = 0 ; i < nMaxWrkrs ; ++i)
+				pthread_mutex_destroy(&wrkrs[i].mut);
+			free(wrkrs);
+			wrkrs = NULL;
+		}
+		executorNumWrkrs = 0;
+	}
+	RETiRet;
+}
+
+
+/* terminate all executor threads. Must only be called after all queues
+ * that use the executor have been destructed.
+ */
+void
+executorExit(void)
+{
+	int i;
+
+	if(wrkrs == NULL)
+		return;
+
+	pthread_mutex_lock(&mutExec);
+	bShutdown = 1;
+	pthread_cond_broadcast(&condExec);
+	pthread_mutex_unlock(&mutExec);
+
+	for(i = 0 ; i < nStarted ; ++i) {
+		pthread_join(wrkrs[i].thrdID, NULL);
+	}
+	for(i = 0 ; i < nMaxWrkrs ; ++i) {
+		if(wrkrs[i].pWti != NULL)
+			wtiDestruct(&wrkrs[i].pWti);
+		pthread_mutex_destroy(&wrkrs[i].mut);
+		free(wrkrs[i].tasks);
+	}
+	if(stats != NULL)
+		statsobj.Destruct(&stats);
+	free(wrkrs);
+	wrkrs = NULL;
+	nStarted = 0;
+	DBGPRINTF("executor: all threads terminated\n");
+}
+
+
+rsRetVal
+executorClassInit(void)
+{
+	int r;
+	DEFiRet;
+	CHKiRet(objGetObjInterface(&obj));
+	CHKiRet(objUse(statsobj, CORE_COMPONENT));
+	INIT_ATOMIC_HELPER_MUT(mutExecPending);
+	if((r = pthread_key_create(&keyWrkr, NULL)) != 0) {
+		LogError(r, RS_RET_ERR, "executor: pthread_key_create failed");
+		ABORT_FINALIZE(RS_RET_ERR);
+	}
+finalize_it:
+	RETiRet;
+}
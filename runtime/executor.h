@@ -0,0 +1,39 @@
+/* Definitions for the shared queue executor.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INCLUDED_EXECUTOR_H
+#define INCLUDED_EXECUTOR_H
+
+extern int executorNumWrkrs;	/* max number of executor threads, 0 = executor disabled */
+
+/* how a task is to be placed on the submitting thread's deque */
+typedef enum execSubmitMode_e {
+	EXEC_SUBMIT_NEW = 0,	/* new work, run it next (LIFO, cache-hot) */
+	EXEC_SUBMIT_CONTINUE	/* continuation of a task, let others go first */
+} execSubmitMode_t;
+
+rsRetVal executorClassInit(void);
+rsRetVal executorEnable(void);
+void executorSubmit(qqueue_t *pQueue, execSubmitMode_t mode);
+void executorBlockBegin(void);
+void executorBlockEnd(void);
+void executorReleaseAction(action_t *pAction);
+void executorReleaseDirectActions(void);
+void executorExit(void);
+
+#endif /* #ifndef INCLUDED_EXECUTOR_H */
@@ -57,6 +57,9 @@
 #include "rsconf.h"
 #include "queue.h"
 #include "dnscache.h"
+#include "msgtrace.h"
+#include "executor.h"
+#include "statsobj.h"
 
 #define REPORT_CHILD_PROCESS_EXITS_NONE 0
 #define REPORT_CHILD_PROCESS_EXITS_ERRORS 1
@@ -102,6 +105,9 @@ static int oversizeMsgInputMode = 0;	/* Mode which oversize messages will be for
 static int reportOversizeMsg = 1;	/* shall error messages be generated for oversize messages? */
 static int reportChildProcessExits = REPORT_CHILD_PROCESS_EXITS_ERRORS;
 static int iGnuTLSLoglevel = 0;		/* Sets GNUTLS Debug Level */
+static int iTlsSessionTimeout = 300;	/* lifetime of resumable TLS sessions/tickets, in seconds */
+static int bTlsKtls = 0;		/* try to offload TLS records to the kernel (if driver supports it)? */
+static int iStreamWriterThreads = 0;	/* size of shared stream writer pool, 0 = one thread per stream */
 static int iDefPFFamily = PF_UNSPEC;     /* protocol family (IPv4, IPv6 or both) */
 static int bDropMalPTRMsgs = 0;/* Drop messages which have malicious PTR records during DNS lookup */
 static int option_DisallowWarning = 1;	/* complain if message from disallowed sender is received */
@@ -204,6 +210,9 @@ static struct cnfparamdescr cnfparamdescr[] = {
 	{ "net.aclresolvehostname", eCmdHdlrBinary, 0 },
 	{ "net.enabledns", eCmdHdlrBinary, 0 },
 	{ "net.permitACLwarning", eCmdHdlrBinary, 0 },
+	{ "net.tls.sessiontimeout", eCmdHdlrPositiveInt, 0 },
+	{ "net.tls.ktls", eCmdHdlrBinary, 0 },
+	{ "stream.writerthreads", eCmdHdlrNonNegInt, 0 },
 	{ "abortonuncleanconfig", eCmdHdlrBinary, 0 },
 	{ "variables.casesensitive", eCmdHdlrBinary, 0 },
 	{ "environment", eCmdHdlrArray, 0 },
@@ -225,6 +234,12 @@ static struct cnfparamdescr cnfparamdescr[] = {
 	{ "default.ruleset.queue.timeoutworkerthreadshutdown", eCmdHdlrInt, 0 },
 	{ "reverselookup.cache.ttl.default", eCmdHdlrNonNegInt, 0 },
 	{ "reverselookup.cache.ttl.enable", eCmdHdlrBinary, 0 },
+	{ "reverselookup.cache.ttl.negative", eCmdHdlrNonNegInt, 0 },
+	{ "reverselookup.async.workers", eCmdHdlrNonNegInt, 0 },
+	{ "reverselookup.async.timeout", eCmdHdlrNonNegInt, 0 },
+	{ "msgtrace.samplerate", eCmdHdlrNonNegInt, 0 },
+	{ "executor.workerthreads", eCmdHdlrNonNegInt, 0 },
+	{ "stats.latencyhistograms", eCmdHdlrBinary, 0 },
 	{ "debug.files", eCmdHdlrArray, 0 },
 	{ "debug.whitelist", eCmdHdlrBinary, 0 }
 };
@@ -263,6 +278,27 @@ GetGnuTLSLoglevel(void)
 	return(iGnuTLSLoglevel);
 }
 
+
+int
+GetTlsSessionTimeout(void)
+{
+	return(iTlsSessionTimeout);
+}
+
+
+int
+GetTlsKtls(void)
+{
+	return(bTlsKtls);
+}
+
+
+int
+GetStreamWriterThreads(void)
+{
+	return(iStreamWriterThreads);
+}
+
 /* define a macro for the simple properties' set and get functions
  * (which are always the same). This is only suitable for pretty
  * simple cases which require neither checks nor memory allocation.
@@ -1377,6 +1413,12 @@ glblDoneLoadCnf(void)
 			LogError(0, RS_RET_OK, "debug: onShutdown set to %d", glblDebugOnShutdown);
 		} else if(!strcmp(paramblk.descr[i].name, "debug.gnutls")) {
 			iGnuTLSLoglevel = (int) cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "net.tls.sessiontimeout")) {
+			iTlsSessionTimeout = (int) cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "net.tls.ktls")) {
+			bTlsKtls = (int) cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "stream.writerthreads")) {
+			iStreamWriterThreads = (int) cnfparamvals[i].val.d.n;
 		} else if(!strcmp(paramblk.descr[i].name, "debug.unloadmodules")) {
 			glblUnloadModules = (int) cnfparamvals[i].val.d.n;
 		} else if(!strcmp(paramblk.descr[i].name, "parser.controlcharacterescapeprefix")) {
@@ -1502,12 +1544,32 @@ glblDoneLoadCnf(void)
 			dnscacheDefaultTTL = cnfparamvals[i].val.d.n;
 		} else if(!strcmp(paramblk.descr[i].name, "reverselookup.cache.ttl.enable")) {
 			dnscacheEnableTTL = cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "reverselookup.cache.ttl.negative")) {
+			dnscacheNegativeTTL = cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "reverselookup.async.workers")) {
+			dnscacheAsyncWorkers = cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "reverselookup.async.timeout")) {
+			dnscacheAsyncTimeout = cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "msgtrace.samplerate")) {
+			msgtraceSampleRate = cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "executor.workerthreads")) {
+			executorNumWrkrs = cnfparamvals[i].val.d.n;
+		} else if(!strcmp(paramblk.descr[i].name, "stats.latencyhistograms")) {
+			GatherLatencyStats = (int) cnfparamvals[i].val.d.n;
 		} else {
 			dbgprintf("glblDoneLoadCnf: program error, non-handled "
 				"param '%s'\n", paramblk.descr[i].name);
 		}
 	}
 
+	if(msgtraceSampleRate > 0) {
+		msgtraceEnable(); /* errors are reported, tracing is optional */
+	}
+
+	if(executorNumWrkrs > 0) {
+		executorEnable(); /* on error, queues use their own workers */
+	}
+
 	if(glblDebugOnShutdown && Debug != DEBUG_FULL) {
 		Debug = DEBUG_ONDEMAND;
 		stddbg = -1;
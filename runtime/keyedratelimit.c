@@ -0,0 +1,362 @@
+/* keyedratelimit.c
+ * Support for keyed rate-limiting. A keyed ratelimiter holds one token
+ * bucket per key (e.g. sending host or program name), so that a single
+ * noisy source can be limited without affecting all others. Keyed
+ * ratelimiters are defined via the ratelimiter() config object and used
+ * via the ratelimit() RainerScript function.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "rsyslog.h"
+#include "errmsg.h"
+#include "rsconf.h"
+#include "parserif.h"
+#include "unicode-helper.h"
+
+/* definitions for objects we access */
+DEFobjStaticHelpers
+DEFobjCurrIf(statsobj)
+
+#define KRL_DFLT_MAX_KEYS 10000
+#define KRL_DFLT_IDLE_TIMEOUT 300 /* seconds */
+#define KRL_SWEEP_INTERVAL 1000 /* ms */
+
+static struct cnfparamdescr modpdescr[] = {
+	{ "name", eCmdHdlrString, CNFPARAM_REQUIRED },
+	{ "rate", eCmdHdlrPositiveInt, CNFPARAM_REQUIRED },
+	{ "burst", eCmdHdlrPositiveInt, 0 },
+	{ "maxkeys", eCmdHdlrPositiveInt, 0 },
+	{ "idletimeout", eCmdHdlrPositiveInt, 0 } /* in seconds */
+};
+
+static struct cnfparamblk modpblk =
+{
+	CNFPARAMBLK_VERSION,
+	sizeof(modpdescr)/sizeof(struct cnfparamdescr),
+	modpdescr
+};
+
+rsRetVal
+keyedratelimitClassInit(void)
+{
+	DEFiRet;
+	CHKiRet(objGetObjInterface(&obj));
+	CHKiRet(objUse(statsobj, CORE_COMPONENT));
+finalize_it:
+	RETiRet;
+}
+
+
+static uint64_t
+getMonotonicMs(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+
+static void
+no_op_free(void __attribute__((unused)) *ignore)  {}
+
+
+/* LRU list handling; the caller must hold the shard lock */
+static void
+lruUnlink(krl_shard_t *const shard, krl_key_t *const k)
+{
+	if(k->prev == NULL)
+		shard->head = k->next;
+	else
+		k->prev->next = k->next;
+	if(k->next == NULL)
+		shard->tail = k->prev;
+	else
+		k->next->prev = k->prev;
+	k->prev = k->next = NULL;
+}
+
+static void
+lruPushHead(krl_shard_t *const shard, krl_key_t *const k)
+{
+	k->prev = NULL;
+	k->next = shard->head;
+	if(shard->head != NULL)
+		shard->head->prev = k;
+	shard->head = k;
+	if(shard->tail == NULL)
+		shard->tail = k;
+}
+
+
+/* remove the least recently used key of a shard; the caller must
+ * hold the shard lock.
+ */
+static void
+evictTail(keyedratelimit_t *const krl, krl_shard_t *const shard)
+{
+	krl_key_t *const k = shard->tail;
+
+	lruUnlink(shard, k);
+	hashtable_remove(shard->table, k->key); /* also frees the key */
+	free(k);
+	--shard->nKeys;
+	STATSCOUNTER_INC(krl->ctrKeysEvicted, krl->mutCtrKeysEvicted);
+}
+
+
+/* evict keys which were not used for idleTimeout; the caller must
+ * hold the shard lock.
+ */
+static void
+evictIdle(keyedratelimit_t *const krl, krl_shard_t *const shard, const uint64_t now)
+{
+	shard->lastSweep = now;
+	while(shard->tail != NULL && now - shard->tail->lastRefill > krl->idleTimeout) {
+		evictTail(krl, shard);
+	}
+}
+
+
+/* check if a message with the given key is within its rate limit. If
+ * so, a token is consumed and 1 is returned, else 0. On internal errors
+ * (out of memory), the message is permitted. This function is thread-safe.
+ */
+int
+keyedratelimitCheck(keyedratelimit_t *const krl, const uchar *const key)
+{
+	krl_shard_t *shard;
+	krl_key_t *k;
+	uchar *keyCopy;
+	unsigned h;
+	unsigned nLost = 0;
+	int ret = 1;
+	const uint64_t now = getMonotonicMs();
+
+	h = hash_from_string((void*) key);
+	shard = &krl->shards[(h ^ (h >> 16)) & (KRL_NUM_SHARDS - 1)];
+
+	pthread_mutex_lock(&shard->mut);
+	if(now - shard->lastSweep > KRL_SWEEP_INTERVAL) {
+		evictIdle(krl, shard, now);
+	}
+	k = (krl_key_t*) hashtable_search(shard->table, (void*) key);
+	if(k == NULL) {
+		if(shard->nKeys >= krl->maxKeysPerShard) {
+			evictTail(krl, shard);
+		}
+		if((k = calloc(1, sizeof(krl_key_t))) == NULL
+		   || (keyCopy = ustrdup(key)) == NULL) {
+			free(k);
+			goto done;
+		}
+		if(!hashtable_insert(shard->table, keyCopy, k)) {
+			free(keyCopy);
+			free(k);
+			goto done;
+		}
+		k->key = keyCopy;
+		k->tokens = krl->burst;
+		k->lastRefill = now;
+		++shard->nKeys;
+		STATSCOUNTER_INC(krl->ctrKeysCreated, krl->mutCtrKeysCreated);
+	} else {
+		k->tokens += (double) (now - k->lastRefill) * krl->rate / 1000.0;
+		if(k->tokens > krl->burst)
+			k->tokens = krl->burst;
+		k->lastRefill = now;
+		lruUnlink(shard, k);
+	}
+	lruPushHead(shard, k);
+
+	if(k->tokens >= 1.0) {
+		k->tokens -= 1.0;
+		if(k->missed > 0) {
+			nLost = k->missed;
+			k->missed = 0;
+		}
+	} else {
+		++k->missed;
+		ret = 0;
+	}
+
+done:
+	pthread_mutex_unlock(&shard->mut);
+
+	if(ret) {
+		STATSCOUNTER_INC(krl->ctrAllowed, krl->mutCtrAllowed);
+		if(nLost > 0) {
+			LogMsg(0, RS_RET_RATE_LIMITED, LOG_INFO, "ratelimiter '%s': %u messages with key '%s' "
+				"lost due to rate-limiting (%u per second, burst %u)", krl->name, nLost,
+				key, krl->rate, krl->burst);
+		}
+	} else {
+		STATSCOUNTER_INC(krl->ctrLimited, krl->mutCtrLimited);
+	}
+	return ret;
+}
+
+
+static void
+destroyKeyedRatelimit(keyedratelimit_t *const krl)
+{
+	int i;
+	krl_shard_t *shard;
+	krl_key_t *k, *del;
+
+	for(i = 0 ; i < KRL_NUM_SHARDS ; ++i) {
+		shard = &krl->shards[i];
+		if(shard->table != NULL) {
+			hashtable_destroy(shard->table, 0); /* frees keys */
+		}
+		for(k = shard->head ; k != NULL ; ) {
+			del = k;
+			k = k->next;
+			free(del);
+		}
+		pthread_mutex_destroy(&shard->mut);
+	}
+	if(krl->stats != NULL)
+		statsobj.Destruct(&krl->stats);
+	free(krl->name);
+	free(krl);
+}
+
+
+static rsRetVal
+initStats(keyedratelimit_t *const krl)
+{
+	DEFiRet;
+
+	CHKiRet(statsobj.Construct(&krl->stats));
+	CHKiRet(statsobj.SetOrigin(krl->stats, UCHAR_CONSTANT("ratelimiter")));
+	CHKiRet(statsobj.SetName(krl->stats, krl->name));
+	STATSCOUNTER_INIT(krl->ctrAllowed, krl->mutCtrAllowed);
+	CHKiRet(statsobj.AddCounter(krl->stats, UCHAR_CONSTANT("allowed"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &krl->ctrAllowed));
+	STATSCOUNTER_INIT(krl->ctrLimited, krl->mutCtrLimited);
+	CHKiRet(statsobj.AddCounter(krl->stats, UCHAR_CONSTANT("limited"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &krl->ctrLimited));
+	STATSCOUNTER_INIT(krl->ctrKeysCreated, krl->mutCtrKeysCreated);
+	CHKiRet(statsobj.AddCounter(krl->stats, UCHAR_CONSTANT("keys_created"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &krl->ctrKeysCreated));
+	STATSCOUNTER_INIT(krl->ctrKeysEvicted, krl->mutCtrKeysEvicted);
+	CHKiRet(statsobj.AddCounter(krl->stats, UCHAR_CONSTANT("keys_evicted"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &krl->ctrKeysEvicted));
+	CHKiRet(statsobj.ConstructFinalize(krl->stats));
+
+finalize_it:
+	RETiRet;
+}
+
+
+rsRetVal
+keyedratelimitProcessCnf(struct cnfobj *o)
+{
+	struct cnfparamvals *pvals;
+	keyedratelimit_t *krl = NULL;
+	unsigned maxKeys = KRL_DFLT_MAX_KEYS;
+	unsigned idleTimeout = KRL_DFLT_IDLE_TIMEOUT;
+	int i;
+	DEFiRet;
+
+	pvals = nvlstGetParams(o->nvlst, &modpblk, NULL);
+	if(pvals == NULL) {
+		ABORT_FINALIZE(RS_RET_MISSING_CNFPARAMS);
+	}
+
+	CHKmalloc(krl = calloc(1, sizeof(keyedratelimit_t)));
+	for(i = 0 ; i < KRL_NUM_SHARDS ; ++i) {
+		pthread_mutex_init(&krl->shards[i].mut, NULL);
+	}
+	for(i = 0 ; i < modpblk.nParams ; ++i) {
+		if(!pvals[i].bUsed)
+			continue;
+		if(!strcmp(modpblk.descr[i].name, "name")) {
+			CHKmalloc(krl->name = (uchar*)es_str2cstr(pvals[i].val.d.estr, NULL));
+		} else if(!strcmp(modpblk.descr[i].name, "rate")) {
+			krl->rate = (unsigned) pvals[i].val.d.n;
+		} else if(!strcmp(modpblk.descr[i].name, "burst")) {
+			krl->burst = (unsigned) pvals[i].val.d.n;
+		} else if(!strcmp(modpblk.descr[i].name, "maxkeys")) {
+			maxKeys = (unsigned) pvals[i].val.d.n;
+		} else if(!strcmp(modpblk.descr[i].name, "idletimeout")) {
+			idleTimeout = (unsigned) pvals[i].val.d.n;
+		} else {
+			dbgprintf("ratelimiter: program error, non-handled "
+				  "param '%s'\n", modpblk.descr[i].name);
+		}
+	}
+
+	if(keyedratelimitFind(krl->name) != NULL) {
+		parser_errmsg("ratelimiter '%s' is already defined - ignoring new definition", krl->name);
+		ABORT_FINALIZE(RS_RET_DUP_PARAM);
+	}
+	if(krl->burst == 0)
+		krl->burst = krl->rate;
+	krl->idleTimeout = (uint64_t) idleTimeout * 1000;
+	/* the key limit is enforced per shard, so we round up */
+	krl->maxKeysPerShard = (maxKeys + KRL_NUM_SHARDS - 1) / KRL_NUM_SHARDS;
+	for(i = 0 ; i < KRL_NUM_SHARDS ; ++i) {
+		CHKmalloc(krl->shards[i].table = create_hashtable(krl->maxKeysPerShard + 1,
+			hash_from_string, key_equals_string, no_op_free));
+	}
+	CHKiRet(initStats(krl));
+
+	DBGPRINTF("ratelimiter '%s': rate %u, burst %u, maxkeys %u, idletimeout %u\n",
+		krl->name, krl->rate, krl->burst, maxKeys, idleTimeout);
+	krl->next = loadConf->keyedratelimits;
+	loadConf->keyedratelimits = krl;
+
+finalize_it:
+	if(iRet != RS_RET_OK && krl != NULL) {
+		destroyKeyedRatelimit(krl);
+	}
+	cnfparamvalsDestruct(pvals, &modpblk);
+	RETiRet;
+}
+
+
+keyedratelimit_t *
+keyedratelimitFind(const uchar *const name)
+{
+	keyedratelimit_t *krl;
+
+	for(krl = loadConf->keyedratelimits ; krl != NULL ; krl = krl->next) {
+		if(!ustrcmp(name, krl->name))
+			break;
+	}
+	return krl;
+}
+
+
+void
+keyedratelimitDestroyAll(rsconf_t *const cnf)
+{
+	keyedratelimit_t *krl;
+
+	while(cnf->keyedratelimits != NULL) {
+		krl = cnf->keyedratelimits;
+		cnf->keyedratelimits = krl->next;
+		destroyKeyedRatelimit(krl);
+	}
+}
@@ -0,0 +1,69 @@
+/* header for keyedratelimit.c
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INCLUDED_KEYEDRATELIMIT_H
+#define INCLUDED_KEYEDRATELIMIT_H
+
+#include "hashtable.h"
+
+#define KRL_NUM_SHARDS 64 /* must be a power of 2 */
+
+/* token bucket for a single key */
+struct krl_key_s {
+	uchar *key;		/* owned by the hashtable */
+	double tokens;		/* tokens currently available */
+	uint64_t lastRefill;	/* ms, monotonic clock */
+	unsigned missed;	/* messages discarded since we began to limit */
+	struct krl_key_s *prev;	/* LRU list, most recently used first */
+	struct krl_key_s *next;
+};
+
+/* the keys are spread over several shards, each with its own lock,
+ * so that concurrent workers do not serialize on a single mutex.
+ */
+struct krl_shard_s {
+	pthread_mutex_t mut;
+	struct hashtable *table;
+	krl_key_t *head;	/* most recently used */
+	krl_key_t *tail;	/* least recently used */
+	unsigned nKeys;
+	uint64_t lastSweep;	/* ms, monotonic clock */
+};
+
+struct keyedratelimit_s {
+	uchar *name;
+	unsigned rate;		/* tokens per second */
+	unsigned burst;		/* bucket size */
+	unsigned maxKeysPerShard;
+	uint64_t idleTimeout;	/* ms */
+	krl_shard_t shards[KRL_NUM_SHARDS];
+	statsobj_t *stats;
+	STATSCOUNTER_DEF(ctrAllowed, mutCtrAllowed);
+	STATSCOUNTER_DEF(ctrLimited, mutCtrLimited);
+	STATSCOUNTER_DEF(ctrKeysCreated, mutCtrKeysCreated);
+	STATSCOUNTER_DEF(ctrKeysEvicted, mutCtrKeysEvicted);
+	keyedratelimit_t *next; /* linked list ptr */
+};
+
+rsRetVal keyedratelimitProcessCnf(struct cnfobj *o);
+keyedratelimit_t *keyedratelimitFind(const uchar *name);
+int keyedratelimitCheck(keyedratelimit_t *krl, const uchar *key);
+void keyedratelimitDestroyAll(rsconf_t *cnf);
+rsRetVal keyedratelimitClassInit(void);
+
+#endif /* #ifndef INCLUDED_KEYEDRATELIMIT_H */
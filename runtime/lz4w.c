@@ -0,0 +1,215 @@
+/* The lz4wrap object.
+ *
+ * This is an rsyslog object wrapper around the lz4 frame API. It implements
+ * lz4 compression for file streams. Stream state and frame handling are
+ * shared with lmzstdw, see comprw.c.
+ *
+ * Copyright 2026 Adiscon GmbH.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <lz4frame.h>
+
+#include "rsyslog.h"
+#include "module-template.h"
+#include "obj.h"
+#include "errmsg.h"
+#include "stream.h"
+#include "comprw.h"
+#include "lz4w.h"
+
+MODULE_TYPE_LIB
+MODULE_TYPE_NOKEEP
+
+/* static data */
+DEFobjStaticHelpers
+
+/* we feed the compressor at most this much data per call, so that the
+ * output buffer size is fixed.
+ */
+#define LZ4W_CHUNK_SIZE (64 * 1024)
+
+/* ------------------------------ methods ------------------------------ */
+
+static void
+lz4wSetPrefs(strm_t *const pThis, LZ4F_preferences_t *const prefs)
+{
+	memset(prefs, 0, sizeof(*prefs));
+	prefs->frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+	prefs->compressionLevel = pThis->iZipLevel;
+}
+
+
+static void
+lz4wFreeCctx(void *const cctx)
+{
+	if(cctx != NULL)
+		LZ4F_freeCompressionContext((LZ4F_cctx*) cctx);
+}
+
+
+/* create the compression context on first write */
+static rsRetVal
+lz4wInit(strm_t *const pThis, comprwCtx_t *const pCtx)
+{
+	LZ4F_preferences_t prefs;
+	LZ4F_cctx *cctx = NULL;
+	LZ4F_errorCode_t r;
+	DEFiRet;
+
+	lz4wSetPrefs(pThis, &prefs);
+	pCtx->lenOutBuf = LZ4F_compressBound(LZ4W_CHUNK_SIZE, &prefs) + LZ4F_HEADER_SIZE_MAX;
+	r = LZ4F_createCompressionContext(&cctx, LZ4F_VERSION);
+	if(LZ4F_isError(r)) {
+		LogError(0, RS_RET_COMPRESSION_ERR, "lz4: could not create compression context: %s",
+			LZ4F_getErrorName(r));
+		ABORT_FINALIZE(RS_RET_COMPRESSION_ERR);
+	}
+	pCtx->cctx = cctx;
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* check a lz4 frame API return value and write the output it produced */
+static rsRetVal
+lz4wWriteOut(strm_t *const pThis, comprwCtx_t *const pCtx, const size_t r, const char *const pszOp,
+	comprwPhysWrite_t strmPhysWrite)
+{
+	DEFiRet;
+
+	if(LZ4F_isError(r)) {
+		LogError(0, RS_RET_COMPRESSION_ERR, "lz4: %s failed: %s", pszOp, LZ4F_getErrorName(r));
+		ABORT_FINALIZE(RS_RET_COMPRESSION_ERR);
+	}
+	CHKiRet(comprwWriteOut(pThis, pCtx, r, strmPhysWrite));
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* write the frame header */
+static rsRetVal
+lz4wBegin(strm_t *const pThis, comprwCtx_t *const pCtx, comprwPhysWrite_t strmPhysWrite)
+{
+	LZ4F_preferences_t prefs;
+
+	lz4wSetPrefs(pThis, &prefs);
+	return lz4wWriteOut(pThis, pCtx, LZ4F_compressBegin((LZ4F_cctx*) pCtx->cctx, pCtx->outBuf,
+		pCtx->lenOutBuf, &prefs), "compressBegin", strmPhysWrite);
+}
+
+
+static rsRetVal
+lz4wCompress(strm_t *const pThis, comprwCtx_t *const pCtx, uchar *pBuf, size_t lenBuf,
+	const int bFlush, comprwPhysWrite_t strmPhysWrite)
+{
+	LZ4F_cctx *const cctx = (LZ4F_cctx*) pCtx->cctx;
+	size_t lenChunk;
+	DEFiRet;
+
+	while(lenBuf > 0) {
+		lenChunk = (lenBuf > LZ4W_CHUNK_SIZE) ? LZ4W_CHUNK_SIZE : lenBuf;
+		CHKiRet(lz4wWriteOut(pThis, pCtx, LZ4F_compressUpdate(cctx, pCtx->outBuf, pCtx->lenOutBuf,
+			pBuf, lenChunk, NULL), "compressUpdate", strmPhysWrite));
+		pBuf += lenChunk;
+		lenBuf -= lenChunk;
+	}
+	if(bFlush) {
+		CHKiRet(lz4wWriteOut(pThis, pCtx, LZ4F_flush(cctx, pCtx->outBuf, pCtx->lenOutBuf, NULL),
+			"flush", strmPhysWrite));
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
+static rsRetVal
+lz4wEnd(strm_t *const pThis, comprwCtx_t *const pCtx, comprwPhysWrite_t strmPhysWrite)
+{
+	return lz4wWriteOut(pThis, pCtx, LZ4F_compressEnd((LZ4F_cctx*) pCtx->cctx, pCtx->outBuf,
+		pCtx->lenOutBuf, NULL), "compressEnd", strmPhysWrite);
+}
+
+
+static const comprwDrvr_t lz4wDrvr = {
+	lz4wInit, lz4wBegin, lz4wCompress, lz4wEnd, lz4wFreeCctx
+};
+
+
+static rsRetVal
+DoStrmWrite(strm_t *pThis, uchar *pBuf, size_t lenBuf, const int bFlush,
+	rsRetVal (*strmPhysWrite)(strm_t *pThis, uchar *pBuf, size_t lenBuf))
+{
+	return comprwWrite(pThis, &lz4wDrvr, pBuf, lenBuf, bFlush, strmPhysWrite);
+}
+
+
+/* queryInterface function
+ */
+BEGINobjQueryInterface(lz4w)
+CODESTARTobjQueryInterface(lz4w)
+	if(pIf->ifVersion != lz4wCURR_IF_VERSION) { /* check for current version, increment on each change */
+		ABORT_FINALIZE(RS_RET_INTERFACE_NOT_SUPPORTED);
+	}
+
+	pIf->DoStrmWrite = DoStrmWrite;
+	pIf->DoCompressFinish = comprwFinish;
+	pIf->Destruct = comprwDestruct;
+finalize_it:
+ENDobjQueryInterface(lz4w)
+
+
+/* Initialize the lz4w class. Must be called as the very first method
+ * before anything else is called inside this class.
+ */
+BEGINAbstractObjClassInit(lz4w, 1, OBJ_IS_LOADABLE_MODULE) /* class, version */
+	/* request objects we use */
+
+	/* set our own handlers */
+ENDObjClassInit(lz4w)
+
+
+/* --------------- here now comes the plumbing that makes as a library module --------------- */
+
+
+BEGINmodExit
+CODESTARTmodExit
+ENDmodExit
+
+
+BEGINqueryEtryPt
+CODESTARTqueryEtryPt
+CODEqueryEtryPt_STD_LIB_QUERIES
+ENDqueryEtryPt
+
+
+BEGINmodInit()
+CODESTARTmodInit
+	*ipIFVersProvided = CURR_MOD_IF_VERSION; /* we only support the current interface specification */
+
+	CHKiRet(lz4wClassInit(pModInfo));
+ENDmodInit
+/* vi:set ai:
+ */
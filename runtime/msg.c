@@ -58,6 +58,7 @@
 #include "glbl.h"
 #include "regexp.h"
 #include "atomic.h"
+#include "dnscache.h"
 #include "unicode-helper.h"
 #include "ruleset.h"
 #include "prop.h"
@@ -66,6 +67,7 @@
 #include "rsconf.h"
 #include "parserif.h"
 #include "errmsg.h"
+#include "msgtrace.h"
 
 #define DEV_DEBUG 0	/* set to 1 to enable very verbose developer debugging messages */
 
@@ -511,6 +513,7 @@ resolveDNS(smsg_t * const pMsg) {
 	MsgLock(pMsg);
 	CHKiRet(objUse(net, CORE_COMPONENT));
 	if(pMsg->msgFlags & NEEDS_DNSRESOL) {
+		dnscacheNameNeeded();
 		if (pMsg->msgFlags & PRESERVE_CASE) {
 			localRet = net.cvthname(pMsg->rcvFrom.pfrominet, NULL, &localName, &ip);
 		} else {
@@ -884,6 +887,7 @@ msgBaseConstruct(smsg_t **ppThis)
 	pM->pszTIMESTAMP_Unix[0] = '\0';
 	pM->pszRcvdAt_Unix[0] = '\0';
 	pM->pszUUID = NULL;
+	pM->pTrace = NULL;
 	pthread_mutex_init(&pM->mut, NULL);
 
 	#if DEV_DEBUG == 1
@@ -1033,6 +1037,7 @@ CODESTARTobjDestruct(msg)
 			json_object_put(pThis->localvars);
 		if(pThis->pszUUID != NULL)
 			free(pThis->pszUUID);
+		free(pThis->pTrace);
 #	ifndef HAVE_ATOMIC_BUILTINS
 		MsgUnlock(pThis);
 # 	endif
@@ -1186,6 +1191,8 @@ smsg_t* MsgDup(smsg_t* pOld)
 		pNew->json = jsonDeepCopy(pOld->json);
 	if(pOld->localvars != NULL)
 		pNew->localvars = jsonDeepCopy(pOld->localvars);
+	if(pOld->pTrace != NULL && (pNew->pTrace = malloc(sizeof(msgtrace_t))) != NULL)
+		memcpy(pNew->pTrace, pOld->pTrace, sizeof(msgtrace_t));
 
 	/* we do not copy all other cache properties, as we do not even know
 	 * if they are needed once again. So we let them re-create if needed.
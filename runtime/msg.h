@@ -133,6 +133,7 @@ struct msg {
 	char pszRcvdAt_Unix[12];
 	char dfltTZ[8];	    /* 7 chars max, less overhead than ptr! */
 	uchar *pszUUID; /* The message's UUID */
+	msgtrace_t *pTrace; /* pipeline trace, only set for sampled messages */
 };
 
 
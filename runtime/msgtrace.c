@@ -0,0 +1,268 @@
+/* msgtrace.c
+ * A sampling tracer for the message pipeline. If enabled via the
+ * msgtrace.samplerate global parameter, one in n messages is timestamped
+ * when it is parsed, enters ruleset processing, is submitted to an action
+ * and is committed by that action. Completed traces are kept in small
+ * per-thread ring buffers (readable via imdiag) and summarized in the
+ * "msgtrace" stats object.
+ *
+ * If tracing is disabled, the only cost is one check of the sample rate
+ * in ParseMsg() and one NULL check of the message's trace pointer at each
+ * other stage.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "rsyslog.h"
+#include "msg.h"
+#include "statsobj.h"
+#include "atomic.h"
+#include "errmsg.h"
+#include "unicode-helper.h"
+#include "msgtrace.h"
+
+/* definitions for objects we access */
+DEFobjStaticHelpers
+DEFobjCurrIf(statsobj)
+
+int msgtraceSampleRate = 0;
+
+/* completed traces of a single thread. Each thread only writes to its
+ * own ring, the mutex is needed only for readers (imdiag) and thus
+ * never contended in practice.
+ */
+typedef struct msgtraceRing_s {
+	pthread_mutex_t mut;
+	unsigned nRecs;		/* total number of records ever written */
+	sbool bInUse;		/* owned by a live thread? */
+	msgtraceRec_t recs[MSGTRACE_RING_SIZE];
+	struct msgtraceRing_s *next;
+} msgtraceRing_t;
+
+/* rings are never freed, but rings of terminated threads are reused */
+static msgtraceRing_t *rings = NULL;
+static pthread_mutex_t mutRings = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t keyRing;
+
+static unsigned nSeen = 0;	/* messages seen by the sampler */
+DEF_ATOMIC_HELPER_MUT(mutMsgtraceSeen)
+
+static statsobj_t *stats = NULL;
+static intctr_t ctrSampled;
+DEF_ATOMIC_HELPER_MUT64(mutMsgtraceSampled)
+static STATSHIST_DEF(histParseRuleset)
+static STATSHIST_DEF(histRulesetSubmit)
+static STATSHIST_DEF(histSubmitCommit)
+static STATSHIST_DEF(histTotal)
+
+
+/* called on thread termination; makes the ring available to new threads */
+static void
+ringRelease(void *const ring)
+{
+	pthread_mutex_lock(&mutRings);
+	((msgtraceRing_t*) ring)->bInUse = 0;
+	pthread_mutex_unlock(&mutRings);
+}
+
+
+static msgtraceRing_t *
+getMyRing(void)
+{
+	msgtraceRing_t *ring;
+
+	if((ring = pthread_getspecific(keyRing)) != NULL)
+		return ring;
+
+	pthread_mutex_lock(&mutRings);
+	for(ring = rings ; ring != NULL && ring->bInUse ; ring = ring->next)
+		/* just search */;
+	if(ring == NULL && (ring = calloc(1, sizeof(msgtraceRing_t))) != NULL) {
+		pthread_mutex_init(&ring->mut, NULL);
+		ring->next = rings;
+		rings = ring;
+	}
+	if(ring != NULL)
+		ring->bInUse = 1;
+	pthread_mutex_unlock(&mutRings);
+
+	if(ring != NULL)
+		pthread_setspecific(keyRing, ring);
+	return ring;
+}
+
+
+/* decide if the message is to be traced and, if so, start the trace.
+ * Tracing is best effort, so errors are silently ignored.
+ */
+void
+msgtraceSample(smsg_t *const pMsg)
+{
+	const unsigned n = ATOMIC_INC_AND_FETCH_unsigned(&nSeen, &mutMsgtraceSeen);
+
+	if(n % msgtraceSampleRate != 0 || pMsg->pTrace != NULL)
+		return;
+	if((pMsg->pTrace = calloc(1, sizeof(msgtrace_t))) == NULL)
+		return;
+	pMsg->pTrace->id = n;
+	pMsg->pTrace->ts[MSGTRACE_PARSE] = msgtraceNow();
+	STATSCOUNTER_INC(ctrSampled, mutMsgtraceSampled);
+}
+
+
+static inline void
+recordStage(statshist_t *const hist, const uint64_t from, const uint64_t to)
+{
+	if(from != 0 && to >= from) {
+		STATSHIST_RECORD(*hist, (to - from) / 1000);
+	}
+}
+
+
+/* a traced message has been committed by an action. Complete the
+ * trace and store it in the calling thread's ring.
+ */
+void
+msgtraceCommit(smsg_t *const pMsg, const uchar *const action)
+{
+	const msgtrace_t *const t = pMsg->pTrace;
+	const uint64_t now = msgtraceNow();
+	msgtraceRing_t *ring;
+	msgtraceRec_t *rec;
+
+	recordStage(&histParseRuleset, t->ts[MSGTRACE_PARSE], t->ts[MSGTRACE_RULESET]);
+	recordStage(&histRulesetSubmit, t->ts[MSGTRACE_RULESET], t->ts[MSGTRACE_SUBMIT]);
+	recordStage(&histSubmitCommit, t->ts[MSGTRACE_SUBMIT], now);
+	recordStage(&histTotal, t->ts[MSGTRACE_PARSE], now);
+
+	if((ring = getMyRing()) == NULL)
+		return;
+	pthread_mutex_lock(&ring->mut);
+	rec = &ring->recs[ring->nRecs++ & (MSGTRACE_RING_SIZE - 1)];
+	rec->id = t->id;
+	rec->action = action;
+	memcpy(rec->ts, t->ts, sizeof(t->ts));
+	rec->ts[MSGTRACE_COMMIT] = now;
+	pthread_mutex_unlock(&ring->mut);
+}
+
+
+static int
+cmpRecsByCommit(const void *const r1, const void *const r2)
+{
+	const uint64_t t1 = ((const msgtraceRec_t*) r1)->ts[MSGTRACE_COMMIT];
+	const uint64_t t2 = ((const msgtraceRec_t*) r2)->ts[MSGTRACE_COMMIT];
+	return (t1 < t2) ? 1 : ((t1 > t2) ? -1 : 0); /* most recent first */
+}
+
+
+/* copy the (at most) nMax most recently completed traces of all threads
+ * to recs, most recent first. Returns the number of records copied.
+ */
+int
+msgtraceGetRecent(msgtraceRec_t *const recs, const int nMax)
+{
+	msgtraceRing_t *ring;
+	msgtraceRec_t *all = NULL;
+	size_t nAll = 0;
+	size_t nRings = 0;
+	unsigned i, nRecs;
+	int n = 0;
+
+	pthread_mutex_lock(&mutRings);
+	for(ring = rings ; ring != NULL ; ring = ring->next)
+		++nRings;
+	if(nRings == 0 || (all = malloc(nRings * MSGTRACE_RING_SIZE * sizeof(msgtraceRec_t))) == NULL)
+		goto done;
+	for(ring = rings ; ring != NULL ; ring = ring->next) {
+		pthread_mutex_lock(&ring->mut);
+		nRecs = (ring->nRecs < MSGTRACE_RING_SIZE) ? ring->nRecs : MSGTRACE_RING_SIZE;
+		for(i = 0 ; i < nRecs ; ++i)
+			all[nAll++] = ring->recs[i];
+		pthread_mutex_unlock(&ring->mut);
+	}
+	qsort(all, nAll, sizeof(msgtraceRec_t), cmpRecsByCommit);
+	n = (nAll < (size_t) nMax) ? (int) nAll : nMax;
+	memcpy(recs, all, n * sizeof(msgtraceRec_t));
+
+done:
+	pthread_mutex_unlock(&mutRings);
+	free(all);
+	return n;
+}
+
+
+/* called once the configuration is loaded and tracing is enabled */
+rsRetVal
+msgtraceEnable(void)
+{
+	DEFiRet;
+
+	if(stats != NULL)
+		FINALIZE; /* already enabled */
+
+	ctrSampled = 0;
+	INIT_ATOMIC_HELPER_MUT64(mutMsgtraceSampled);
+	STATSHIST_INIT(histParseRuleset);
+	STATSHIST_INIT(histRulesetSubmit);
+	STATSHIST_INIT(histSubmitCommit);
+	STATSHIST_INIT(histTotal);
+
+	CHKiRet(statsobj.Construct(&stats));
+	CHKiRet(statsobj.SetName(stats, UCHAR_CONSTANT("msgtrace")));
+	CHKiRet(statsobj.SetOrigin(stats, UCHAR_CONSTANT("core.msgtrace")));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("sampled"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrSampled));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("parse-ruleset.us"),
+		ctrType_Histogram, CTR_FLAG_RESETTABLE, &histParseRuleset));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("ruleset-submit.us"),
+		ctrType_Histogram, CTR_FLAG_RESETTABLE, &histRulesetSubmit));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("submit-commit.us"),
+		ctrType_Histogram, CTR_FLAG_RESETTABLE, &histSubmitCommit));
+	CHKiRet(statsobj.AddCounter(stats, UCHAR_CONSTANT("total.us"),
+		ctrType_Histogram, CTR_FLAG_RESETTABLE, &histTotal));
+	CHKiRet(statsobj.ConstructFinalize(stats));
+	DBGPRINTF("msgtrace: tracing 1 in %d messages\n", msgtraceSampleRate);
+
+finalize_it:
+	if(iRet != RS_RET_OK) {
+		LogError(0, iRet, "msgtrace: error enabling message tracing, tracing disabled");
+		msgtraceSampleRate = 0;
+	}
+	RETiRet;
+}
+
+
+rsRetVal
+msgtraceClassInit(void)
+{
+	int r;
+	DEFiRet;
+	CHKiRet(objGetObjInterface(&obj));
+	CHKiRet(objUse(statsobj, CORE_COMPONENT));
+	INIT_ATOMIC_HELPER_MUT(mutMsgtraceSeen);
+	if((r = pthread_key_create(&keyRing, ringRelease)) != 0) {
+		LogError(r, RS_RET_ERR, "msgtrace: pthread_key_create failed");
+		ABORT_FINALIZE(RS_RET_ERR);
+	}
+finalize_it:
+	RETiRet;
+}
@@ -0,0 +1,76 @@
+/* Definitions for the sampling message pipeline tracer.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef INCLUDED_MSGTRACE_H
+#define INCLUDED_MSGTRACE_H
+
+#include <time.h>
+
+#define MSGTRACE_RING_SIZE 256 /* records kept per thread, must be a power of 2 */
+#define MSGTRACE_MAX_PER_BATCH 64 /* max commits recorded per batch and action, excess is not traced */
+
+/* the pipeline stages we record. All but the last one are stored inside
+ * the message, the commit stage is recorded once per action.
+ */
+typedef enum msgtraceStage_e {
+	MSGTRACE_PARSE = 0,	/* ParseMsg() called */
+	MSGTRACE_RULESET,	/* ruleset processing begins */
+	MSGTRACE_SUBMIT,	/* (first) submission to an action */
+	MSGTRACE_COMMIT,	/* action has committed the message */
+	MSGTRACE_NUM_STAGES
+} msgtraceStage_t;
+
+/* per-message trace data, only allocated for sampled messages */
+struct msgtrace_s {
+	uint64_t id;
+	uint64_t ts[MSGTRACE_COMMIT];	/* ns, monotonic clock, 0 = not yet reached */
+};
+
+/* a completed trace, as kept in the per-thread ring buffers */
+typedef struct msgtraceRec_s {
+	uint64_t id;
+	const uchar *action;	/* name of the committing action */
+	uint64_t ts[MSGTRACE_NUM_STAGES];
+} msgtraceRec_t;
+
+extern int msgtraceSampleRate;	/* trace 1 in n messages, 0 = disabled */
+
+static inline uint64_t
+msgtraceNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* record the time a traced message reaches a stage. Only the first time
+ * is kept, as a message may e.g. be submitted to multiple actions.
+ */
+#define MSGTRACE_STAMP(pMsg, stage) \
+	do { \
+		if((pMsg)->pTrace != NULL && (pMsg)->pTrace->ts[stage] == 0) \
+			(pMsg)->pTrace->ts[stage] = msgtraceNow(); \
+	} while(0)
+
+rsRetVal msgtraceClassInit(void);
+rsRetVal msgtraceEnable(void);
+void msgtraceSample(smsg_t *pMsg);
+void msgtraceCommit(smsg_t *pMsg, const uchar *action);
+int msgtraceGetRecent(msgtraceRec_t *recs, int nMax);
+
+#endif /* #ifndef INCLUDED_MSGTRACE_H */
@@ -120,4 +120,18 @@ BEGINinterface(nsdpoll) /* name must also be changed in ENDinterface macro! */
 ENDinterface(nsdpoll)
 #define nsdpollCURR_IF_VERSION 1 /* increment whenever you change the interface structure! */
 
+/* registration of a session's socket in an epoll set. TLS drivers keep it,
+ * because while a handshake is in progress they must wait for the socket to
+ * become writable instead of readable whenever the TLS library wants to send.
+ * The registration is filled in by the driver's nsdpoll Ctl() method.
+ */
+struct nsdpoll_reg_s {
+	nsdpoll_t *pPoll;	/* poll set the socket is registered with, NULL if none */
+	nsd_t *pSock;		/* the registered plain tcp driver object */
+	int id;
+	void *pUsr;
+	int mode;		/* NSDPOLL_IN or NSDPOLL_OUT */
+	rsRetVal (*SetMode)(nsdpoll_reg_t *pReg, int mode);
+};
+
 #endif /* #ifndef INCLUDED_NSD_H */
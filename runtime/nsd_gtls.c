@@ -37,6 +37,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <netdb.h>
 
 #include "rsyslog.h"
 #include "syslogd-types.h"
@@ -47,8 +48,11 @@
 #include "errmsg.h"
 #include "net.h"
 #include "datetime.h"
+#include "statsobj.h"
+#include "nspoll.h"
 #include "nsd_ptcp.h"
 #include "nsdsel_gtls.h"
+#include "nsdpoll_gtls.h"
 #include "nsd_gtls.h"
 #include "unicode-helper.h"
 
@@ -67,6 +71,7 @@ DEFobjStaticHelpers
 DEFobjCurrIf(glbl)
 DEFobjCurrIf(net)
 DEFobjCurrIf(datetime)
+DEFobjCurrIf(statsobj)
 DEFobjCurrIf(nsd_ptcp)
 
 /* Static Helper variables for certless communication */
@@ -81,6 +86,29 @@ static pthread_mutex_t mutGtlsStrerror;
 
 static gnutls_dh_params_t dh_params; /**< server DH parameters for anon mode */
 
+/* TLS session resumption. On the server side, we hand out session tickets
+ * encrypted with a key that is generated once per run. On the client side,
+ * we keep the session data of the last closed connection per "host:port"
+ * so that a reconnect (e.g. by omfwd) can resume instead of doing a full
+ * handshake.
+ */
+static gnutls_datum_t sessTicketKey = { NULL, 0 };
+#define GTLS_SESSCACHE_MAX 64	/* max number of remote peers we cache sessions for */
+typedef struct gtlsSessCacheEtry_s gtlsSessCacheEtry_t;
+struct gtlsSessCacheEtry_s {
+	gtlsSessCacheEtry_t *next;
+	char *pszPeer;		/* "host:port" */
+	gnutls_datum_t data;	/* serialized session, allocated by GnuTLS */
+};
+static gtlsSessCacheEtry_t *sessCacheRoot = NULL;
+static int sessCacheNum = 0;
+static pthread_mutex_t mutSessCache;
+
+/* handshake statistics */
+static statsobj_t *tlsStats;
+STATSCOUNTER_DEF(ctrHandshakeFull, mutCtrHandshakeFull);
+STATSCOUNTER_DEF(ctrHandshakeResumed, mutCtrHandshakeResumed);
+
 /* a macro to abort if GnuTLS error is not acceptable. We split this off from
  * CHKgnutls() to avoid some Coverity report in cases where we know GnuTLS
  * failed. Note: gnuRet must already be set accordingly!
@@ -603,6 +631,171 @@ finalize_it:
 }
 
 
+/* account a completed handshake as either resumed or full */
+static void
+gtlsCountHandshake(nsd_gtls_t *const pThis)
+{
+	if(gnutls_session_is_resumed(pThis->sess)) {
+		dbgprintf("GnuTLS session %p was resumed\n", pThis);
+		STATSCOUNTER_INC(ctrHandshakeResumed, mutCtrHandshakeResumed);
+	} else {
+		STATSCOUNTER_INC(ctrHandshakeFull, mutCtrHandshakeFull);
+	}
+}
+
+
+static void
+gtlsSessCacheEtryDestruct(gtlsSessCacheEtry_t *const pEtry)
+{
+	free(pEtry->pszPeer);
+	gnutls_free(pEtry->data.data);
+	free(pEtry);
+}
+
+
+/* offer the cached session for the given peer (if any) for resumption.
+ * Failure to do so is not an error, we just do a full handshake in that case.
+ */
+static void
+gtlsSessCacheApply(nsd_gtls_t *const pThis, const char *const pszPeer)
+{
+	gtlsSessCacheEtry_t *pEtry;
+	int gnuRet;
+
+	pthread_mutex_lock(&mutSessCache);
+	for(pEtry = sessCacheRoot ; pEtry != NULL ; pEtry = pEtry->next) {
+		if(!strcmp(pEtry->pszPeer, pszPeer)) {
+			gnuRet = gnutls_session_set_data(pThis->sess, pEtry->data.data, pEtry->data.size);
+			dbgprintf("gtlsSessCacheApply: offering cached session for %s, ret %d\n",
+				pszPeer, gnuRet);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mutSessCache);
+}
+
+
+/* a client that never reads (like omfwd) does not process the session
+ * tickets a TLS 1.3 server sends after the handshake. So before we close,
+ * we read whatever the server has sent without blocking. Application data
+ * is not expected here and is discarded.
+ */
+static void
+gtlsReadPending(nsd_gtls_t *const pThis)
+{
+	char buf[1024];
+	int sock;
+	int flags;
+	int i;
+	ssize_t gnuRet;
+
+	if(nsd_ptcp.GetSock(pThis->pTcp, &sock) != RS_RET_OK
+	   || (flags = fcntl(sock, F_GETFL)) == -1
+	   || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
+		return;
+	for(i = 0 ; i < 16 ; ++i) {
+		gnuRet = gnutls_record_recv(pThis->sess, buf, sizeof(buf));
+		if(gnuRet <= 0 && gnuRet != GNUTLS_E_INTERRUPTED)
+			break;
+	}
+	fcntl(sock, F_SETFL, flags);
+}
+
+
+/* remember the session of a client connection that is about to be closed.
+ * We do this at close and not right after the handshake, because TLS 1.3
+ * session tickets arrive only later. The most recently used peer is kept at
+ * the head of the list, so if the cache is full, we drop its tail.
+ */
+static void
+gtlsSessCacheStore(nsd_gtls_t *const pThis)
+{
+	const char *const pszPeer = pThis->pszSessPeer;
+	gtlsSessCacheEtry_t *pEtry;
+	gtlsSessCacheEtry_t **ppEtry;
+	gnutls_datum_t data;
+
+#if GNUTLS_VERSION_NUMBER >= 0x030603
+	if(gnutls_protocol_get_version(pThis->sess) == GNUTLS_TLS1_3) {
+		gtlsReadPending(pThis);
+		if(!(gnutls_session_get_flags(pThis->sess) & GNUTLS_SFLAGS_SESSION_TICKET)) {
+			dbgprintf("gtlsSessCacheStore: no session ticket received from %s\n", pszPeer);
+			return;
+		}
+	}
+#endif
+	if(gnutls_session_get_data2(pThis->sess, &data) != 0)
+		return;
+
+	pthread_mutex_lock(&mutSessCache);
+	for(ppEtry = &sessCacheRoot ; *ppEtry != NULL ; ppEtry = &(*ppEtry)->next) {
+		if(!strcmp((*ppEtry)->pszPeer, pszPeer))
+			break;
+	}
+	if(*ppEtry != NULL) {
+		pEtry = *ppEtry;
+		*ppEtry = pEtry->next;
+		gnutls_free(pEtry->data.data);
+	} else {
+		if((pEtry = calloc(1, sizeof(gtlsSessCacheEtry_t))) == NULL
+		   || (pEtry->pszPeer = strdup(pszPeer)) == NULL) {
+			free(pEtry);
+			gnutls_free(data.data);
+			goto done;
+		}
+		if(++sessCacheNum > GTLS_SESSCACHE_MAX) {
+			for(ppEtry = &sessCacheRoot ; (*ppEtry)->next != NULL ; ppEtry = &(*ppEtry)->next)
+				/* just search the tail */;
+			gtlsSessCacheEtryDestruct(*ppEtry);
+			*ppEtry = NULL;
+			--sessCacheNum;
+		}
+	}
+	pEtry->data = data;
+	pEtry->next = sessCacheRoot;
+	sessCacheRoot = pEtry;
+done:
+	pthread_mutex_unlock(&mutSessCache);
+}
+
+
+/* continue a TLS handshake that could not yet be completed. This is
+ * called whenever the socket is ready for the handshake to proceed.
+ * Once the handshake is done, the peer is authenticated. Until then,
+ * rtryCall remains set to gtlsRtry_handshake.
+ */
+rsRetVal
+gtlsContinueHandshake(nsd_gtls_t *const pThis)
+{
+	int gnuRet;
+	DEFiRet;
+
+	ISOBJ_TYPE_assert(pThis, nsd_gtls);
+	gnuRet = gnutls_handshake(pThis->sess);
+	if(gnuRet == GNUTLS_E_AGAIN || gnuRet == GNUTLS_E_INTERRUPTED) {
+		dbgprintf("GnuTLS handshake does not complete immediately - "
+			"setting to retry (this is OK and normal)\n");
+		FINALIZE;
+	}
+
+	pThis->rtryCall = gtlsRtry_None; /* we are done, one way or the other */
+	if(gnuRet == 0) {
+		gtlsCountHandshake(pThis);
+		/* we got a handshake, now check authorization */
+		CHKiRet(gtlsChkPeerAuth(pThis));
+	} else {
+		uchar *pGnuErr = gtlsStrerror(gnuRet);
+		LogError(0, RS_RET_TLS_HANDSHAKE_ERR,
+			"gnutls returned error on handshake: %s\n", pGnuErr);
+		free(pGnuErr);
+		ABORT_FINALIZE(RS_RET_TLS_HANDSHAKE_ERR);
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
 /* add our own certificate to the certificate set, so that the peer
  * can identify us. Please note that we try to use mutual authentication,
  * so we always add a cert, even if we are in the client role (later,
@@ -754,6 +947,9 @@ gtlsGlblInit(void)
 	CHKgnutls(gnutls_anon_allocate_server_credentials(&anoncredSrv));
 	gnutls_anon_set_server_dh_params(anoncredSrv, dh_params);
 
+	/* key for the session tickets we issue as server */
+	CHKgnutls(gnutls_session_ticket_key_generate(&sessTicketKey));
+
 finalize_it:
 	RETiRet;
 }
@@ -797,6 +993,10 @@ gtlsInitSession(nsd_gtls_t *pThis)
 	/* request client certificate if any.  */
 	gnutls_certificate_server_set_request( pThis->sess, GNUTLS_CERT_REQUEST);
 
+	/* permit clients to resume their sessions via tickets */
+	CHKgnutls(gnutls_session_ticket_enable_server(pThis->sess, &sessTicketKey));
+	gnutls_db_set_cache_expiration(pThis->sess, GetTlsSessionTimeout());
+
 
 finalize_it:
 	if(iRet != RS_RET_OK && iRet != RS_RET_CERTLESS) {
@@ -1299,7 +1499,19 @@ finalize_it:
 static rsRetVal
 gtlsGlblExit(void)
 {
+	gtlsSessCacheEtry_t *pEtry;
 	DEFiRet;
+	while(sessCacheRoot != NULL) {
+		pEtry = sessCacheRoot;
+		sessCacheRoot = pEtry->next;
+		gtlsSessCacheEtryDestruct(pEtry);
+	}
+	sessCacheNum = 0;
+	if(sessTicketKey.data != NULL) {
+		gnutls_memset(sessTicketKey.data, 0, sessTicketKey.size);
+		gnutls_free(sessTicketKey.data);
+		sessTicketKey.data = NULL;
+	}
 	/* X509 stuff */
 	gnutls_certificate_free_credentials(xcred);
 	gnutls_global_deinit(); /* we are done... */
@@ -1319,6 +1531,8 @@ gtlsEndSess(nsd_gtls_t *pThis)
 
 	if(pThis->bHaveSess) {
 		if(pThis->bIsInitiator) {
+			if(pThis->pszSessPeer != NULL)
+				gtlsSessCacheStore(pThis);
 			gnuRet = gnutls_bye(pThis->sess, GNUTLS_SHUT_RDWR);
 			while(gnuRet == GNUTLS_E_INTERRUPTED || gnuRet == GNUTLS_E_AGAIN) {
 				gnuRet = gnutls_bye(pThis->sess, GNUTLS_SHUT_RDWR);
@@ -1372,6 +1586,8 @@ CODESTARTobjDestruct(nsd_gtls)
 		free(pThis->pszConnectHost);
 	}
 
+	free(pThis->pszSessPeer);
+
 	if(pThis->pszRcvBuf == NULL) {
 		free(pThis->pszRcvBuf);
 	}
@@ -1809,25 +2025,13 @@ AcceptConnReq(nsd_t *pNsd, nsd_t **ppNew)
 		}
 	}
 
-	/* we now do the handshake. This is a bit complicated, because we are
-	 * on non-blocking sockets. Usually, the handshake will not complete
-	 * immediately, so that we need to retry it some time later.
+	/* we do NOT do the handshake here. It is CPU-intense and doing it inline
+	 * would hold up the listener (and thus all other sessions) during a
+	 * reconnect storm. Instead, it is carried out by Rcv() as soon as the
+	 * peer's data arrives. As Rcv() is called from the tcpsrv worker pool,
+	 * handshakes of many sessions are now done concurrently.
 	 */
-	gnuRet = gnutls_handshake(pNew->sess);
-	if(gnuRet == GNUTLS_E_AGAIN || gnuRet == GNUTLS_E_INTERRUPTED) {
-		pNew->rtryCall = gtlsRtry_handshake;
-		dbgprintf("GnuTLS handshake does not complete immediately - "
-			"setting to retry (this is OK and normal)\n");
-	} else if(gnuRet == 0) {
-		/* we got a handshake, now check authorization */
-		CHKiRet(gtlsChkPeerAuth(pNew));
-	} else {
-		uchar *pGnuErr = gtlsStrerror(gnuRet);
-		LogError(0, RS_RET_TLS_HANDSHAKE_ERR,
-			"gnutls returned error on handshake: %s\n", pGnuErr);
-		free(pGnuErr);
-		ABORT_FINALIZE(RS_RET_TLS_HANDSHAKE_ERR);
-	}
+	pNew->rtryCall = gtlsRtry_handshake;
 
 	pNew->iMode = 1; /* this session is now in TLS mode! */
 
@@ -1886,6 +2090,21 @@ Rcv(nsd_t *pNsd, uchar *pBuf, ssize_t *pLenBuf, int *const oserr)
 
 	/* --- in TLS mode now --- */
 
+	if(pThis->rtryCall == gtlsRtry_handshake) {
+		/* the handshake is still in progress - continue it. If it is
+		 * done, the peer may already have sent data, so we try to read.
+		 */
+		CHKiRet(gtlsContinueHandshake(pThis));
+		/* in epoll mode, wait for the direction the handshake needs next */
+		if(pThis->pollReg.SetMode != NULL) {
+			CHKiRet(pThis->pollReg.SetMode(&pThis->pollReg,
+				(pThis->rtryCall == gtlsRtry_handshake && gnutls_record_get_direction(pThis->sess))
+				? NSDPOLL_OUT : NSDPOLL_IN));
+		}
+		if(pThis->rtryCall == gtlsRtry_handshake)
+			ABORT_FINALIZE(RS_RET_RETRY);
+	}
+
 	/* Buffer logic applies only if we are in TLS mode. Here we
 	 * assume that we will switch from plain to TLS, but never back. This
 	 * assumption may be unsafe, but it is the model for the time being and I
@@ -2034,6 +2253,7 @@ Connect(nsd_t *pNsd, int family, uchar *port, uchar *host, char *device)
 	int sock;
 	int gnuRet;
 	const char *error_position;
+	char szPeer[NI_MAXHOST + 64];
 #	ifdef HAVE_GNUTLS_CERTIFICATE_TYPE_SET_PRIORITY
 	static const int cert_type_priority[2] = { GNUTLS_CRT_X509, 0 };
 #	endif
@@ -2138,15 +2358,23 @@ Connect(nsd_t *pNsd, int family, uchar *port, uchar *host, char *device)
 	 */
 	CHKmalloc(pThis->pszConnectHost = (uchar*)strdup((char*)host));
 
+	/* try to resume the last session we had with this peer */
+	snprintf(szPeer, sizeof(szPeer), "%s:%s", host, port);
+	gtlsSessCacheApply(pThis, szPeer);
+
 	/* and perform the handshake */
 	CHKgnutls(gnutls_handshake(pThis->sess));
 	dbgprintf("GnuTLS handshake succeeded\n");
+	gtlsCountHandshake(pThis);
 
 	/* now check if the remote peer is permitted to talk to us - ideally, we
 	 * should do this during the handshake, but GnuTLS does not yet provide
 	 * the necessary callbacks -- rgerhards, 2008-05-26
 	 */
 	CHKiRet(gtlsChkPeerAuth(pThis));
+	/* the session is cached on close, see gtlsSessCacheStore() */
+	free(pThis->pszSessPeer);
+	pThis->pszSessPeer = strdup(szPeer);
 
 finalize_it:
 	if(iRet != RS_RET_OK) {
@@ -2206,8 +2434,11 @@ ENDobjQueryInterface(nsd_gtls)
 BEGINObjClassExit(nsd_gtls, OBJ_IS_LOADABLE_MODULE) /* CHANGE class also in END MACRO! */
 CODESTARTObjClassExit(nsd_gtls)
 	gtlsGlblExit();	/* shut down GnuTLS */
+	if(tlsStats != NULL)
+		statsobj.Destruct(&tlsStats);
 
 	/* release objects we no longer need */
+	objRelease(statsobj, CORE_COMPONENT);
 	objRelease(nsd_ptcp, LM_NSD_PTCP_FILENAME);
 	objRelease(net, LM_NET_FILENAME);
 	objRelease(glbl, CORE_COMPONENT);
@@ -2225,6 +2456,19 @@ BEGINObjClassInit(nsd_gtls, 1, OBJ_IS_LOADABLE_MODULE) /* class, version */
 	CHKiRet(objUse(glbl, CORE_COMPONENT));
 	CHKiRet(objUse(net, LM_NET_FILENAME));
 	CHKiRet(objUse(nsd_ptcp, LM_NSD_PTCP_FILENAME));
+	CHKiRet(objUse(statsobj, CORE_COMPONENT));
+
+	/* handshake statistics, mostly to see if session resumption works */
+	CHKiRet(statsobj.Construct(&tlsStats));
+	CHKiRet(statsobj.SetName(tlsStats, UCHAR_CONSTANT("nsd_gtls")));
+	CHKiRet(statsobj.SetOrigin(tlsStats, UCHAR_CONSTANT("nsd_gtls")));
+	STATSCOUNTER_INIT(ctrHandshakeFull, mutCtrHandshakeFull);
+	CHKiRet(statsobj.AddCounter(tlsStats, UCHAR_CONSTANT("handshakes.full"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrHandshakeFull));
+	STATSCOUNTER_INIT(ctrHandshakeResumed, mutCtrHandshakeResumed);
+	CHKiRet(statsobj.AddCounter(tlsStats, UCHAR_CONSTANT("handshakes.resumed"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrHandshakeResumed));
+	CHKiRet(statsobj.ConstructFinalize(tlsStats));
 
 	/* now do global TLS init stuff */
 	CHKiRet(gtlsGlblInit());
@@ -2236,9 +2480,13 @@ ENDObjClassInit(nsd_gtls)
 
 BEGINmodExit
 CODESTARTmodExit
+#	ifdef HAVE_EPOLL_CREATE /* module only available if epoll() is supported! */
+	nsdpoll_gtlsClassExit();
+#	endif
 	nsdsel_gtlsClassExit();
 	nsd_gtlsClassExit();
 	pthread_mutex_destroy(&mutGtlsStrerror);
+	pthread_mutex_destroy(&mutSessCache);
 ENDmodExit
 
 
@@ -2251,10 +2499,14 @@ ENDqueryEtryPt
 BEGINmodInit()
 CODESTARTmodInit
 	*ipIFVersProvided = CURR_MOD_IF_VERSION; /* we only support the current interface specification */
+	pthread_mutex_init(&mutSessCache, NULL);
 
 	/* Initialize all classes that are in our module - this includes ourselfs */
 	CHKiRet(nsd_gtlsClassInit(pModInfo)); /* must be done after tcps_sess, as we use it */
 	CHKiRet(nsdsel_gtlsClassInit(pModInfo)); /* must be done after tcps_sess, as we use it */
+#	ifdef HAVE_EPOLL_CREATE /* module only available if epoll() is supported! */
+	CHKiRet(nsdpoll_gtlsClassInit(pModInfo)); /* must be done after tcps_sess, as we use it */
+#	endif
 
 	pthread_mutex_init(&mutGtlsStrerror, NULL);
 ENDmodInit
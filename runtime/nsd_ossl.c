@@ -37,6 +37,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <pthread.h>
+#include <netdb.h>
 
 #include "rsyslog.h"
 #include "syslogd-types.h"
@@ -47,8 +48,11 @@
 #include "errmsg.h"
 #include "net.h"
 #include "datetime.h"
+#include "statsobj.h"
+#include "nspoll.h"
 #include "nsd_ptcp.h"
 #include "nsdsel_ossl.h"
+#include "nsdpoll_ossl.h"
 #include "nsd_ossl.h"
 #include "unicode-helper.h"
 
@@ -64,6 +68,7 @@ DEFobjStaticHelpers
 DEFobjCurrIf(glbl)
 DEFobjCurrIf(net)
 DEFobjCurrIf(datetime)
+DEFobjCurrIf(statsobj)
 DEFobjCurrIf(nsd_ptcp)
 
 /* OpenSSL API differences */
@@ -92,6 +97,30 @@ static short bHaveKey;
 static int bAnonInit;
 static MUTEX_TYPE anonInit_mut = PTHREAD_MUTEX_INITIALIZER;
 
+/* TLS session resumption. As server, OpenSSL's internal session cache and
+ * session tickets are used. As client, we keep the most recent session per
+ * "host:port" so that reconnects (e.g. by omfwd) can resume it instead of
+ * doing a full handshake. Entries are added from the new session callback.
+ * With TLS 1.3, the session ticket arrives after the handshake, so clients
+ * read it on close, see osslReadPending().
+ */
+#define OSSL_SESSCACHE_MAX 64	/* max number of remote peers we cache sessions for */
+typedef struct osslSessCacheEtry_s osslSessCacheEtry_t;
+struct osslSessCacheEtry_s {
+	osslSessCacheEtry_t *next;
+	char *pszPeer;		/* "host:port" */
+	SSL_SESSION *sess;
+};
+static osslSessCacheEtry_t *sessCacheRoot = NULL;
+static int sessCacheNum = 0;
+static MUTEX_TYPE mutSessCache = PTHREAD_MUTEX_INITIALIZER;
+
+/* handshake statistics */
+static statsobj_t *tlsStats;
+STATSCOUNTER_DEF(ctrHandshakeFull, mutCtrHandshakeFull);
+STATSCOUNTER_DEF(ctrHandshakeResumed, mutCtrHandshakeResumed);
+STATSCOUNTER_DEF(ctrKtlsSess, mutCtrKtlsSess);
+
 /*--------------------------------------MT OpenSSL helpers ------------------------------------------*/
 static MUTEX_TYPE *mutex_buf = NULL;
 
@@ -408,6 +437,161 @@ finalize_it:
 }
 
 
+static void
+osslSessCacheEtryDestruct(osslSessCacheEtry_t *const pEtry)
+{
+	free(pEtry->pszPeer);
+	SSL_SESSION_free(pEtry->sess);
+	free(pEtry);
+}
+
+
+/* offer the cached session for our peer (if any) for resumption.
+ * Failure to do so is not an error, we just do a full handshake in that case.
+ */
+static void
+osslSessCacheApply(nsd_ossl_t *const pThis)
+{
+	osslSessCacheEtry_t *pEtry;
+
+	MUTEX_LOCK(mutSessCache);
+	for(pEtry = sessCacheRoot ; pEtry != NULL ; pEtry = pEtry->next) {
+		if(!strcmp(pEtry->pszPeer, pThis->pszSessPeer)) {
+			if(SSL_set_session(pThis->ssl, pEtry->sess) == 1) {
+				dbgprintf("osslSessCacheApply: offering cached session for %s\n",
+					pThis->pszSessPeer);
+			}
+			break;
+		}
+	}
+	MUTEX_UNLOCK(mutSessCache);
+}
+
+
+/* if configured, ask OpenSSL to hand the record layer over to the kernel
+ * (kTLS) once the handshake is done. Then SSL_read/SSL_write boil down to
+ * plain recv/send. OpenSSL silently keeps doing the crypto in userspace if
+ * the kernel or the negotiated cipher does not support it, so there is
+ * nothing we need to fall back to ourselves.
+ */
+static void
+osslSetKtls(nsd_ossl_t *const pThis)
+{
+	if(!GetTlsKtls())
+		return;
+#	ifdef SSL_OP_ENABLE_KTLS
+	SSL_set_options(pThis->ssl, SSL_OP_ENABLE_KTLS);
+#	else
+	static int bWarned = 0;
+	(void) pThis;
+	if(!bWarned) {
+		bWarned = 1;
+		LogMsg(0, RS_RET_NOT_IMPLEMENTED, LOG_WARNING, "net.tls.ktls is set, but this "
+			"OpenSSL version does not support kernel TLS - ignored");
+	}
+#	endif
+}
+
+
+/* check if the kernel took over the record layer after the handshake */
+static void
+osslChkKtls(nsd_ossl_t *const pThis)
+{
+#	ifdef SSL_OP_ENABLE_KTLS
+	const int bSend = BIO_get_ktls_send(SSL_get_wbio(pThis->ssl));
+	const int bRecv = BIO_get_ktls_recv(SSL_get_rbio(pThis->ssl));
+	dbgprintf("osslChkKtls: ssl[%p] kTLS send %d, recv %d\n", (void *)pThis->ssl, bSend, bRecv);
+	if(bSend || bRecv) {
+		STATSCOUNTER_INC(ctrKtlsSess, mutCtrKtlsSess);
+	}
+#	else
+	(void) pThis;
+#	endif
+}
+
+
+/* new session callback. We only keep client sessions, server sessions
+ * are handled by OpenSSL's internal cache. The most recently used peer
+ * is kept at the head of the list, so if the cache is full, we drop its
+ * tail. Returns 1 if we took over the session reference, 0 otherwise.
+ */
+static int
+osslSessCacheNewCb(SSL *ssl, SSL_SESSION *sess)
+{
+	osslSessCacheEtry_t *pEtry;
+	osslSessCacheEtry_t **ppEtry;
+	nsd_ossl_t *const pThis = (nsd_ossl_t*) SSL_get_ex_data(ssl, 0);
+	int bTaken = 0;
+
+	if(pThis == NULL || pThis->sslState != osslClient || pThis->pszSessPeer == NULL)
+		return 0;
+
+	MUTEX_LOCK(mutSessCache);
+	for(ppEtry = &sessCacheRoot ; *ppEtry != NULL ; ppEtry = &(*ppEtry)->next) {
+		if(!strcmp((*ppEtry)->pszPeer, pThis->pszSessPeer))
+			break;
+	}
+	if(*ppEtry != NULL) {
+		pEtry = *ppEtry;
+		*ppEtry = pEtry->next;
+		SSL_SESSION_free(pEtry->sess);
+	} else {
+		if((pEtry = calloc(1, sizeof(osslSessCacheEtry_t))) == NULL
+		   || (pEtry->pszPeer = strdup(pThis->pszSessPeer)) == NULL) {
+			free(pEtry);
+			goto done;
+		}
+		if(++sessCacheNum > OSSL_SESSCACHE_MAX) {
+			for(ppEtry = &sessCacheRoot ; (*ppEtry)->next != NULL ; ppEtry = &(*ppEtry)->next)
+				/* just search the tail */;
+			osslSessCacheEtryDestruct(*ppEtry);
+			*ppEtry = NULL;
+			--sessCacheNum;
+		}
+	}
+	pEtry->sess = sess;
+	pEtry->next = sessCacheRoot;
+	sessCacheRoot = pEtry;
+	bTaken = 1;
+done:
+	MUTEX_UNLOCK(mutSessCache);
+	return bTaken;
+}
+
+
+/* a client that never reads (like omfwd) does not process the session
+ * tickets a TLS 1.3 server sends after the handshake, so the new session
+ * callback never fires. So before we close, we read whatever the server has
+ * sent without blocking. Application data is not expected here and is
+ * discarded.
+ */
+static void
+osslReadPending(nsd_ossl_t *const pThis)
+{
+#	ifdef TLS1_3_VERSION
+	char buf[1024];
+	int sock;
+	int flags;
+	int i;
+
+	if(SSL_version(pThis->ssl) != TLS1_3_VERSION || !SSL_is_init_finished(pThis->ssl))
+		return;
+	if((sock = SSL_get_fd(pThis->ssl)) == -1
+	   || (flags = fcntl(sock, F_GETFL)) == -1
+	   || fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)
+		return;
+	for(i = 0 ; i < 16 ; ++i) {
+		if(SSL_read(pThis->ssl, buf, sizeof(buf)) <= 0)
+			break;
+	}
+	ERR_clear_error();
+	fcntl(sock, F_SETFL, flags);
+#	else
+	(void) pThis;
+#	endif
+}
+
+
 /* globally initialize OpenSSL  */
 static rsRetVal
 osslGlblInit(void)
@@ -487,7 +671,14 @@ osslGlblInit(void)
 	/* Set default VERIFY Options for OpenSSL CTX - and CALLBACK */
 	SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, verify_callback);
 
-	SSL_CTX_set_timeout(ctx, 30);	/* Default Session Timeout, TODO: Make configureable */
+	/* session resumption: server side cache and tickets need a session id
+	 * context (as we may request peer certificates), client sessions are
+	 * picked up by our own cache.
+	 */
+	SSL_CTX_set_session_id_context(ctx, (const unsigned char*) "rsyslog", sizeof("rsyslog") - 1);
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_BOTH);
+	SSL_CTX_sess_set_new_cb(ctx, osslSessCacheNewCb);
+	SSL_CTX_set_timeout(ctx, GetTlsSessionTimeout());
 	SSL_CTX_set_mode(ctx, SSL_MODE_AUTO_RETRY);
 
 	bGlblSrvrInitDone = 1;
@@ -650,6 +841,7 @@ osslInitSession(nsd_ossl_t *pThis) /* , nsd_ossl_t *pServer) */
 	/* Create BIO from ptcp socket! */
 	client = BIO_new_socket(pPtcp->sock, BIO_CLOSE /*BIO_NOCLOSE*/);
 	dbgprintf("osslInitSession: Init client BIO[%p] done\n", (void *)client);
+	osslSetKtls(pThis);
 
 	/* Set debug Callback for client BIO as well! */
 	BIO_set_callback(client, BIO_debug_callback);
@@ -964,8 +1156,15 @@ finalize_it:
 static rsRetVal
 osslGlblExit(void)
 {
+	osslSessCacheEtry_t *pEtry;
 	DEFiRet;
 	DBGPRINTF("openssl: entering osslGlblExit\n");
+	while(sessCacheRoot != NULL) {
+		pEtry = sessCacheRoot;
+		sessCacheRoot = pEtry->next;
+		osslSessCacheEtryDestruct(pEtry);
+	}
+	sessCacheNum = 0;
 	ENGINE_cleanup();
 	ERR_free_strings();
 	EVP_cleanup();
@@ -987,6 +1186,8 @@ osslEndSess(nsd_ossl_t *pThis)
 
 	/* try closing SSL Connection */
 	if(pThis->bHaveSess) {
+		if(pThis->sslState == osslClient && pThis->pszSessPeer != NULL)
+			osslReadPending(pThis); /* lets the new session callback see TLS 1.3 tickets */
 		DBGPRINTF("osslEndSess: closing SSL Session ...\n");
 		ret = SSL_shutdown(pThis->ssl);
 		if (ret <= 0) {
@@ -1048,6 +1249,8 @@ CODESTARTobjDestruct(nsd_ossl)
 		free(pThis->pszConnectHost);
 	}
 
+	free(pThis->pszSessPeer);
+
 	if(pThis->pszRcvBuf != NULL) {
 		free(pThis->pszRcvBuf);
 	}
@@ -1428,6 +1631,15 @@ osslHandshakeCheck(nsd_ossl_t *pNsd)
 		}
 	}
 
+	if(SSL_session_reused(pNsd->ssl)) {
+		dbgprintf("osslHandshakeCheck: session for ssl[%p] was resumed\n", (void *)pNsd->ssl);
+		STATSCOUNTER_INC(ctrHandshakeResumed, mutCtrHandshakeResumed);
+	} else {
+		STATSCOUNTER_INC(ctrHandshakeFull, mutCtrHandshakeFull);
+	}
+	if(GetTlsKtls())
+		osslChkKtls(pNsd);
+
 	/* Do post handshake stuff */
 	CHKiRet(osslPostHandshakeCheck(pNsd));
 
@@ -1476,8 +1688,15 @@ AcceptConnReq(nsd_t *pNsd, nsd_t **ppNew)
 	/* Store nsd_ossl_t* reference in SSL obj */
 	SSL_set_ex_data(pNew->ssl, 0, pThis);
 
-	/* We now do the handshake */
-	CHKiRet(osslHandshakeCheck(pNew));
+	/* We do NOT do the handshake here. It is CPU-intense and doing it inline
+	 * would hold up the listener (and thus all other sessions) during a
+	 * reconnect storm. Instead, it is carried out by Rcv() as soon as the
+	 * peer's data arrives. As Rcv() is called from the tcpsrv worker pool,
+	 * handshakes of many sessions are now done concurrently.
+	 */
+	pNew->rtryCall = osslRtry_handshake;
+	pNew->rtryOsslErr = SSL_ERROR_WANT_READ;
+	pNew->iMode = 1; /* this session is now in TLS mode! */
 
 	*ppNew = (nsd_t*) pNew;
 finalize_it:
@@ -1536,6 +1755,24 @@ Rcv(nsd_t *pNsd, uchar *pBuf, ssize_t *pLenBuf, int *const oserr)
 
 	/* --- in TLS mode now --- */
 
+	if(pThis->rtryCall == osslRtry_handshake) {
+		/* the handshake is still in progress - continue it. If it is
+		 * done, the peer may already have sent data, so we try to read.
+		 * Note: osslHandshakeCheck() sets rtryCall again if it needs
+		 * to be retried.
+		 */
+		pThis->rtryCall = osslRtry_None;
+		CHKiRet(osslHandshakeCheck(pThis));
+		/* in epoll mode, wait for the direction the handshake needs next */
+		if(pThis->pollReg.SetMode != NULL) {
+			CHKiRet(pThis->pollReg.SetMode(&pThis->pollReg,
+				(pThis->rtryCall == osslRtry_handshake && pThis->rtryOsslErr == SSL_ERROR_WANT_WRITE)
+				? NSDPOLL_OUT : NSDPOLL_IN));
+		}
+		if(pThis->rtryCall == osslRtry_handshake)
+			ABORT_FINALIZE(RS_RET_RETRY);
+	}
+
 	/* Buffer logic applies only if we are in TLS mode. Here we
 	 * assume that we will switch from plain to TLS, but never back. This
 	 * assumption may be unsafe, but it is the model for the time being and I
@@ -1685,6 +1922,7 @@ Connect(nsd_t *pNsd, int family, uchar *port, uchar *host, char *device)
 	nsd_ptcp_t* pPtcp = (nsd_ptcp_t*) pThis->pTcp;
 	BIO *conn;
 	char pristringBuf[4096];
+	char szPeer[NI_MAXHOST + 64];
 
 	ISOBJ_TYPE_assert(pThis, nsd_ossl);
 	assert(port != NULL);
@@ -1743,12 +1981,19 @@ BIO_set_nbio( conn, 1 );
 
 	SSL_set_bio(pThis->ssl, conn, conn);
 	SSL_set_connect_state(pThis->ssl); /*sets ssl to work in client mode.*/
+	osslSetKtls(pThis);
 	pThis->sslState = osslClient; /*set Client state */
 	pThis->bHaveSess = 1;
 
 	/* Store nsd_ossl_t* reference in SSL obj */
 	SSL_set_ex_data(pThis->ssl, 0, pThis);
 
+	/* try to resume the last session we had with this peer */
+	snprintf(szPeer, sizeof(szPeer), "%s:%s", host, port);
+	free(pThis->pszSessPeer);
+	CHKmalloc(pThis->pszSessPeer = strdup(szPeer));
+	osslSessCacheApply(pThis);
+
 	/* We now do the handshake */
 	iRet = osslHandshakeCheck(pThis);
 finalize_it:
@@ -1943,8 +2188,11 @@ ENDobjQueryInterface(nsd_ossl)
 BEGINObjClassExit(nsd_ossl, OBJ_IS_LOADABLE_MODULE) /* CHANGE class also in END MACRO! */
 CODESTARTObjClassExit(nsd_ossl)
 	osslGlblExit();	/* shut down OpenSSL */
+	if(tlsStats != NULL)
+		statsobj.Destruct(&tlsStats);
 
 	/* release objects we no longer need */
+	objRelease(statsobj, CORE_COMPONENT);
 	objRelease(nsd_ptcp, LM_NSD_PTCP_FILENAME);
 	objRelease(net, LM_NET_FILENAME);
 	objRelease(glbl, CORE_COMPONENT);
@@ -1961,6 +2209,22 @@ BEGINObjClassInit(nsd_ossl, 1, OBJ_IS_LOADABLE_MODULE) /* class, version */
 	CHKiRet(objUse(glbl, CORE_COMPONENT));
 	CHKiRet(objUse(net, LM_NET_FILENAME));
 	CHKiRet(objUse(nsd_ptcp, LM_NSD_PTCP_FILENAME));
+	CHKiRet(objUse(statsobj, CORE_COMPONENT));
+
+	/* handshake statistics, mostly to see if session resumption works */
+	CHKiRet(statsobj.Construct(&tlsStats));
+	CHKiRet(statsobj.SetName(tlsStats, UCHAR_CONSTANT("nsd_ossl")));
+	CHKiRet(statsobj.SetOrigin(tlsStats, UCHAR_CONSTANT("nsd_ossl")));
+	STATSCOUNTER_INIT(ctrHandshakeFull, mutCtrHandshakeFull);
+	CHKiRet(statsobj.AddCounter(tlsStats, UCHAR_CONSTANT("handshakes.full"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrHandshakeFull));
+	STATSCOUNTER_INIT(ctrHandshakeResumed, mutCtrHandshakeResumed);
+	CHKiRet(statsobj.AddCounter(tlsStats, UCHAR_CONSTANT("handshakes.resumed"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrHandshakeResumed));
+	STATSCOUNTER_INIT(ctrKtlsSess, mutCtrKtlsSess);
+	CHKiRet(statsobj.AddCounter(tlsStats, UCHAR_CONSTANT("ktls.sessions"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &ctrKtlsSess));
+	CHKiRet(statsobj.ConstructFinalize(tlsStats));
 
 	/* now do global TLS init stuff */
 	CHKiRet(osslGlblInit());
@@ -1972,6 +2236,9 @@ ENDObjClassInit(nsd_ossl)
 
 BEGINmodExit
 CODESTARTmodExit
+#	ifdef HAVE_EPOLL_CREATE /* module only available if epoll() is supported! */
+	nsdpoll_osslClassExit();
+#	endif
 	nsdsel_osslClassExit();
 	nsd_osslClassExit();
 ENDmodExit
@@ -1990,4 +2257,7 @@ CODESTARTmodInit
 	/* Initialize all classes that are in our module - this includes ourselfs */
 	CHKiRet(nsd_osslClassInit(pModInfo)); /* must be done after tcps_sess, as we use it */
 	CHKiRet(nsdsel_osslClassInit(pModInfo)); /* must be done after tcps_sess, as we use it */
+#	ifdef HAVE_EPOLL_CREATE /* module only available if epoll() is supported! */
+	CHKiRet(nsdpoll_osslClassInit(pModInfo)); /* must be done after tcps_sess, as we use it */
+#	endif
 ENDmodInit
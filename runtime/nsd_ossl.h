@@ -45,6 +45,7 @@ typedef nsd_if_t nsd_ossl_if_t; /* we just *implement* this interface */
 struct nsd_ossl_s {
 	BEGINobjInstance;	/* Data to implement generic object - MUST be the first data element! */
 	nsd_t *pTcp;		/**< our aggregated nsd_ptcp data */
+	nsdpoll_reg_t pollReg;	/**< our epoll registration (server sessions), see nsd.h */
 	uchar *pszConnectHost;	/**< hostname used for connect - may be used to
 					authenticate peer if no other name given */
 	int iMode;		/* 0 - plain tcp, 1 - TLS */
@@ -83,6 +84,7 @@ struct nsd_ossl_s {
 //	BIO *acc;		/* OpenSSL main BIO obj */
 	SSL *ssl;		/* OpenSSL main SSL obj */
 	osslSslState_t sslState;/**< what must we retry? */
+	char *pszSessPeer;	/**< "host:port" of our peer, used to cache client sessions for resumption */
 };
 
 /* interface is defined in nsd.h, we just implement it! */
@@ -0,0 +1,40 @@
+/* An implementation of the nsd epoll() interface for OpenSSL.
+ *
+ * Copyright (C) 2020 Adiscon GmbH.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INCLUDED_NSDPOLL_OSSL_H
+#define INCLUDED_NSDPOLL_OSSL_H
+
+#include "nsd.h"
+typedef nsdpoll_if_t nsdpoll_ossl_if_t; /* we just *implement* this interface */
+
+/* the nsdpoll_ossl object */
+struct nsdpoll_ossl_s {
+	BEGINobjInstance;	/* Data to implement generic object - MUST be the first data element! */
+	nsdpoll_t *pTcp;	/* our aggregated ptcp poll handler (which does almost everything) */
+};
+
+/* interface is defined in nsd.h, we just implement it! */
+#define nsdpoll_osslCURR_IF_VERSION nsdCURR_IF_VERSION
+
+/* prototypes */
+PROTOTYPEObj(nsdpoll_ossl);
+
+#endif /* #ifndef INCLUDED_NSDPOLL_OSSL_H */
@@ -118,6 +118,44 @@ finalize_it:
 }
 
 
+/* change the mode of the entry identified by id/pUsr. The epoll set is
+ * updated while we hold the list lock, so that the entry can not go away.
+ */
+static rsRetVal
+modEvent(nsdpoll_ptcp_t *pThis, int id, void *pUsr, int mode, nsd_ptcp_t *pSock) {
+	nsdpoll_epollevt_lst_t *pEvtLst;
+	int errSave;
+	char errStr[512];
+	DEFiRet;
+
+	pthread_mutex_lock(&pThis->mutEvtLst);
+	pEvtLst = pThis->pRoot;
+	while(pEvtLst != NULL && !(pEvtLst->id == id && pEvtLst->pUsr == pUsr)) {
+		pEvtLst = pEvtLst->pNext;
+	}
+	if(pEvtLst == NULL)
+		ABORT_FINALIZE(RS_RET_NOT_FOUND);
+
+	pEvtLst->event.events = 0;
+	if(mode & NSDPOLL_IN)
+		pEvtLst->event.events |= EPOLLIN;
+	if(mode & NSDPOLL_OUT)
+		pEvtLst->event.events |= EPOLLOUT;
+	if(epoll_ctl(pThis->efd, EPOLL_CTL_MOD, pSock->sock, &pEvtLst->event) < 0) {
+		errSave = errno;
+		rs_strerror_r(errSave, errStr, sizeof(errStr));
+		LogError(errSave, RS_RET_ERR_EPOLL_CTL,
+			"epoll_ctl failed on fd %d, id %d/%p, op %d with %s\n",
+			pSock->sock, id, pUsr, mode, errStr);
+		ABORT_FINALIZE(RS_RET_ERR_EPOLL_CTL);
+	}
+
+finalize_it:
+	pthread_mutex_unlock(&pThis->mutEvtLst);
+	RETiRet;
+}
+
+
 /* destruct the provided element. It must already be unlinked from the list.
  * rgerhards, 2009-11-23
  */
@@ -206,6 +244,9 @@ Ctl(nsdpoll_t *pNsdpoll, nsd_t *pNsd, int id, void *pUsr, int mode, int op) {
 			ABORT_FINALIZE(RS_RET_ERR_EPOLL_CTL);
 		}
 		CHKiRet(delEvent(&pEventLst));
+	} else if(op == NSDPOLL_MOD) {
+		dbgprintf("modifying nsdpoll entry %d/%p, sock %d, mode %d\n", id, pUsr, pSock->sock, mode);
+		CHKiRet(modEvent(pThis, id, pUsr, mode, pSock));
 	} else {
 		dbgprintf("program error: invalid NSDPOLL_mode %d - ignoring request\n", op);
 		ABORT_FINALIZE(RS_RET_ERR);
@@ -0,0 +1,225 @@
+/* nsdpoll_tls.c
+ *
+ * An implementation of the nsd epoll() interface for the TLS drivers. This
+ * file is compiled into both lmnsd_gtls and lmnsd_ossl. The driver-specific
+ * parts are selected via NSDPOLL_TLS_GTLS or NSDPOLL_TLS_OSSL, which the
+ * build passes to the respective module.
+ *
+ * All actual work is done by the aggregated nsdpoll_ptcp object on the
+ * underlying socket:
+ * - the TLS handshake is continued by the driver's Rcv() method whenever
+ *   the socket becomes ready. As Rcv() is called from the tcpsrv worker
+ *   pool, handshakes of many sessions are carried out concurrently and do
+ *   not hold up the event loop.
+ * - while the handshake is in progress, the TLS library may need to send
+ *   when the socket's send buffer is full. In that case the driver switches
+ *   the registration to wait for the socket to become writable, and back
+ *   to readable afterwards. For this, Ctl() hands the registration to the
+ *   driver object, see nsdpoll_reg_t.
+ * - tcpsrv receives with a buffer larger than a full TLS record, so no
+ *   decrypted data is left over inside the driver after a Rcv() call. Thus
+ *   level-triggered epoll on the raw socket does not miss any data.
+ *
+ * Copyright (C) 2020 Adiscon GmbH.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "config.h"
+
+#ifdef HAVE_EPOLL_CREATE /* this module requires epoll! */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "rsyslog.h"
+#include "module-template.h"
+#include "obj.h"
+#include "errmsg.h"
+#include "nsd.h"
+#include "nspoll.h"
+#include "nsd_ptcp.h"
+#include "nsdpoll_ptcp.h"
+
+/* driver hooks */
+#if defined(NSDPOLL_TLS_GTLS)
+#	include <gnutls/gnutls.h>
+#	include "nsd_gtls.h"
+#	include "nsdpoll_gtls.h"
+#	define NSDPOLL_TLS_CLASS nsdpoll_gtls
+#	define NSD_TLS_CLASS nsd_gtls
+typedef nsdpoll_gtls_t nsdpoll_tls_t;
+typedef nsd_gtls_t nsd_tls_t;
+#elif defined(NSDPOLL_TLS_OSSL)
+#	include <openssl/ssl.h>
+#	include "nsd_ossl.h"
+#	include "nsdpoll_ossl.h"
+#	define NSDPOLL_TLS_CLASS nsdpoll_ossl
+#	define NSD_TLS_CLASS nsd_ossl
+typedef nsdpoll_ossl_t nsdpoll_tls_t;
+typedef nsd_ossl_t nsd_tls_t;
+#else
+#	error "nsdpoll_tls.c requires NSDPOLL_TLS_GTLS or NSDPOLL_TLS_OSSL"
+#endif
+
+/* the object macros paste their class argument, so we need one level of
+ * indirection to get the class name macros expanded first.
+ */
+#define OBJ_TLS(macro, ...) macro(__VA_ARGS__)
+
+/* static data */
+DEFobjStaticHelpers
+DEFobjCurrIf(glbl)
+DEFobjCurrIf(nsdpoll_ptcp)
+
+
+/* Standard-Constructor
+ */
+OBJ_TLS(BEGINobjConstruct, NSDPOLL_TLS_CLASS) /* be sure to specify the object type also in END macro! */
+	iRet = nsdpoll_ptcp.Construct(&pThis->pTcp);
+OBJ_TLS(ENDobjConstruct, NSDPOLL_TLS_CLASS)
+
+
+/* destructor for the nsdpoll_tls object */
+OBJ_TLS(BEGINobjDestruct, NSDPOLL_TLS_CLASS) /* be sure to specify the object type also in END and CODESTART macros! */
+OBJ_TLS(CODESTARTobjDestruct, NSDPOLL_TLS_CLASS)
+	if(pThis->pTcp != NULL)
+		nsdpoll_ptcp.Destruct(&pThis->pTcp);
+OBJ_TLS(ENDobjDestruct, NSDPOLL_TLS_CLASS)
+
+
+/* change the events a registered session waits for. This is called by
+ * the TLS driver during the handshake, via the registration's SetMode hook.
+ */
+static rsRetVal
+SetMode(nsdpoll_reg_t *const pReg, const int mode)
+{
+	DEFiRet;
+
+	if(pReg->pPoll == NULL || pReg->mode == mode)
+		FINALIZE;
+	CHKiRet(nsdpoll_ptcp.Ctl(pReg->pPoll, pReg->pSock, pReg->id, pReg->pUsr, mode, NSDPOLL_MOD));
+	pReg->mode = mode;
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* Modify socket set */
+static rsRetVal
+Ctl(nsdpoll_t *pNsdpoll, nsd_t *pNsd, int id, void *pUsr, int mode, int op) {
+	nsdpoll_tls_t *pThis = (nsdpoll_tls_t*) pNsdpoll;
+	nsd_tls_t *pNsdTLS = (nsd_tls_t*) pNsd;
+	nsdpoll_reg_t *const pReg = &pNsdTLS->pollReg;
+	DEFiRet;
+
+	OBJ_TLS(ISOBJ_TYPE_assert, pThis, NSDPOLL_TLS_CLASS);
+	OBJ_TLS(ISOBJ_TYPE_assert, pNsdTLS, NSD_TLS_CLASS);
+	CHKiRet(nsdpoll_ptcp.Ctl(pThis->pTcp, pNsdTLS->pTcp, id, pUsr, mode, op));
+	if(op == NSDPOLL_ADD) {
+		/* listeners are registered as well, they just never change their mode */
+		pReg->pPoll = pThis->pTcp;
+		pReg->pSock = pNsdTLS->pTcp;
+		pReg->id = id;
+		pReg->pUsr = pUsr;
+		pReg->mode = mode;
+		pReg->SetMode = SetMode;
+	} else if(op == NSDPOLL_DEL) {
+		pReg->pPoll = NULL;
+	} else if(op == NSDPOLL_MOD) {
+		pReg->mode = mode;
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* Wait for io to become ready. See nsdpoll_ptcp for details.
+ */
+static rsRetVal
+Wait(nsdpoll_t *pNsdpoll, int timeout, int *numEntries, nsd_epworkset_t workset[]) {
+	nsdpoll_tls_t *pThis = (nsdpoll_tls_t*) pNsdpoll;
+	DEFiRet;
+
+	OBJ_TLS(ISOBJ_TYPE_assert, pThis, NSDPOLL_TLS_CLASS);
+	iRet = nsdpoll_ptcp.Wait(pThis->pTcp, timeout, numEntries, workset);
+
+	RETiRet;
+}
+
+
+/* ------------------------------ end support for the epoll() interface ------------------------------ */
+
+
+/* queryInterface function */
+OBJ_TLS(BEGINobjQueryInterface, NSDPOLL_TLS_CLASS)
+OBJ_TLS(CODESTARTobjQueryInterface, NSDPOLL_TLS_CLASS)
+	if(pIf->ifVersion != nsdCURR_IF_VERSION) {/* check for current version, increment on each change */
+		ABORT_FINALIZE(RS_RET_INTERFACE_NOT_SUPPORTED);
+	}
+
+	/* ok, we have the right interface, so let's fill it
+	 * Please note that we may also do some backwards-compatibility
+	 * work here (if we can support an older interface version - that,
+	 * of course, also affects the "if" above).
+	 */
+#if defined(NSDPOLL_TLS_GTLS)
+	pIf->Construct = (rsRetVal(*)(nsdpoll_t**)) nsdpoll_gtlsConstruct;
+	pIf->Destruct = (rsRetVal(*)(nsdpoll_t**)) nsdpoll_gtlsDestruct;
+#else
+	pIf->Construct = (rsRetVal(*)(nsdpoll_t**)) nsdpoll_osslConstruct;
+	pIf->Destruct = (rsRetVal(*)(nsdpoll_t**)) nsdpoll_osslDestruct;
+#endif
+	pIf->Ctl = Ctl;
+	pIf->Wait = Wait;
+finalize_it:
+OBJ_TLS(ENDobjQueryInterface, NSDPOLL_TLS_CLASS)
+
+
+/* exit our class
+ */
+OBJ_TLS(BEGINObjClassExit, NSDPOLL_TLS_CLASS, OBJ_IS_CORE_MODULE) /* CHANGE class also in END MACRO! */
+OBJ_TLS(CODESTARTObjClassExit, NSDPOLL_TLS_CLASS)
+	/* release objects we no longer need */
+	objRelease(glbl, CORE_COMPONENT);
+	objRelease(nsdpoll_ptcp, LM_NSD_PTCP_FILENAME);
+OBJ_TLS(ENDObjClassExit, NSDPOLL_TLS_CLASS)
+
+
+/* Initialize the nsdpoll_tls class. Must be called as the very first method
+ * before anything else is called inside this class.
+ */
+OBJ_TLS(BEGINObjClassInit, NSDPOLL_TLS_CLASS, 1, OBJ_IS_CORE_MODULE) /* class, version */
+	/* request objects we use */
+	CHKiRet(objUse(glbl, CORE_COMPONENT));
+	CHKiRet(objUse(nsdpoll_ptcp, LM_NSD_PTCP_FILENAME));
+
+	/* set our own handlers */
+OBJ_TLS(ENDObjClassInit, NSDPOLL_TLS_CLASS)
+#else
+
+#ifdef __xlc__ /* Xlc require some code, even unused, in source file*/
+static void dummy(void) {}
+#endif
+
+#endif /* #ifdef HAVE_EPOLL_CREATE this module requires epoll! */
+
+/* vi:set ai:
+ */
@@ -149,12 +149,8 @@ doRetry(nsd_gtls_t *pNsd)
 	 */
 	switch(pNsd->rtryCall) {
 		case gtlsRtry_handshake:
-			gnuRet = gnutls_handshake(pNsd->sess);
-			if(gnuRet == 0) {
-				pNsd->rtryCall = gtlsRtry_None; /* we are done */
-				/* we got a handshake, now check authorization */
-				CHKiRet(gtlsChkPeerAuth(pNsd));
-			}
+			CHKiRet(gtlsContinueHandshake(pNsd));
+			gnuRet = (pNsd->rtryCall == gtlsRtry_None) ? 0 : GNUTLS_E_AGAIN;
 			break;
 		case gtlsRtry_recv:
 			dbgprintf("retrying gtls recv, nsd: %p\n", pNsd);
@@ -210,12 +206,12 @@ IsReady(nsdsel_t *pNsdsel, nsd_t *pNsd, nsdsel_waitOp_t waitOp, int *pbIsReady)
 			FINALIZE;
 		}
 		if(pNsdGTLS->rtryCall == gtlsRtry_handshake) {
-			CHKiRet(doRetry(pNsdGTLS));
-			/* we used this up for our own internal processing, so the socket
-			 * is not ready from the upper layer point of view.
+			/* the handshake is continued by Rcv(), so that it is carried
+			 * out by the upper layer's worker pool and does not hold up
+			 * the select loop. We just need to check if the socket is
+			 * ready for the direction GnuTLS waits on.
 			 */
-			*pbIsReady = 0;
-			FINALIZE;
+			waitOp = (gnutls_record_get_direction(pNsdGTLS->sess) == 0) ? NSDSEL_RD : NSDSEL_WR;
 		}
 		else if(pNsdGTLS->rtryCall == gtlsRtry_recv) {
 			iRet = doRetry(pNsdGTLS);
@@ -209,12 +209,12 @@ DBGPRINTF("nsdsel_ossl IsReady EINTR\n");
 			FINALIZE;
 		}
 		if(pNsdOSSL->rtryCall == osslRtry_handshake) {
-			CHKiRet(doRetry(pNsdOSSL));
-			/* we used this up for our own internal processing, so the socket
-			 * is not ready from the upper layer point of view.
+			/* the handshake is continued by Rcv(), so that it is carried
+			 * out by the upper layer's worker pool and does not hold up
+			 * the select loop. We just need to check if the socket is
+			 * ready for the direction OpenSSL waits on.
 			 */
-			*pbIsReady = 0;
-			FINALIZE;
+			waitOp = (pNsdOSSL->rtryOsslErr == SSL_ERROR_WANT_WRITE) ? NSDSEL_WR : NSDSEL_RD;
 		}
 		else if(pNsdOSSL->rtryCall == osslRtry_recv) {
 			iRet = doRetry(pNsdOSSL);
@@ -27,6 +27,7 @@
 /* some operations to be portable when we do not have epoll() available */
 #define NSDPOLL_ADD	1
 #define NSDPOLL_DEL	2
+#define NSDPOLL_MOD	3	/* change the mode of an existing entry */
 
 /* and some mode specifiers for waiting on input/output */
 #define NSDPOLL_IN	1	/* EPOLLIN */
@@ -1348,6 +1348,7 @@ objClassExit(void)
 {
 	DEFiRet;
 	/* release objects we no longer need */
+	strmWrPoolExit();
 	objRelease(strm, CORE_COMPONENT);
 	objRelease(var, CORE_COMPONENT);
 	objRelease(module, CORE_COMPONENT);
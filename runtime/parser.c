@@ -42,6 +42,7 @@
 #include "unicode-helper.h"
 #include "dirty.h"
 #include "cfsysline.h"
+#include "msgtrace.h"
 
 /* some defines */
 #define DEFUPRI		(LOG_USER|LOG_NOTICE)
@@ -624,6 +625,9 @@ ParseMsg(smsg_t *pMsg)
 	static int iErrMsgRateLimiter = 0;
 	DEFiRet;
 
+	if(msgtraceSampleRate)
+		msgtraceSample(pMsg);
+
 	if(pMsg->iLenRawMsg == 0)
 		ABORT_FINALIZE(RS_RET_EMPTY_MSG);
 
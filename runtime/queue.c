@@ -62,6 +62,8 @@
 #include "unicode-helper.h"
 #include "statsobj.h"
 #include "parserif.h"
+#include "action.h"
+#include "executor.h"
 
 #ifdef OS_SOLARIS
 #	include <sched.h>
@@ -104,6 +106,7 @@ static rsRetVal qqueueChkStopWrkrDA(qqueue_t *pThis);
 static rsRetVal GetDeqBatchSize(qqueue_t *pThis, int *pVal);
 static rsRetVal ConsumerDA(qqueue_t *pThis, wti_t *pWti);
 static rsRetVal batchProcessed(qqueue_t *pThis, wti_t *pWti);
+static rsRetVal ChkStopWrkrReg(qqueue_t *pThis);
 static rsRetVal qqueueMultiEnqObjNonDirect(qqueue_t *pThis, multi_submit_t *pMultiSub);
 static rsRetVal qqueueMultiEnqObjDirect(qqueue_t *pThis, multi_submit_t *pMultiSub);
 static rsRetVal qAddDirect(qqueue_t *pThis, smsg_t *pMsg);
@@ -147,7 +150,8 @@ static struct cnfparamdescr cnfpdescr[] = {
 	{ "queue.dequeuetimeend", eCmdHdlrInt, 0 },
 	{ "queue.cry.provider", eCmdHdlrGetWord, 0 },
 	{ "queue.samplinginterval", eCmdHdlrInt, 0 },
-	{ "queue.takeflowctlfrommsg", eCmdHdlrBinary, 0 }
+	{ "queue.takeflowctlfrommsg", eCmdHdlrBinary, 0 },
+	{ "queue.executor", eCmdHdlrGetWord, 0 }
 };
 static struct cnfparamblk pblk =
 	{ CNFPARAMBLK_VERSION,
@@ -337,6 +341,7 @@ qqueueDbgPrint(qqueue_t *pThis)
 	dbgoprint((obj_t*) pThis, "queue.dequeueslowdown: %d\n", pThis->iDeqSlowdown);
 	dbgoprint((obj_t*) pThis, "queue.dequeuetimebegin: %d\n", pThis->iDeqtWinFromHr);
 	dbgoprint((obj_t*) pThis, "queue.dequeuetimeend: %d\n", pThis->iDeqtWinToHr);
+	dbgoprint((obj_t*) pThis, "queue.executor: %s\n", pThis->bUseExecutor ? "shared" : "dedicated");
 }
 
 
@@ -418,7 +423,17 @@ qqueueAdviseMaxWorkers(qqueue_t *pThis)
 		} else {
 			iMaxWorkers = getLogicalQueueSize(pThis) / pThis->iMinMsgsPerWrkr + 1;
 		}
-		wtpAdviseMaxWorkers(pThis->pWtpReg, iMaxWorkers, DENY_WORKER_START_DURING_SHUTDOWN);
+		if(pThis->bExecutor) {
+			/* tasks take the place of worker threads */
+			if(iMaxWorkers > pThis->iNumWorkerThreads)
+				iMaxWorkers = pThis->iNumWorkerThreads;
+			while(pThis->nExecTasks < iMaxWorkers) {
+				++pThis->nExecTasks;
+				executorSubmit(pThis, EXEC_SUBMIT_NEW);
+			}
+		} else {
+			wtpAdviseMaxWorkers(pThis->pWtpReg, iMaxWorkers, DENY_WORKER_START_DURING_SHUTDOWN);
+		}
 	}
 
 	RETiRet;
@@ -608,6 +623,12 @@ static rsRetVal qConstructFixedArray(qqueue_t *pThis)
 	if((pThis->tVars.farray.pBuf = malloc(sizeof(void *) * pThis->iMaxQueueSize)) == NULL) {
 		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
 	}
+	if(GatherLatencyStats
+	   && (pThis->tVars.farray.pEnqTime = malloc(sizeof(uint64_t) * pThis->iMaxQueueSize)) == NULL) {
+		free(pThis->tVars.farray.pBuf);
+		pThis->tVars.farray.pBuf = NULL;
+		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
+	}
 
 	pThis->tVars.farray.deqhead = 0;
 	pThis->tVars.farray.head = 0;
@@ -628,6 +649,7 @@ static rsRetVal qDestructFixedArray(qqueue_t *pThis)
 
 	queueDrain(pThis); /* discard any remaining queue entries */
 	free(pThis->tVars.farray.pBuf);
+	free(pThis->tVars.farray.pEnqTime);
 
 	RETiRet;
 }
@@ -639,6 +661,8 @@ static rsRetVal qAddFixedArray(qqueue_t *pThis, smsg_t* in)
 
 	assert(pThis != NULL);
 	pThis->tVars.farray.pBuf[pThis->tVars.farray.tail] = in;
+	if(pThis->tVars.farray.pEnqTime != NULL)
+		pThis->tVars.farray.pEnqTime[pThis->tVars.farray.tail] = STATSHIST_NOW();
 	pThis->tVars.farray.tail++;
 	if (pThis->tVars.farray.tail == pThis->iMaxQueueSize)
 		pThis->tVars.farray.tail = 0;
@@ -653,6 +677,9 @@ static rsRetVal qDeqFixedArray(qqueue_t *pThis, smsg_t **out)
 
 	assert(pThis != NULL);
 	*out = (void*) pThis->tVars.farray.pBuf[pThis->tVars.farray.deqhead];
+	if(pThis->tVars.farray.pEnqTime != NULL) {
+		STATSHIST_RECORD_SINCE(pThis->histEnqDeq, pThis->tVars.farray.pEnqTime[pThis->tVars.farray.deqhead]);
+	}
 
 	pThis->tVars.farray.deqhead++;
 	if (pThis->tVars.farray.deqhead == pThis->iMaxQueueSize)
@@ -717,6 +744,7 @@ static rsRetVal qAddLinkedList(qqueue_t *pThis, smsg_t* pMsg)
 
 	pEntry->pNext = NULL;
 	pEntry->pMsg = pMsg;
+	pEntry->tEnq = STATSHIST_NOW();
 
 	if(pThis->tVars.linklist.pDelRoot == NULL) {
 		pThis->tVars.linklist.pDelRoot = pThis->tVars.linklist.pDeqRoot = pThis->tVars.linklist.pLast
@@ -742,6 +770,7 @@ static rsRetVal qDeqLinkedList(qqueue_t *pThis, smsg_t **ppMsg)
 
 	pEntry = pThis->tVars.linklist.pDeqRoot;
 	*ppMsg = pEntry->pMsg;
+	STATSHIST_RECORD_SINCE(pThis->histEnqDeq, pEntry->tEnq);
 	pThis->tVars.linklist.pDeqRoot = pEntry->pNext;
 
 	RETiRet;
@@ -1411,6 +1440,68 @@ cancelWorkers(qqueue_t *pThis)
 }
 
 
+/* wait until the queue has no more executor tasks or the timeout expires.
+ * Must be called with the queue mutex locked.
+ * @returns 0 on timeout, something else otherwise
+ */
+static int
+waitExecTasksDone(qqueue_t *const pThis, const struct timespec *const pTimeout)
+{
+	while(pThis->nExecTasks > 0) {
+		if(pthread_cond_timedwait(&pThis->condExecIdle, pThis->mut, pTimeout) == ETIMEDOUT)
+			return pThis->nExecTasks == 0;
+	}
+	return 1;
+}
+
+
+/* shutdown for queues processed by the shared executor. This mirrors the
+ * phases of the regular shutdown: first, the executor may drain the queue
+ * within the queue shutdown timeout. Then, processing is aborted after the
+ * current batch and we wait the action completion timeout for that. As
+ * executor threads are shared, they cannot be cancelled, so if that also
+ * times out, we have no choice but to wait until the running batch is done.
+ */
+static rsRetVal
+shutdownExecTasks(qqueue_t *const pThis)
+{
+	struct timespec tTimeout;
+	DEFiRet;
+
+	DBGOPRINT((obj_t*) pThis, "initiating executor task shutdown sequence\n");
+	d_pthread_mutex_lock(pThis->mut);
+	timeoutComp(&tTimeout, pThis->toQShutdown);
+	if(!waitExecTasksDone(pThis, &tTimeout)) {
+		LogMsg(0, RS_RET_TIMED_OUT, LOG_INFO,
+			"%s: regular queue shutdown timed out on primary queue "
+			"(this is OK, timeout was %d)",
+			objGetName((obj_t*) pThis), pThis->toQShutdown);
+		pThis->bEnqOnly = 1;
+		pThis->bShutdownImmediate = 1;
+		timeoutComp(&tTimeout, pThis->toActShutdown);
+		if(!waitExecTasksDone(pThis, &tTimeout)) {
+			LogMsg(0, RS_RET_TIMED_OUT, LOG_WARNING,
+				"%s: immediate shutdown timed out, but executor threads "
+				"cannot be cancelled - waiting for the current batch to "
+				"finish", objGetName((obj_t*) pThis));
+			while(pThis->nExecTasks > 0)
+				d_pthread_cond_wait(&pThis->condExecIdle, pThis->mut);
+		}
+	}
+	/* no tasks must be submitted from now on, we are about to be destructed */
+	pThis->bEnqOnly = 1;
+	d_pthread_mutex_unlock(pThis->mut);
+
+	/* the executor threads still hold our action's worker instances */
+	if(pThis->pAction != NULL)
+		executorReleaseAction(pThis->pAction);
+
+	DBGOPRINT((obj_t*) pThis, "executor tasks terminated, remaining queue size log %d, phys %d.\n",
+		  getLogicalQueueSize(pThis), getPhysicalQueueSize(pThis));
+	RETiRet;
+}
+
+
 /* This function shuts down all worker threads and waits until they
  * have terminated. If they timeout, they are cancelled.
  * rgerhards, 2008-01-24
@@ -1440,6 +1531,11 @@ qqueueShutdownWorkers(qqueue_t *const pThis)
 
 	assert(pThis->pqParent == NULL); /* detect invalid calling sequence */
 
+	if(pThis->bExecutor) {
+		CHKiRet(shutdownExecTasks(pThis));
+		FINALIZE;
+	}
+
 	DBGOPRINT((obj_t*) pThis, "initiating worker thread shutdown sequence %p\n", pThis);
 
 	CHKiRet(tryShutdownWorkersWithinQueueTimeout(pThis));
@@ -2168,6 +2264,43 @@ finalize_it:
 }
 
 
+/* run a single task of this queue on a shared executor thread: process one
+ * batch, just like a regular worker does in one iteration, and resubmit the
+ * task if there is more work. As the next task of the thread may belong to
+ * a different queue, the batch is always deleted before we return.
+ */
+void
+qqueueExecTask(qqueue_t *const pThis, wti_t *const pWti)
+{
+	rsRetVal localRet = RS_RET_IDLE;
+
+	ISOBJ_TYPE_assert(pThis, qqueue);
+	ISOBJ_TYPE_assert(pWti, wti);
+
+	d_pthread_mutex_lock(pThis->mut);
+	if(pWti->batch.maxElem < pThis->iDeqBatchSize) {
+		batchFree(&pWti->batch);
+		localRet = batchInit(&pWti->batch, pThis->iDeqBatchSize);
+		if(localRet != RS_RET_OK) {
+			pWti->batch.maxElem = 0;
+			LogError(0, localRet, "%s: cannot allocate batch for executor task",
+				objGetName((obj_t*) pThis));
+		}
+	}
+	if(pWti->batch.maxElem > 0 && ChkStopWrkrReg(pThis) != RS_RET_TERMINATE_NOW) {
+		localRet = ConsumerReg(pThis, pWti);
+		batchProcessed(pThis, pWti);
+	}
+
+	if(localRet == RS_RET_OK && !pThis->bEnqOnly && getLogicalQueueSize(pThis) > 0) {
+		executorSubmit(pThis, EXEC_SUBMIT_CONTINUE);
+	} else if(--pThis->nExecTasks == 0) {
+		pthread_cond_broadcast(&pThis->condExecIdle);
+	}
+	d_pthread_mutex_unlock(pThis->mut);
+}
+
+
 /* This is a special consumer to feed the disk-queue in disk-assisted mode.
  * When active, our own queue more or less acts as a memory buffer to the disk.
  * So this consumer just needs to drain the memory queue and submit entries
@@ -2310,6 +2443,41 @@ GetDeqBatchSize(qqueue_t *pThis, int *pVal)
 }
 
 
+/* construct the worker thread pool for regular (non-DA) operation */
+static rsRetVal
+constructWtpReg(qqueue_t *const pThis)
+{
+	uchar pszBuf[64];
+	size_t lenBuf;
+	DEFiRet;
+
+	lenBuf = snprintf((char*)pszBuf, sizeof(pszBuf), "%.*s:Reg",
+		(int) (sizeof(pszBuf)-16),
+		obj.GetName((obj_t*) pThis)); /* leave some room inside the name for suffixes */
+	if(lenBuf >= sizeof(pszBuf)) {
+		LogError(0, RS_RET_INTERNAL_ERROR, "%s:%d debug header too long: %zd - in "
+				"thory this cannot happen - truncating", __FILE__, __LINE__, lenBuf);
+		lenBuf = sizeof(pszBuf)-1;
+		pszBuf[lenBuf] = '\0';
+	}
+	CHKiRet(wtpConstruct		(&pThis->pWtpReg));
+	CHKiRet(wtpSetDbgHdr		(pThis->pWtpReg, pszBuf, lenBuf));
+	CHKiRet(wtpSetpfRateLimiter	(pThis->pWtpReg, (rsRetVal (*)(void *pUsr)) RateLimiter));
+	CHKiRet(wtpSetpfChkStopWrkr	(pThis->pWtpReg, (rsRetVal (*)(void *pUsr, int)) ChkStopWrkrReg));
+	CHKiRet(wtpSetpfGetDeqBatchSize	(pThis->pWtpReg, (rsRetVal (*)(void *pUsr, int*)) GetDeqBatchSize));
+	CHKiRet(wtpSetpfDoWork		(pThis->pWtpReg, (rsRetVal (*)(void *pUsr, void *pWti)) ConsumerReg));
+	CHKiRet(wtpSetpfObjProcessed	(pThis->pWtpReg, (rsRetVal (*)(void *pUsr, wti_t *pWti)) batchProcessed));
+	CHKiRet(wtpSetpmutUsr		(pThis->pWtpReg, pThis->mut));
+	CHKiRet(wtpSetiNumWorkerThreads	(pThis->pWtpReg, pThis->iNumWorkerThreads));
+	CHKiRet(wtpSettoWrkShutdown	(pThis->pWtpReg, pThis->toWrkShutdown));
+	CHKiRet(wtpSetpUsr		(pThis->pWtpReg, pThis));
+	CHKiRet(wtpConstructFinalize	(pThis->pWtpReg));
+
+finalize_it:
+	RETiRet;
+}
+
+
 /* start up the queue - it must have been constructed and parameters defined
  * before.
  */
@@ -2317,12 +2485,10 @@ rsRetVal
 qqueueStart(qqueue_t *pThis) /* this is the ConstructionFinalizer */
 {
 	DEFiRet;
-	uchar pszBuf[64];
 	uchar pszQIFNam[MAXFNAME];
 	int wrk;
 	int goodval; /* a "good value" to use for comparisons (different objects) */
 	uchar *qName;
-	size_t lenBuf;
 
 	assert(pThis != NULL);
 
@@ -2541,29 +2707,37 @@ qqueueStart(qqueue_t *pThis) /* this is the ConstructionFinalizer */
 	if(pThis->qType == QUEUETYPE_DIRECT)
 		FINALIZE;	/* with direct queues, we are already finished... */
 
+	if(pThis->bUseExecutor) {
+		if(executorNumWrkrs == 0) {
+			LogMsg(0, RS_RET_OK, LOG_WARNING, "warning on queue '%s': "
+				"queue.executor=\"shared\" set, but the shared executor is not "
+				"enabled (global executor.workerthreads) - using own worker threads",
+				obj.GetName((obj_t*) pThis));
+		} else if((pThis->qType != QUEUETYPE_FIXED_ARRAY && pThis->qType != QUEUETYPE_LINKEDLIST)
+		          || pThis->bIsDA || pThis->iMinDeqBatchSize > 0 || pThis->iDeqSlowdown > 0
+			  || pThis->iDeqtWinToHr != 25) {
+			/* these would block or need a queue-specific thread */
+			LogMsg(0, RS_RET_OK, LOG_WARNING, "warning on queue '%s': "
+				"queue.executor=\"shared\" is only supported for in-memory queues "
+				"without disk assistance, minimum dequeue batch size, dequeue "
+				"slowdown or dequeue time window - using own worker threads",
+				obj.GetName((obj_t*) pThis));
+		} else if(pThis->pAction != NULL && pThis->pAction->iResumeRetryCount == -1) {
+			/* a suspended action would occupy an executor thread for good */
+			LogMsg(0, RS_RET_OK, LOG_WARNING, "warning on queue '%s': "
+				"queue.executor=\"shared\" is not supported for actions with "
+				"action.resumeRetryCount=\"-1\" - using own worker threads",
+				obj.GetName((obj_t*) pThis));
+		} else {
+			pThis->bExecutor = 1;
+			pthread_cond_init(&pThis->condExecIdle, NULL);
+		}
+	}
+
 	/* create worker thread pools for regular and DA operation.
 	 */
-	lenBuf = snprintf((char*)pszBuf, sizeof(pszBuf), "%.*s:Reg",
-		(int) (sizeof(pszBuf)-16),
-		obj.GetName((obj_t*) pThis)); /* leave some room inside the name for suffixes */
-	if(lenBuf >= sizeof(pszBuf)) {
-		LogError(0, RS_RET_INTERNAL_ERROR, "%s:%d debug header too long: %zd - in "
-				"thory this cannot happen - truncating", __FILE__, __LINE__, lenBuf);
-		lenBuf = sizeof(pszBuf)-1;
-		pszBuf[lenBuf] = '\0';
-	}
-	CHKiRet(wtpConstruct		(&pThis->pWtpReg));
-	CHKiRet(wtpSetDbgHdr		(pThis->pWtpReg, pszBuf, lenBuf));
-	CHKiRet(wtpSetpfRateLimiter	(pThis->pWtpReg, (rsRetVal (*)(void *pUsr)) RateLimiter));
-	CHKiRet(wtpSetpfChkStopWrkr	(pThis->pWtpReg, (rsRetVal (*)(void *pUsr, int)) ChkStopWrkrReg));
-	CHKiRet(wtpSetpfGetDeqBatchSize	(pThis->pWtpReg, (rsRetVal (*)(void *pUsr, int*)) GetDeqBatchSize));
-	CHKiRet(wtpSetpfDoWork		(pThis->pWtpReg, (rsRetVal (*)(void *pUsr, void *pWti)) ConsumerReg));
-	CHKiRet(wtpSetpfObjProcessed	(pThis->pWtpReg, (rsRetVal (*)(void *pUsr, wti_t *pWti)) batchProcessed));
-	CHKiRet(wtpSetpmutUsr		(pThis->pWtpReg, pThis->mut));
-	CHKiRet(wtpSetiNumWorkerThreads	(pThis->pWtpReg, pThis->iNumWorkerThreads));
-	CHKiRet(wtpSettoWrkShutdown	(pThis->pWtpReg, pThis->toWrkShutdown));
-	CHKiRet(wtpSetpUsr		(pThis->pWtpReg, pThis));
-	CHKiRet(wtpConstructFinalize	(pThis->pWtpReg));
+	if(!pThis->bExecutor) /* else the shared executor does the work */
+		CHKiRet(constructWtpReg(pThis));
 
 	/* set up DA system if we have a disk-assisted queue */
 	if(pThis->bIsDA)
@@ -2605,6 +2779,13 @@ qqueueStart(qqueue_t *pThis) /* this is the ConstructionFinalizer */
 	CHKiRet(statsobj.AddCounter(pThis->statsobj, UCHAR_CONSTANT("maxqsize"),
 		ctrType_Int, CTR_FLAG_NONE, &pThis->ctrMaxqsize));
 
+	if(GatherLatencyStats
+	   && (pThis->qType == QUEUETYPE_FIXED_ARRAY || pThis->qType == QUEUETYPE_LINKEDLIST)) {
+		STATSHIST_INIT(pThis->histEnqDeq);
+		CHKiRet(statsobj.AddCounter(pThis->statsobj, UCHAR_CONSTANT("latency.us"),
+			ctrType_Histogram, CTR_FLAG_RESETTABLE, &pThis->histEnqDeq));
+	}
+
 	CHKiRet(statsobj.ConstructFinalize(pThis->statsobj));
 
 finalize_it:
@@ -2808,7 +2989,7 @@ CODESTARTobjDestruct(qqueue)
 		 * with a child! -- rgerhards, 2008-01-28
 		 */
 		if(pThis->qType != QUEUETYPE_DIRECT && !pThis->bEnqOnly && pThis->pqParent == NULL
-		   && pThis->pWtpReg != NULL)
+		   && (pThis->pWtpReg != NULL || pThis->bExecutor))
 			qqueueShutdownWorkers(pThis);
 
 		if(pThis->bIsDA && getPhysicalQueueSize(pThis) > 0){
@@ -2873,6 +3054,8 @@ CODESTARTobjDestruct(qqueue)
 		pthread_cond_destroy(&pThis->notFull);
 		pthread_cond_destroy(&pThis->belowFullDlyWtrMrk);
 		pthread_cond_destroy(&pThis->belowLightDlyWtrMrk);
+		if(pThis->bExecutor)
+			pthread_cond_destroy(&pThis->condExecIdle);
 
 		DESTROY_ATOMIC_HELPER_MUT(pThis->mutQueueSize);
 		DESTROY_ATOMIC_HELPER_MUT(pThis->mutLogDeq);
@@ -3016,7 +3199,9 @@ doEnqSingleObj(qqueue_t *pThis, flowControl_t flowCtlType, smsg_t *pMsg)
 			DBGOPRINT((obj_t*) pThis, "doEnqSingleObject: FullDelay mark reached for full "
 				"delayable message - blocking, queue size is %d.\n", pThis->iQueueSize);
 			timeoutComp(&t, 1000);
+			executorBlockBegin();
 			err = pthread_cond_timedwait(&pThis->belowLightDlyWtrMrk, pThis->mut, &t);
+			executorBlockEnd();
 			if(err != 0 && err != ETIMEDOUT) {
 				/* Something is really wrong now. Report to debug log and abort the
 				 * wait. That keeps us running, even though we may lose messages.
@@ -3033,7 +3218,9 @@ doEnqSingleObj(qqueue_t *pThis, flowControl_t flowCtlType, smsg_t *pMsg)
 			DBGOPRINT((obj_t*) pThis, "doEnqSingleObject: LightDelay mark reached for light "
 			          "delayable message - blocking a bit.\n");
 			timeoutComp(&t, 1000); /* 1000 millisconds = 1 second TODO: make configurable */
+			executorBlockBegin();
 			err = pthread_cond_timedwait(&pThis->belowLightDlyWtrMrk, pThis->mut, &t);
+			executorBlockEnd();
 			if(err != 0 && err != ETIMEDOUT) {
 				/* Something is really wrong now. Report to debug log */
 				DBGOPRINT((obj_t*) pThis, "potential program bug: pthread_cond_timedwait()"
@@ -3069,7 +3256,10 @@ doEnqSingleObj(qqueue_t *pThis, flowControl_t flowCtlType, smsg_t *pMsg)
 				ABORT_FINALIZE(RS_RET_FORCE_TERM);
 			}
 			timeoutComp(&t, pThis->toEnq);
+			/* on an executor thread, our consumer may need to run elsewhere */
+			executorBlockBegin();
 			const int r = pthread_cond_timedwait(&pThis->notFull, pThis->mut, &t);
+			executorBlockEnd();
 			if(dbgTimeoutToStderr && r != 0) {
 				fprintf(stderr, "%lld: queue timeout(%dms), error %d%s, "
 					"lost message %s\n", (long long) time(NULL), pThis->toEnq,
@@ -3422,6 +3612,17 @@ qqueueApplyCnfParam(qqueue_t *pThis, struct nvlst *lst)
 			pThis->iSmpInterval = pvals[i].val.d.n;
 		} else if(!strcmp(pblk.descr[i].name, "queue.takeflowctlfrommsg")) {
 			pThis->takeFlowCtlFromMsg = pvals[i].val.d.n;
+		} else if(!strcmp(pblk.descr[i].name, "queue.executor")) {
+			char *const mode = es_str2cstr(pvals[i].val.d.estr, NULL);
+			if(!strcasecmp(mode, "shared")) {
+				pThis->bUseExecutor = 1;
+			} else if(!strcasecmp(mode, "dedicated")) {
+				pThis->bUseExecutor = 0;
+			} else {
+				parser_errmsg("invalid queue.executor '%s', must be \"shared\" "
+					"or \"dedicated\" - using dedicated worker threads", mode);
+			}
+			free(mode);
 		} else {
 			DBGPRINTF("queue: program error, non-handled "
 			  "param '%s'\n", pblk.descr[i].name);
@@ -53,6 +53,7 @@ typedef enum {
 typedef struct qLinkedList_S {
 	struct qLinkedList_S *pNext;
 	smsg_t *pMsg;
+	uint64_t tEnq;		/* enqueue time, for latency stats (0 - not recorded) */
 } qLinkedList_t;
 
 
@@ -74,6 +75,10 @@ struct queue_s {
 	/* minimum nbr of msgs per worker thread, if more, a new worker is started until max wrkrs */
 	wtp_t	*pWtpDA;
 	wtp_t	*pWtpReg;
+	sbool	bUseExecutor;	/* queue.executor="shared" requested? */
+	sbool	bExecutor;	/* processed by the shared executor (pWtpReg is unused)? */
+	int	nExecTasks;	/* our tasks submitted to or running on the executor, protected by mut */
+	pthread_cond_t condExecIdle; /* signalled when nExecTasks drops to 0 */
 	action_t *pAction;	/* for action queues, ptr to action object; for main queues unused */
 	int	iUpdsSincePersist;/* nbr of queue updates since the last persist call */
 	int	iPersistUpdCnt;	/* persits queue info after this nbr of updates - 0 -> persist only on shutdown */
@@ -156,6 +161,7 @@ struct queue_s {
 		struct {
 			long deqhead, head, tail;
 			void** pBuf;		/* the queued user data structure */
+			uint64_t *pEnqTime;	/* enqueue times, for latency stats (NULL if these are off) */
 		} farray;
 		struct {
 			qLinkedList_t *pDeqRoot;
@@ -187,6 +193,7 @@ struct queue_s {
 	STATSCOUNTER_DEF(ctrFDscrd, mutCtrFDscrd)
 	STATSCOUNTER_DEF(ctrNFDscrd, mutCtrNFDscrd)
 	int ctrMaxqsize; /* NOT guarded by a mutex */
+	STATSHIST_DEF(histEnqDeq)	/* enqueue to dequeue latency (in-memory queues only) */
 	int iSmpInterval; /* line interval of sampling logs */
 };
 
@@ -212,6 +219,7 @@ void qqueueSetDefaultsRulesetQueue(qqueue_t *pThis);
 void qqueueSetDefaultsActionQueue(qqueue_t *pThis);
 void qqueueDbgPrint(qqueue_t *pThis);
 rsRetVal qqueueShutdownWorkers(qqueue_t *pThis);
+void qqueueExecTask(qqueue_t *pThis, wti_t *pWti);
 void qqueueDoneLoadCnf(void);
 
 PROTOTYPEObjClassInit(qqueue);
@@ -235,6 +235,7 @@ CODESTARTobjDestruct(rsconf)
 	freeCnf(pThis);
 	tplDeleteAll(pThis);
 	dynstats_destroyAllBuckets();
+	keyedratelimitDestroyAll(pThis);
 	free(pThis->globals.mainQ.pszMainMsgQFName);
 	free(pThis->globals.pszConfDAGFile);
 	lookupDestroyCnf();
@@ -461,6 +462,9 @@ cnfDoObj(struct cnfobj *const o)
 	case CNFOBJ_DYN_STATS:
 		dynstats_processCnf(o);
 		break;
+	case CNFOBJ_RATELIMITER:
+		keyedratelimitProcessCnf(o);
+		break;
 	case CNFOBJ_PARSER:
 		parserProcessCnf(o);
 		break;
@@ -80,6 +80,8 @@
 #include "lookup.h"
 #include "strgen.h"
 #include "statsobj.h"
+#include "msgtrace.h"
+#include "executor.h"
 #include "atomic.h"
 #include "srUtils.h"
 
@@ -228,6 +230,12 @@ rsrtInit(const char **ppErrObj, obj_if_t *pObjIF)
 		CHKiRet(lookupClassInit());
 		if(ppErrObj != NULL) *ppErrObj = "dynstats";
 		CHKiRet(dynstatsClassInit());
+		if(ppErrObj != NULL) *ppErrObj = "keyedratelimit";
+		CHKiRet(keyedratelimitClassInit());
+		if(ppErrObj != NULL) *ppErrObj = "msgtrace";
+		CHKiRet(msgtraceClassInit());
+		if(ppErrObj != NULL) *ppErrObj = "executor";
+		CHKiRet(executorClassInit());
 
 		/* dummy "classes" */
 		if(ppErrObj != NULL) *ppErrObj = "str";
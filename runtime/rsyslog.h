@@ -582,6 +582,7 @@ enum rsRetVal_				/** return value. All methods return this if not specified oth
 	RS_RET_RABBITMQ_CHANNEL_ERR = -2449, /**< RabbitMQ Connection error */
 	RS_RET_NO_WRKDIR_SET = -2450, /**< working directory not set, but desired by functionality */
 	RS_RET_ERR_QUEUE_FN_DUP = -2451, /**< duplicate queue file name */
+	RS_RET_COMPRESSION_ERR = -2452, /**< error during zstd or lz4 compression */
 
 	/* RainerScript error messages (range 1000.. 1999) */
 	RS_RET_SYSVAR_NOT_FOUND = 1001, /**< system variable could not be found (maybe misspelled) */
@@ -49,6 +49,8 @@
 #include "srUtils.h"
 #include "modules.h"
 #include "wti.h"
+#include "msgtrace.h"
+#include "executor.h"
 #include "dirty.h" /* for main ruleset queue creation */
 
 
@@ -657,6 +659,7 @@ processBatch(batch_t *pBatch, wti_t *pWti)
 		pMsg = pBatch->pElem[i].pMsg;
 		DBGPRINTF("processBATCH: next msg %d: %.128s\n", i, pMsg->pszRawMsg);
 		pRuleset = (pMsg->pRuleset == NULL) ? ourConf->rulesets.pDflt : pMsg->pRuleset;
+		MSGTRACE_STAMP(pMsg, MSGTRACE_RULESET);
 		localRet = scriptExec(pRuleset->root, pMsg, pWti);
 		/* the most important case here is that processing may be aborted
 		 * due to pbShutdownImmediate, in which case we MUST NOT flag this
@@ -883,6 +886,8 @@ destructAllActions(rsconf_t *conf)
 	 */
 	DBGPRINTF("destructAllActions: queue shutdown\n");
 	llExecFunc(&(conf->rulesets.llRulesets), doShutdownQueueWorkers, NULL);
+	/* now no shared executor thread can run actions without own queue */
+	executorReleaseDirectActions();
 	DBGPRINTF("destructAllActions: action and conf stmt shutdown\n");
 	llExecFunc(&(conf->rulesets.llRulesets), doDestructCnfStmt, NULL);
 
@@ -46,6 +46,7 @@
 
 /* externally-visiable data (see statsobj.h for explanation) */
 int GatherStats = 0;
+int GatherLatencyStats = 0;
 
 /* static data */
 DEFobjStaticHelpers
@@ -225,6 +226,12 @@ ctr_t **entryRef, int8_t linked)
 	case ctrType_Int:
 		ctr->val.pInt = (int*) pCtr;
 		break;
+	case ctrType_StripedCtr:
+		ctr->val.pStriped = (statsctr_striped_t*) pCtr;
+		break;
+	case ctrType_Histogram:
+		ctr->val.pHist = (statshist_t*) pCtr;
+		break;
 	}
 	if (linked) {
 		addCtrToList(pThis, ctr);
@@ -284,9 +291,73 @@ destructCounter(statsobj_t *pThis, ctr_t *pCtr)
 	destructUnlinkedCounter(pCtr);
 }
 
+/* sum up the stripes of a striped counter */
+static intctr_t
+stripedCtrValue(statsctr_striped_t *const pStriped)
+{
+	intctr_t sum = 0;
+	unsigned i;
+	for(i = 0 ; i < STATSCTR_NUM_STRIPES ; ++i)
+		sum += *statsCtrStripe(pStriped, i);
+	return sum;
+}
+
+/* histograms are reported as a set of values, named <ctrname>.<suffix> */
+#define STATSHIST_NUM_VALUES 6
+static const char *const histValueNames[STATSHIST_NUM_VALUES] =
+	{ "count", "sum", "p50", "p99", "p999", "max" };
+static const unsigned histPercentiles[] = { 500, 990, 999 }; /* per mille, for p50..p999 */
+
+/* largest value that is counted in a histogram bucket */
+static intctr_t
+histBucketUpper(const unsigned idx)
+{
+	unsigned e;
+	if(idx < STATSHIST_SUB_BUCKETS)
+		return idx;
+	e = idx / STATSHIST_SUB_BUCKETS + STATSHIST_SUB_BITS - 1;
+	return (((intctr_t) STATSHIST_SUB_BUCKETS + idx % STATSHIST_SUB_BUCKETS + 1) << (e - STATSHIST_SUB_BITS)) - 1;
+}
+
+/* compute the reported values of a histogram. We work on a snapshot, so
+ * that concurrent updates do not lead to inconsistent percentiles.
+ */
+static void
+histValues(statshist_t *const pHist, intctr_t values[STATSHIST_NUM_VALUES])
+{
+	intctr_t snapshot[STATSHIST_NUM_BUCKETS];
+	intctr_t count = 0;
+	intctr_t cumulated = 0;
+	intctr_t rank;
+	unsigned i, p;
+
+	memset(values, 0, sizeof(intctr_t) * STATSHIST_NUM_VALUES);
+	for(i = 0 ; i < STATSHIST_NUM_BUCKETS ; ++i) {
+		snapshot[i] = pHist->buckets[i];
+		count += snapshot[i];
+		if(snapshot[i] != 0)
+			values[5] = histBucketUpper(i);
+	}
+	values[0] = count;
+	values[1] = pHist->sum;
+	if(count == 0)
+		return;
+	for(i = 0, p = 0 ; i < STATSHIST_NUM_BUCKETS && p < 3 ; ++i) {
+		cumulated += snapshot[i];
+		while(p < 3) {
+			rank = (count * histPercentiles[p] + 999) / 1000;
+			if(cumulated < rank)
+				break;
+			values[2 + p] = histBucketUpper(i);
+			++p;
+		}
+	}
+}
+
 static void
 resetResettableCtr(ctr_t *pCtr, int8_t bResetCtrs)
 {
+	unsigned i;
 	if ((bResetCtrs && (pCtr->flags & CTR_FLAG_RESETTABLE)) ||
 		(pCtr->flags & CTR_FLAG_MUST_RESET)) {
 		switch(pCtr->ctrType) {
@@ -296,6 +367,14 @@ resetResettableCtr(ctr_t *pCtr, int8_t bResetCtrs)
 		case ctrType_Int:
 			*(pCtr->val.pInt) = 0;
 			break;
+		case ctrType_StripedCtr:
+			for(i = 0 ; i < STATSCTR_NUM_STRIPES ; ++i)
+				*statsCtrStripe(pCtr->val.pStriped, i) = 0;
+			break;
+		case ctrType_Histogram:
+			memset(pCtr->val.pHist->buckets, 0, sizeof(pCtr->val.pHist->buckets));
+			pCtr->val.pHist->sum = 0;
+			break;
 		}
 	}
 }
@@ -318,6 +397,30 @@ finalize_it:
 	RETiRet;
 }
 
+/* add a counter to a JSON stats record, honoring format specifics */
+static rsRetVal
+addCtrForReportingFmt(json_object *to, const statsFmtType_t fmt, const uchar* field_name, intctr_t value) {
+	DEFiRet;
+	if (fmt == statsFmt_JSON_ES) {
+		/* work-around for broken Elasticsearch JSON implementation:
+		 * we need to replace dots by a different char, we use bang.
+		 * Note: ES 2.0 does not longer accept dot in name
+		 */
+		uchar esbuf[256];
+		strncpy((char*)esbuf, (char*)field_name, sizeof(esbuf)-1);
+		esbuf[sizeof(esbuf)-1] = '\0';
+		for(uchar *c = esbuf ; *c ; ++c) {
+			if(*c == '.')
+				*c = '!';
+		}
+		CHKiRet(addCtrForReporting(to, esbuf, value));
+	} else {
+		CHKiRet(addCtrForReporting(to, field_name, value));
+	}
+finalize_it:
+	RETiRet;
+}
+
 static rsRetVal
 addContextForReporting(json_object *to, const uchar* field_name, const uchar* value) {
 	json_object *v;
@@ -337,6 +440,10 @@ accumulatedValue(ctr_t *pCtr) {
 		return *(pCtr->val.pIntCtr);
 	case ctrType_Int:
 		return *(pCtr->val.pInt);
+	case ctrType_StripedCtr:
+		return stripedCtrValue(pCtr->val.pStriped);
+	case ctrType_Histogram:
+		break; /* has multiple values, see histValues() */
 	}
 	return -1;
 }
@@ -378,21 +485,16 @@ getStatsLineCEE(statsobj_t *pThis, cstr_t **ppcstr, const statsFmtType_t fmt, co
 	pthread_mutex_lock(&pThis->mutCtr);
 	locked = 1;
 	for(pCtr = pThis->ctrRoot ; pCtr != NULL ; pCtr = pCtr->next) {
-		if (fmt == statsFmt_JSON_ES) {
-			/* work-around for broken Elasticsearch JSON implementation:
-			 * we need to replace dots by a different char, we use bang.
-			 * Note: ES 2.0 does not longer accept dot in name
-			 */
-			uchar esbuf[256];
-			strncpy((char*)esbuf, (char*)pCtr->name, sizeof(esbuf)-1);
-			esbuf[sizeof(esbuf)-1] = '\0';
-			for(uchar *c = esbuf ; *c ; ++c) {
-				if(*c == '.')
-					*c = '!';
+		if(pCtr->ctrType == ctrType_Histogram) {
+			intctr_t histVals[STATSHIST_NUM_VALUES];
+			uchar namebuf[256];
+			histValues(pCtr->val.pHist, histVals);
+			for(int i = 0 ; i < STATSHIST_NUM_VALUES ; ++i) {
+				snprintf((char*)namebuf, sizeof(namebuf), "%s.%s", pCtr->name, histValueNames[i]);
+				CHKiRet(addCtrForReportingFmt(values, fmt, namebuf, histVals[i]));
 			}
-			CHKiRet(addCtrForReporting(values, esbuf, accumulatedValue(pCtr)));
 		} else {
-			CHKiRet(addCtrForReporting(values, pCtr->name, accumulatedValue(pCtr)));
+			CHKiRet(addCtrForReportingFmt(values, fmt, pCtr->name, accumulatedValue(pCtr)));
 		}
 		resetResettableCtr(pCtr, bResetCtrs);
 	}
@@ -444,6 +546,20 @@ getStatsLine(statsobj_t *pThis, cstr_t **ppcstr, int8_t bResetCtrs)
 	/* now add all counters to this line */
 	pthread_mutex_lock(&pThis->mutCtr);
 	for(pCtr = pThis->ctrRoot ; pCtr != NULL ; pCtr = pCtr->next) {
+		if(pCtr->ctrType == ctrType_Histogram) {
+			intctr_t histVals[STATSHIST_NUM_VALUES];
+			histValues(pCtr->val.pHist, histVals);
+			for(int i = 0 ; i < STATSHIST_NUM_VALUES ; ++i) {
+				rsCStrAppendStr(pcstr, pCtr->name);
+				cstrAppendChar(pcstr, '.');
+				rsCStrAppendStr(pcstr, (const uchar*) histValueNames[i]);
+				cstrAppendChar(pcstr, '=');
+				rsCStrAppendInt(pcstr, histVals[i]);
+				cstrAppendChar(pcstr, ' ');
+			}
+			resetResettableCtr(pCtr, bResetCtrs);
+			continue;
+		}
 		rsCStrAppendStr(pcstr, pCtr->name);
 		cstrAppendChar(pcstr, '=');
 		switch(pCtr->ctrType) {
@@ -453,6 +569,11 @@ getStatsLine(statsobj_t *pThis, cstr_t **ppcstr, int8_t bResetCtrs)
 		case ctrType_Int:
 			rsCStrAppendInt(pcstr, *(pCtr->val.pInt));
 			break;
+		case ctrType_StripedCtr:
+			rsCStrAppendInt(pcstr, stripedCtrValue(pCtr->val.pStriped));
+			break;
+		case ctrType_Histogram:
+			break; /* handled above */
 		}
 		cstrAppendChar(pcstr, ' ');
 		resetResettableCtr(pCtr, bResetCtrs);
@@ -468,6 +589,257 @@ finalize_it:
 
 
 
+/* ------------------------- OpenMetrics (Prometheus) ------------------------- */
+
+/* A sample (or group of samples, e.g. for a summary) belonging to one metric
+ * family. OpenMetrics requires all samples of a family to be contiguous, so
+ * we collect them first and sort by family before generating the output.
+ */
+typedef struct promSample_s {
+	char *family;
+	const char *type;
+	char *lines;	/* complete sample line(s), each '\n'-terminated */
+} promSample_t;
+
+typedef struct promSamples_s {
+	promSample_t *s;
+	size_t n;
+	size_t max;
+} promSamples_t;
+
+/* append src to the metric name in dst, replacing invalid chars by '_' */
+static void
+promAppendName(char *const dst, const size_t lenDst, const uchar *src)
+{
+	size_t i = strlen(dst);
+	for( ; *src != '\0' && i < lenDst - 1 ; ++src, ++i) {
+		const uchar c = *src;
+		dst[i] = ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+			|| c == '_' || c == ':') ? (char) c : '_';
+	}
+	dst[i] = '\0';
+}
+
+/* append a label value to dst, escaped as OpenMetrics requires */
+static void
+promAppendLabelVal(char *const dst, const size_t lenDst, const uchar *src)
+{
+	size_t i = strlen(dst);
+	for( ; *src != '\0' && i < lenDst - 2 ; ++src) {
+		if(*src == '\\' || *src == '"' || *src == '\n') {
+			dst[i++] = '\\';
+			dst[i++] = (*src == '\n') ? 'n' : (char) *src;
+		} else {
+			dst[i++] = (char) *src;
+		}
+	}
+	dst[i] = '\0';
+}
+
+static rsRetVal
+promAddSample(promSamples_t *const samples, const char *const family, const char *const type,
+	const char *const lines)
+{
+	promSample_t *newS;
+	DEFiRet;
+
+	if(samples->n == samples->max) {
+		const size_t newMax = (samples->max == 0) ? 256 : 2 * samples->max;
+		CHKmalloc(newS = realloc(samples->s, newMax * sizeof(promSample_t)));
+		samples->s = newS;
+		samples->max = newMax;
+	}
+	CHKmalloc(samples->s[samples->n].family = strdup(family));
+	if((samples->s[samples->n].lines = strdup(lines)) == NULL) {
+		free(samples->s[samples->n].family);
+		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
+	}
+	samples->s[samples->n].type = type;
+	++samples->n;
+finalize_it:
+	RETiRet;
+}
+
+/* collect the samples of one stats object. Counters are never reset
+ * by this (scrapes must not interfere with interval reporting). If
+ * bResetCtrs is set, interval reporting resets the resettable counters,
+ * so these are exported as gauges.
+ */
+static rsRetVal
+promCollectObj(statsobj_t *const pThis, promSamples_t *const samples, const int8_t bResetCtrs)
+{
+	ctr_t *pCtr;
+	char base[256];
+	char family[256];
+	char labels[1024];
+	char lines[2048];
+	const char *type;
+	intctr_t histVals[STATSHIST_NUM_VALUES];
+	DEFiRet;
+
+	strcpy(base, "rsyslog_");
+	promAppendName(base, sizeof(base), (pThis->origin == NULL) ? UCHAR_CONSTANT("core") : pThis->origin);
+
+	pthread_mutex_lock(&pThis->mutCtr);
+	for(pCtr = pThis->ctrRoot ; pCtr != NULL ; pCtr = pCtr->next) {
+		snprintf(family, sizeof(family), "%s_", base);
+		strcpy(labels, "name=\"");
+		promAppendLabelVal(labels, sizeof(labels), pThis->name);
+		if(pThis->reporting_ns != NULL) {
+			/* counter names are dynamic (e.g. dynstats), so make them a label */
+			promAppendName(family, sizeof(family), pThis->reporting_ns);
+			strncat(labels, "\",key=\"", sizeof(labels) - strlen(labels) - 1);
+			promAppendLabelVal(labels, sizeof(labels), pCtr->name);
+		} else {
+			promAppendName(family, sizeof(family), pCtr->name);
+		}
+		strncat(labels, "\"", sizeof(labels) - strlen(labels) - 1);
+
+		switch(pCtr->ctrType) {
+		case ctrType_Int:
+			type = "gauge";
+			snprintf(lines, sizeof(lines), "%s{%s} %llu\n", family, labels,
+				accumulatedValue(pCtr));
+			break;
+		case ctrType_IntCtr:
+		case ctrType_StripedCtr:
+			/* a counter that is reset each interval is not monotonic */
+			if((pCtr->flags & CTR_FLAG_MUST_RESET)
+			   || (bResetCtrs && (pCtr->flags & CTR_FLAG_RESETTABLE))) {
+				type = "gauge";
+				snprintf(lines, sizeof(lines), "%s{%s} %llu\n", family, labels,
+					accumulatedValue(pCtr));
+			} else {
+				type = "counter";
+				snprintf(lines, sizeof(lines), "%s_total{%s} %llu\n", family, labels,
+					accumulatedValue(pCtr));
+			}
+			break;
+		case ctrType_Histogram:
+		default:
+			histValues(pCtr->val.pHist, histVals);
+			type = "summary";
+			snprintf(lines, sizeof(lines),
+				"%s{%s,quantile=\"0.5\"} %llu\n"
+				"%s{%s,quantile=\"0.99\"} %llu\n"
+				"%s{%s,quantile=\"0.999\"} %llu\n"
+				"%s_sum{%s} %llu\n"
+				"%s_count{%s} %llu\n",
+				family, labels, histVals[2], family, labels, histVals[3],
+				family, labels, histVals[4], family, labels, histVals[1],
+				family, labels, histVals[0]);
+			CHKiRet(promAddSample(samples, family, type, lines));
+			strncat(family, "_max", sizeof(family) - strlen(family) - 1);
+			type = "gauge";
+			snprintf(lines, sizeof(lines), "%s{%s} %llu\n", family, labels, histVals[5]);
+			break;
+		}
+		CHKiRet(promAddSample(samples, family, type, lines));
+	}
+
+finalize_it:
+	pthread_mutex_unlock(&pThis->mutCtr);
+	RETiRet;
+}
+
+static int
+promCmpSamples(const void *s1, const void *s2)
+{
+	const promSample_t *const p1 = (const promSample_t*) s1;
+	const promSample_t *const p2 = (const promSample_t*) s2;
+	const int r = strcmp(p1->family, p2->family);
+	return (r != 0) ? r : strcmp(p1->type, p2->type);
+}
+
+/* append the sample lines, with the family name prefix of each line
+ * replaced by newFamily.
+ */
+static rsRetVal
+promAppendRenamed(cstr_t *const cstr, const promSample_t *const sample, const char *const newFamily)
+{
+	const size_t lenFamily = strlen(sample->family);
+	const char *line = sample->lines;
+	const char *eol;
+	DEFiRet;
+
+	while(*line != '\0') {
+		eol = strchr(line, '\n');
+		eol = (eol == NULL) ? line + strlen(line) : eol + 1;
+		CHKiRet(rsCStrAppendStr(cstr, (uchar*) newFamily));
+		CHKiRet(rsCStrAppendStrWithLen(cstr, (uchar*) line + lenFamily, eol - line - lenFamily));
+		line = eol;
+	}
+finalize_it:
+	RETiRet;
+}
+
+/* generate all stats in OpenMetrics text format and pass them as one
+ * document to the callback. Each object's counter lock is only held while
+ * its values are copied; sorting, formatting and the callback happen
+ * without any stats lock held.
+ * A family must have a single type, but different objects with the same
+ * origin may use the same counter name with different counter types. In
+ * that case, the samples that do not match the family's first type are
+ * moved to a family named <family>_<type>.
+ */
+static rsRetVal
+getAllStatsPrometheus(rsRetVal(*cb)(void*, const char*), void *const usrptr, const int8_t bResetCtrs)
+{
+	statsobj_t *o;
+	promSamples_t samples = { NULL, 0, 0 };
+	cstr_t *cstr = NULL;
+	const char *famType = NULL;
+	char newFamily[256];
+	int bNewFamily;
+	int bRenamed;
+	size_t i;
+	DEFiRet;
+
+	for(o = objRoot ; o != NULL ; o = o->next) {
+		CHKiRet(promCollectObj(o, &samples, bResetCtrs));
+	}
+
+	qsort(samples.s, samples.n, sizeof(promSample_t), promCmpSamples);
+
+	CHKiRet(cstrConstruct(&cstr));
+	for(i = 0 ; i < samples.n ; ++i) {
+		bNewFamily = (i == 0 || strcmp(samples.s[i].family, samples.s[i-1].family));
+		if(bNewFamily)
+			famType = samples.s[i].type;
+		bRenamed = strcmp(samples.s[i].type, famType) != 0;
+		if(bRenamed) {
+			snprintf(newFamily, sizeof(newFamily), "%s_%s", samples.s[i].family, samples.s[i].type);
+		}
+		if(bNewFamily || strcmp(samples.s[i].type, samples.s[i-1].type)) {
+			CHKiRet(rsCStrAppendStr(cstr, UCHAR_CONSTANT("# TYPE ")));
+			CHKiRet(rsCStrAppendStr(cstr, (uchar*) (bRenamed ? newFamily : samples.s[i].family)));
+			CHKiRet(cstrAppendChar(cstr, ' '));
+			CHKiRet(rsCStrAppendStr(cstr, (uchar*) samples.s[i].type));
+			CHKiRet(cstrAppendChar(cstr, '\n'));
+		}
+		if(bRenamed) {
+			CHKiRet(promAppendRenamed(cstr, &samples.s[i], newFamily));
+		} else {
+			CHKiRet(rsCStrAppendStr(cstr, (uchar*) samples.s[i].lines));
+		}
+	}
+	CHKiRet(rsCStrAppendStr(cstr, UCHAR_CONSTANT("# EOF\n")));
+	cstrFinalize(cstr);
+	CHKiRet(cb(usrptr, (const char*)cstrGetSzStrNoNULL(cstr)));
+
+finalize_it:
+	for(i = 0 ; i < samples.n ; ++i) {
+		free(samples.s[i].family);
+		free(samples.s[i].lines);
+	}
+	free(samples.s);
+	if(cstr != NULL) {
+		rsCStrDestruct(&cstr);
+	}
+	RETiRet;
+}
+
+
 /* this function obtains all sender stats. hlper to getAllStatsLines()
  * We need to keep this looked to avoid resizing of the hash table
  * (what could otherwise cause a segfault).
@@ -520,6 +892,8 @@ getSenderStats(rsRetVal(*cb)(void*, const char*),
  * submits each stats line to the callback. The callback has two parameters:
  * the first one is a caller-provided void*, the second one the cstr_t with the
  * line. If the callback reports an error, processing is stopped.
+ * For statsFmt_Prometheus, counters are never reset. There, bResetCtrs tells
+ * that interval reporting resets them, so they are not exported as counters.
  */
 static rsRetVal
 getAllStatsLines(rsRetVal(*cb)(void*, const char*), void *const usrptr, statsFmtType_t fmt, const int8_t bResetCtrs)
@@ -528,8 +902,15 @@ getAllStatsLines(rsRetVal(*cb)(void*, const char*), void *const usrptr, statsFmt
 	cstr_t *cstr = NULL;
 	DEFiRet;
 
+	if(fmt == statsFmt_Prometheus) {
+		/* sender stats are not included, their cardinality is unbounded */
+		CHKiRet(getAllStatsPrometheus(cb, usrptr, bResetCtrs));
+		FINALIZE;
+	}
+
 	for(o = objRoot ; o != NULL ; o = o->next) {
 		switch(fmt) {
+		case statsFmt_Prometheus: /* handled above, keep compiler happy */
 		case statsFmt_Legacy:
 			CHKiRet(getStatsLine(o, &cstr, bResetCtrs));
 			break;
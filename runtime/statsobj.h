@@ -21,6 +21,10 @@
 #ifndef INCLUDED_STATSOBJ_H
 #define INCLUDED_STATSOBJ_H
 
+#include <pthread.h>
+#ifdef HAVE_SCHED_GETCPU
+#	include <sched.h>
+#endif
 #include "atomic.h"
 
 /* The following data item is somewhat dirty, in that it does not follow
@@ -32,15 +36,100 @@
  */
 extern int GatherStats;
 
+/* If set, queues and actions additionally measure and report latency
+ * histograms (global parameter stats.latencyhistograms). This costs a
+ * clock read per enqueue/dequeue and commit, so it is off by default.
+ * Must be set before queues and actions are activated.
+ */
+extern int GatherLatencyStats;
+
 /* our basic counter type -- need 32 bit on 32 bit platform.
  * IMPORTANT: this type *MUST* be supported by atomic instructions!
  */
 typedef uint64 intctr_t;
 
+/* striped counter -- for counters which are updated by many threads
+ * concurrently (e.g. action or listener stats). Each CPU increments
+ * its own cache line, so the hot path does not bounce a shared line
+ * between cores. The stripes are summed up only when stats are read.
+ * Note that the increment itself is still atomic, as a thread may
+ * migrate to a different CPU and multiple threads may map to the same
+ * stripe -- but an atomic op on an uncontended line is cheap.
+ */
+#define STATSCTR_STRIPE_BITS 4
+#define STATSCTR_NUM_STRIPES (1 << STATSCTR_STRIPE_BITS)
+#define STATSCTR_CACHE_LINE 64
+typedef struct statsctr_striped_s {
+	/* one extra line, as we align the stripes inside the buffer */
+	char buf[(STATSCTR_NUM_STRIPES + 1) * STATSCTR_CACHE_LINE];
+	DEF_ATOMIC_HELPER_MUT64(mut)
+} statsctr_striped_t;
+
+static inline intctr_t *
+statsCtrStripe(statsctr_striped_t *const ctr, const unsigned idx)
+{
+	const uintptr_t base = ((uintptr_t) ctr->buf + STATSCTR_CACHE_LINE - 1)
+		& ~((uintptr_t) STATSCTR_CACHE_LINE - 1);
+	return (intctr_t*) (base + idx * STATSCTR_CACHE_LINE);
+}
+
+static inline unsigned
+statsCtrMyStripe(void)
+{
+#ifdef HAVE_SCHED_GETCPU
+	const int cpu = sched_getcpu();
+	if(cpu >= 0)
+		return (unsigned) cpu & (STATSCTR_NUM_STRIPES - 1);
+#endif
+	/* fallback: spread threads by (hashed) thread id */
+	return (unsigned) (((uint64_t) (uintptr_t) pthread_self() * 0x9E3779B97F4A7C15ULL)
+		>> (64 - STATSCTR_STRIPE_BITS));
+}
+
+/* latency histogram -- log-linear ("HDR-style") buckets: values below
+ * 2^STATSHIST_SUB_BITS are counted exactly, above that each power of two
+ * is split into 2^STATSHIST_SUB_BITS linear sub-buckets, which gives a
+ * relative error of at most 12.5%. Values are in microseconds. Percentiles
+ * are computed only when stats are read.
+ */
+#define STATSHIST_SUB_BITS 3
+#define STATSHIST_SUB_BUCKETS (1 << STATSHIST_SUB_BITS)
+#define STATSHIST_MAX_EXP 40 /* larger values are clamped (2^40us is ~12 days) */
+#define STATSHIST_NUM_BUCKETS ((STATSHIST_MAX_EXP - STATSHIST_SUB_BITS + 1) * STATSHIST_SUB_BUCKETS)
+typedef struct statshist_s {
+	intctr_t buckets[STATSHIST_NUM_BUCKETS];
+	intctr_t sum;
+	DEF_ATOMIC_HELPER_MUT64(mut)
+} statshist_t;
+
+static inline unsigned
+statsHistBucket(uint64_t val)
+{
+	unsigned e;
+	if(val < STATSHIST_SUB_BUCKETS)
+		return (unsigned) val;
+	if(val >= ((uint64_t) 1 << STATSHIST_MAX_EXP))
+		val = ((uint64_t) 1 << STATSHIST_MAX_EXP) - 1;
+	e = 63 - __builtin_clzll(val);
+	return (e - STATSHIST_SUB_BITS + 1) * STATSHIST_SUB_BUCKETS
+		+ (unsigned) ((val >> (e - STATSHIST_SUB_BITS)) & (STATSHIST_SUB_BUCKETS - 1));
+}
+
+/* current time in microseconds, for latency measurement only */
+static inline uint64_t
+statsHistNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /* counter types */
 typedef enum statsCtrType_e {
 	ctrType_IntCtr,
-	ctrType_Int
+	ctrType_Int,
+	ctrType_StripedCtr,
+	ctrType_Histogram	/* reported as <name>.count, .sum, .p50, .p99, .p999, .max */
 } statsCtrType_t;
 
 /* stats line format types */
@@ -48,7 +137,8 @@ typedef enum statsFmtType_e {
 	statsFmt_Legacy,
 	statsFmt_JSON,
 	statsFmt_JSON_ES,
-	statsFmt_CEE
+	statsFmt_CEE,
+	statsFmt_Prometheus	/* OpenMetrics text; passed to the callback as a single document */
 } statsFmtType_t;
 
 /* counter flags */
@@ -67,6 +157,8 @@ typedef struct ctr_s {
 	union {
 		intctr_t *pIntCtr;
 		int *pInt;
+		statsctr_striped_t *pStriped;
+		statshist_t *pHist;
 	} val;
 	int8_t flags;
 	struct ctr_s *next, *prev;
@@ -192,6 +284,51 @@ void checkGoneAwaySenders(time_t);
 	if(GatherStats) \
 		ATOMIC_DEC_uint64(&ctr, &mut);
 
+/* striped counters, see statsctr_striped_t. Register them with
+ * ctrType_StripedCtr.
+ */
+#define STATSCOUNTER_STRIPED_DEF(ctr) \
+	statsctr_striped_t ctr;
+
+#define STATSCOUNTER_STRIPED_INIT(ctr) \
+	memset(&(ctr), 0, sizeof(ctr)); \
+	INIT_ATOMIC_HELPER_MUT64((ctr).mut);
+
+#define STATSCOUNTER_STRIPED_INC(ctr) \
+	if(GatherStats) \
+		ATOMIC_INC_uint64(statsCtrStripe(&(ctr), statsCtrMyStripe()), &(ctr).mut);
+
+#define STATSCOUNTER_STRIPED_ADD(ctr, delta) \
+	if(GatherStats) \
+		ATOMIC_ADD_uint64(statsCtrStripe(&(ctr), statsCtrMyStripe()), &(ctr).mut, delta);
+
+/* latency histograms, see statshist_t. Register them with ctrType_Histogram.
+ * STATSHIST_RECORD_SINCE records the time elapsed since tStart, which must
+ * have been obtained via statsHistNow() (0 means "not recorded").
+ */
+#define STATSHIST_DEF(hist) \
+	statshist_t hist;
+
+#define STATSHIST_INIT(hist) \
+	memset(&(hist), 0, sizeof(hist)); \
+	INIT_ATOMIC_HELPER_MUT64((hist).mut);
+
+#define STATSHIST_RECORD(hist, val) \
+	if(GatherStats) { \
+		ATOMIC_INC_uint64(&(hist).buckets[statsHistBucket(val)], &(hist).mut); \
+		ATOMIC_ADD_uint64(&(hist).sum, &(hist).mut, (val)); \
+	}
+
+/* start timestamp for STATSHIST_RECORD_SINCE, 0 if latency stats are off */
+#define STATSHIST_NOW() \
+	((GatherStats && GatherLatencyStats) ? statsHistNow() : 0)
+
+#define STATSHIST_RECORD_SINCE(hist, tStart) \
+	if(GatherStats && (tStart) != 0) { \
+		const uint64_t tDelta_ = statsHistNow() - (tStart); \
+		STATSHIST_RECORD(hist, tDelta_); \
+	}
+
 /* the next macro works only if the variable is already guarded
  * by mutex (or the users risks a wrong result). It is assumed
  * that there are not concurrent operations that modify the counter.
@@ -50,6 +50,8 @@
 #include <errno.h>
 #include <pthread.h>
 #include <poll.h>
+#include <limits.h>
+#include <sys/uio.h>
 #ifdef HAVE_SYS_PRCTL_H
 #  include <sys/prctl.h>
 #endif
@@ -64,6 +66,17 @@
 #include "errmsg.h"
 #include "cryprov.h"
 #include "datetime.h"
+#include "zstdw.h"
+#include "lz4w.h"
+
+#ifndef IOV_MAX
+#define IOV_MAX 16 /* POSIX minimum */
+#endif
+
+/* alignment of file offsets, lengths and buffers for O_DIRECT writes. We use
+ * the page size, which is a multiple of all common logical block sizes.
+ */
+#define STRM_DIO_ALIGN 4096
 
 /* some platforms do not have large file support :( */
 #ifndef O_LARGEFILE
@@ -76,6 +89,31 @@
 /* static data */
 DEFobjStaticHelpers
 DEFobjCurrIf(zlibw)
+DEFobjCurrIf(zstdw)
+DEFobjCurrIf(lz4w)
+
+/* The shared writer pool. If global(stream.writerThreads) is set, async
+ * streams do not get their own writer thread. Instead, they queue themselves
+ * to the pool's run queue whenever they have a buffer to write, and any pool
+ * thread writes out everything the stream has pending. The double buffer of
+ * each stream is unchanged, so the in-flight data per stream is still limited
+ * to STREAM_ASYNC_NUMBUFS-1 buffers, and the producer blocks if it is used up.
+ * Lock order is stream mutex first, then pool mutex.
+ */
+#define STRM_WRPOOL_IDLE 0	/* stream has nothing to do for the pool */
+#define STRM_WRPOOL_QUEUED 1	/* stream is in run queue */
+#define STRM_WRPOOL_ACTIVE 2	/* stream is being processed by a pool thread */
+static struct {
+	pthread_mutex_t mut;
+	pthread_cond_t wakeup;
+	pthread_t *thrds;
+	int nThrds;
+	sbool bStop;
+	time_t tNextSweep;	/* next time to check for flush timeouts */
+	strm_t *pRunHead;
+	strm_t *pRunTail;
+	strm_t *pAll;		/* all streams served by the pool */
+} wrPool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, 0, 0, 0, NULL, NULL, NULL };
 
 /* forward definitions */
 static rsRetVal strmFlushInternal(strm_t *pThis, int bFlushZip);
@@ -83,8 +121,11 @@ static rsRetVal strmWrite(strm_t *__restrict__ const pThis, const uchar *__restr
 	const size_t lenBuf);
 static rsRetVal strmCloseFile(strm_t *pThis);
 static void *asyncWriterThread(void *pPtr);
+static void wrPoolSchedule(strm_t *pThis);
+static rsRetVal wrPoolRegister(strm_t *pThis);
 static rsRetVal doZipWrite(strm_t *pThis, uchar *pBuf, size_t lenBuf, int bFlush);
 static rsRetVal doZipFinish(strm_t *pThis);
+static rsRetVal doCompressFinish(strm_t *pThis);
 static rsRetVal strmPhysWrite(strm_t *pThis, uchar *pBuf, size_t lenBuf);
 static rsRetVal strmSeekCurrOffs(strm_t *pThis);
 
@@ -239,6 +280,291 @@ finalize_it:
 }
 
 
+#ifdef O_DIRECT
+/* make the staging buffer match a file of size fileSize. Tail bytes that
+ * were already written to the file are dropped, pending ones are kept. If
+ * the file does not end on a block boundary, its partial last block is read
+ * in front of the pending bytes, because the next direct write must begin
+ * with it. This is used on open and after the file was changed behind our
+ * back, e.g. truncated by logrotate's copytruncate.
+ */
+static rsRetVal
+dioLoadTail(strm_t *const pThis, const off_t fileSize)
+{
+	const size_t lenDisk = pThis->lenDioDisk;
+	const size_t lenPending = pThis->lenDioBuf - lenDisk;
+	size_t lenPart;
+	ssize_t lenRead;
+	DEFiRet;
+
+	pThis->iDioOffs = fileSize & ~((off_t) STRM_DIO_ALIGN - 1);
+	lenPart = fileSize - pThis->iDioOffs;
+	pThis->lenDioBuf = lenPending;
+	pThis->lenDioDisk = 0;
+	if(lenPart > 0) {
+		/* a direct read may fill the whole block, so park pending data behind it */
+		memmove(pThis->pDioBuf + STRM_DIO_ALIGN, pThis->pDioBuf + lenDisk, lenPending);
+		do {
+			lenRead = pread(pThis->fd, pThis->pDioBuf, STRM_DIO_ALIGN, pThis->iDioOffs);
+		} while(lenRead == -1 && errno == EINTR);
+		if(lenRead != (ssize_t) lenPart) {
+			LogError((lenRead == -1) ? errno : 0, RS_RET_IO_ERROR, "file '%s': cannot read last block "
+				"for direct I/O", pThis->pszCurrFName);
+			ABORT_FINALIZE(RS_RET_IO_ERROR);
+		}
+		memmove(pThis->pDioBuf + lenPart, pThis->pDioBuf + STRM_DIO_ALIGN, lenPending);
+		pThis->lenDioBuf = lenPart + lenPending;
+		pThis->lenDioDisk = lenPart;
+	} else if(lenDisk > 0) {
+		memmove(pThis->pDioBuf, pThis->pDioBuf + lenDisk, lenPending);
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* obtain the current size of the file */
+static rsRetVal
+dioGetFileSize(strm_t *const pThis, off_t *const pSize)
+{
+	struct stat statFile;
+	DEFiRet;
+
+	if(fstat(pThis->fd, &statFile) == -1) {
+		LogError(errno, RS_RET_IO_ERROR, "file '%s': cannot obtain file size", pThis->pszCurrFName);
+		ABORT_FINALIZE(RS_RET_IO_ERROR);
+	}
+	*pSize = statFile.st_size;
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* set up direct I/O state for a freshly opened file */
+static rsRetVal
+dioInit(strm_t *const pThis)
+{
+	off_t fileSize;
+	DEFiRet;
+
+	pThis->lenDioBuf = 0;
+	pThis->lenDioDisk = 0;
+	CHKiRet(dioGetFileSize(pThis, &fileSize));
+	CHKiRet(dioLoadTail(pThis, fileSize));
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* pwrite() all of pBuf at offset offs, handling partial writes */
+static rsRetVal
+dioPwrite(strm_t *const pThis, const uchar *pBuf, size_t lenBuf, off_t offs)
+{
+	ssize_t iWritten;
+	DEFiRet;
+
+	while(lenBuf > 0) {
+		iWritten = pwrite(pThis->fd, pBuf, lenBuf, offs);
+		if(iWritten < 0) {
+			if(errno == EINTR)
+				continue;
+			LogError(errno, RS_RET_IO_ERROR, "file '%s'[%d] write error - see "
+				"https://www.rsyslog.com/solving-rsyslog-write-errors/ for help "
+				"OS error", pThis->pszCurrFName, pThis->fd);
+			ABORT_FINALIZE(RS_RET_IO_ERROR);
+		}
+		pBuf += iWritten;
+		lenBuf -= iWritten;
+		offs += iWritten;
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* write a buffer in direct I/O mode. All complete blocks are written via
+ * O_DIRECT. The remaining partial block is kept in the staging buffer until
+ * it is complete; it is written only on close, on an explicit flush (e.g.
+ * flushOnTXEnd) or when the file is synced, see dioWriteTail(). The next
+ * direct write rewrites that block in full.
+ * If there is no partial block pending and pBuf is aligned, we write from
+ * pBuf directly; otherwise the data is first appended to the staging buffer.
+ * As we write at explicit offsets, we check that the file still has the size
+ * we expect. If not, someone else has truncated or extended it, and we
+ * continue at its new end, just like O_APPEND would.
+ */
+static rsRetVal
+dioWrite(strm_t *const pThis, uchar *const pBuf, const size_t lenBuf)
+{
+	uchar *pWr;
+	size_t lenWr;
+	size_t lenFull;
+	off_t fileSize;
+	DEFiRet;
+
+	CHKiRet(dioGetFileSize(pThis, &fileSize));
+	if(fileSize != pThis->iDioOffs + (off_t) pThis->lenDioDisk) {
+		DBGPRINTF("file '%s': size changed externally from %lld to %lld, continuing at end of file\n",
+			pThis->pszCurrFName, (long long) (pThis->iDioOffs + pThis->lenDioDisk),
+			(long long) fileSize);
+		CHKiRet(dioLoadTail(pThis, fileSize));
+	}
+
+	if(pThis->lenDioBuf == 0 && ((uintptr_t) pBuf & (STRM_DIO_ALIGN - 1)) == 0) {
+		pWr = pBuf;
+		lenWr = lenBuf;
+	} else {
+		assert(pThis->lenDioBuf + lenBuf <= pThis->sIOBufSize + 2 * STRM_DIO_ALIGN);
+		memcpy(pThis->pDioBuf + pThis->lenDioBuf, pBuf, lenBuf);
+		pWr = pThis->pDioBuf;
+		lenWr = pThis->lenDioBuf + lenBuf;
+	}
+
+	lenFull = lenWr & ~((size_t) STRM_DIO_ALIGN - 1);
+	if(lenFull > 0) {
+		CHKiRet(dioPwrite(pThis, pWr, lenFull, pThis->iDioOffs));
+		pThis->iDioOffs += lenFull;
+		pThis->lenDioDisk = 0;
+	}
+
+	pThis->lenDioBuf = lenWr - lenFull;
+	if(pThis->lenDioBuf > 0 && pWr + lenFull != pThis->pDioBuf) {
+		memmove(pThis->pDioBuf, pWr + lenFull, pThis->lenDioBuf);
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* write the pending part of the partial last block. This can not be done
+ * with O_DIRECT, so the flag is cleared for the write. If bKeepOpen is set,
+ * the file is used afterwards and O_DIRECT is restored; if that fails, we
+ * continue the stream with regular writes.
+ */
+static rsRetVal
+dioWriteTail(strm_t *const pThis, const int bKeepOpen)
+{
+	int flags;
+	DEFiRet;
+
+	if(pThis->lenDioBuf == pThis->lenDioDisk)
+		FINALIZE;
+
+	if((flags = fcntl(pThis->fd, F_GETFL)) == -1
+	   || fcntl(pThis->fd, F_SETFL, flags & ~O_DIRECT) == -1) {
+		LogError(errno, RS_RET_IO_ERROR, "file '%s': cannot turn off direct I/O to "
+			"write last block", pThis->pszCurrFName);
+		ABORT_FINALIZE(RS_RET_IO_ERROR);
+	}
+	CHKiRet(dioPwrite(pThis, pThis->pDioBuf + pThis->lenDioDisk, pThis->lenDioBuf - pThis->lenDioDisk,
+		pThis->iDioOffs + pThis->lenDioDisk));
+	pThis->lenDioDisk = pThis->lenDioBuf;
+
+	if(bKeepOpen && fcntl(pThis->fd, F_SETFL, flags) == -1) {
+		LogError(errno, RS_RET_IO_ERROR, "file '%s': cannot turn direct I/O back on, "
+			"using regular writes", pThis->pszCurrFName);
+		pThis->bDirectIO = 0;
+		if(lseek(pThis->fd, 0, SEEK_END) == -1)
+			ABORT_FINALIZE(RS_RET_IO_ERROR);
+	}
+
+finalize_it:
+	RETiRet;
+}
+#else
+/* direct I/O is always turned off in ConstructFinalize in this case */
+static rsRetVal
+dioInit(strm_t __attribute__((unused)) *const pThis)
+{
+	return RS_RET_NOT_IMPLEMENTED;
+}
+
+static rsRetVal
+dioWrite(strm_t __attribute__((unused)) *const pThis, uchar __attribute__((unused)) *const pBuf,
+	const size_t __attribute__((unused)) lenBuf)
+{
+	return RS_RET_NOT_IMPLEMENTED;
+}
+
+static rsRetVal
+dioWriteTail(strm_t __attribute__((unused)) *const pThis, const int __attribute__((unused)) bKeepOpen)
+{
+	return RS_RET_NOT_IMPLEMENTED;
+}
+#endif /* #ifdef O_DIRECT */
+
+
+/* preallocate file space for an upcoming write of lenBuf bytes. Space is
+ * allocated in extents of iPreallocSize without changing the file size, so
+ * readers never see the preallocated area. If the file system does not
+ * support this, preallocation is turned off for the stream.
+ */
+#if defined(HAVE_FALLOCATE) && defined(FALLOC_FL_KEEP_SIZE)
+static void
+preallocate(strm_t *const pThis, const size_t lenBuf)
+{
+	const off_t iEnd = pThis->iCurrOffs + lenBuf;
+	off_t iStart;
+	off_t lenAlloc;
+
+	if(iEnd <= pThis->iPreallocEnd)
+		return;
+	iStart = (pThis->iCurrOffs > pThis->iPreallocEnd) ? pThis->iCurrOffs : pThis->iPreallocEnd;
+	lenAlloc = ((iEnd - iStart + pThis->iPreallocSize - 1) / pThis->iPreallocSize) * pThis->iPreallocSize;
+	if(fallocate(pThis->fd, FALLOC_FL_KEEP_SIZE, iStart, lenAlloc) == -1) {
+		LogError(errno, RS_RET_IO_ERROR, "file '%s': cannot preallocate space, "
+			"preallocation disabled for this file", pThis->pszCurrFName);
+		pThis->iPreallocSize = 0;
+		return;
+	}
+	pThis->iPreallocEnd = iStart + lenAlloc;
+}
+#else
+static void
+preallocate(strm_t __attribute__((unused)) *const pThis, const size_t __attribute__((unused)) lenBuf)
+{
+}
+#endif
+
+
+/* drop the file's data from the page cache. Only clean pages are dropped,
+ * so we advise on the whole file: pages still dirty now will be dropped by
+ * one of the next calls.
+ */
+static void
+dropCache(strm_t *const pThis)
+{
+#ifdef HAVE_POSIX_FADVISE
+	(void) posix_fadvise(pThis->fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+	pThis->bDropCache = 0;
+#endif
+}
+
+
+/* release preallocated space beyond the end of file. Truncating the file to
+ * its current size frees any blocks allocated past it.
+ */
+static void
+releasePrealloc(strm_t *const pThis)
+{
+	struct stat statFile;
+
+	if(fstat(pThis->fd, &statFile) == 0 && statFile.st_size < pThis->iPreallocEnd) {
+		if(ftruncate(pThis->fd, statFile.st_size) != 0) {
+			DBGPRINTF("file '%s': could not release preallocated space, errno %d\n",
+				pThis->pszCurrFName, errno);
+		}
+	}
+	pThis->iPreallocEnd = 0;
+}
+
+
 /* now, we define type-specific handlers. The provide a generic functionality,
  * but for this specific type of strm. The mapping to these handlers happens during
  * strm construction. Later on, handlers are called by pointers present in the
@@ -278,7 +604,22 @@ doPhysOpen(strm_t *pThis)
 		iFlags |= O_NONBLOCK;
 	}
 
-	pThis->fd = open((char*)pThis->pszCurrFName, iFlags | O_LARGEFILE, pThis->tOpenMode);
+#ifdef O_DIRECT
+	if(pThis->bDirectIO) {
+		/* we write at explicit (aligned) offsets, so O_APPEND must not be used.
+		 * We also need to read back a partial last block, see dioInit().
+		 */
+		pThis->fd = open((char*)pThis->pszCurrFName,
+			(iFlags & ~(O_APPEND | O_WRONLY)) | O_RDWR | O_DIRECT | O_LARGEFILE, pThis->tOpenMode);
+		if(pThis->fd == -1 && errno == EINVAL) {
+			LogMsg(0, RS_RET_OK, LOG_WARNING, "file '%s': file system does not "
+				"support direct I/O, using regular writes", pThis->pszCurrFName);
+			pThis->bDirectIO = 0;
+		}
+	}
+	if(!pThis->bDirectIO)
+#endif
+		pThis->fd = open((char*)pThis->pszCurrFName, iFlags | O_LARGEFILE, pThis->tOpenMode);
 	const int errno_save = errno; /* dbgprintf can mangle it! */
 	DBGPRINTF("file '%s' opened as #%d with mode %d\n", pThis->pszCurrFName,
 		  pThis->fd, (int) pThis->tOpenMode);
@@ -313,6 +654,11 @@ doPhysOpen(strm_t *pThis)
 		pThis->bIsTTY = 0;
 	}
 
+	pThis->iPreallocEnd = 0;
+	if(pThis->bDirectIO) {
+		CHKiRet(dioInit(pThis));
+	}
+
 	if(pThis->cryprov != NULL) {
 		CHKiRet(pThis->cryprov->OnFileOpen(pThis->cryprovData,
 		 	pThis->pszCurrFName, &pThis->cryprovFileData,
@@ -454,6 +800,44 @@ strmWaitAsyncWriterDone(strm_t *pThis)
 static void
 stopWriter(strm_t *const pThis)
 {
+	if(pThis->bUseWrPool) {
+		/* we have no thread to stop, but we must make sure that the pool
+		 * is done with us and no longer knows about us.
+		 */
+		strmWaitAsyncWriterDone(pThis);
+		pthread_mutex_lock(&wrPool.mut);
+		while(pThis->wrPoolState != STRM_WRPOOL_IDLE) {
+			if(pThis->wrPoolState == STRM_WRPOOL_QUEUED) {
+				/* only a flush timeout can have queued us, just drop it */
+				strm_t *pPrev = NULL;
+				strm_t *p = wrPool.pRunHead;
+				while(p != pThis) {
+					pPrev = p;
+					p = p->pWrPoolNext;
+				}
+				if(pPrev == NULL)
+					wrPool.pRunHead = pThis->pWrPoolNext;
+				else
+					pPrev->pWrPoolNext = pThis->pWrPoolNext;
+				if(wrPool.pRunTail == pThis)
+					wrPool.pRunTail = pPrev;
+				pThis->wrPoolState = STRM_WRPOOL_IDLE;
+			} else {
+				pthread_mutex_unlock(&wrPool.mut);
+				d_pthread_cond_wait(&pThis->isEmpty, &pThis->mut);
+				pthread_mutex_lock(&wrPool.mut);
+			}
+		}
+		if(pThis->pWrPoolAllPrev == NULL)
+			wrPool.pAll = pThis->pWrPoolAllNext;
+		else
+			pThis->pWrPoolAllPrev->pWrPoolAllNext = pThis->pWrPoolAllNext;
+		if(pThis->pWrPoolAllNext != NULL)
+			pThis->pWrPoolAllNext->pWrPoolAllPrev = pThis->pWrPoolAllPrev;
+		pthread_mutex_unlock(&wrPool.mut);
+		d_pthread_mutex_unlock(&pThis->mut);
+		return;
+	}
 	pThis->bStopWriter = 1;
 	pthread_cond_signal(&pThis->notEmpty);
 	d_pthread_mutex_unlock(&pThis->mut);
@@ -485,7 +869,7 @@ static rsRetVal strmCloseFile(strm_t *pThis)
 		}
 		strmFlushInternal(pThis, 0);
 		if(pThis->iZipLevel) {
-			doZipFinish(pThis);
+			doCompressFinish(pThis);
 		}
 		if(pThis->bAsyncWrite) {
 			stopWriter(pThis);
@@ -510,7 +894,11 @@ static rsRetVal strmCloseFile(strm_t *pThis)
 	if(pThis->fd != -1) {
 		DBGOPRINT((obj_t*) pThis, "file %d(%s) closing\n",
 			pThis->fd, getFileDebugName(pThis));
+		if(pThis->bDirectIO)
+			dioWriteTail(pThis, 0); /* errors are reported inside */
 		currOffs = lseek64(pThis->fd, 0, SEEK_CUR);
+		if(pThis->iPreallocEnd > 0)
+			releasePrealloc(pThis);
 		close(pThis->fd);
 		pThis->fd = -1;
 		pThis->inode = 0;
@@ -904,6 +1292,19 @@ strmReadLine(strm_t *const pThis, cstr_t **ppCStr, uint8_t mode, sbool bEscapeLF
 	if(mode == 0) {
 		while(c != '\n') {
 			CHKiRet(cstrAppendChar(*ppCStr, c));
+			/* bulk-append the rest of the line as far as it is in the buffer;
+			 * memchr() is vectorized by libc, so this is far cheaper than
+			 * going through strmReadChar() for each octet.
+			 */
+			const uchar *const pBuf = pThis->pIOBuf + pThis->iBufPtr;
+			const size_t lenAvail = pThis->iBufPtrMax - pThis->iBufPtr;
+			const uchar *const pLF = (lenAvail == 0) ? NULL : memchr(pBuf, '\n', lenAvail);
+			const size_t lenSeg = (pLF == NULL) ? lenAvail : (size_t) (pLF - pBuf);
+			if(lenSeg > 0) {
+				CHKiRet(rsCStrAppendStrWithLen(*ppCStr, pBuf, lenSeg));
+				pThis->iBufPtr += lenSeg;
+				pThis->iCurrOffs += lenSeg;
+			}
 			CHKiRet(strmReadChar(pThis, &c));
 		}
 		if (trimLineOverBytes > 0 && (uint32_t) cstrLen(*ppCStr) > trimLineOverBytes) {
@@ -1034,6 +1435,67 @@ finalize_it:
 	RETiRet;
 }
 
+/* read a single LF-terminated line (ReadLine mode 0) without copying it, if
+ * possible. If the complete line is inside the read buffer, *ppLine points to
+ * it and *ppCStr is set to NULL. The pointer is only valid until the next read
+ * operation on the stream. If the line spans buffers (or there is some state
+ * left over from a previous read), we fall back to strmReadLine() and return
+ * the line in *ppCStr, with *ppLine set to NULL. In both cases *pLenLine
+ * receives the line length. The caller must destruct *ppCStr if set.
+ */
+static rsRetVal ATTR_NONNULL(1, 2, 3, 4)
+strmReadLineDirect(strm_t *const pThis, cstr_t **ppCStr, const uchar **ppLine, size_t *pLenLine,
+	uint32_t trimLineOverBytes, int64 *const strtOffs)
+{
+	int padBytes = 0;
+	DEFiRet;
+
+	*ppCStr = NULL;
+	*ppLine = NULL;
+	*pLenLine = 0;
+
+	if(pThis->iUngetC == -1 && pThis->prevLineSegment == NULL) {
+		if(pThis->iBufPtr >= pThis->iBufPtrMax) {
+			CHKiRet(strmReadBuf(pThis, &padBytes));
+			pThis->iCurrOffs += padBytes;
+		}
+		const uchar *const pBuf = pThis->pIOBuf + pThis->iBufPtr;
+		const uchar *const pLF = memchr(pBuf, '\n', pThis->iBufPtrMax - pThis->iBufPtr);
+		if(pLF != NULL) {
+			size_t lenLine = pLF - pBuf;
+			pThis->iBufPtr += lenLine + 1;
+			pThis->iCurrOffs += lenLine + 1;
+			if(strtOffs != NULL) {
+				*strtOffs = pThis->strtOffs;
+			}
+			pThis->strtOffs = pThis->iCurrOffs; /* we are at begin of next line */
+			if(trimLineOverBytes > 0 && lenLine > trimLineOverBytes) {
+				/* keep semantics of strmReadLine(): truncate and append LF */
+				dbgprintf("Truncate long line at %u, mode 0\n", trimLineOverBytes);
+				CHKiRet(cstrConstruct(ppCStr));
+				CHKiRet(rsCStrAppendStrWithLen(*ppCStr, pBuf, trimLineOverBytes));
+				CHKiRet(cstrAppendChar(*ppCStr, '\n'));
+				cstrFinalize(*ppCStr);
+				*pLenLine = cstrLen(*ppCStr);
+			} else {
+				*ppLine = pBuf;
+				*pLenLine = lenLine;
+			}
+			FINALIZE;
+		}
+	}
+
+	/* line not completely available - use the regular (copying) reader */
+	CHKiRet(strmReadLine(pThis, ppCStr, 0, 0, NULL, trimLineOverBytes, strtOffs));
+	*pLenLine = cstrLen(*ppCStr);
+
+finalize_it:
+	if(iRet != RS_RET_OK && *ppCStr != NULL) {
+		cstrDestruct(ppCStr);
+	}
+	RETiRet;
+}
+
 /* check if the current multi line read is timed out
  * @return 0 - no timeout, something else - timeout
  */
@@ -1218,6 +1680,7 @@ BEGINobjConstruct(strm) /* be sure to specify the object type also in END macro!
 	pThis->fdDir = -1;
 	pThis->iUngetC = -1;
 	pThis->bVeryReliableZip = 0;
+	pThis->compressionDriver = STRM_COMPRESS_ZIP;
 	pThis->sType = STREAMTYPE_FILE_SINGLE;
 	pThis->sIOBufSize = glblGetIOBufSize();
 	pThis->tOpenMode = 0600;
@@ -1233,6 +1696,22 @@ BEGINobjConstruct(strm) /* be sure to specify the object type also in END macro!
 ENDobjConstruct(strm)
 
 
+/* allocate an io buffer. In direct I/O mode, buffers must be aligned so that
+ * they can be handed to the OS without copying them first.
+ */
+static uchar *
+allocIOBuf(const strm_t *const pThis, const size_t lenBuf)
+{
+	void *pBuf;
+
+	if(!pThis->bDirectIO)
+		return (uchar*) malloc(lenBuf);
+	if(posix_memalign(&pBuf, STRM_DIO_ALIGN, lenBuf) != 0)
+		return NULL;
+	return (uchar*) pBuf;
+}
+
+
 /* ConstructionFinalizer
  * rgerhards, 2008-01-09
  */
@@ -1245,7 +1724,56 @@ static rsRetVal strmConstructFinalize(strm_t *pThis)
 	assert(pThis != NULL);
 
 	pThis->iBufPtrMax = 0; /* results in immediate read request */
-	if(pThis->iZipLevel) { /* do we need a zip buf? */
+
+	if(pThis->bDirectIO) {
+#ifdef O_DIRECT
+		const char *reason = NULL;
+		if(pThis->iZipLevel || pThis->cryprov != NULL) {
+			reason = "together with compression or encryption";
+		} else if(pThis->sType != STREAMTYPE_FILE_SINGLE) {
+			reason = "for this stream type";
+		} else if(pThis->tOperationsMode != STREAMMODE_WRITE_APPEND
+		          && pThis->tOperationsMode != STREAMMODE_WRITE_TRUNC) {
+			reason = "for streams that are not write-only";
+		}
+		if(reason != NULL) {
+			LogMsg(0, RS_RET_OK, LOG_WARNING, "stream %s: direct I/O is not supported "
+				"%s, using regular writes", getFileDebugName(pThis), reason);
+			pThis->bDirectIO = 0;
+		} else {
+			pThis->sIOBufSize = (pThis->sIOBufSize + STRM_DIO_ALIGN - 1) & ~(STRM_DIO_ALIGN - 1);
+			CHKmalloc(pThis->pDioBuf = allocIOBuf(pThis, pThis->sIOBufSize + 2 * STRM_DIO_ALIGN));
+		}
+#else
+		LogMsg(0, RS_RET_OK, LOG_WARNING, "stream %s: direct I/O is not supported "
+			"on this platform, using regular writes", getFileDebugName(pThis));
+		pThis->bDirectIO = 0;
+#endif
+	}
+
+#if !defined(HAVE_FALLOCATE) || !defined(FALLOC_FL_KEEP_SIZE)
+	if(pThis->iPreallocSize > 0) {
+		LogMsg(0, RS_RET_OK, LOG_WARNING, "stream %s: preallocation is not "
+			"supported on this platform, ignored", getFileDebugName(pThis));
+		pThis->iPreallocSize = 0;
+	}
+#endif
+
+	if(pThis->iZipLevel && pThis->compressionDriver != STRM_COMPRESS_ZIP) {
+		/* zstd and lz4 drivers keep their buffers inside their own state */
+		if(pThis->compressionDriver == STRM_COMPRESS_ZSTD)
+			localRet = objUse(zstdw, LM_ZSTDW_FILENAME);
+		else
+			localRet = objUse(lz4w, LM_LZ4W_FILENAME);
+		if(localRet != RS_RET_OK) {
+			LogError(0, localRet, "stream %s: %s compression requested, but %s module "
+				"unavailable - writing uncompressed", getFileDebugName(pThis),
+				pThis->compressionDriver == STRM_COMPRESS_ZSTD ? "zstd" : "lz4",
+				pThis->compressionDriver == STRM_COMPRESS_ZSTD ? LM_ZSTDW_FILENAME
+									       : LM_LZ4W_FILENAME);
+			pThis->iZipLevel = 0;
+		}
+	} else if(pThis->iZipLevel) { /* do we need a zip buf? */
 		localRet = objUse(zlibw, LM_ZLIBW_FILENAME);
 		if(localRet != RS_RET_OK) {
 			pThis->iZipLevel = 0;
@@ -1289,17 +1817,19 @@ static rsRetVal strmConstructFinalize(strm_t *pThis)
 		pthread_cond_init(&pThis->isEmpty, 0);
 		pThis->iCnt = pThis->iEnq = pThis->iDeq = 0;
 		for(i = 0 ; i < STREAM_ASYNC_NUMBUFS ; ++i) {
-			CHKmalloc(pThis->asyncBuf[i].pBuf = (uchar*) malloc(pThis->sIOBufSize));
+			CHKmalloc(pThis->asyncBuf[i].pBuf = allocIOBuf(pThis, pThis->sIOBufSize));
 		}
 		pThis->pIOBuf = pThis->asyncBuf[0].pBuf;
 		pThis->bStopWriter = 0;
-		if(pthread_create(&pThis->writerThreadID,
+		if(GetStreamWriterThreads() > 0 && wrPoolRegister(pThis) == RS_RET_OK) {
+			DBGPRINTF("stream %s: using shared writer pool\n", getFileDebugName(pThis));
+		} else if(pthread_create(&pThis->writerThreadID,
 			    	  &default_thread_attr,
 				  asyncWriterThread, pThis) != 0)
 			DBGPRINTF("ERROR: stream %p cold not create writer thread\n", pThis);
 	} else {
 		/* we work synchronously, so we need to alloc a fixed pIOBuf */
-		CHKmalloc(pThis->pIOBuf = (uchar*) malloc(pThis->sIOBufSize));
+		CHKmalloc(pThis->pIOBuf = allocIOBuf(pThis, pThis->sIOBufSize));
 		CHKmalloc(pThis->pIOBuf_truncation = (char*) malloc(pThis->sIOBufSize));
 	}
 
@@ -1343,8 +1873,15 @@ CODESTARTobjDestruct(strm)
 		cstrDestruct(&pThis->prevLineSegment);
 	if(pThis->prevMsgSegment)
 		cstrDestruct(&pThis->prevMsgSegment);
+	if(pThis->compressionCtx != NULL) {
+		if(pThis->compressionDriver == STRM_COMPRESS_ZSTD)
+			zstdw.Destruct(pThis);
+		else
+			lz4w.Destruct(pThis);
+	}
 	free(pThis->pszDir);
 	free(pThis->pZipBuf);
+	free(pThis->pDioBuf);
 	free(pThis->pszCurrFName);
 	free(pThis->pszFName);
 	free(pThis->pszSizeLimitCmd);
@@ -1511,10 +2048,23 @@ doWriteInternal(strm_t *pThis, uchar *pBuf, const size_t lenBuf, const int bFlus
 		pThis->fd, getFileDebugName(pThis), bFlush);
 
 	if(pThis->iZipLevel) {
-		CHKiRet(doZipWrite(pThis, pBuf, lenBuf, bFlush));
+		switch(pThis->compressionDriver) {
+		case STRM_COMPRESS_ZSTD:
+			CHKiRet(zstdw.DoStrmWrite(pThis, pBuf, lenBuf, bFlush, strmPhysWrite));
+			break;
+		case STRM_COMPRESS_LZ4:
+			CHKiRet(lz4w.DoStrmWrite(pThis, pBuf, lenBuf, bFlush, strmPhysWrite));
+			break;
+		case STRM_COMPRESS_ZIP:
+		default:
+			CHKiRet(doZipWrite(pThis, pBuf, lenBuf, bFlush));
+			break;
+		}
 	} else {
 		/* write without zipping */
 		CHKiRet(strmPhysWrite(pThis, pBuf, lenBuf));
+		if(bFlush && pThis->bDirectIO)
+			CHKiRet(dioWriteTail(pThis, 1));
 	}
 
 finalize_it:
@@ -1551,7 +2101,10 @@ doAsyncWriteInternal(strm_t *pThis, size_t lenBuf, const int bFlushZip)
 
 	pThis->bDoTimedWait = 0; /* everything written, no need to timeout partial buffer writes */
 	if(++pThis->iCnt == 1) {
-		pthread_cond_signal(&pThis->notEmpty);
+		if(pThis->bUseWrPool)
+			wrPoolSchedule(pThis);
+		else
+			pthread_cond_signal(&pThis->notEmpty);
 		DBGOPRINT((obj_t*) pThis, "doAsyncWriteInternal signaled notEmpty\n");
 	}
 	DBGOPRINT((obj_t*) pThis, "file %d(%s) doAsyncWriteInternal at exit: "
@@ -1687,6 +2240,196 @@ finalize_it:
 }
 
 
+/* add a stream to the writer pool run queue. Pool mutex must be locked. */
+static void
+wrPoolEnqueue(strm_t *const pThis)
+{
+	pThis->pWrPoolNext = NULL;
+	if(wrPool.pRunTail == NULL)
+		wrPool.pRunHead = pThis;
+	else
+		wrPool.pRunTail->pWrPoolNext = pThis;
+	wrPool.pRunTail = pThis;
+	pThis->wrPoolState = STRM_WRPOOL_QUEUED;
+	pthread_cond_signal(&wrPool.wakeup);
+}
+
+
+/* tell the pool that a stream has work. Stream mutex must be locked. */
+static void
+wrPoolSchedule(strm_t *const pThis)
+{
+	pthread_mutex_lock(&wrPool.mut);
+	if(pThis->wrPoolState == STRM_WRPOOL_IDLE)
+		wrPoolEnqueue(pThis);
+	pthread_mutex_unlock(&wrPool.mut);
+}
+
+
+/* queue all streams whose flush interval has expired. This replaces the
+ * timed wait of the per-stream writer thread. Pool mutex must be locked.
+ */
+static void
+wrPoolChkFlushTimeouts(const time_t tNow)
+{
+	strm_t *pThis;
+
+	for(pThis = wrPool.pAll ; pThis != NULL ; pThis = pThis->pWrPoolAllNext) {
+		if(pThis->tWrPoolFlushDue != 0 && pThis->tWrPoolFlushDue <= tNow) {
+			pThis->tWrPoolFlushDue = 0;
+			pThis->bWrPoolTimedOut = 1;
+			if(pThis->wrPoolState == STRM_WRPOOL_IDLE)
+				wrPoolEnqueue(pThis);
+		}
+	}
+}
+
+
+/* write out everything a stream has pending. This is the pool equivalent of
+ * one asyncWriterThread() run. Called without any mutex held.
+ */
+static void
+wrPoolProcessStrm(strm_t *const pThis)
+{
+	int iDeq;
+	sbool bTimedOut;
+
+	d_pthread_mutex_lock(&pThis->mut);
+	while(1) {
+		if(pThis->iCnt > 0) {
+			iDeq = pThis->iDeq++ % STREAM_ASYNC_NUMBUFS;
+			const int bFlush = pThis->bFlushNow;
+			pThis->bFlushNow = 0;
+			d_pthread_mutex_unlock(&pThis->mut);
+			doWriteInternal(pThis, pThis->asyncBuf[iDeq].pBuf, pThis->asyncBuf[iDeq].lenBuf, bFlush);
+			d_pthread_mutex_lock(&pThis->mut);
+			--pThis->iCnt;
+			pthread_cond_signal(&pThis->notFull);
+			if(pThis->iCnt == 0)
+				pthread_cond_broadcast(&pThis->isEmpty);
+			continue;
+		}
+		pthread_mutex_lock(&wrPool.mut);
+		bTimedOut = pThis->bWrPoolTimedOut;
+		pThis->bWrPoolTimedOut = 0;
+		if(!bTimedOut)
+			pThis->wrPoolState = STRM_WRPOOL_IDLE;
+		pthread_mutex_unlock(&wrPool.mut);
+		if(!bTimedOut)
+			break;
+		if(pThis->iBufPtr > 0) {
+			/* this hands the partial buffer over, so we loop to write it */
+			strmFlushInternal(pThis, 1);
+		}
+	}
+	/* stopWriter() may wait for us to go idle */
+	pthread_cond_broadcast(&pThis->isEmpty);
+	d_pthread_mutex_unlock(&pThis->mut);
+}
+
+
+/* the writer pool thread */
+static void *
+wrPoolThrd(void __attribute__((unused)) *pArg)
+{
+	strm_t *pThis;
+	struct timespec t;
+	time_t tNow;
+
+	dbgOutputTID((char*)"rs:strmwr");
+#	if defined(HAVE_PRCTL) && defined(PR_SET_NAME)
+	if(prctl(PR_SET_NAME, "rs:strmwr", 0, 0, 0) != 0) {
+		DBGPRINTF("prctl failed, not setting thread name for '%s'\n", "stream writer pool");
+	}
+#	endif
+
+	pthread_mutex_lock(&wrPool.mut);
+	while(!wrPool.bStop) {
+		tNow = getTime(NULL);
+		if(tNow >= wrPool.tNextSweep) {
+			wrPoolChkFlushTimeouts(tNow);
+			wrPool.tNextSweep = tNow + 1;
+		}
+		if(wrPool.pRunHead == NULL) {
+			timeoutComp(&t, 1000); /* flush intervals are in seconds */
+			pthread_cond_timedwait(&wrPool.wakeup, &wrPool.mut, &t);
+			continue;
+		}
+		pThis = wrPool.pRunHead;
+		wrPool.pRunHead = pThis->pWrPoolNext;
+		if(wrPool.pRunHead == NULL)
+			wrPool.pRunTail = NULL;
+		pThis->wrPoolState = STRM_WRPOOL_ACTIVE;
+		pthread_mutex_unlock(&wrPool.mut);
+		wrPoolProcessStrm(pThis);
+		pthread_mutex_lock(&wrPool.mut);
+	}
+	pthread_mutex_unlock(&wrPool.mut);
+	return NULL;
+}
+
+
+/* make a stream use the writer pool. The pool threads are started on first
+ * use. If no thread can be started, we return an error and the caller uses
+ * a dedicated writer thread instead.
+ */
+static rsRetVal
+wrPoolRegister(strm_t *const pThis)
+{
+	const int nThrds = GetStreamWriterThreads();
+	int r;
+	DEFiRet;
+
+	pthread_mutex_lock(&wrPool.mut);
+	if(wrPool.thrds == NULL) {
+		CHKmalloc(wrPool.thrds = calloc(nThrds, sizeof(pthread_t)));
+		while(wrPool.nThrds < nThrds) {
+			r = pthread_create(&wrPool.thrds[wrPool.nThrds], &default_thread_attr,
+				wrPoolThrd, NULL);
+			if(r != 0) {
+				LogError(r, RS_RET_ERR, "stream: could only start %d of %d "
+					"writer pool threads", wrPool.nThrds, nThrds);
+				break;
+			}
+			++wrPool.nThrds;
+		}
+	}
+	if(wrPool.nThrds == 0)
+		ABORT_FINALIZE(RS_RET_ERR);
+
+	pThis->bUseWrPool = 1;
+	pThis->wrPoolState = STRM_WRPOOL_IDLE;
+	pThis->pWrPoolAllPrev = NULL;
+	pThis->pWrPoolAllNext = wrPool.pAll;
+	if(wrPool.pAll != NULL)
+		wrPool.pAll->pWrPoolAllPrev = pThis;
+	wrPool.pAll = pThis;
+
+finalize_it:
+	pthread_mutex_unlock(&wrPool.mut);
+	RETiRet;
+}
+
+
+/* stop the writer pool threads. All streams must already be destructed. */
+void
+strmWrPoolExit(void)
+{
+	int i;
+
+	pthread_mutex_lock(&wrPool.mut);
+	wrPool.bStop = 1;
+	pthread_cond_broadcast(&wrPool.wakeup);
+	pthread_mutex_unlock(&wrPool.mut);
+	for(i = 0 ; i < wrPool.nThrds ; ++i)
+		pthread_join(wrPool.thrds[i], NULL);
+	free(wrPool.thrds);
+	wrPool.thrds = NULL;
+	wrPool.nThrds = 0;
+	wrPool.bStop = 0;
+}
+
+
 /* sync the file to disk, so that any unwritten data is persisted. This
  * also syncs the directory and thus makes sure that the file survives
  * fatal failure. Note that we do NOT return an error status if the
@@ -1752,8 +2495,15 @@ strmPhysWrite(strm_t *pThis, uchar *pBuf, size_t lenBuf)
 	}
 	/* end crypto */
 
+	if(pThis->iPreallocSize > 0)
+		preallocate(pThis, lenBuf);
+
 	iWritten = lenBuf;
-	CHKiRet(doWriteCall(pThis, pBuf, &iWritten));
+	if(pThis->bDirectIO) {
+		CHKiRet(dioWrite(pThis, pBuf, lenBuf));
+	} else {
+		CHKiRet(doWriteCall(pThis, pBuf, &iWritten));
+	}
 
 	pThis->iCurrOffs += iWritten;
 	/* update user counter, if provided */
@@ -1761,9 +2511,14 @@ strmPhysWrite(strm_t *pThis, uchar *pBuf, size_t lenBuf)
 		*pThis->pUsrWCntr += iWritten;
 
 	if(pThis->bSync) {
+		if(pThis->bDirectIO)
+			CHKiRet(dioWriteTail(pThis, 1));
 		CHKiRet(syncFile(pThis));
 	}
 
+	if(pThis->bDropCache)
+		dropCache(pThis);
+
 	if(pThis->sType == STREAMTYPE_FILE_CIRCULAR) {
 		CHKiRet(strmCheckNextOutputFile(pThis));
 	} else if(pThis->iSizeLimit != 0) {
@@ -1879,6 +2634,30 @@ finalize_it:
 done:	RETiRet;
 }
 
+
+/* finish the compressed output of the configured driver, to be called
+ * before closing the file.
+ */
+static rsRetVal
+doCompressFinish(strm_t *pThis)
+{
+	DEFiRet;
+
+	switch(pThis->compressionDriver) {
+	case STRM_COMPRESS_ZSTD:
+		iRet = zstdw.DoCompressFinish(pThis, strmPhysWrite);
+		break;
+	case STRM_COMPRESS_LZ4:
+		iRet = lz4w.DoCompressFinish(pThis, strmPhysWrite);
+		break;
+	case STRM_COMPRESS_ZIP:
+	default:
+		iRet = doZipFinish(pThis);
+		break;
+	}
+	RETiRet;
+}
+
 /* flush stream output buffer to persistent storage. This can be called at any time
  * and is automatically called when the output buffer is full.
  * rgerhards, 2008-01-10
@@ -1895,6 +2674,12 @@ strmFlushInternal(strm_t *pThis, int bFlushZip)
 
 	if(pThis->tOperationsMode != STREAMMODE_READ && pThis->iBufPtr > 0) {
 		iRet = strmSchedWrite(pThis, pThis->pIOBuf, pThis->iBufPtr, bFlushZip);
+	} else if(bFlushZip && pThis->bDirectIO && pThis->fd != -1) {
+		/* nothing buffered, but the partial last block of an earlier write
+		 * may still be pending. Once the writer is done, no one else writes.
+		 */
+		strmWaitAsyncWriterDone(pThis);
+		iRet = dioWriteTail(pThis, 1);
 	}
 
 	RETiRet;
@@ -2159,7 +2944,13 @@ finalize_it:
 			 * writer thread that it can set and pick up timeouts.
 			 */
 			pThis->bDoTimedWait = 1;
-			pthread_cond_signal(&pThis->notEmpty);
+			if(pThis->bUseWrPool) {
+				pthread_mutex_lock(&wrPool.mut);
+				pThis->tWrPoolFlushDue = getTime(NULL) + pThis->iFlushInterval;
+				pthread_mutex_unlock(&wrPool.mut);
+			} else {
+				pthread_cond_signal(&pThis->notEmpty);
+			}
 		}
 		d_pthread_mutex_unlock(&pThis->mut);
 	}
@@ -2168,6 +2959,91 @@ finalize_it:
 }
 
 
+/* write a set of buffers to the stream. For plain, synchronously written
+ * single files this is done via a gather write directly from the caller's
+ * buffers, so the data does not need to be copied into the stream's output
+ * buffer first. Anything already buffered is flushed before, so ordering is
+ * preserved. All other stream configurations (compression, encryption,
+ * async writer, circular files, ttys) fall back to regular strmWrite().
+ * Note that the data is on its way to the OS when this function returns,
+ * so callers should use it only if they would flush at this point anyhow.
+ */
+static rsRetVal
+strmWriteV(strm_t *__restrict__ const pThis, const struct iovec *__restrict__ const iov, const int iovcnt)
+{
+	int i;
+	int n;
+	ssize_t iWritten;
+	size_t lenWr;
+	DEFiRet;
+	ISOBJ_TYPE_assert(pThis, strm);
+
+	if(pThis->bDisabled)
+		ABORT_FINALIZE(RS_RET_STREAM_DISABLED);
+
+	if(pThis->iZipLevel || pThis->cryprov != NULL || pThis->bAsyncWrite || pThis->bDirectIO
+	   || pThis->sType != STREAMTYPE_FILE_SINGLE || pThis->bIsTTY) {
+		for(i = 0 ; i < iovcnt ; ++i) {
+			CHKiRet(strmWrite(pThis, iov[i].iov_base, iov[i].iov_len));
+		}
+		FINALIZE;
+	}
+
+	if(pThis->iBufPtr > 0)
+		CHKiRet(strmFlushInternal(pThis, 0));
+	if(pThis->fd == -1)
+		CHKiRet(strmOpenFile(pThis));
+
+	if(pThis->iPreallocSize > 0) {
+		lenWr = 0;
+		for(i = 0 ; i < iovcnt ; ++i)
+			lenWr += iov[i].iov_len;
+		preallocate(pThis, lenWr);
+	}
+
+	i = 0;
+	while(i < iovcnt) {
+		n = (iovcnt - i > IOV_MAX) ? IOV_MAX : iovcnt - i;
+		iWritten = writev(pThis->fd, iov + i, n);
+		if(iWritten < 0) {
+			if(errno == EINTR)
+				continue;
+			/* let the regular write path do error reporting and recovery */
+			lenWr = iov[i].iov_len;
+			CHKiRet(doWriteCall(pThis, iov[i].iov_base, &lenWr));
+			iWritten = lenWr;
+		}
+		pThis->iCurrOffs += iWritten;
+		if(pThis->pUsrWCntr != NULL)
+			*pThis->pUsrWCntr += iWritten;
+		while(i < iovcnt && (size_t) iWritten >= iov[i].iov_len) {
+			iWritten -= iov[i].iov_len;
+			++i;
+		}
+		if(iWritten > 0) { /* partial write - complete this element */
+			lenWr = iov[i].iov_len - iWritten;
+			CHKiRet(doWriteCall(pThis, (uchar*) iov[i].iov_base + iWritten, &lenWr));
+			pThis->iCurrOffs += lenWr;
+			if(pThis->pUsrWCntr != NULL)
+				*pThis->pUsrWCntr += lenWr;
+			++i;
+		}
+	}
+
+	if(pThis->bSync) {
+		CHKiRet(syncFile(pThis));
+	}
+	if(pThis->bDropCache)
+		dropCache(pThis);
+	if(pThis->iSizeLimit != 0) {
+		CHKiRet(doSizeLimitProcessing(pThis));
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
 /* property set methods */
 /* simple ones first */
 DEFpropSetMeth(strm, iMaxFileSize, int64)
@@ -2185,6 +3061,11 @@ DEFpropSetMeth(strm, iFlushInterval, int)
 DEFpropSetMeth(strm, pszSizeLimitCmd, uchar*)
 DEFpropSetMeth(strm, cryprov, cryprov_if_t*)
 DEFpropSetMeth(strm, cryprovData, void*)
+DEFpropSetMeth(strm, compressionDriver, strm_compressionDriver_t)
+DEFpropSetMeth(strm, iCompressionWorkers, int)
+DEFpropSetMeth(strm, iPreallocSize, off_t)
+DEFpropSetMeth(strm, bDirectIO, int)
+DEFpropSetMeth(strm, bDropCache, int)
 
 /* sets timeout in seconds */
 void ATTR_NONNULL()
@@ -2555,6 +3436,8 @@ CODESTARTobjQueryInterface(strm)
 	pIf->Write = strmWrite;
 	pIf->WriteChar = strmWriteChar;
 	pIf->WriteLong = strmWriteLong;
+	pIf->WriteV = strmWriteV;
+	pIf->ReadLineDirect = strmReadLineDirect;
 	pIf->SetFName = strmSetFName;
 	pIf->SetFileNotFoundError = strmSetFileNotFoundError;
 	pIf->SetDir = strmSetDir;
@@ -2584,6 +3467,11 @@ CODESTARTobjQueryInterface(strm)
 	pIf->SetpszSizeLimitCmd = strmSetpszSizeLimitCmd;
 	pIf->Setcryprov = strmSetcryprov;
 	pIf->SetcryprovData = strmSetcryprovData;
+	pIf->SetcompressionDriver = strmSetcompressionDriver;
+	pIf->SetiCompressionWorkers = strmSetiCompressionWorkers;
+	pIf->SetiPreallocSize = strmSetiPreallocSize;
+	pIf->SetbDirectIO = strmSetbDirectIO;
+	pIf->SetbDropCache = strmSetbDropCache;
 finalize_it:
 ENDobjQueryInterface(strm)
 
@@ -69,6 +69,7 @@
 #include <pthread.h>
 #include <stdint.h>
 #include <time.h>
+#include <sys/uio.h>
 #include "obj-types.h"
 #include "glbl.h"
 #include "stream.h"
@@ -95,6 +96,13 @@ typedef enum {				/* when extending, do NOT change existing modes! */
 #define	STRM_ROTATION_DO_CHECK		0
 #define	STRM_ROTATION_DO_NOT_CHECK	1
 
+/* compression drivers, used if iZipLevel is non-zero */
+typedef enum {
+	STRM_COMPRESS_ZIP = 0,	/**< gzip via zlibw (the default) */
+	STRM_COMPRESS_ZSTD = 1,	/**< zstd via zstdw */
+	STRM_COMPRESS_LZ4 = 2	/**< lz4 frame format via lz4w */
+} strm_compressionDriver_t;
+
 #define STREAM_ASYNC_NUMBUFS 2 /* must be a power of 2 -- TODO: make configurable */
 /* The strm_t data structure */
 typedef struct strm_s {
@@ -155,11 +163,31 @@ typedef struct strm_s {
 	void 	*cryprovFileData;/* opaque data ptr for file instance */
 	short iCnt;	/* current nbr of elements in buffer */
 	z_stream zstrm;	/* zip stream to use */
+	strm_compressionDriver_t compressionDriver;
+	int iCompressionWorkers; /* zstd only: nbr of compression threads, 0 = compress in caller */
+	void *compressionCtx;	/* opaque state of the zstd/lz4 driver, NULL if not yet initialized */
 	struct {
 		uchar *pBuf;
 		size_t lenBuf;
 	} asyncBuf[STREAM_ASYNC_NUMBUFS];
 	pthread_t writerThreadID;
+	/* support for the shared writer pool, used instead of writerThreadID if configured */
+	sbool bUseWrPool;	/* is this stream served by the shared writer pool? */
+	sbool bWrPoolTimedOut;	/* flush interval expired, partial buffer needs to be written */
+	int wrPoolState;	/* STRM_WRPOOL_* - protected by the pool mutex */
+	time_t tWrPoolFlushDue;	/* when partial buffer must be flushed, 0 if nothing pending */
+	struct strm_s *pWrPoolNext;	/* pool run queue link */
+	struct strm_s *pWrPoolAllPrev;	/* list of all pool streams (for flush timeouts) */
+	struct strm_s *pWrPoolAllNext;
+	/* write-once archive support: preallocation, direct I/O and cache dropping */
+	off_t	iPreallocSize;	/* preallocate file space in extents of this size, 0 = off */
+	off_t	iPreallocEnd;	/* file offset up to which space has been preallocated */
+	sbool	bDirectIO;	/* write via O_DIRECT */
+	sbool	bDropCache;	/* drop written data from page cache after each write */
+	uchar	*pDioBuf;	/* aligned staging buffer, begins with the partial last block */
+	size_t	lenDioBuf;	/* nbr of bytes of the partial last block in pDioBuf */
+	size_t	lenDioDisk;	/* nbr of those bytes already written to the file */
+	off_t	iDioOffs;	/* file offset of pDioBuf[0], always block-aligned */
 	/* support for omfile size-limiting commands, special counters, NOT persisted! */
 	off_t	iSizeLimit;	/* file size limit, 0 = no limit */
 	uchar	*pszSizeLimitCmd;	/* command to carry out when size limit is reached */
@@ -219,13 +247,29 @@ BEGINinterface(strm) /* name must also be changed in ENDinterface macro! */
 	/* v9 added  2013-04-04 */
 	INTERFACEpropSetMeth(strm, cryprov, cryprov_if_t*);
 	INTERFACEpropSetMeth(strm, cryprovData, void*);
+	/* v15 added  2026-10-18 */
+	INTERFACEpropSetMeth(strm, compressionDriver, strm_compressionDriver_t);
+	INTERFACEpropSetMeth(strm, iCompressionWorkers, int);
+	/* v16 added  2026-10-18 */
+	rsRetVal (*WriteV)(strm_t *const pThis, const struct iovec *const iov, const int iovcnt);
+	/* v17 added  2026-10-18 */
+	INTERFACEpropSetMeth(strm, iPreallocSize, off_t);
+	INTERFACEpropSetMeth(strm, bDirectIO, int);
+	INTERFACEpropSetMeth(strm, bDropCache, int);
+	/* v18 added  2026-10-18 */
+	rsRetVal (*ReadLineDirect)(strm_t *pThis, cstr_t **ppCStr, const uchar **ppLine, size_t *pLenLine,
+		uint32_t trimLineOverBytes, int64 *const strtOffs);
 ENDinterface(strm)
-#define strmCURR_IF_VERSION 14 /* increment whenever you change the interface structure! */
+#define strmCURR_IF_VERSION 18 /* increment whenever you change the interface structure! */
 /* V10, 2013-09-10: added new parameter bEscapeLF, changed mode to uint8_t (rgerhards) */
 /* V11, 2015-12-03: added new parameter bReopenOnTruncate */
 /* V12, 2015-12-11: added new parameter trimLineOverBytes, changed mode to uint32_t */
 /* V13, 2017-09-06: added new parameter strtoffs to ReadLine() */
 /* V14, 2019-11-13: added new parameter bEscapeLFString (rgerhards) */
+/* V15, 2026-10-18: added compression driver selection (zstd, lz4) */
+/* V16, 2026-10-18: added WriteV() for gather writes without buffer copy */
+/* V17, 2026-10-18: added preallocation, direct I/O and page cache dropping */
+/* V18, 2026-10-18: added ReadLineDirect() for reading lines without a copy */
 
 #define strmGetCurrFileNum(pStrm) ((pStrm)->iCurrFNum)
 
@@ -238,6 +282,7 @@ rsRetVal ATTR_NONNULL(1,2) strmReadMultiLine(strm_t *pThis, cstr_t **ppCStr, reg
 int strmReadMultiLine_isTimedOut(const strm_t *const __restrict__ pThis);
 void strmDebugOutBuf(const strm_t *const pThis);
 void strmSetReadTimeout(strm_t *const __restrict__ pThis, const int val);
+void strmWrPoolExit(void);
 const uchar * ATTR_NONNULL() strmGetPrevLineSegment(strm_t *const pThis);
 const uchar * ATTR_NONNULL() strmGetPrevMsgSegment(strm_t *const pThis);
 int ATTR_NONNULL() strmGetPrevWasNL(const strm_t *const pThis);
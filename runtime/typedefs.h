@@ -64,6 +64,9 @@ typedef struct nsdsel_ptcp_s nsdsel_ptcp_t;
 typedef struct nsdsel_gtls_s nsdsel_gtls_t;
 typedef struct nsdsel_ossl_s nsdsel_ossl_t;
 typedef struct nsdpoll_ptcp_s nsdpoll_ptcp_t;
+typedef struct nsdpoll_gtls_s nsdpoll_gtls_t;
+typedef struct nsdpoll_ossl_s nsdpoll_ossl_t;
+typedef struct nsdpoll_reg_s nsdpoll_reg_t;
 typedef struct wti_s wti_t;
 typedef struct msgPropDescr_s msgPropDescr_t;
 typedef struct msg smsg_t;
@@ -126,9 +129,14 @@ typedef uint64 qDeqID;	/* queue Dequeue order ID. 32 bits is considered dangerou
 typedef struct tcpLstnPortList_s tcpLstnPortList_t; // TODO: rename?
 typedef struct strmLstnPortList_s strmLstnPortList_t; // TODO: rename?
 typedef struct actWrkrIParams actWrkrIParams_t;
+typedef struct actPipeline_s actPipeline_t;
 typedef struct dynstats_bucket_s dynstats_bucket_t;
 typedef struct dynstats_buckets_s dynstats_buckets_t;
 typedef struct dynstats_ctr_s dynstats_ctr_t;
+typedef struct keyedratelimit_s keyedratelimit_t;
+typedef struct krl_shard_s krl_shard_t;
+typedef struct krl_key_s krl_key_t;
+typedef struct msgtrace_s msgtrace_t;
 
 /* under Solaris (actually only SPARC), we need to redefine some types
  * to be void, so that we get void* pointers. Otherwise, we will see
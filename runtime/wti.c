@@ -315,6 +315,15 @@ wtiWorkerCancelCleanup(void *arg)
 
 	DBGPRINTF("%s: cancelation cleanup handler called.\n", wtiGetDbgHdr(pThis));
 	pWtp->pfObjProcessed(pWtp->pUsr, pThis);
+	/* a cancelled worker must not leave commit threads behind, these would
+	 * use the action after it is destructed.
+	 */
+	for(int i = 0 ; i < iActionNbr ; ++i) {
+		if(pThis->actWrkrInfo[i].pPipeline != NULL) {
+			actionPipelineDestruct(pThis->actWrkrInfo[i].pPipeline, 1);
+			pThis->actWrkrInfo[i].pPipeline = NULL;
+		}
+	}
 	DBGPRINTF("%s: done cancelation cleanup handler.\n", wtiGetDbgHdr(pThis));
 	
 }
@@ -369,6 +378,45 @@ doIdleProcessing(wti_t *const pThis, wtp_t *const pWtp, int *const pbInactivityT
 }
 
 
+/* free this thread's worker instance of action number iAct (if it has one)
+ * together with the parameter cache. It is re-created on next use. The
+ * caller must ensure that the action is currently not being processed by
+ * this worker.
+ */
+void ATTR_NONNULL()
+wtiFreeActWrkrInfo(wti_t *const pThis, const int iAct)
+{
+	actWrkrInfo_t *const wrkrInfo = &(pThis->actWrkrInfo[iAct]);
+	action_t *const pAction = wrkrInfo->pAction;
+
+	dbgprintf("wti %p, action %d, ptr %p\n", pThis, iAct, wrkrInfo->actWrkrData);
+	if(wrkrInfo->pPipeline != NULL) {
+		/* commits all batches still in flight */
+		actionPipelineDestruct(wrkrInfo->pPipeline, 0);
+		wrkrInfo->pPipeline = NULL;
+	}
+	if(wrkrInfo->actWrkrData == NULL) {
+		/* a pipelining worker only renders, so it has no output instance,
+		 * but still owns an iparam cache.
+		 */
+		if(pAction == NULL || !pAction->isTransactional)
+			return;
+	} else {
+		actionRemoveWorker(pAction, wrkrInfo->actWrkrData);
+		pAction->pMod->mod.om.freeWrkrInstance(wrkrInfo->actWrkrData);
+	}
+	if(pAction->isTransactional) {
+		actionFreeIParams(pAction, wrkrInfo->p.tx.iparams, wrkrInfo->p.tx.maxIParams);
+		wrkrInfo->p.tx.iparams = NULL;
+		wrkrInfo->p.tx.currIParam = 0;
+		wrkrInfo->p.tx.maxIParams = 0;
+	} else {
+		releaseDoActionParams(pAction, pThis, 1);
+	}
+	wrkrInfo->actWrkrData = NULL; /* re-init for next activation */
+}
+
+
 /* generic worker thread framework. Note that we prohibit cancellation
  * during almost all times, because it can have very undesired side effects.
  * However, we may need to cancel a thread if the consumer blocks for too
@@ -381,12 +429,10 @@ rsRetVal
 wtiWorker(wti_t *__restrict__ const pThis)
 {
 	wtp_t *__restrict__ const pWtp = pThis->pWtp; /* our worker thread pool -- shortcut */
-	action_t *__restrict__ pAction;
 	rsRetVal localRet;
 	rsRetVal terminateRet;
-	actWrkrInfo_t *__restrict__ wrkrInfo;
 	int iCancelStateSave;
-	int i, j, k;
+	int i;
 	DEFiRet;
 
 	dbgSetThrdName(pThis->pszDbgHdr);
@@ -446,29 +492,7 @@ wtiWorker(wti_t *__restrict__ const pThis)
 
 	DBGPRINTF("DDDD: wti %p: worker cleanup action instances\n", pThis);
 	for(i = 0 ; i < iActionNbr ; ++i) {
-		wrkrInfo = &(pThis->actWrkrInfo[i]);
-		dbgprintf("wti %p, action %d, ptr %p\n", pThis, i, wrkrInfo->actWrkrData);
-		if(wrkrInfo->actWrkrData != NULL) {
-			pAction = wrkrInfo->pAction;
-			actionRemoveWorker(pAction, wrkrInfo->actWrkrData);
-			pAction->pMod->mod.om.freeWrkrInstance(wrkrInfo->actWrkrData);
-			if(pAction->isTransactional) {
-				/* free iparam "cache" - we need to go through to max! */
-				for(j = 0 ; j < wrkrInfo->p.tx.maxIParams ; ++j) {
-					for(k = 0 ; k < pAction->iNumTpls ; ++k) {
-						free(actParam(wrkrInfo->p.tx.iparams,
-							      pAction->iNumTpls, j, k).param);
-					}
-				}
-				free(wrkrInfo->p.tx.iparams);
-				wrkrInfo->p.tx.iparams = NULL;
-				wrkrInfo->p.tx.currIParam = 0;
-				wrkrInfo->p.tx.maxIParams = 0;
-			} else {
-				releaseDoActionParams(pAction, pThis, 1);
-			}
-			wrkrInfo->actWrkrData = NULL; /* re-init for next activation */
-		}
+		wtiFreeActWrkrInfo(pThis, i);
 	}
 
 	/* indicate termination */
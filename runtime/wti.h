@@ -48,6 +48,7 @@ typedef struct actWrkrInfo {
 				   immediate failure following */
 	int	iNbrResRtry;	/* number of retries since last suspend */
 	sbool	bHadAutoCommit;	/* did an auto-commit happen during doAction()? */
+	actPipeline_t *pPipeline; /* commit pipeline, if action.pipelinedepth is set */
 	struct {
 		unsigned actState : 3;
 	} flags;
@@ -104,6 +105,7 @@ rsRetVal wtiWakeupThrd(wti_t * const pThis);
 int wtiGetState(wti_t * const pThis);
 wti_t *wtiGetDummy(void);
 int ATTR_NONNULL() wtiWaitNonEmpty(wti_t *const pThis, const struct timespec timeout);
+void ATTR_NONNULL() wtiFreeActWrkrInfo(wti_t *const pThis, const int iAct);
 PROTOTYPEObjClassInit(wti);
 PROTOTYPEObjClassExit(wti);
 PROTOTYPEpropSetMeth(wti, pszDbgHdr, uchar*);
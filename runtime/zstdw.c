@@ -0,0 +1,196 @@
+/* The zstdwrap object.
+ *
+ * This is an rsyslog object wrapper around zstd. It implements zstd
+ * compression for file streams. Stream state and frame handling are
+ * shared with lmlz4w, see comprw.c.
+ *
+ * Copyright 2026 Adiscon GmbH.
+ *
+ * This file is part of the rsyslog runtime library.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *       http://www.apache.org/licenses/LICENSE-2.0
+ *       -or-
+ *       see COPYING.ASL20 in the source distribution
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <zstd.h>
+
+#include "rsyslog.h"
+#include "module-template.h"
+#include "obj.h"
+#include "errmsg.h"
+#include "stream.h"
+#include "comprw.h"
+#include "zstdw.h"
+
+MODULE_TYPE_LIB
+MODULE_TYPE_NOKEEP
+
+/* static data */
+DEFobjStaticHelpers
+
+/* ------------------------------ methods ------------------------------ */
+
+static void
+zstdwFreeCctx(void *const cctx)
+{
+	ZSTD_freeCCtx((ZSTD_CCtx*) cctx);
+}
+
+
+/* create the compression context on first write */
+static rsRetVal
+zstdwInit(strm_t *const pThis, comprwCtx_t *const pCtx)
+{
+	ZSTD_CCtx *cctx;
+	size_t r;
+	DEFiRet;
+
+	pCtx->lenOutBuf = ZSTD_CStreamOutSize();
+	if((pCtx->cctx = cctx = ZSTD_createCCtx()) == NULL) {
+		LogError(0, RS_RET_OUT_OF_MEMORY, "zstd: could not create compression context");
+		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
+	}
+	r = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, pThis->iZipLevel);
+	if(ZSTD_isError(r)) {
+		LogError(0, RS_RET_COMPRESSION_ERR, "zstd: cannot set compression level %d: %s",
+			pThis->iZipLevel, ZSTD_getErrorName(r));
+		ABORT_FINALIZE(RS_RET_COMPRESSION_ERR);
+	}
+	ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1);
+	if(pThis->iCompressionWorkers > 0) {
+		/* this fails if libzstd was built without multithreading support */
+		r = ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, pThis->iCompressionWorkers);
+		if(ZSTD_isError(r)) {
+			LogError(0, RS_RET_COMPRESSION_ERR, "zstd: cannot use %d compression "
+				"workers, compressing single-threaded: %s",
+				pThis->iCompressionWorkers, ZSTD_getErrorName(r));
+		}
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* run the compressor on the given input until zstd is done with the
+ * requested operation, writing all output to the file.
+ */
+static rsRetVal
+zstdwRun(strm_t *const pThis, comprwCtx_t *const pCtx, uchar *const pBuf, const size_t lenBuf,
+	const ZSTD_EndDirective mode, comprwPhysWrite_t strmPhysWrite)
+{
+	ZSTD_inBuffer in = { pBuf, lenBuf, 0 };
+	ZSTD_outBuffer out;
+	size_t remaining;
+	int bDone;
+	DEFiRet;
+
+	do {
+		out.dst = pCtx->outBuf;
+		out.size = pCtx->lenOutBuf;
+		out.pos = 0;
+		remaining = ZSTD_compressStream2((ZSTD_CCtx*) pCtx->cctx, &out, &in, mode);
+		if(ZSTD_isError(remaining)) {
+			LogError(0, RS_RET_COMPRESSION_ERR, "zstd: compression error: %s",
+				ZSTD_getErrorName(remaining));
+			ABORT_FINALIZE(RS_RET_COMPRESSION_ERR);
+		}
+		CHKiRet(comprwWriteOut(pThis, pCtx, out.pos, strmPhysWrite));
+		/* on continue, zstd may keep data internally; flush and end must be drained */
+		bDone = (mode == ZSTD_e_continue) ? (in.pos == in.size) : (remaining == 0);
+	} while(!bDone);
+
+finalize_it:
+	RETiRet;
+}
+
+
+static rsRetVal
+zstdwCompress(strm_t *const pThis, comprwCtx_t *const pCtx, uchar *const pBuf, const size_t lenBuf,
+	const int bFlush, comprwPhysWrite_t strmPhysWrite)
+{
+	return zstdwRun(pThis, pCtx, pBuf, lenBuf, bFlush ? ZSTD_e_flush : ZSTD_e_continue, strmPhysWrite);
+}
+
+
+static rsRetVal
+zstdwEnd(strm_t *const pThis, comprwCtx_t *const pCtx, comprwPhysWrite_t strmPhysWrite)
+{
+	return zstdwRun(pThis, pCtx, NULL, 0, ZSTD_e_end, strmPhysWrite);
+}
+
+
+/* zstd starts a new frame implicitly, so there is no Begin */
+static const comprwDrvr_t zstdwDrvr = {
+	zstdwInit, NULL, zstdwCompress, zstdwEnd, zstdwFreeCctx
+};
+
+
+static rsRetVal
+DoStrmWrite(strm_t *pThis, uchar *pBuf, size_t lenBuf, const int bFlush,
+	rsRetVal (*strmPhysWrite)(strm_t *pThis, uchar *pBuf, size_t lenBuf))
+{
+	return comprwWrite(pThis, &zstdwDrvr, pBuf, lenBuf, bFlush, strmPhysWrite);
+}
+
+
+/* queryInterface function
+ */
+BEGINobjQueryInterface(zstdw)
+CODESTARTobjQueryInterface(zstdw)
+	if(pIf->ifVersion != zstdwCURR_IF_VERSION) { /* check for current version, increment on each change */
+		ABORT_FINALIZE(RS_RET_INTERFACE_NOT_SUPPORTED);
+	}
+
+	pIf->DoStrmWrite = DoStrmWrite;
+	pIf->DoCompressFinish = comprwFinish;
+	pIf->Destruct = comprwDestruct;
+finalize_it:
+ENDobjQueryInterface(zstdw)
+
+
+/* Initialize the zstdw class. Must be called as the very first method
+ * before anything else is called inside this class.
+ */
+BEGINAbstractObjClassInit(zstdw, 1, OBJ_IS_LOADABLE_MODULE) /* class, version */
+	/* request objects we use */
+
+	/* set our own handlers */
+ENDObjClassInit(zstdw)
+
+
+/* --------------- here now comes the plumbing that makes as a library module --------------- */
+
+
+BEGINmodExit
+CODESTARTmodExit
+ENDmodExit
+
+
+BEGINqueryEtryPt
+CODESTARTqueryEtryPt
+CODEqueryEtryPt_STD_LIB_QUERIES
+ENDqueryEtryPt
+
+
+BEGINmodInit()
+CODESTARTmodInit
+	*ipIFVersProvided = CURR_MOD_IF_VERSION; /* we only support the current interface specification */
+
+	CHKiRet(zstdwClassInit(pModInfo));
+ENDmodInit
+/* vi:set ai:
+ */
@@ -0,0 +1,25 @@
+#!/bin/bash
+# check that shutdown does not hang while a pipelined action has batches
+# in flight and its output cannot commit them (no receiver is running)
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=5000
+generate_conf
+add_conf '
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+
+:msg, contains, "msgnum:" {
+	action(name="forwarder" type="omfwd" template="outfmt"
+		target="127.0.0.1" port="'$TCPFLOOD_PORT'" protocol="tcp"
+		action.resumeRetryCount="-1" action.resumeinterval="1"
+		action.pipelinedepth="4" queue.type="linkedList"
+		queue.dequeueBatchSize="16" queue.timeoutshutdown="500"
+		queue.timeoutactioncompletion="500")
+}
+'
+startup
+injectmsg
+./msleep 1000
+shutdown_immediate
+wait_shutdown # fails the test if rsyslogd hangs
+exit_test
@@ -0,0 +1,35 @@
+#!/bin/bash
+# check that a pipelined action keeps messages in the queue while it is
+# suspended and delivers all of them once it is resumed
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=10000
+generate_conf
+add_conf '
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+
+:msg, contains, "msgnum:" {
+	action(name="forwarder" type="omfwd" template="outfmt"
+		target="127.0.0.1" port="'$TCPFLOOD_PORT'" protocol="tcp"
+		action.externalstate.file="'$RSYSLOG_DYNNAME'.STATE"
+		action.resumeRetryCount="-1" action.resumeinterval="1"
+		action.pipelinedepth="2" queue.type="linkedList"
+		queue.dequeueBatchSize="64")
+}
+'
+./minitcpsrv -t127.0.0.1 -p$TCPFLOOD_PORT -f $RSYSLOG_OUT_LOG &
+BGPROCESS=$!
+echo background minitcpsrv process id is $BGPROCESS
+
+startup
+injectmsg 0 5000
+printf "%s" "SUSPENDED" > $RSYSLOG_DYNNAME.STATE
+./msleep 2000 # ensure ResumeInterval expired
+injectmsg 5000 1000
+./msleep 2000
+printf "%s" "READY" > $RSYSLOG_DYNNAME.STATE
+injectmsg 6000 4000
+shutdown_when_empty
+wait_shutdown
+seq_check
+exit_test
@@ -0,0 +1,21 @@
+#!/bin/bash
+# check that a transactional action with commit pipelining enabled
+# writes all messages
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=20000
+generate_conf
+add_conf '
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+if $msg contains "msgnum:" then {
+	action(type="omfile" template="outfmt" file="'$RSYSLOG_OUT_LOG'"
+	       action.pipelinedepth="2" queue.type="linkedList"
+	       queue.dequeueBatchSize="64" queue.workerthreads="2")
+}
+'
+startup
+injectmsg
+shutdown_when_empty
+wait_shutdown
+seq_check
+exit_test
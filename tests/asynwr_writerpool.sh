@@ -0,0 +1,26 @@
+#!/bin/bash
+# test async writing via the shared stream writer pool instead of one
+# writer thread per stream. We use more dynafiles than pool threads.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=20000
+generate_conf
+add_conf '
+global(stream.writerThreads="2")
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+template(name="outfmt" type="string" string="%msg:F,58:3%\n")
+template(name="dynfile" type="string" string="'$RSYSLOG_DYNNAME'.%msg:F,58:2%.log")
+
+local0.* action(type="omfile" dynafile="dynfile" template="outfmt"
+		 flushOnTXEnd="off" flushInterval="1" ioBufferSize="4k"
+		 asyncWriting="on" dynaFileCacheSize="20")
+'
+startup
+tcpflood -m$NUMMESSAGES -P129 -f16
+shutdown_when_empty
+wait_shutdown
+cat $RSYSLOG_DYNNAME.*.log | sort -n > $RSYSLOG_OUT_LOG
+seq_check
+exit_test
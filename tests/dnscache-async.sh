@@ -0,0 +1,38 @@
+#!/bin/bash
+# added 2026-10-18, released under ASL 2.0
+# check that asynchronous reverse lookup does not lose or block messages,
+# sets the resolved host name and resolves each address only once.
+# Name lookups are answered by a preloaded getnameinfo() override.
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=1000
+export RSYSLOG_PRELOAD=.libs/liboverride_getnameinfo.so
+export OVERRIDE_GETNAMEINFO_LOG=$RSYSLOG_DYNNAME.dnsqueries
+generate_conf
+add_conf '
+global(reverselookup.async.workers="2"
+       reverselookup.async.timeout="10000"
+       reverselookup.cache.ttl.negative="5")
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%,%fromhost%\n")
+:msg, contains, "msgnum:" action(type="omfile" template="outfmt"
+			         file="'$RSYSLOG_OUT_LOG'")
+'
+startup
+tcpflood -m$NUMMESSAGES -c10
+shutdown_when_empty
+wait_shutdown
+if grep -v ',dnscache-test$' $RSYSLOG_OUT_LOG ; then
+	echo "FAIL: fromhost not set to the resolved name, see above"
+	error_exit 1
+fi
+# 10 connections from the same address: one query, the rest is served by the cache
+if [ "$(grep -c '^127\.0\.0\.1$' $OVERRIDE_GETNAMEINFO_LOG)" != "1" ]; then
+	echo "FAIL: expected exactly one name query for 127.0.0.1, got:"
+	cat $OVERRIDE_GETNAMEINFO_LOG
+	error_exit 1
+fi
+sed -i 's/,.*$//' $RSYSLOG_OUT_LOG
+seq_check
+exit_test
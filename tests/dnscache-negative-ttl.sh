@@ -0,0 +1,43 @@
+#!/bin/bash
+# added 2026-10-18, released under ASL 2.0
+# check that failed reverse lookups are cached for the negative TTL only:
+# while cached, the IP is used without a new query; once expired, the
+# name is queried again. Name lookups fail via a preloaded getnameinfo()
+# override.
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=100
+export RSYSLOG_PRELOAD=.libs/liboverride_getnameinfo.so
+export OVERRIDE_GETNAMEINFO_LOG=$RSYSLOG_DYNNAME.dnsqueries
+export OVERRIDE_GETNAMEINFO_FAIL=1
+generate_conf
+add_conf '
+global(reverselookup.async.workers="2"
+       reverselookup.async.timeout="10000"
+       reverselookup.cache.ttl.negative="2")
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%,%fromhost%\n")
+:msg, contains, "msgnum:" action(type="omfile" template="outfmt"
+			         file="'$RSYSLOG_OUT_LOG'")
+'
+startup
+tcpflood -m50 -c5
+./msleep 3500 # let the negative entry expire
+tcpflood -m50 -i50 -c5
+./msleep 500 # let the resolver do the refresh
+shutdown_when_empty
+wait_shutdown
+if grep -v ',127\.0\.0\.1$' $RSYSLOG_OUT_LOG ; then
+	echo "FAIL: fromhost is not the IP for an unresolvable address, see above"
+	error_exit 1
+fi
+# one query initially, one more after the negative TTL expired
+if [ "$(grep -c '^127\.0\.0\.1$' $OVERRIDE_GETNAMEINFO_LOG)" != "2" ]; then
+	echo "FAIL: expected exactly two name queries for 127.0.0.1, got:"
+	cat $OVERRIDE_GETNAMEINFO_LOG
+	error_exit 1
+fi
+sed -i 's/,.*$//' $RSYSLOG_OUT_LOG
+seq_check
+exit_test
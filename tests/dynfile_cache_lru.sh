@@ -0,0 +1,30 @@
+#!/bin/bash
+# check that the dynafile cache evicts the least recently used file and
+# that the cache statistics account hits, misses and evictions correctly.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+generate_conf
+add_conf '
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+module(load="../plugins/impstats/.libs/impstats"
+	log.file="'$RSYSLOG_DYNNAME'.stats" interval="1" ruleset="stats")
+ruleset(name="stats") {
+	stop # nothing to do here
+}
+
+template(name="outfmt" type="string" string="%msg:F,58:3%\n")
+template(name="dynfile" type="string" string="%msg:F,58:2%.log")
+local0.* action(type="omfile" dynaFile="dynfile" template="outfmt" dynaFileCacheSize="4")
+'
+startup
+# fill the cache (4 misses), then use file 0 again (hit), so that file 1
+# is the least recently used one and gets evicted by file 4
+for i in 0 1 2 3 0 4 0 1; do
+	tcpflood -m1 -M "\"<129>Mar 10 01:00:00 172.20.245.8 tag msg:$RSYSLOG_DYNNAME.out.$i.log:$i\""
+done
+./msleep 2000 # let impstats write the final counters
+shutdown_when_empty
+wait_shutdown
+content_check 'requests=8 level0=0 hits=2 missed=6 evicted=2 maxused=4' $RSYSLOG_DYNNAME.stats
+exit_test
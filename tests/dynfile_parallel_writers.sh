@@ -0,0 +1,32 @@
+#!/bin/bash
+# check parallel dynafile writers: all messages must be written and the
+# message order inside each file must be preserved. The cache is smaller
+# than the number of files, so pending groups need to be written before
+# entries are evicted.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=20000
+generate_conf
+add_conf '
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+template(name="outfmt" type="string" string="%msg:F,58:3%\n")
+template(name="dynfile" type="string" string="'$RSYSLOG_DYNNAME'.%msg:F,58:2%.log")
+
+local0.* action(type="omfile" dynafile="dynfile" template="outfmt"
+		 dynaFileCacheSize="4" dynafile.writers="3")
+'
+startup
+tcpflood -m$NUMMESSAGES -P129 -f10
+shutdown_when_empty
+wait_shutdown
+for f in $RSYSLOG_DYNNAME.*.log; do
+	if ! sort -n -c $f; then
+		echo "FAIL: message order not preserved in $f"
+		error_exit 1
+	fi
+done
+cat $RSYSLOG_DYNNAME.*.log | sort -n > $RSYSLOG_OUT_LOG
+seq_check
+exit_test
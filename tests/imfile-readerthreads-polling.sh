@@ -0,0 +1,37 @@
+#!/bin/bash
+# test reading files via the reader thread pool in polling mode. One of
+# the files is much larger than the others, so it needs several reader
+# runs; this must not change the order of its lines.
+# This is part of the rsyslog testbench, licensed under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMFILES=8
+export BIGFILEMSGS=50000
+export MSGSPERFILE=1000
+export NUMMESSAGES=$((BIGFILEMSGS + (NUMFILES - 1) * MSGSPERFILE))
+generate_conf
+add_conf '
+$WorkDirectory '$RSYSLOG_DYNNAME'.spool
+module(load="../plugins/imfile/.libs/imfile" mode="polling" pollingInterval="1"
+       readerThreads="3")
+input(type="imfile" File="./'$RSYSLOG_DYNNAME'.input.*" tag="file:")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+if $msg contains "msgnum:" then
+	action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt")
+'
+./inputfilegen -m $BIGFILEMSGS > $RSYSLOG_DYNNAME.input.0
+for i in $(seq 1 $((NUMFILES - 1))); do
+	./inputfilegen -m $MSGSPERFILE -i $((BIGFILEMSGS + (i - 1) * MSGSPERFILE)) > $RSYSLOG_DYNNAME.input.$i
+done
+startup
+wait_file_lines
+shutdown_when_empty
+wait_shutdown
+seq_check
+# lines of the big file must be in order
+grep -E '^[0-9]+$' $RSYSLOG_OUT_LOG | awk -v max=$BIGFILEMSGS '$1 < max' > $RSYSLOG_DYNNAME.bigfile
+if ! sort -n -c $RSYSLOG_DYNNAME.bigfile; then
+	echo "FAIL: lines from big file out of order"
+	error_exit 1
+fi
+exit_test
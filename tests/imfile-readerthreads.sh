@@ -0,0 +1,33 @@
+#!/bin/bash
+# test reading many files via the reader thread pool, with inotify
+# events being coalesced. All files are written concurrently.
+# This is part of the rsyslog testbench, licensed under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+. $srcdir/diag.sh check-inotify-only
+export NUMFILES=20
+export NUMMESSAGES=40000
+export MSGSPERFILE=$((NUMMESSAGES / NUMFILES))
+generate_conf
+add_conf '
+$WorkDirectory '$RSYSLOG_DYNNAME'.spool
+module(load="../plugins/imfile/.libs/imfile" mode="inotify"
+       readerThreads="4" eventCoalescingWindow="10")
+input(type="imfile" File="./'$RSYSLOG_DYNNAME'.input.*" tag="file:")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+if $msg contains "msgnum:" then
+	action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt")
+'
+for i in $(seq 0 $((NUMFILES - 1))); do
+	touch $RSYSLOG_DYNNAME.input.$i
+done
+startup
+for i in $(seq 0 $((NUMFILES - 1))); do
+	./inputfilegen -m $MSGSPERFILE -i $((i * MSGSPERFILE)) >> $RSYSLOG_DYNNAME.input.$i &
+done
+wait
+wait_file_lines $RSYSLOG_OUT_LOG $NUMMESSAGES
+shutdown_when_empty
+wait_shutdown
+seq_check
+exit_test
@@ -0,0 +1,27 @@
+#!/bin/bash
+# Check that lines which span read buffer boundaries are correctly
+# reassembled. The lines are long enough so that most of them cross
+# the buffer end, while some are fully contained in it. This exercises
+# both the direct (non-copying) and the regular line reader.
+# This is part of the rsyslog testbench, licensed under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=20000
+generate_conf
+add_conf '
+global(maxMessageSize="8k")
+module(load="../plugins/imfile/.libs/imfile")
+input(type="imfile" File="./'$RSYSLOG_DYNNAME'.input" tag="file:")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+if $msg contains "msgnum:" then
+	action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt")
+'
+touch $RSYSLOG_DYNNAME.input
+startup
+./inputfilegen -m 10000 -d 1500 >> $RSYSLOG_DYNNAME.input
+./inputfilegen -m 10000 -i 10000 -d 7 >> $RSYSLOG_DYNNAME.input
+wait_file_lines
+shutdown_when_empty
+wait_shutdown
+seq_check
+exit_test
@@ -0,0 +1,28 @@
+#!/bin/bash
+# check that counters reset by interval reporting are not exported
+# as OpenMetrics counters (they are not monotonic)
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+check_command_available curl
+export NUMMESSAGES=100
+export HTTP_PORT="$(get_free_port)"
+generate_conf
+add_conf '
+module(load="../plugins/impstats/.libs/impstats"
+	log.syslog="off" interval="300" resetCounters="on" http.port="'$HTTP_PORT'")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+:msg, contains, "msgnum:" action(name="out" type="omfile" template="outfmt"
+				 file="'$RSYSLOG_OUT_LOG'")
+'
+startup
+injectmsg
+wait_queueempty
+curl --silent --show-error --max-time 10 http://127.0.0.1:$HTTP_PORT/metrics > $RSYSLOG_DYNNAME.metrics
+shutdown_when_empty
+wait_shutdown
+seq_check
+content_check '# TYPE rsyslog_core_action_processed gauge' $RSYSLOG_DYNNAME.metrics
+content_check 'rsyslog_core_action_processed{name="out"} 100' $RSYSLOG_DYNNAME.metrics
+custom_assert_content_missing 'rsyslog_core_action_processed_total' $RSYSLOG_DYNNAME.metrics
+exit_test
@@ -0,0 +1,38 @@
+#!/bin/bash
+# check that impstats serves the counters in OpenMetrics format via http
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+check_command_available curl
+export NUMMESSAGES=1000
+export HTTP_PORT="$(get_free_port)"
+generate_conf
+add_conf '
+global(stats.latencyhistograms="on")
+module(load="../plugins/impstats/.libs/impstats"
+	log.syslog="off" interval="300" http.port="'$HTTP_PORT'")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+:msg, contains, "msgnum:" action(name="out" type="omfile" template="outfmt"
+				 file="'$RSYSLOG_OUT_LOG'")
+'
+startup
+injectmsg
+wait_queueempty
+curl --silent --show-error --max-time 10 http://127.0.0.1:$HTTP_PORT/metrics > $RSYSLOG_DYNNAME.metrics
+curl --silent --max-time 10 -o /dev/null -w '%{http_code}\n' \
+	http://127.0.0.1:$HTTP_PORT/nonexistent > $RSYSLOG_DYNNAME.http404
+shutdown_when_empty
+wait_shutdown
+seq_check
+content_check '# TYPE rsyslog_core_action_processed counter' $RSYSLOG_DYNNAME.metrics
+content_check 'rsyslog_core_action_processed_total{name="out"} 1000' $RSYSLOG_DYNNAME.metrics
+content_check '# TYPE rsyslog_core_queue_latency_us summary' $RSYSLOG_DYNNAME.metrics
+content_check 'rsyslog_core_queue_latency_us{name="main Q",quantile="0.99"}' $RSYSLOG_DYNNAME.metrics
+content_check 'rsyslog_impstats_utime_total{name="resource-usage"}' $RSYSLOG_DYNNAME.metrics
+content_check '# EOF' $RSYSLOG_DYNNAME.metrics
+if grep '^# TYPE ' $RSYSLOG_DYNNAME.metrics | cut -d' ' -f3 | sort | uniq -d | grep .; then
+	echo "FAIL: metric families with more than one TYPE line"
+	error_exit 1
+fi
+content_check '404' $RSYSLOG_DYNNAME.http404
+exit_test
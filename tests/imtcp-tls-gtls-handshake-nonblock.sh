@@ -0,0 +1,38 @@
+#!/bin/bash
+# test that TLS handshakes do not block the epoll event loop or the tcpsrv
+# worker pool: we first open more stalled connections than there are
+# workers. Each one sends only part of a TLS record, so its handshake can
+# not make progress. Regular TLS clients must nevertheless get through.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=10000
+export QUEUE_EMPTY_CHECK_FUNC=wait_seq_check
+generate_conf
+add_conf '
+global(	defaultNetstreamDriverCAFile="'$srcdir/tls-certs/ca.pem'"
+	defaultNetstreamDriverCertFile="'$srcdir/tls-certs/cert.pem'"
+	defaultNetstreamDriverKeyFile="'$srcdir/tls-certs/key.pem'"
+)
+module(	load="../plugins/imtcp/.libs/imtcp"
+	StreamDriver.Name="gtls"
+	StreamDriver.Mode="1"
+	StreamDriver.AuthMode="anon" )
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+:msg, contains, "msgnum:" action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt")
+'
+startup
+for fd in 3 4 5 6 7 8 9; do
+	eval "exec $fd<>/dev/tcp/127.0.0.1/$TCPFLOOD_PORT"
+	printf '\026\003\001' >&$fd # start of a TLS handshake record, never completed
+done
+tcpflood -p$TCPFLOOD_PORT -m$NUMMESSAGES -c20 -Ttls -x$srcdir/tls-certs/ca.pem \
+	-Z$srcdir/tls-certs/cert.pem -z$srcdir/tls-certs/key.pem
+for fd in 3 4 5 6 7 8 9; do
+	eval "exec $fd>&-"
+done
+shutdown_when_empty
+wait_shutdown
+seq_check
+exit_test
@@ -0,0 +1,83 @@
+#!/bin/bash
+# check that imudp prefetches the names of a batch's senders and that the
+# per-message lookups are then served by the cache. Name lookups are
+# answered by a preloaded getnameinfo() override, which logs each query.
+# - message 0 needs the name, which enables prefetching (query 1)
+# - after the entry expired, messages 1..100 do not need the name, so
+#   only the prefetch can refresh it (query 2)
+# - messages 101..200 need the name, which is now cached (no query)
+# As with all UDP tests, message loss is possible, so we keep the
+# amount of data low.
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export TCPFLOOD_EXTRA_OPTS="-b1 -W1"
+export OVERRIDE_GETNAMEINFO_LOG=$RSYSLOG_DYNNAME.dnsqueries
+
+generate_conf
+export PORT_RCVR="$(get_free_port)"
+add_conf '
+global(reverselookup.async.workers="4"
+       reverselookup.async.timeout="10000"
+       reverselookup.cache.ttl.enable="on"
+       reverselookup.cache.ttl.default="4")
+module(load="../plugins/imudp/.libs/imudp" batchsize="32")
+input(type="imudp" port="'$PORT_RCVR'")
+
+template(name="outname" type="string" string="%msg:F,58:2%,%fromhost%\n")
+template(name="outnoname" type="string" string="%msg:F,58:2%,-\n")
+if $msg contains "msgnum:" then {
+	if cnum(field($msg, 58, 2)) >= 1 and cnum(field($msg, 58, 2)) <= 100 then
+		action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outnoname")
+	else
+		action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outname")
+}
+'
+export RSYSLOG_PRELOAD=.libs/liboverride_getnameinfo.so
+startup
+unset RSYSLOG_PRELOAD
+
+generate_conf 2
+export TCPFLOOD_PORT="$(get_free_port)"
+add_conf '
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="'$TCPFLOOD_PORT'")
+
+action(type="omfwd" target="127.0.0.1" port="'$PORT_RCVR'" protocol="udp")
+' 2
+startup 2
+
+count_queries() {
+	grep -c '^127\.0\.0\.1$' $OVERRIDE_GETNAMEINFO_LOG
+}
+
+tcpflood -m1 -i0
+wait_file_lines $RSYSLOG_OUT_LOG 1 $TB_TIMEOUT_STARTSTOP
+./msleep 5000 # let the cache entry expire
+tcpflood -m100 -i1
+wait_file_lines $RSYSLOG_OUT_LOG 101 $TB_TIMEOUT_STARTSTOP
+./msleep 500 # let the resolver finish the prefetch
+if [ "$(count_queries)" != "2" ]; then
+	echo "FAIL: prefetch did not refresh the expired entry, name queries:"
+	cat $OVERRIDE_GETNAMEINFO_LOG
+	error_exit 1
+fi
+tcpflood -m100 -i101
+wait_file_lines $RSYSLOG_OUT_LOG 201 $TB_TIMEOUT_STARTSTOP
+
+shutdown_when_empty 2
+wait_shutdown 2
+shutdown_when_empty
+wait_shutdown
+
+if [ "$(count_queries)" != "2" ]; then
+	echo "FAIL: per-message lookups were not served by the cache, name queries:"
+	cat $OVERRIDE_GETNAMEINFO_LOG
+	error_exit 1
+fi
+if grep -v ',dnscache-test$\|,-$' $RSYSLOG_OUT_LOG ; then
+	echo "FAIL: fromhost not set to the resolved name, see above"
+	error_exit 1
+fi
+sed -i 's/,.*$//' $RSYSLOG_OUT_LOG
+seq_check 0 200
+exit_test
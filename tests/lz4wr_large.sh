@@ -0,0 +1,29 @@
+#!/bin/bash
+# This tests writing large data records with lz4 frame compression, using
+# independent frames (veryRobustZip).
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+if ! command -v lz4 > /dev/null; then
+	printf "lz4 command line tool not available, skipping test\n"
+	skip_test
+fi
+export NUMMESSAGES=4000
+generate_conf
+add_conf '
+$MaxMessageSize 10k
+
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%,%msg:F,58:3%,%msg:F,58:4%\n")
+local0.* action(type="omfile" file="'$RSYSLOG_DYNNAME'.out.lz4" template="outfmt"
+		compression.driver="lz4"
+		zipLevel="6" veryRobustZip="on")
+'
+startup
+tcpflood -m$NUMMESSAGES -r -d10000 -P129
+shutdown_when_empty
+wait_shutdown
+lz4 -dc < $RSYSLOG_DYNNAME.out.lz4 > $RSYSLOG_OUT_LOG
+seq_check 0 $((NUMMESSAGES - 1)) -E
+exit_test
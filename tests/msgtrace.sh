@@ -0,0 +1,27 @@
+#!/bin/bash
+# check that sampled message traces are recorded and reported
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=1000
+generate_conf
+add_conf '
+global(msgtrace.samplerate="10")
+module(load="../plugins/impstats/.libs/impstats"
+	log.file="'$RSYSLOG_DYNNAME'.stats.log" log.syslog="off" interval="1")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+:msg, contains, "msgnum:" action(name="out" type="omfile" template="outfmt"
+				 file="'$RSYSLOG_OUT_LOG'")
+'
+startup
+injectmsg
+wait_queueempty
+echo dumpmsgtrace 5 | $TESTTOOL_DIR/diagtalker -p$IMDIAG_PORT > $RSYSLOG_DYNNAME.trace || error_exit $?
+./msleep 2500 # let impstats emit at least one more interval
+shutdown_when_empty
+wait_shutdown
+seq_check
+content_check --regex 'msgtrace id=[0-9]* action=out ruleset=\+[0-9]*us submit=\+[0-9]*us commit=\+[0-9]*us' $RSYSLOG_DYNNAME.trace
+content_check --regex 'msgtrace: origin=core.msgtrace .*sampled=[1-9][0-9]*.* parse-ruleset.us.count=[1-9][0-9]* ' $RSYSLOG_DYNNAME.stats.log
+content_check --regex 'total.us.count=[1-9][0-9]* total.us.sum=[0-9]* total.us.p50=[0-9]*' $RSYSLOG_DYNNAME.stats.log
+exit_test
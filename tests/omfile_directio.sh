@@ -0,0 +1,32 @@
+#!/bin/bash
+# test writing with direct I/O, preallocation and page cache dropping.
+# We restart rsyslog in between, so that appending to a file that does
+# not end on a block boundary is exercised as well. Before each shutdown,
+# we check that the partial last block has been written at the end of
+# the transaction (flushOnTXEnd) and not only when the file is closed.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=10000
+generate_conf
+add_conf '
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+local0.* action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt"
+		 io.direct="on" io.dropcache="on" preallocation.size="1m"
+		 ioBufferSize="6k")
+'
+startup
+tcpflood -m$((NUMMESSAGES / 2))
+wait_file_lines "$RSYSLOG_OUT_LOG" $((NUMMESSAGES / 2))
+shutdown_when_empty
+wait_shutdown
+rm -f $RSYSLOG_DYNNAME.tcpflood_port
+startup
+tcpflood -m$((NUMMESSAGES / 2)) -i$((NUMMESSAGES / 2))
+wait_file_lines "$RSYSLOG_OUT_LOG" $NUMMESSAGES
+shutdown_when_empty
+wait_shutdown
+seq_check
+exit_test
@@ -0,0 +1,34 @@
+#!/bin/bash
+# test that direct I/O continues at the new end of file if the file is
+# truncated while rsyslog writes it (as logrotate's copytruncate does).
+# The file must not become sparse, i.e. it must not contain NUL bytes.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=2000
+generate_conf
+add_conf '
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+:msg, contains, "msgnum:" action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt"
+				 io.direct="on" ioBufferSize="4k")
+'
+startup
+injectmsg 0 $((NUMMESSAGES / 2))
+wait_queueempty
+: > $RSYSLOG_OUT_LOG
+injectmsg $((NUMMESSAGES / 2)) $((NUMMESSAGES / 2))
+shutdown_when_empty
+wait_shutdown
+if [ "$(tr -d '\000' < $RSYSLOG_OUT_LOG | wc -c)" != "$(wc -c < $RSYSLOG_OUT_LOG)" ]; then
+	echo "FAIL: output file contains NUL bytes, direct I/O wrote past the truncated end"
+	error_exit 1
+fi
+if [ "$(tail -n1 $RSYSLOG_OUT_LOG)" != "00001999" ]; then
+	echo "FAIL: last record is not the last message, file content:"
+	cat -n $RSYSLOG_OUT_LOG | tail -n5
+	error_exit 1
+fi
+if [ $(wc -l < $RSYSLOG_OUT_LOG) -gt 1100 ]; then
+	echo "FAIL: truncation not honored, file has $(wc -l < $RSYSLOG_OUT_LOG) lines"
+	error_exit 1
+fi
+exit_test
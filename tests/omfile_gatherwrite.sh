@@ -0,0 +1,25 @@
+#!/bin/bash
+# test that batches written via gather writes (flushOnTXEnd) arrive
+# completely and in order. We use large, variable-sized records and a
+# small io buffer, so that each batch spans many buffer sizes.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=20000
+export QUEUE_EMPTY_CHECK_FUNC=wait_seq_check
+generate_conf
+add_conf '
+$MaxMessageSize 10k
+main_queue(queue.dequeueBatchSize="2048")
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%,%msg:F,58:3%,%msg:F,58:4%\n")
+local0.* action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt"
+		 flushOnTXEnd="on" ioBufferSize="1k")
+'
+startup
+tcpflood -m$NUMMESSAGES -r -d1000 -P129
+shutdown_when_empty
+wait_shutdown
+seq_check 0 $((NUMMESSAGES - 1)) -E
+exit_test
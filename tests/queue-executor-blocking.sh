@@ -0,0 +1,29 @@
+#!/bin/bash
+# check that a single executor thread does not deadlock when it blocks on
+# a full action queue whose consumer task is on its own deque
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=20000
+generate_conf
+add_conf '
+global(executor.workerthreads="1")
+main_queue(queue.type="linkedList" queue.executor="shared")
+module(load="../plugins/impstats/.libs/impstats"
+	log.file="'$RSYSLOG_DYNNAME'.stats.log" log.syslog="off" interval="1")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+if $msg contains "msgnum:" then {
+	action(type="omfile" template="outfmt" file="'$RSYSLOG_OUT_LOG'"
+	       queue.type="fixedArray" queue.size="100" queue.executor="shared"
+	       queue.timeoutEnqueue="60000")
+}
+'
+startup
+injectmsg
+wait_queueempty
+./msleep 1500 # let impstats emit at least one more interval
+shutdown_when_empty
+wait_shutdown
+seq_check
+content_check --regex 'executor: origin=core.executor .*standins=[1-9][0-9]* ' $RSYSLOG_DYNNAME.stats.log
+exit_test
@@ -0,0 +1,28 @@
+#!/bin/bash
+# check that tasks submitted from outside the executor are run after an idle
+# period, when some executor threads have not been started yet. The bursts
+# are small, so that only one thread is running when the next one arrives.
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=400
+generate_conf
+add_conf '
+global(executor.workerthreads="2")
+main_queue(queue.type="linkedList" queue.executor="shared")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+if $msg contains "msgnum:" then {
+	action(type="omfile" template="outfmt" file="'$RSYSLOG_OUT_LOG'"
+	       queue.type="linkedList" queue.executor="shared" queue.workerthreads="1")
+}
+'
+startup
+for i in 0 1 2 3; do
+	injectmsg $((i * 100)) 100
+	wait_file_lines "$RSYSLOG_OUT_LOG" $(((i + 1) * 100)) 10
+	./msleep 1000 # let the executor threads go idle
+done
+shutdown_when_empty
+wait_shutdown
+seq_check
+exit_test
@@ -0,0 +1,31 @@
+#!/bin/bash
+# check that main and action queues can be run by the shared executor
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=20000
+generate_conf
+add_conf '
+global(executor.workerthreads="2")
+main_queue(queue.type="linkedList" queue.executor="shared" queue.workerthreads="2")
+module(load="../plugins/impstats/.libs/impstats"
+	log.file="'$RSYSLOG_DYNNAME'.stats.log" log.syslog="off" interval="1")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+if $msg contains "msgnum:" then {
+	action(type="omfile" template="outfmt" file="'$RSYSLOG_OUT_LOG'"
+	       queue.type="fixedArray" queue.executor="shared" queue.workerthreads="2")
+	action(type="omfile" template="outfmt" file="'$RSYSLOG2_OUT_LOG'"
+	       queue.type="linkedList" queue.executor="shared")
+}
+'
+startup
+injectmsg
+wait_queueempty
+./msleep 1500 # let impstats emit at least one more interval
+shutdown_when_empty
+wait_shutdown
+seq_check
+export SEQ_CHECK_FILE="$RSYSLOG2_OUT_LOG"
+seq_check
+content_check --regex 'executor: origin=core.executor tasks=[1-9][0-9]* ' $RSYSLOG_DYNNAME.stats.log
+exit_test
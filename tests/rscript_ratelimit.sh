@@ -0,0 +1,43 @@
+#!/bin/bash
+# test for keyed ratelimiting via the ratelimit() script function. We use
+# two keys, so the first burst messages of each key must pass (msgnum
+# 0..199). The refill rate is low enough that only a few more messages
+# may pass while the test runs.
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=1000
+generate_conf
+add_conf '
+# a single worker, so that messages are checked in order
+main_queue(queue.workerThreads="1")
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+
+ratelimiter(name="perkey" rate="1" burst="100")
+
+if $msg contains "msgnum:" then {
+	set $.key = cnum(field($msg, 58, 2)) % 2;
+	if ratelimit("perkey", $.key) then
+		action(type="omfile" file=`echo $RSYSLOG_OUT_LOG` template="outfmt")
+	else
+		action(type="omfile" file=`echo $RSYSLOG2_OUT_LOG` template="outfmt")
+}
+'
+startup
+injectmsg 0 $NUMMESSAGES
+shutdown_when_empty
+wait_shutdown
+
+# all messages must be accounted for
+cat $RSYSLOG_OUT_LOG $RSYSLOG2_OUT_LOG > $RSYSLOG_DYNNAME.all.log
+SEQ_CHECK_FILE=$RSYSLOG_DYNNAME.all.log seq_check
+
+# the first 100 messages of each key pass
+sort -n < $RSYSLOG_OUT_LOG | head -200 > $RSYSLOG_DYNNAME.first.log
+SEQ_CHECK_FILE=$RSYSLOG_DYNNAME.first.log seq_check 0 199
+
+passed=$(wc -l < $RSYSLOG_OUT_LOG)
+if [ $passed -gt 220 ]; then
+	echo "FAIL: $passed messages passed ratelimiting, expected at most 220"
+	error_exit 1
+fi
+exit_test
@@ -0,0 +1,56 @@
+#!/bin/bash
+# testing TLS session resumption: the sender rebinds frequently, so
+# all but the first connection should be able to resume the session.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+generate_conf
+export PORT_RCVR="$(get_free_port)"
+add_conf '
+global(
+	defaultNetstreamDriverCAFile="'$srcdir/testsuites/x.509/ca.pem'"
+	defaultNetstreamDriverCertFile="'$srcdir/testsuites/x.509/client-cert.pem'"
+	defaultNetstreamDriverKeyFile="'$srcdir/testsuites/x.509/client-key.pem'"
+	defaultNetstreamDriver="gtls"
+)
+
+module(	load="../plugins/imtcp/.libs/imtcp"
+	StreamDriver.Name="gtls"
+	StreamDriver.Mode="1"
+	StreamDriver.AuthMode="anon" )
+input(type="imtcp" port="0" listenPortFileName="'$RSYSLOG_DYNNAME'.tcpflood_port")
+
+$template outfmt,"%msg:F,58:2%\n"
+:msg, contains, "msgnum:" action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt")
+'
+startup
+export PORT_RCVR=$TCPFLOOD_PORT # save this, will be rewritten with next config
+
+generate_conf 2
+add_conf '
+global(
+	defaultNetstreamDriverCAFile="'$srcdir/tls-certs/ca.pem'"
+	defaultNetstreamDriverCertFile="'$srcdir/tls-certs/cert.pem'"
+	defaultNetstreamDriverKeyFile="'$srcdir/tls-certs/key.pem'"
+	defaultNetstreamDriver="gtls"
+)
+module(load="../plugins/impstats/.libs/impstats"
+	log.file="'$RSYSLOG_DYNNAME'.stats" interval="1" ruleset="stats")
+ruleset(name="stats") {
+	stop # nothing to do here
+}
+
+action(type="omfwd" target="127.0.0.1" port="'$PORT_RCVR'" protocol="tcp"
+	StreamDriverMode="1" StreamDriverAuthMode="anon" RebindInterval="100")
+' 2
+startup 2
+
+injectmsg2 1 5000
+./msleep 2000 # give impstats a chance to write the final counters
+shutdown_when_empty 2
+wait_shutdown 2
+shutdown_when_empty
+wait_shutdown
+
+seq_check 1 5000
+content_check --regex 'nsd_gtls: origin=nsd_gtls handshakes.full=[0-9]* handshakes.resumed=[1-9]' $RSYSLOG_DYNNAME.stats
+exit_test
@@ -0,0 +1,40 @@
+#!/bin/bash
+# This sends and receives messages via UDP with omfwd gathering them in
+# small sendmmsg() batches (batch.maxbytes). As with all UDP tests, message
+# loss is possible, so we keep the amount of data low.
+# This file is part of the rsyslog project, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export TCPFLOOD_EXTRA_OPTS="-b1 -W1"
+
+generate_conf
+export PORT_RCVR="$(get_free_port)"
+add_conf '
+module(load="../plugins/imudp/.libs/imudp")
+input(type="imudp" port="'$PORT_RCVR'")
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+:msg, contains, "msgnum:" action(type="omfile" file="'$RSYSLOG_OUT_LOG'" template="outfmt")
+'
+startup
+
+generate_conf 2
+export TCPFLOOD_PORT="$(get_free_port)"
+add_conf '
+module(load="../plugins/imtcp/.libs/imtcp")
+input(type="imtcp" port="'$TCPFLOOD_PORT'")
+
+action(type="omfwd" target="127.0.0.1" port="'$PORT_RCVR'" protocol="udp"
+	batch.maxbytes="2k")
+' 2
+startup 2
+
+tcpflood -m500 -i1
+wait_file_lines $RSYSLOG_OUT_LOG 500 $TB_TIMEOUT_STARTSTOP
+
+shutdown_when_empty 2
+wait_shutdown 2
+shutdown_when_empty
+wait_shutdown
+
+seq_check 1 500
+exit_test
@@ -0,0 +1,30 @@
+#!/bin/bash
+# check that queue and action latency histograms are reported
+# added 2026-10-18, released under ASL 2.0
+. ${srcdir:=.}/diag.sh init
+export NUMMESSAGES=1000
+generate_conf
+add_conf '
+global(stats.latencyhistograms="on")
+module(load="../plugins/impstats/.libs/impstats"
+	log.file="'$RSYSLOG_DYNNAME'.stats.log"
+	interval="1" ruleset="stats")
+
+ruleset(name="stats") {
+	stop # nothing to do here
+}
+
+template(name="outfmt" type="string" string="%msg:F,58:2%\n")
+:msg, contains, "msgnum:" action(name="out" type="omfile" template="outfmt"
+				 file="'$RSYSLOG_OUT_LOG'")
+'
+startup
+injectmsg
+wait_queueempty
+./msleep 2500 # let impstats emit at least one more interval
+shutdown_when_empty
+wait_shutdown
+seq_check
+content_check --regex 'main Q: origin=core.queue .*latency.us.count=[1-9][0-9]* latency.us.sum=[0-9]* latency.us.p50=[0-9]* latency.us.p99=[0-9]* latency.us.p999=[0-9]* latency.us.max=[0-9]*' $RSYSLOG_DYNNAME.stats.log
+content_check --regex 'out: origin=core.action .*commit.latency.us.count=[1-9][0-9]* ' $RSYSLOG_DYNNAME.stats.log
+exit_test
@@ -47,6 +47,7 @@
 #include <libgen.h>
 #include <unistd.h>
 #include <sys/file.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #ifdef HAVE_ATOMIC_BUILTINS
 #	include <pthread.h>
@@ -70,6 +71,7 @@
 #include "cryprov.h"
 #include "parserif.h"
 #include "janitor.h"
+#include "hashtable.h"
 
 MODULE_TYPE_OUTPUT
 MODULE_TYPE_NOKEEP
@@ -84,51 +86,37 @@ DEF_OMOD_STATIC_DATA
 DEFobjCurrIf(strm)
 DEFobjCurrIf(statsobj)
 
-/* for our current LRU mechanism, we need a monotonically increasing counters. We use
- * it much like a "Lamport logical clock": we do not need the actual time, we just need
- * to know the sequence in which files were accessed. So we use a simple counter to
- * create that sequence. We use an unsigned 64 bit value which is extremely unlike to
- * wrap within the lifetime of a process. If we process 1,000,000 file writes per
- * second, the process could still exist over 500,000 years before a wrap to 0 happens.
- * That should be sufficient (and even than, there would no really bad effect ;)).
- * The variable below is the global counter/clock.
- */
-#ifdef HAVE_ATOMIC_BUILTINS64
-static uint64 clockFileAccess = 0;
-#else
-static unsigned clockFileAccess = 0;
-#endif
-/* and the "tick" function */
-#ifndef HAVE_ATOMIC_BUILTINS
-static pthread_mutex_t mutClock;
-#endif
-static uint64
-getClockFileAccess(void)
-{
-#ifdef HAVE_ATOMIC_BUILTINS64
-	return ATOMIC_INC_AND_FETCH_uint64(&clockFileAccess, &mutClock);
-#else
-	return ATOMIC_INC_AND_FETCH_unsigned(&clockFileAccess, &mutClock);
-#endif
-}
-
-
 /* The following structure is a dynafile name cache entry.
  */
+typedef struct s_dynaFileCacheEntry dynaFileCacheEntry;
 struct s_dynaFileCacheEntry {
-	uchar *pName;		/* name currently open, if dynamic name */
+	uchar *pName;		/* name currently open, if dynamic name. Owned by the cache index
+				 * (hashtable) while the entry is in use, freed on removal from it */
 	strm_t	*pStrm;		/* our output stream */
 	void	*sigprovFileData;	/* opaque data ptr for provider use */
-	uint64	clkTickAccessed;/* for LRU - based on clockFileAccess */
+	dynaFileCacheEntry *pLRUPrev;	/* LRU list: next more recently used entry */
+	dynaFileCacheEntry *pLRUNext;	/* LRU list: next less recently used entry */
+	int	iEntry;		/* our index inside the cache array */
 	short nInactive;	/* number of minutes not writen - for close timeout */
 };
-typedef struct s_dynaFileCacheEntry dynaFileCacheEntry;
+
+
+/* In parallel dynafile writer mode, the messages of a batch are grouped by
+ * target file. A group is the in-order chain of the batch's messages for a
+ * single dynafile cache slot. Each group is written by exactly one writer.
+ */
+typedef struct dynaFileWrGrp_s {
+	int	iFirst;		/* first message of the group, -1 if the slot has no pending data */
+	int	iLast;		/* last message of the group (chain tail) */
+	rsRetVal iRet;		/* result of the final flush of this group */
+} dynaFileWrGrp_t;
 
 
 #define IOBUF_DFLT_SIZE 4096	/* default size for io buffers */
 #define FLUSH_INTRVL_DFLT 1 	/* default buffer flush interval (in seconds) */
 #define USE_ASYNCWRITER_DFLT 0 	/* default buffer use async writer */
 #define FLUSHONTX_DFLT 1 	/* default for flush on TX end */
+#define WRITEV_CHUNK 256	/* max number of messages per gather write */
 
 
 typedef struct _instanceData {
@@ -164,13 +152,47 @@ typedef struct _instanceData {
 	int	iDynaFileCacheSize; /* size of file handle cache */
 	/* The cache is implemented as an array. An empty element is indicated
 	 * by a NULL pointer. Memory is allocated as needed. The following
-	 * pointer points to the overall structure.
+	 * pointer points to the overall structure. Lookup is done via a hash
+	 * table keyed by file name, eviction via an LRU list of the used entries.
+	 * Array slots that became free (janitor, failed opens) are kept on a stack.
 	 */
 	dynaFileCacheEntry **dynCache;
+	struct hashtable *dynCacheIdx;	/* file name -> cache entry */
+	dynaFileCacheEntry *pLRUHead;	/* most recently used entry */
+	dynaFileCacheEntry *pLRUTail;	/* least recently used entry, evicted first */
+	int	*dynCacheFree;		/* stack of free slots in dynCache */
+	int	nDynCacheFree;		/* number of entries on that stack */
+	/* parallel dynafile writers. If nDynWriters is 0, all messages are written
+	 * by the action worker itself. Otherwise, the batch is partitioned by target
+	 * file and the per-file groups are written by the writer pool (plus the
+	 * action worker). All of this is only accessed while holding mutWrite,
+	 * except for the job distribution, which is guarded by mutDynWr.
+	 */
+	int	nDynWriters;		/* number of writer threads to use */
+	int	nDynWrThrds;		/* number of writer threads actually running */
+	pthread_t *dynWrThrds;
+	pthread_mutex_t mutDynWr;
+	pthread_cond_t condDynWr;	/* new jobs available (or shutdown) */
+	pthread_cond_t condDynWrDone;	/* all jobs of the current round done */
+	sbool	bDynWrShutdown;
+	dynaFileWrGrp_t *dynWrGrps;	/* one group per cache slot */
+	int	*dynWrActive;		/* cache slots with pending data, in order of first use */
+	int	nDynWrActive;
+	int	nDynWrJobs;		/* number of jobs published to the writers */
+	int	iDynWrNext;		/* next job to be picked up */
+	int	nDynWrDone;		/* number of jobs completed */
+	const actWrkrIParams_t *dynWrParams; /* the batch currently being written */
+	int	*dynWrMsgNext;		/* per-message chain link inside its group */
+	unsigned maxDynWrMsgs;		/* size of dynWrMsgNext */
 	off_t	iSizeLimit;		/* file size limit, 0 = no limit */
 	uchar	*pszSizeLimitCmd;	/* command to carry out when size limit is reached */
 	int 	iZipLevel;		/* zip mode to use for this selector */
+	strm_compressionDriver_t compressionDriver; /* zlib (default), zstd or lz4 */
+	int	iZstdWorkers;		/* zstd compression threads per file, 0 = none */
 	int	iIOBufSize;		/* size of associated io buffer */
+	off_t	iPreallocSize;		/* preallocate file space in extents of this size, 0 = off */
+	sbool	bDirectIO;		/* write via O_DIRECT */
+	sbool	bDropCache;		/* drop written data from page cache */
 	int	iFlushInterval;		/* how fast flush buffer on inactivity? */
 	short	iCloseTimeout;		/* after how many *minutes* shall the file be closed if inactive? */
 	sbool	bFlushOnTXEnd;		/* flush write buffers when transaction has ended? */
@@ -179,6 +201,7 @@ typedef struct _instanceData {
 	statsobj_t *stats;		/* dynafile, primarily cache stats */
 	STATSCOUNTER_DEF(ctrRequests, mutCtrRequests);
 	STATSCOUNTER_DEF(ctrLevel0, mutCtrLevel0);
+	STATSCOUNTER_DEF(ctrHit, mutCtrHit);
 	STATSCOUNTER_DEF(ctrEvict, mutCtrEvict);
 	STATSCOUNTER_DEF(ctrMiss, mutCtrMiss);
 	STATSCOUNTER_DEF(ctrMax, mutCtrMax);
@@ -277,6 +300,12 @@ static struct cnfparamdescr actpdescr[] = {
 	{ "sig.provider", eCmdHdlrGetWord, 0 },
 	{ "cry.provider", eCmdHdlrGetWord, 0 },
 	{ "closetimeout", eCmdHdlrPositiveInt, 0 },
+	{ "dynafile.writers", eCmdHdlrNonNegInt, 0 },
+	{ "compression.driver", eCmdHdlrGetWord, 0 },
+	{ "compression.zstd.workers", eCmdHdlrPositiveInt, 0 },
+	{ "preallocation.size", eCmdHdlrSize, 0 },
+	{ "io.direct", eCmdHdlrBinary, 0 },
+	{ "io.dropcache", eCmdHdlrBinary, 0 },
 	{ "template", eCmdHdlrGetWord, 0 }
 };
 static struct cnfparamblk actpblk =
@@ -325,7 +354,12 @@ CODESTARTdbgPrintInstInfo
 
 	dbgprintf("\ttemplate='%s'\n", pData->fname);
 	dbgprintf("\tuse async writer=%d\n", pData->bUseAsyncWriter);
+	dbgprintf("\tdynafile writers=%d\n", pData->nDynWriters);
+	dbgprintf("\tcompression driver=%d, zstd workers=%d\n", pData->compressionDriver,
+		pData->iZstdWorkers);
 	dbgprintf("\tflush on TX end=%d\n", pData->bFlushOnTXEnd);
+	dbgprintf("\tpreallocation size=%lld, direct I/O=%d, drop cache=%d\n",
+		(long long) pData->iPreallocSize, pData->bDirectIO, pData->bDropCache);
 	dbgprintf("\tflush interval=%d\n", pData->iFlushInterval);
 	dbgprintf("\tfile cache size=%d\n", pData->iDynaFileCacheSize);
 	dbgprintf("\tcreate directories: %s\n", pData->bCreateDirs ? "on" : "off");
@@ -449,6 +483,72 @@ finalize_it:
 }
 
 
+/* remove an entry from the dynafile cache LRU list */
+static void
+dynaFileLRUUnlink(instanceData *__restrict__ const pData, dynaFileCacheEntry *__restrict__ const pEntry)
+{
+	if(pEntry->pLRUPrev == NULL)
+		pData->pLRUHead = pEntry->pLRUNext;
+	else
+		pEntry->pLRUPrev->pLRUNext = pEntry->pLRUNext;
+	if(pEntry->pLRUNext == NULL)
+		pData->pLRUTail = pEntry->pLRUPrev;
+	else
+		pEntry->pLRUNext->pLRUPrev = pEntry->pLRUPrev;
+	pEntry->pLRUPrev = pEntry->pLRUNext = NULL;
+}
+
+
+/* make an entry the most recently used one (it must not be in the list) */
+static void
+dynaFileLRUPushFront(instanceData *__restrict__ const pData, dynaFileCacheEntry *__restrict__ const pEntry)
+{
+	pEntry->pLRUPrev = NULL;
+	pEntry->pLRUNext = pData->pLRUHead;
+	if(pData->pLRUHead == NULL)
+		pData->pLRUTail = pEntry;
+	else
+		pData->pLRUHead->pLRUPrev = pEntry;
+	pData->pLRUHead = pEntry;
+}
+
+
+/* mark a cache entry as just used */
+static void
+dynaFileLRUTouch(instanceData *__restrict__ const pData, dynaFileCacheEntry *__restrict__ const pEntry)
+{
+	if(pData->pLRUHead != pEntry) {
+		dynaFileLRUUnlink(pData, pEntry);
+		dynaFileLRUPushFront(pData, pEntry);
+	}
+}
+
+
+/* the cache entries are owned by the cache array, not the index */
+static void
+dynaFileNoFree(void __attribute__((unused)) *p)
+{
+}
+
+
+/* allocate the dynafile cache for iCacheSize entries */
+static rsRetVal
+dynaFileAllocCache(instanceData *__restrict__ const pData, const int iCacheSize)
+{
+	DEFiRet;
+	CHKmalloc(pData->dynCache = (dynaFileCacheEntry**)
+			calloc(iCacheSize, sizeof(dynaFileCacheEntry*)));
+	CHKmalloc(pData->dynCacheFree = (int*) malloc(iCacheSize * sizeof(int)));
+	CHKmalloc(pData->dynCacheIdx = create_hashtable(iCacheSize, hash_from_string,
+		key_equals_string, dynaFileNoFree));
+	pData->nDynCacheFree = 0;
+	pData->pLRUHead = pData->pLRUTail = NULL;
+	pData->iCurrElt = -1;		  /* no current element */
+finalize_it:
+	RETiRet;
+}
+
+
 /* This function deletes an entry from the dynamic file name
  * cache. A pointer to the cache must be passed in as well
  * as the index of the to-be-deleted entry. This index may
@@ -460,6 +560,7 @@ static rsRetVal
 dynaFileDelCacheEntry(instanceData *__restrict__ const pData, const int iEntry, const int bFreeEntry)
 {
 	dynaFileCacheEntry **pCache = pData->dynCache;
+	int bIsInUse = 0;
 	DEFiRet;
 	assert(pCache != NULL);
 
@@ -470,8 +571,11 @@ dynaFileDelCacheEntry(instanceData *__restrict__ const pData, const int iEntry,
 		pCache[iEntry]->pName == NULL ? UCHAR_CONSTANT("[OPEN FAILED]") : pCache[iEntry]->pName);
 
 	if(pCache[iEntry]->pName != NULL) {
-		free(pCache[iEntry]->pName);
+		/* removing from the index also frees the name */
+		hashtable_remove(pData->dynCacheIdx, pCache[iEntry]->pName);
 		pCache[iEntry]->pName = NULL;
+		dynaFileLRUUnlink(pData, pCache[iEntry]);
+		bIsInUse = 1;
 	}
 
 	if(pCache[iEntry]->pStrm != NULL) {
@@ -489,6 +593,9 @@ dynaFileDelCacheEntry(instanceData *__restrict__ const pData, const int iEntry,
 	if(bFreeEntry) {
 		free(pCache[iEntry]);
 		pCache[iEntry] = NULL;
+		/* entries not in use (failed open) are already on the free stack */
+		if(bIsInUse)
+			pData->dynCacheFree[pData->nDynCacheFree++] = iEntry;
 	}
 
 finalize_it:
@@ -521,9 +628,13 @@ static void dynaFileFreeCache(instanceData *__restrict__ const pData)
 {
 	assert(pData != NULL);
 
-	dynaFileFreeCacheEntries(pData);
-	if(pData->dynCache != NULL)
+	if(pData->dynCache != NULL) {
+		dynaFileFreeCacheEntries(pData);
 		free(pData->dynCache);
+	}
+	free(pData->dynCacheFree);
+	if(pData->dynCacheIdx != NULL)
+		hashtable_destroy(pData->dynCacheIdx, 0);
 }
 
 
@@ -627,6 +738,8 @@ prepareFile(instanceData *__restrict__ const pData, const uchar *__restrict__ co
 	CHKiRet(strm.SetFName(pData->pStrm, szBaseName, ustrlen(szBaseName)));
 	CHKiRet(strm.SetDir(pData->pStrm, szDirName, ustrlen(szDirName)));
 	CHKiRet(strm.SetiZipLevel(pData->pStrm, pData->iZipLevel));
+	CHKiRet(strm.SetcompressionDriver(pData->pStrm, pData->compressionDriver));
+	CHKiRet(strm.SetiCompressionWorkers(pData->pStrm, pData->iZstdWorkers));
 	CHKiRet(strm.SetbVeryReliableZip(pData->pStrm, pData->bVeryRobustZip));
 	CHKiRet(strm.SetsIOBufSize(pData->pStrm, (size_t) pData->iIOBufSize));
 	CHKiRet(strm.SettOperationsMode(pData->pStrm, STREAMMODE_WRITE_APPEND));
@@ -634,6 +747,9 @@ prepareFile(instanceData *__restrict__ const pData, const uchar *__restrict__ co
 	CHKiRet(strm.SetbSync(pData->pStrm, pData->bSyncFile));
 	CHKiRet(strm.SetsType(pData->pStrm, STREAMTYPE_FILE_SINGLE));
 	CHKiRet(strm.SetiSizeLimit(pData->pStrm, pData->iSizeLimit));
+	CHKiRet(strm.SetiPreallocSize(pData->pStrm, pData->iPreallocSize));
+	CHKiRet(strm.SetbDirectIO(pData->pStrm, pData->bDirectIO));
+	CHKiRet(strm.SetbDropCache(pData->pStrm, pData->bDropCache));
 	if(pData->useCryprov) {
 		CHKiRet(strm.Setcryprov(pData->pStrm, &pData->cryprov));
 		CHKiRet(strm.SetcryprovData(pData->pStrm, pData->cryprovData));
@@ -672,12 +788,10 @@ finalize_it:
 static rsRetVal ATTR_NONNULL()
 prepareDynFile(instanceData *__restrict__ const pData, const uchar *__restrict__ const newFileName)
 {
-	uint64 ctOldest; /* "timestamp" of oldest element */
-	int iOldest;
-	int i;
-	int iFirstFree;
+	int iEntry;
 	rsRetVal localRet;
 	dynaFileCacheEntry **pCache;
+	dynaFileCacheEntry *pEntry;
 	DEFiRet;
 
 	assert(pData != NULL);
@@ -689,9 +803,8 @@ prepareDynFile(instanceData *__restrict__ const pData, const uchar *__restrict__
 	if(   (pData->iCurrElt != -1)
 	   && !ustrcmp(newFileName, pCache[pData->iCurrElt]->pName)) {
 	   	/* great, we are all set */
-		pCache[pData->iCurrElt]->clkTickAccessed = getClockFileAccess();
+		dynaFileLRUTouch(pData, pCache[pData->iCurrElt]);
 		STATSCOUNTER_INC(pData->ctrLevel0, pData->mutCtrLevel0);
-		/* LRU needs only a strictly monotonically increasing counter, so such a one could do */
 		FINALIZE;
 	}
 
@@ -700,39 +813,25 @@ prepareDynFile(instanceData *__restrict__ const pData, const uchar *__restrict__
 	/* if we need to flush (at least) on TXEnd, we need to flush now - because
 	 * we do not know if we will otherwise come back to this file to flush it
 	 * at end of TX. see https://github.com/rsyslog/rsyslog/issues/2502
+	 * With parallel writers, this is not needed: nothing has been written yet
+	 * and each file is flushed after its group has been written.
 	 */
 	if(((glblDevOptions & DEV_OPTION_8_1905_HANG_TEST) == 0) &&
-	    pData->bFlushOnTXEnd && pData->pStrm != NULL) {
+	    pData->bFlushOnTXEnd && pData->pStrm != NULL && pData->nDynWriters == 0) {
 		CHKiRet(strm.Flush(pData->pStrm));
 	}
 
-	/* Now let's search the table if we find a matching spot.
-	 * While doing so, we also prepare for creation of a new one.
-	 */
+	/* Now let's look up the file in the cache index */
 	pData->iCurrElt = -1;	/* invalid current element pointer */
-	iFirstFree = -1; /* not yet found */
-	iOldest = 0; /* we assume the first element to be the oldest - that will change as we loop */
-	ctOldest = getClockFileAccess(); /* there must always be an older one */
-	for(i = 0 ; i < pData->iCurrCacheSize ; ++i) {
-		if(pCache[i] == NULL || pCache[i]->pName == NULL) {
-			if(iFirstFree == -1)
-				iFirstFree = i;
-		} else { /* got an element, let's see if it matches */
-			if(!ustrcmp(newFileName, pCache[i]->pName)) {
-				/* we found our element! */
-				pData->pStrm = pCache[i]->pStrm;
-				if(pData->useSigprov)
-					pData->sigprovFileData = pCache[i]->sigprovFileData;
-				pData->iCurrElt = i;
-				pCache[i]->clkTickAccessed = getClockFileAccess(); /* update "timestamp" for LRU */
-				FINALIZE;
-			}
-			/* did not find it - so lets keep track of the counters for LRU */
-			if(pCache[i]->clkTickAccessed < ctOldest) {
-				ctOldest = pCache[i]->clkTickAccessed;
-				iOldest = i;
-				}
-		}
+	pEntry = hashtable_search(pData->dynCacheIdx, (void*) newFileName);
+	if(pEntry != NULL) {
+		pData->pStrm = pEntry->pStrm;
+		if(pData->useSigprov)
+			pData->sigprovFileData = pEntry->sigprovFileData;
+		pData->iCurrElt = pEntry->iEntry;
+		dynaFileLRUTouch(pData, pEntry);
+		STATSCOUNTER_INC(pData->ctrHit, pData->mutCtrHit);
+		FINALIZE;
 	}
 
 	/* we have not found an entry */
@@ -745,24 +844,30 @@ prepareDynFile(instanceData *__restrict__ const pData, const uchar *__restrict__
 	 */
 	pData->pStrm = NULL, pData->sigprovFileData = NULL;
 
-	if(iFirstFree == -1 && (pData->iCurrCacheSize < pData->iDynaFileCacheSize)) {
-		/* there is space left, so set it to that index */
-		iFirstFree = pData->iCurrCacheSize++;
-		STATSCOUNTER_SETMAX_NOMUT(pData->ctrMax, (unsigned) pData->iCurrCacheSize);
-	}
-
 	/* Note that the following code sequence does not work with the cache entry itself,
 	 * but rather with pData->pStrm, the (sole) stream pointer in the non-dynafile case.
 	 * The cache array is only updated after the open was successful. -- rgerhards, 2010-03-21
 	 */
-	if(iFirstFree == -1) {
-		dynaFileDelCacheEntry(pData, iOldest, 0);
-		STATSCOUNTER_INC(pData->ctrEvict, pData->mutCtrEvict);
-		iFirstFree = iOldest; /* this one *is* now free ;) */
+	if(pData->nDynCacheFree > 0) {
+		iEntry = pData->dynCacheFree[--pData->nDynCacheFree];
+	} else if(pData->iCurrCacheSize < pData->iDynaFileCacheSize) {
+		/* there is space left, so set it to that index */
+		iEntry = pData->iCurrCacheSize++;
+		STATSCOUNTER_SETMAX_NOMUT(pData->ctrMax, (unsigned) pData->iCurrCacheSize);
 	} else {
+		iEntry = pData->pLRUTail->iEntry;
+		dynaFileDelCacheEntry(pData, iEntry, 0);
+		STATSCOUNTER_INC(pData->ctrEvict, pData->mutCtrEvict);
+	}
+	if(pCache[iEntry] == NULL) {
 		/* we need to allocate memory for the cache structure */
-		CHKmalloc(pCache[iFirstFree] = (dynaFileCacheEntry*) calloc(1, sizeof(dynaFileCacheEntry)));
+		if((pCache[iEntry] = (dynaFileCacheEntry*) calloc(1, sizeof(dynaFileCacheEntry))) == NULL) {
+			pData->dynCacheFree[pData->nDynCacheFree++] = iEntry;
+			ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
+		}
+		pCache[iEntry]->iEntry = iEntry;
 	}
+	pEntry = pCache[iEntry];
 
 	/* Ok, we finally can open the file */
 	localRet = prepareFile(pData, newFileName); /* ignore exact error, we check fd below */
@@ -774,19 +879,28 @@ prepareDynFile(instanceData *__restrict__ const pData, const uchar *__restrict__
 		 */
 		parser_errmsg("Could not open dynamic file '%s' [state %d] - discarding "
 		"message", newFileName, localRet);
+		pData->dynCacheFree[pData->nDynCacheFree++] = iEntry;
 		ABORT_FINALIZE(localRet);
 	}
 
-	if((pCache[iFirstFree]->pName = ustrdup(newFileName)) == NULL) {
+	if((pEntry->pName = ustrdup(newFileName)) == NULL) {
 		closeFile(pData); /* need to free failed entry! */
+		pData->dynCacheFree[pData->nDynCacheFree++] = iEntry;
+		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
+	}
+	if(!hashtable_insert(pData->dynCacheIdx, pEntry->pName, pEntry)) {
+		closeFile(pData);
+		free(pEntry->pName);
+		pEntry->pName = NULL;
+		pData->dynCacheFree[pData->nDynCacheFree++] = iEntry;
 		ABORT_FINALIZE(RS_RET_OUT_OF_MEMORY);
 	}
-	pCache[iFirstFree]->pStrm = pData->pStrm;
+	dynaFileLRUPushFront(pData, pEntry);
+	pEntry->pStrm = pData->pStrm;
 	if(pData->useSigprov)
-		pCache[iFirstFree]->sigprovFileData = pData->sigprovFileData;
-	pCache[iFirstFree]->clkTickAccessed = getClockFileAccess();
-	pData->iCurrElt = iFirstFree;
-	DBGPRINTF("Added new entry %d for file cache, file '%s'.\n", iFirstFree, newFileName);
+		pEntry->sigprovFileData = pData->sigprovFileData;
+	pData->iCurrElt = iEntry;
+	DBGPRINTF("Added new entry %d for file cache, file '%s'.\n", iEntry, newFileName);
 
 finalize_it:
 	if(iRet == RS_RET_OK)
@@ -821,6 +935,51 @@ finalize_it:
 }
 
 
+/* write a set of messages to pStrm via gather writes. This hands the
+ * rendered template strings directly to the stream, which saves copying
+ * them into the stream buffer. As the stream then writes right away, this
+ * must only be used when the stream is flushed at transaction end anyhow.
+ * Messages are either iMsg..nParams-1 or, if pNext is given, the list
+ * starting at iMsg and linked via pNext (terminated by -1, nParams is
+ * ignored in that case).
+ */
+static rsRetVal
+writeGathered(instanceData *__restrict__ const pData, strm_t *const pStrm,
+	const actWrkrIParams_t *__restrict__ const pParams, int iMsg,
+	const int *const pNext, const unsigned nParams)
+{
+	struct iovec iov[WRITEV_CHUNK];
+	int nIov = 0;
+	int i;
+	DEFiRet;
+
+	if(pNext == NULL && (unsigned) iMsg >= nParams)
+		FINALIZE;
+
+	while(iMsg != -1) {
+		iov[nIov].iov_base = actParam(pParams, pData->iNumTpls, iMsg, 0).param;
+		iov[nIov].iov_len = actParam(pParams, pData->iNumTpls, iMsg, 0).lenStr;
+		if(pNext == NULL)
+			iMsg = ((unsigned) iMsg + 1 < nParams) ? iMsg + 1 : -1;
+		else
+			iMsg = pNext[iMsg];
+		if(++nIov == WRITEV_CHUNK || iMsg == -1) {
+			CHKiRet(strm.WriteV(pStrm, iov, nIov));
+			if(pData->useSigprov) {
+				for(i = 0 ; i < nIov ; ++i) {
+					CHKiRet(pData->sigprov.OnRecordWrite(pData->sigprovFileData,
+						iov[i].iov_base, iov[i].iov_len));
+				}
+			}
+			nIov = 0;
+		}
+	}
+
+finalize_it:
+	RETiRet;
+}
+
+
 /* rgerhards 2004-11-11: write to a file output.  */
 static rsRetVal
 writeFile(instanceData *__restrict__ const pData,
@@ -856,6 +1015,249 @@ finalize_it:
 }
 
 
+/* write one group of messages to its dynafile. This is called by the
+ * writer threads as well as the action worker, without mutDynWr held.
+ * Like in the sequential case, with flushOnTXEnd the result of the gathered
+ * write and the final flush is returned via pGrp->iRet (and propagated by
+ * dynaFileWrFlushPending()). Without it, messages are written one by one and,
+ * as in writeFile(), a failed write does not fail the transaction.
+ */
+static void
+dynaFileWrWriteGrp(instanceData *__restrict__ const pData, const int iEntry)
+{
+	dynaFileWrGrp_t *const pGrp = &pData->dynWrGrps[iEntry];
+	strm_t *const pStrm = pData->dynCache[iEntry]->pStrm;
+	const actWrkrIParams_t *const pParams = pData->dynWrParams;
+	int i;
+
+	if(pData->bFlushOnTXEnd) {
+		pGrp->iRet = writeGathered(pData, pStrm, pParams, pGrp->iFirst,
+			pData->dynWrMsgNext, 0);
+		if(pGrp->iRet == RS_RET_OK)
+			pGrp->iRet = strm.Flush(pStrm);
+		return;
+	}
+
+	for(i = pGrp->iFirst ; i != -1 ; i = pData->dynWrMsgNext[i]) {
+		strm.Write(pStrm, actParam(pParams, pData->iNumTpls, i, 0).param,
+			actParam(pParams, pData->iNumTpls, i, 0).lenStr);
+	}
+	pGrp->iRet = RS_RET_OK;
+}
+
+
+/* pick up the next job and process it. Must be called with mutDynWr
+ * locked, returns with it locked.
+ */
+static void
+dynaFileWrDoJob(instanceData *__restrict__ const pData)
+{
+	const int iEntry = pData->dynWrActive[pData->iDynWrNext++];
+	pthread_mutex_unlock(&pData->mutDynWr);
+	dynaFileWrWriteGrp(pData, iEntry);
+	pthread_mutex_lock(&pData->mutDynWr);
+	if(++pData->nDynWrDone == pData->nDynWrJobs)
+		pthread_cond_signal(&pData->condDynWrDone);
+}
+
+
+/* the dynafile writer thread */
+static void *
+dynaFileWrThrd(void *arg)
+{
+	instanceData *__restrict__ const pData = (instanceData*) arg;
+
+	pthread_mutex_lock(&pData->mutDynWr);
+	while(1) {
+		while(!pData->bDynWrShutdown && pData->iDynWrNext >= pData->nDynWrJobs)
+			pthread_cond_wait(&pData->condDynWr, &pData->mutDynWr);
+		if(pData->bDynWrShutdown)
+			break;
+		dynaFileWrDoJob(pData);
+	}
+	pthread_mutex_unlock(&pData->mutDynWr);
+	return NULL;
+}
+
+
+/* start the writer threads. We do this on first use, so that no threads
+ * are created during config processing. If some threads cannot be started,
+ * we carry on with the ones we have - the action worker always takes part
+ * in writing, so we never depend on a writer thread being available.
+ */
+static void
+dynaFileWrStart(instanceData *__restrict__ const pData)
+{
+	int r;
+
+	if(pData->dynWrThrds != NULL)
+		return;
+	if((pData->dynWrThrds = calloc(pData->nDynWriters, sizeof(pthread_t))) == NULL)
+		return;
+	while(pData->nDynWrThrds < pData->nDynWriters) {
+		r = pthread_create(&pData->dynWrThrds[pData->nDynWrThrds], NULL, dynaFileWrThrd, pData);
+		if(r != 0) {
+			LogError(r, RS_RET_ERR, "omfile: could not start dynafile writer thread "
+				"%d of %d for '%s'", pData->nDynWrThrds+1, pData->nDynWriters,
+				pData->fname);
+			break;
+		}
+		++pData->nDynWrThrds;
+	}
+}
+
+
+/* stop the writer threads and free the writer resources */
+static void
+dynaFileWrFree(instanceData *__restrict__ const pData)
+{
+	int i;
+
+	if(pData->dynWrGrps == NULL)
+		return;
+	pthread_mutex_lock(&pData->mutDynWr);
+	pData->bDynWrShutdown = 1;
+	pthread_cond_broadcast(&pData->condDynWr);
+	pthread_mutex_unlock(&pData->mutDynWr);
+	for(i = 0 ; i < pData->nDynWrThrds ; ++i)
+		pthread_join(pData->dynWrThrds[i], NULL);
+	free(pData->dynWrThrds);
+	free(pData->dynWrGrps);
+	free(pData->dynWrActive);
+	free(pData->dynWrMsgNext);
+	pthread_cond_destroy(&pData->condDynWrDone);
+	pthread_cond_destroy(&pData->condDynWr);
+	pthread_mutex_destroy(&pData->mutDynWr);
+}
+
+
+/* set up the parallel writer data structures (threads are started on
+ * first use).
+ */
+static rsRetVal
+dynaFileWrInit(instanceData *__restrict__ const pData)
+{
+	int i;
+	DEFiRet;
+
+	CHKmalloc(pData->dynWrGrps = calloc(pData->iDynaFileCacheSize, sizeof(dynaFileWrGrp_t)));
+	CHKmalloc(pData->dynWrActive = calloc(pData->iDynaFileCacheSize, sizeof(int)));
+	for(i = 0 ; i < pData->iDynaFileCacheSize ; ++i)
+		pData->dynWrGrps[i].iFirst = -1;
+	pthread_mutex_init(&pData->mutDynWr, NULL);
+	pthread_cond_init(&pData->condDynWr, NULL);
+	pthread_cond_init(&pData->condDynWrDone, NULL);
+
+finalize_it:
+	if(iRet != RS_RET_OK) {
+		free(pData->dynWrGrps);
+		pData->dynWrGrps = NULL;
+		free(pData->dynWrActive);
+		pData->dynWrActive = NULL;
+	}
+	RETiRet;
+}
+
+
+/* write all pending groups in parallel and wait until they are done.
+ * Returns the first flush error, if any.
+ */
+static rsRetVal
+dynaFileWrFlushPending(instanceData *__restrict__ const pData)
+{
+	int i;
+	dynaFileWrGrp_t *pGrp;
+	DEFiRet;
+
+	if(pData->nDynWrActive == 0)
+		FINALIZE;
+
+	dynaFileWrStart(pData);
+	pthread_mutex_lock(&pData->mutDynWr);
+	pData->iDynWrNext = 0;
+	pData->nDynWrDone = 0;
+	pData->nDynWrJobs = pData->nDynWrActive;
+	if(pData->nDynWrJobs > 1)
+		pthread_cond_broadcast(&pData->condDynWr);
+	while(pData->iDynWrNext < pData->nDynWrJobs)
+		dynaFileWrDoJob(pData);
+	while(pData->nDynWrDone < pData->nDynWrJobs)
+		pthread_cond_wait(&pData->condDynWrDone, &pData->mutDynWr);
+	pData->nDynWrJobs = 0;
+	pData->iDynWrNext = 0;
+	pthread_mutex_unlock(&pData->mutDynWr);
+
+	for(i = 0 ; i < pData->nDynWrActive ; ++i) {
+		pGrp = &pData->dynWrGrps[pData->dynWrActive[i]];
+		if(pGrp->iRet != RS_RET_OK && iRet == RS_RET_OK)
+			iRet = pGrp->iRet;
+		pGrp->iFirst = -1;
+	}
+	pData->nDynWrActive = 0;
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* dynafile commit with parallel writers. The batch is partitioned by the
+ * target file, keeping message order inside each file. File lookup and
+ * opening are done here, single-threaded, as they modify the cache. If a
+ * cache miss would evict an entry, the pending groups are written first,
+ * so that no stream with pending data is ever closed.
+ */
+static rsRetVal
+dynaFileWrCommit(instanceData *__restrict__ const pData,
+	const actWrkrIParams_t *__restrict__ const pParams,
+	const unsigned nParams)
+{
+	unsigned i;
+	int *newNext;
+	uchar *newFileName;
+	dynaFileWrGrp_t *pGrp;
+	rsRetVal localRet;
+	DEFiRet;
+
+	if(nParams > pData->maxDynWrMsgs) {
+		CHKmalloc(newNext = realloc(pData->dynWrMsgNext, nParams * sizeof(int)));
+		pData->dynWrMsgNext = newNext;
+		pData->maxDynWrMsgs = nParams;
+	}
+	pData->dynWrParams = pParams;
+
+	for(i = 0 ; i < nParams ; ++i) {
+		STATSCOUNTER_INC(pData->ctrRequests, pData->mutCtrRequests);
+		newFileName = actParam(pParams, pData->iNumTpls, i, 1).param;
+		if(   pData->nDynWrActive > 0
+		   && pData->nDynCacheFree == 0
+		   && pData->iCurrCacheSize == pData->iDynaFileCacheSize
+		   && hashtable_search(pData->dynCacheIdx, newFileName) == NULL) {
+			localRet = dynaFileWrFlushPending(pData);
+			if(iRet == RS_RET_OK)
+				iRet = localRet;
+		}
+		if(prepareDynFile(pData, newFileName) != RS_RET_OK)
+			continue; /* error already reported, message discarded */
+		pGrp = &pData->dynWrGrps[pData->iCurrElt];
+		if(pGrp->iFirst == -1) {
+			pGrp->iFirst = i;
+			pData->dynWrActive[pData->nDynWrActive++] = pData->iCurrElt;
+		} else {
+			pData->dynWrMsgNext[pGrp->iLast] = i;
+		}
+		pGrp->iLast = i;
+		pData->dynWrMsgNext[i] = -1;
+	}
+
+	localRet = dynaFileWrFlushPending(pData);
+	if(iRet == RS_RET_OK)
+		iRet = localRet;
+
+finalize_it:
+	RETiRet;
+}
+
+
 BEGINbeginCnfLoad
 CODESTARTbeginCnfLoad
 	loadModConf = pModConf;
@@ -1020,6 +1422,7 @@ CODESTARTfreeInstance
 	if(pData->iCloseTimeout > 0)
 		janitorDelEtry(pData->janitorID);
 	if(pData->bDynamicName) {
+		dynaFileWrFree(pData);
 		dynaFileFreeCache(pData);
 	} else if(pData->pStrm != NULL)
 		closeFile(pData);
@@ -1064,8 +1467,33 @@ BEGINcommitTransaction
 CODESTARTcommitTransaction
 	pthread_mutex_lock(&pData->mutWrite);
 
-	for(i = 0 ; i < nParams ; ++i) {
-		writeFile(pData, pParams, i);
+	if(pData->nDynWriters > 0) {
+		CHKiRet(dynaFileWrCommit(pData, pParams, nParams));
+		FINALIZE;
+	}
+
+	if(!pData->bDynamicName && pData->bFlushOnTXEnd) {
+		/* we flush below anyhow, so hand the whole batch to the stream in
+		 * one go instead of copying each message into its buffer.
+		 */
+		STATSCOUNTER_ADD(pData->ctrRequests, pData->mutCtrRequests, nParams);
+		if(pData->pStrm == NULL) {
+			/* like in writeFile(), an open error is reported but does
+			 * not fail the transaction.
+			 */
+			if(prepareFile(pData, pData->fname) != RS_RET_OK || pData->pStrm == NULL) {
+				parser_errmsg(
+					"Could not open output file '%s'", pData->fname);
+			}
+		}
+		pData->nInactive = 0;
+		if(pData->pStrm != NULL) {
+			CHKiRet(writeGathered(pData, pData->pStrm, pParams, 0, NULL, nParams));
+		}
+	} else {
+		for(i = 0 ; i < nParams ; ++i) {
+			writeFile(pData, pParams, i);
+		}
 	}
 	/* Note: pStrm may be NULL if there was an error opening the stream */
 	/* if bFlushOnTXEnd is set, we need to flush on transaction end - in
@@ -1115,6 +1543,12 @@ setInstParamDefaults(instanceData *__restrict__ const pData)
 	pData->useSigprov = 0;
 	pData->useCryprov = 0;
 	pData->iCloseTimeout = -1;
+	pData->nDynWriters = 0;
+	pData->compressionDriver = STRM_COMPRESS_ZIP;
+	pData->iZstdWorkers = 0;
+	pData->iPreallocSize = 0;
+	pData->bDirectIO = 0;
+	pData->bDropCache = 0;
 }
 
 
@@ -1140,6 +1574,9 @@ setupInstStatsCtrs(instanceData *__restrict__ const pData)
 	STATSCOUNTER_INIT(pData->ctrLevel0, pData->mutCtrLevel0);
 	CHKiRet(statsobj.AddCounter(pData->stats, UCHAR_CONSTANT("level0"),
 		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &(pData->ctrLevel0)));
+	STATSCOUNTER_INIT(pData->ctrHit, pData->mutCtrHit);
+	CHKiRet(statsobj.AddCounter(pData->stats, UCHAR_CONSTANT("hits"),
+		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &(pData->ctrHit)));
 	STATSCOUNTER_INIT(pData->ctrMiss, pData->mutCtrMiss);
 	CHKiRet(statsobj.AddCounter(pData->stats, UCHAR_CONSTANT("missed"),
 		ctrType_IntCtr, CTR_FLAG_RESETTABLE, &(pData->ctrMiss)));
@@ -1328,6 +1765,28 @@ CODESTARTnewActInst
 			pData->cryprovName = (uchar*)es_str2cstr(pvals[i].val.d.estr, NULL);
 		} else if(!strcmp(actpblk.descr[i].name, "closetimeout")) {
 			pData->iCloseTimeout = (int) pvals[i].val.d.n;
+		} else if(!strcmp(actpblk.descr[i].name, "dynafile.writers")) {
+			pData->nDynWriters = (int) pvals[i].val.d.n;
+		} else if(!strcmp(actpblk.descr[i].name, "compression.driver")) {
+			if(!es_strcasebufcmp(pvals[i].val.d.estr, (uchar*)"zlib", 4)) {
+				pData->compressionDriver = STRM_COMPRESS_ZIP;
+			} else if(!es_strcasebufcmp(pvals[i].val.d.estr, (uchar*)"zstd", 4)) {
+				pData->compressionDriver = STRM_COMPRESS_ZSTD;
+			} else if(!es_strcasebufcmp(pvals[i].val.d.estr, (uchar*)"lz4", 3)) {
+				pData->compressionDriver = STRM_COMPRESS_LZ4;
+			} else {
+				parser_errmsg("omfile: invalid compression.driver, "
+					"must be one of \"zlib\", \"zstd\" or \"lz4\"");
+				ABORT_FINALIZE(RS_RET_PARAM_ERROR);
+			}
+		} else if(!strcmp(actpblk.descr[i].name, "compression.zstd.workers")) {
+			pData->iZstdWorkers = (int) pvals[i].val.d.n;
+		} else if(!strcmp(actpblk.descr[i].name, "preallocation.size")) {
+			pData->iPreallocSize = (off_t) pvals[i].val.d.n;
+		} else if(!strcmp(actpblk.descr[i].name, "io.direct")) {
+			pData->bDirectIO = (sbool) pvals[i].val.d.n;
+		} else if(!strcmp(actpblk.descr[i].name, "io.dropcache")) {
+			pData->bDropCache = (sbool) pvals[i].val.d.n;
 		} else {
 			dbgprintf("omfile: program error, non-handled "
 			  "param '%s'\n", actpblk.descr[i].name);
@@ -1353,6 +1812,17 @@ CODESTARTnewActInst
 		ABORT_FINALIZE(RS_RET_MISSING_CNFPARAMS);
 	}
 
+	if(pData->compressionDriver != STRM_COMPRESS_ZIP && pData->iZipLevel == 0) {
+		parser_errmsg("omfile: compression.driver is set, but zipLevel is not - "
+			"file '%s' will be written uncompressed", pData->fname);
+	}
+
+	if(pData->bDirectIO && (pData->iZipLevel || pData->cryprovName != NULL)) {
+		parser_errmsg("omfile: io.direct cannot be used together with compression "
+			"or encryption - file '%s' will be written without direct I/O", pData->fname);
+		pData->bDirectIO = 0;
+	}
+
 	if(pData->sigprovName != NULL) {
 		initSigprov(pData, lst);
 	}
@@ -1373,9 +1843,19 @@ CODESTARTnewActInst
 		pData->iNumTpls = 2;
 		// TODO: create unified code for this (legacy+v6 system)
 		/* we now allocate the cache table */
-		CHKmalloc(pData->dynCache = (dynaFileCacheEntry**)
-				calloc(pData->iDynaFileCacheSize, sizeof(dynaFileCacheEntry*)));
-		pData->iCurrElt = -1;		  /* no current element */
+		CHKiRet(dynaFileAllocCache(pData, pData->iDynaFileCacheSize));
+		if(pData->nDynWriters > 0 && pData->useSigprov) {
+			parser_errmsg("omfile: dynafile.writers cannot be used together with "
+				"a signature provider, parallel writers disabled for '%s'",
+				pData->fname);
+			pData->nDynWriters = 0;
+		}
+		if(pData->nDynWriters > 0)
+			CHKiRet(dynaFileWrInit(pData));
+	} else if(pData->nDynWriters > 0) {
+		parser_errmsg("omfile: dynafile.writers is only supported for dynafile "
+			"actions, ignored for file '%s'", pData->fname);
+		pData->nDynWriters = 0;
 	}
 // TODO: add	pData->iSizeLimit = 0; /* default value, use outchannels to configure! */
 	setupInstStatsCtrs(pData);
@@ -1450,8 +1930,7 @@ CODESTARTparseSelectorAct
 		 */
 		CHKiRet(OMSRsetEntry(*ppOMSR, 1, ustrdup(pData->fname), OMSR_NO_RQD_TPL_OPTS));
 		/* we now allocate the cache table */
-		CHKmalloc(pData->dynCache = (dynaFileCacheEntry**)
-				calloc(cs.iDynaFileCacheSize, sizeof(dynaFileCacheEntry*)));
+		CHKiRet(dynaFileAllocCache(pData, cs.iDynaFileCacheSize));
 		break;
 
 	case '/':
@@ -1532,7 +2011,6 @@ BEGINmodExit
 CODESTARTmodExit
 	objRelease(strm, CORE_COMPONENT);
 	objRelease(statsobj, CORE_COMPONENT);
-	DESTROY_ATOMIC_HELPER_MUT(mutClock);
 ENDmodExit
 
 
@@ -1555,8 +2033,6 @@ INITLegCnfVars
 	CHKiRet(objUse(strm, CORE_COMPONENT));
 	CHKiRet(objUse(statsobj, CORE_COMPONENT));
 
-	INIT_ATOMIC_HELPER_MUT(mutClock);
-
 	INITChkCoreFeature(bCoreSupportsBatching, CORE_FEATURE_BATCHING);
 	DBGPRINTF("omfile: %susing transactional output interface.\n", bCoreSupportsBatching ? "" : "not ");
 	CHKiRet(omsdRegCFSLineHdlr((uchar *)"dynafilecachesize", 0, eCmdHdlrInt, setDynaFileCacheSize,
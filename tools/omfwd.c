@@ -29,6 +29,7 @@
 #include <string.h>
 #include <time.h>
 #include <netinet/in.h>
+#include <sys/socket.h>
 #include <netdb.h>
 #include <fnmatch.h>
 #include <assert.h>
@@ -75,6 +76,8 @@ DEFobjCurrIf(tcpclt)
 /* some local constants (just) for better readybility */
 #define IS_FLUSH 1
 #define NO_FLUSH 0
+#define DFLT_BATCH_MAXBYTES (16*1024)	/* default size of send buffer / UDP batch */
+#define UDP_MAX_BATCH 1024		/* max messages per sendmmsg() call (UIO_MAXIOV) */
 
 typedef struct _instanceData {
 	uchar 	*tplName;	/* name of assigned template */
@@ -118,6 +121,7 @@ typedef struct _instanceData {
 	uint8_t compressionMode;
 	int errsToReport;	/* max number of errors to report (per instance) */
 	sbool strmCompFlushOnTxEnd; /* flush stream compression on transaction end? */
+	unsigned batchMaxBytes;	/* max bytes to gather before we send (tcp send buffer, udp batch) */
 } instanceData;
 
 typedef struct wrkrInstanceData {
@@ -131,8 +135,17 @@ typedef struct wrkrInstanceData {
 	tcpclt_t *pTCPClt;	/* our tcpclt object */
 	sbool bzInitDone; /* did we do an init of zstrm already? */
 	z_stream zstrm;	/* zip stream to use for tcp compression */
-	uchar sndBuf[16*1024];	/* this is intensionally fixed -- see no good reason to make configurable */
+	uchar *sndBuf;		/* tcp send buffer, batchMaxBytes in size */
+	unsigned lenSndBuf;	/* size of send buffer */
 	unsigned offsSndBuf;	/* next free spot in send buffer */
+#	ifdef HAVE_SENDMMSG
+	/* UDP messages gathered during the current transaction, sent via sendmmsg() */
+	struct mmsghdr *udpMsgs;
+	struct iovec *udpIov;
+	uchar **udpOwnedBufs;	/* buffers we need to free after sending (compressed msgs), else NULL */
+	unsigned nUdpBatch;	/* number of messages in batch */
+	size_t lenUdpBatch;	/* number of bytes in batch */
+#	endif
 	int errsToReport;	/* (remaining) number of errors to report */
 } wrkrInstanceData_t;
 
@@ -197,6 +210,7 @@ static struct cnfparamdescr actpdescr[] = {
 	{ "udp.sendtoall", eCmdHdlrBinary, 0 },
 	{ "udp.senddelay", eCmdHdlrInt, 0 },
 	{ "udp.sendbuf", eCmdHdlrSize, 0 },
+	{ "batch.maxbytes", eCmdHdlrSize, 0 },
 	{ "template", eCmdHdlrGetWord, 0 }
 };
 static struct cnfparamblk actpblk =
@@ -232,6 +246,9 @@ ENDinitConfVars
 
 static rsRetVal doTryResume(wrkrInstanceData_t *);
 static rsRetVal doZipFinish(wrkrInstanceData_t *);
+#ifdef HAVE_SENDMMSG
+static void UDPBatchReset(wrkrInstanceData_t *__restrict__ const pWrkrData);
+#endif
 
 /* this function gets the default template. It coordinates action between
  * old-style and new-style configuration parts.
@@ -386,7 +403,24 @@ BEGINcreateWrkrInstance
 CODESTARTcreateWrkrInstance
 	dbgprintf("DDDD: createWrkrInstance: pWrkrData %p\n", pWrkrData);
 	pWrkrData->offsSndBuf = 0;
+	if(pData->protocol == FORW_TCP) {
+		pWrkrData->lenSndBuf = pData->batchMaxBytes;
+		CHKmalloc(pWrkrData->sndBuf = malloc(pWrkrData->lenSndBuf));
+	}
+#	ifdef HAVE_SENDMMSG
+	if(pData->protocol == FORW_UDP) {
+		unsigned i;
+		CHKmalloc(pWrkrData->udpMsgs = calloc(UDP_MAX_BATCH, sizeof(struct mmsghdr)));
+		CHKmalloc(pWrkrData->udpIov = calloc(UDP_MAX_BATCH, sizeof(struct iovec)));
+		CHKmalloc(pWrkrData->udpOwnedBufs = calloc(UDP_MAX_BATCH, sizeof(uchar*)));
+		for(i = 0 ; i < UDP_MAX_BATCH ; ++i) {
+			pWrkrData->udpMsgs[i].msg_hdr.msg_iov = &pWrkrData->udpIov[i];
+			pWrkrData->udpMsgs[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+#	endif
 	iRet = initTCP(pWrkrData);
+finalize_it:
 ENDcreateWrkrInstance
 
 
@@ -419,6 +453,15 @@ CODESTARTfreeWrkrInstance
 	if(pWrkrData->pData->protocol == FORW_TCP) {
 		tcpclt.Destruct(&pWrkrData->pTCPClt);
 	}
+	free(pWrkrData->sndBuf);
+#	ifdef HAVE_SENDMMSG
+	if(pWrkrData->udpMsgs != NULL) {
+		UDPBatchReset(pWrkrData);
+		free(pWrkrData->udpMsgs);
+		free(pWrkrData->udpIov);
+		free(pWrkrData->udpOwnedBufs);
+	}
+#	endif
 ENDfreeWrkrInstance
 
 
@@ -532,6 +575,133 @@ finalize_it:
 }
 
 
+#ifdef HAVE_SENDMMSG
+/* free all buffers in the UDP batch and reset it */
+static void
+UDPBatchReset(wrkrInstanceData_t *__restrict__ const pWrkrData)
+{
+	unsigned i;
+	for(i = 0 ; i < pWrkrData->nUdpBatch ; ++i) {
+		free(pWrkrData->udpOwnedBufs[i]);
+		pWrkrData->udpOwnedBufs[i] = NULL;
+	}
+	pWrkrData->nUdpBatch = 0;
+	pWrkrData->lenUdpBatch = 0;
+}
+
+
+/* Send all messages gathered so far in the UDP batch. We do this via
+ * sendmmsg(), so that a full batch needs only a single system call. Note
+ * that we only batch if there is a single target address, so we do not
+ * need to care about udp.sendtoall here. If sendmmsg() fails, we hand the
+ * remaining messages over to UDPSend(), which does all the error handling
+ * (message truncation, socket re-init, error reporting).
+ */
+static rsRetVal
+UDPSendBatch(wrkrInstanceData_t *__restrict__ const pWrkrData)
+{
+	unsigned i;
+	unsigned nSent = 0;
+	int r;
+	DEFiRet;
+
+	if(pWrkrData->nUdpBatch == 0)
+		FINALIZE;
+
+	if(pWrkrData->pSockArray == NULL) {
+		CHKiRet(doTryResume(pWrkrData));
+	}
+
+	if(pWrkrData->pSockArray == NULL) {
+		FINALIZE;
+	}
+
+	for(i = 0 ; i < pWrkrData->nUdpBatch ; ++i) {
+		pWrkrData->udpMsgs[i].msg_hdr.msg_name = pWrkrData->f_addr->ai_addr;
+		pWrkrData->udpMsgs[i].msg_hdr.msg_namelen = pWrkrData->f_addr->ai_addrlen;
+	}
+
+	/* as in UDPSend(), we try the sockets in order until one works */
+	for(i = 0 ; nSent < pWrkrData->nUdpBatch && i < (unsigned) *pWrkrData->pSockArray ; ++i) {
+		while(nSent < pWrkrData->nUdpBatch) {
+			r = sendmmsg(pWrkrData->pSockArray[i+1], pWrkrData->udpMsgs + nSent,
+				pWrkrData->nUdpBatch - nSent, 0);
+			if(r <= 0) {
+				DBGPRINTF("omfwd/udp: socket %d: sendmmsg() failed after %u messages, "
+					"errno %d\n", pWrkrData->pSockArray[i+1], nSent, errno);
+				break;
+			}
+			nSent += r;
+		}
+	}
+	DBGPRINTF("omfwd/udp: sent %u of %u messages via sendmmsg()\n", nSent, pWrkrData->nUdpBatch);
+
+	for( ; nSent < pWrkrData->nUdpBatch ; ++nSent) {
+		CHKiRet(UDPSend(pWrkrData, pWrkrData->udpIov[nSent].iov_base, pWrkrData->udpIov[nSent].iov_len));
+	}
+
+finalize_it:
+	UDPBatchReset(pWrkrData);
+	RETiRet;
+}
+
+
+/* add a message to the UDP batch, sending the batch first if it is full.
+ * If pOwned is given, the batch takes over ownership of that buffer.
+ */
+static rsRetVal
+UDPBatchAdd(wrkrInstanceData_t *__restrict__ const pWrkrData,
+	uchar *__restrict__ const msg,
+	size_t len,
+	uchar *const pOwned)
+{
+	unsigned n;
+	DEFiRet;
+
+	if(len > UDP_MAX_MSGSIZE) {
+		LogError(0, RS_RET_UDP_MSGSIZE_TOO_LARGE, "omfwd/udp: message is %u "
+			"bytes long, but UDP can send at most %d bytes (by RFC limit) "
+			"- truncating message", (unsigned) len, UDP_MAX_MSGSIZE);
+		len = UDP_MAX_MSGSIZE;
+	}
+
+	if(pWrkrData->nUdpBatch == UDP_MAX_BATCH
+	   || (pWrkrData->nUdpBatch > 0
+	       && pWrkrData->lenUdpBatch + len > pWrkrData->pData->batchMaxBytes)) {
+		iRet = UDPSendBatch(pWrkrData);
+		if(iRet != RS_RET_OK) {
+			free(pOwned);
+			FINALIZE;
+		}
+	}
+
+	n = pWrkrData->nUdpBatch++;
+	pWrkrData->udpIov[n].iov_base = msg;
+	pWrkrData->udpIov[n].iov_len = len;
+	pWrkrData->udpOwnedBufs[n] = pOwned;
+	pWrkrData->lenUdpBatch += len;
+
+finalize_it:
+	RETiRet;
+}
+
+
+/* we can only batch if UDPSend() would always send to a single address
+ * and there is no per-message work (rebind counting, send delay) to do.
+ */
+static int
+UDPCanBatch(wrkrInstanceData_t *__restrict__ const pWrkrData)
+{
+	const instanceData *__restrict__ const pData = pWrkrData->pData;
+	return pWrkrData->udpMsgs != NULL
+		&& pData->iRebindInterval == 0
+		&& pData->iUDPSendDelay == 0
+		&& pWrkrData->f_addr != NULL
+		&& pWrkrData->f_addr->ai_next == NULL;
+}
+#endif /* #ifdef HAVE_SENDMMSG */
+
+
 /* set the permitted peers -- rgerhards, 2008-05-19
  */
 static rsRetVal
@@ -686,7 +856,7 @@ static rsRetVal TCPSendFrame(void *pvData, char *msg, size_t len)
 
 	DBGPRINTF("omfwd: add %u bytes to send buffer (curr offs %u)\n",
 		(unsigned) len, pWrkrData->offsSndBuf);
-	if(pWrkrData->offsSndBuf != 0 && pWrkrData->offsSndBuf + len >= sizeof(pWrkrData->sndBuf)) {
+	if(pWrkrData->offsSndBuf != 0 && pWrkrData->offsSndBuf + len >= pWrkrData->lenSndBuf) {
 		/* no buffer space left, need to commit previous records. With the
 		 * current API, there unfortunately is no way to signal this
 		 * state transition to the upper layer.
@@ -699,7 +869,7 @@ static rsRetVal TCPSendFrame(void *pvData, char *msg, size_t len)
 	}
 
 	/* check if the message is too large to fit into buffer */
-	if(len > sizeof(pWrkrData->sndBuf)) {
+	if(len > pWrkrData->lenSndBuf) {
 		CHKiRet(TCPSendBuf(pWrkrData, (uchar*)msg, len, NO_FLUSH));
 		ABORT_FINALIZE(RS_RET_OK);	/* committed everything so far */
 	}
@@ -1029,6 +1199,16 @@ processMsg(wrkrInstanceData_t *__restrict__ const pWrkrData,
 
 	if(pData->protocol == FORW_UDP) {
 		/* forward via UDP */
+#		ifdef HAVE_SENDMMSG
+		if(UDPCanBatch(pWrkrData)) {
+			/* the batch takes over the compression buffer, if we used it */
+			uchar *const pOwned = (psz == out) ? out : NULL;
+			if(pOwned != NULL)
+				out = NULL;
+			CHKiRet(UDPBatchAdd(pWrkrData, psz, l, pOwned));
+			FINALIZE;
+		}
+#		endif
 		CHKiRet(UDPSend(pWrkrData, psz, l));
 	} else {
 		/* forward via TCP */
@@ -1064,7 +1244,15 @@ CODESTARTcommitTransaction
 		iRet = TCPSendBuf(pWrkrData, pWrkrData->sndBuf, pWrkrData->offsSndBuf, IS_FLUSH);
 		pWrkrData->offsSndBuf = 0;
 	}
+#	ifdef HAVE_SENDMMSG
+	if(pWrkrData->nUdpBatch != 0) {
+		iRet = UDPSendBatch(pWrkrData);
+	}
+#	endif
 finalize_it:
+#	ifdef HAVE_SENDMMSG
+	UDPBatchReset(pWrkrData); /* no-op if already sent, drops batch on error */
+#	endif
 ENDcommitTransaction
 
 
@@ -1142,6 +1330,7 @@ setInstParamDefaults(instanceData *pData)
 	pData->strmCompFlushOnTxEnd = 1;
 	pData->compressionMode = COMPRESS_NEVER;
 	pData->ipfreebind = IPFREEBIND_ENABLED_WITH_LOG;
+	pData->batchMaxBytes = DFLT_BATCH_MAXBYTES;
 }
 
 BEGINnewActInst
@@ -1286,6 +1475,14 @@ CODESTARTnewActInst
 			pData->iUDPSendDelay = (int) pvals[i].val.d.n;
 		} else if(!strcmp(actpblk.descr[i].name, "udp.sendbuf")) {
 			pData->UDPSendBuf = (int) pvals[i].val.d.n;
+		} else if(!strcmp(actpblk.descr[i].name, "batch.maxbytes")) {
+			if(pvals[i].val.d.n < 1024) {
+				parser_errmsg("omfwd: batch.maxbytes must be at least 1024 but is %lld "
+					"- using 1024", (long long) pvals[i].val.d.n);
+				pData->batchMaxBytes = 1024;
+			} else {
+				pData->batchMaxBytes = (unsigned) pvals[i].val.d.n;
+			}
 		} else if(!strcmp(actpblk.descr[i].name, "template")) {
 			pData->tplName = (uchar*)es_str2cstr(pvals[i].val.d.estr, NULL);
 		} else if(!strcmp(actpblk.descr[i].name, "compression.stream.flushontxend")) {
@@ -1490,6 +1687,7 @@ CODE_STD_STRING_REQUESTparseSelectorAct(1)
 	/* copy over config data as needed */
 	pData->iRebindInterval = (pData->protocol == FORW_TCP) ?
 				 cs.iTCPRebindInterval : cs.iUDPRebindInterval;
+	pData->batchMaxBytes = DFLT_BATCH_MAXBYTES;
 
 	pData->bKeepAlive = cs.bKeepAlive;
 	pData->iKeepAliveProbes = cs.iKeepAliveProbes;
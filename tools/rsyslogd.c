@@ -62,6 +62,7 @@
 #include "dirty.h"
 #include "janitor.h"
 #include "parserif.h"
+#include "executor.h"
 
 /* some global vars we need to differentiate between environments,
  * for TZ-related things see
@@ -2028,6 +2029,9 @@ deinitAll(void)
 	DBGPRINTF("Terminating outputs...\n");
 	rsyslogd_destructAllActions();
 
+	/* all queues are gone, so the shared executor has nothing left to do */
+	executorExit();
+
 	DBGPRINTF("all primary multi-thread sources have been terminated - now doing aux cleanup...\n");
 
 	DBGPRINTF("destructing current config...\n");